@@ -56,6 +56,8 @@ enum access_query_e
     ACCESS_GET_CONTENT_TYPE,/* arg1=char **ppsz_content_type res=can fail */
 
     ACCESS_GET_SIGNAL,      /* arg1=double *pf_quality, arg2=double *pf_strength   res=can fail */
+    ACCESS_GET_STALLS,      /* arg1=uint64_t *pi_count, arg2=int64_t *pi_time (us)   res=can fail */
+    ACCESS_GET_CONNECTION_STATS, /* arg1=uint64_t *pi_cache_hits, arg2=uint64_t *pi_cache_hit_bytes, arg3=uint64_t *pi_reuses, arg4=uint64_t *pi_reconnections   res=can fail */
 
     /* */
     ACCESS_SET_PAUSE_STATE = 0x200, /* arg1= bool           can fail */
@@ -174,6 +174,11 @@ enum demux_query_e
     DEMUX_NAV_DOWN,            /* res=can fail */
     DEMUX_NAV_LEFT,            /* res=can fail */
     DEMUX_NAV_RIGHT,           /* res=can fail */
+
+    /* Packets of the network stream, counted since the demux was opened */
+    DEMUX_GET_PACKET_STATS,    /* arg1= uint64_t *pi_lost, arg2= uint64_t *pi_late,
+                                  arg3= uint64_t *pi_reordered,
+                                  arg4= uint64_t *pi_duplicate   res=can fail */
 };
 
 VLC_API int demux_vaControlHelper( stream_t *, int64_t i_start, int64_t i_end, int64_t i_bitrate, int i_align, int i_query, va_list args );
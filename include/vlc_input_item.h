@@ -281,6 +281,7 @@ VLC_API void input_item_Release(input_item_t *);
 
 VLC_API int libvlc_MetaRequest(libvlc_int_t *, input_item_t *);
 VLC_API int libvlc_ArtRequest(libvlc_int_t *, input_item_t *);
+VLC_API void libvlc_MetaCancel(libvlc_int_t *, input_item_t *);
 
 /******************
  * Input stats
@@ -319,6 +320,27 @@ struct input_stats_t
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Network packets, as counted by the demux */
+    int64_t i_packets_lost;
+    int64_t i_packets_late;
+    int64_t i_packets_reordered;
+    int64_t i_packets_duplicate;
+
+    /* Reads waiting for the access, summed over the streams of the input */
+    int64_t i_read_stalls;
+    int64_t i_read_stall_time; /* in microseconds */
+
+    /* Stream cache, summed over the streams of the input */
+    int64_t i_stream_cache_size;
+    int64_t i_stream_read_size;
+    int64_t i_stream_seeks;
+
+    /* Access range cache and connections, summed over the streams */
+    int64_t i_cache_hits;
+    int64_t i_cache_hit_bytes;
+    int64_t i_connection_reuses;
+    int64_t i_reconnections;
 };
 
 #endif
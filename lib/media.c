@@ -425,6 +425,14 @@ void libvlc_media_release( libvlc_media_t *p_md )
     if( p_md->p_subitems )
         libvlc_media_list_release( p_md->p_subitems );
 
+    /* Nobody is left to wait for a pending parsing request */
+    vlc_mutex_lock( &p_md->parsed_lock );
+    bool b_pending = p_md->has_asked_preparse && !p_md->is_parsed;
+    vlc_mutex_unlock( &p_md->parsed_lock );
+    if( b_pending )
+        libvlc_MetaCancel( p_md->p_libvlc_instance->p_libvlc_int,
+                           p_md->p_input_item );
+
     uninstall_input_item_observer( p_md );
     vlc_gc_decref( p_md->p_input_item );
 
@@ -51,6 +51,9 @@
 #else
 #   include <unistd.h>
 #endif
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 #include <dirent.h>
 
 #include <vlc_common.h>
@@ -64,12 +67,39 @@
 #include <vlc_fs.h>
 #include <vlc_url.h>
 
+/* Largest amount of data read at once by the prefetch thread */
+#define PREFETCH_CHUNK (256 << 10)
+/* Size of the file windows mapped in memory */
+#define MMAP_WINDOW (4 << 20)
+
 struct access_sys_t
 {
     int fd;
 
     bool b_pace_control;
     uint64_t size;
+
+    /* Memory mapping */
+    size_t i_page;
+
+    /* Prefetching */
+    uint8_t *p_ring;
+    size_t i_ring;
+    size_t i_head;      /* ring index of the current position */
+    size_t i_fill;      /* bytes available from the current position */
+    uint64_t i_offset;  /* file offset of the current position */
+    unsigned i_seek;    /* bumped on every seek, invalidates reads */
+    int i_error;
+    bool b_eof;
+    bool b_closing;
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t wait_space;
+    vlc_cond_t wait_data;
+
+    /* Statistics */
+    uint64_t i_stalls;
+    mtime_t i_stall_time;
 };
 
 #if !defined (_WIN32) && !defined (__OS2__)
@@ -130,6 +160,10 @@ static bool IsRemote (const char *path)
 
 static ssize_t FileRead (access_t *, uint8_t *, size_t);
 static int FileSeek (access_t *, uint64_t);
+static block_t *MmapBlock (access_t *);
+static ssize_t PrefetchRead (access_t *, uint8_t *, size_t);
+static int PrefetchSeek (access_t *, uint64_t);
+static void *PrefetchThread (void *);
 static ssize_t StreamRead (access_t *, uint8_t *, size_t);
 static int NoSeek (access_t *, uint64_t);
 static int FileControl (access_t *, int, va_list);
@@ -215,7 +249,7 @@ int FileOpen( vlc_object_t *p_this )
 #endif
     }
 
-    access_sys_t *p_sys = malloc (sizeof (*p_sys));
+    access_sys_t *p_sys = calloc (1, sizeof (*p_sys));
     if (unlikely(p_sys == NULL))
         goto error;
     access_InitFields (p_access);
@@ -241,6 +275,49 @@ int FileOpen( vlc_object_t *p_this )
 #ifdef F_NOCACHE
         fcntl (fd, F_NOCACHE, 0);
 #endif
+
+#ifdef HAVE_MMAP
+        /* Block devices have no size in st_size and cannot grow: only map
+         * regular files. */
+        if (S_ISREG (st.st_mode) && var_InheritBool (p_access, "file-mmap"))
+        {
+            p_access->pf_read = NULL;
+            p_access->pf_block = MmapBlock;
+            p_sys->i_page = sysconf (_SC_PAGESIZE);
+            posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+        if (p_access->pf_block == NULL)
+            p_sys->i_ring = var_InheritInteger (p_access, "file-prefetch")
+                            * 1024;
+        if (p_sys->i_ring > 0)
+        {
+            p_sys->p_ring = malloc (p_sys->i_ring);
+            if (unlikely(p_sys->p_ring == NULL))
+            {
+                free (p_sys);
+                goto error;
+            }
+            vlc_mutex_init (&p_sys->lock);
+            vlc_cond_init (&p_sys->wait_space);
+            vlc_cond_init (&p_sys->wait_data);
+
+            if (vlc_clone (&p_sys->thread, PrefetchThread, p_access,
+                           VLC_THREAD_PRIORITY_INPUT))
+            {
+                vlc_cond_destroy (&p_sys->wait_data);
+                vlc_cond_destroy (&p_sys->wait_space);
+                vlc_mutex_destroy (&p_sys->lock);
+                free (p_sys->p_ring);
+                p_sys->p_ring = NULL;
+            }
+            else
+            {
+                p_access->pf_read = PrefetchRead;
+                p_access->pf_seek = PrefetchSeek;
+                posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
+        }
     }
     else
     {
@@ -264,7 +341,7 @@ void FileClose (vlc_object_t * p_this)
 {
     access_t     *p_access = (access_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_block == DirBlock)
     {
         DirClose (p_this);
         return;
@@ -272,6 +349,19 @@ void FileClose (vlc_object_t * p_this)
 
     access_sys_t *p_sys = p_access->p_sys;
 
+    if (p_sys->p_ring != NULL)
+    {
+        vlc_mutex_lock (&p_sys->lock);
+        p_sys->b_closing = true;
+        vlc_cond_signal (&p_sys->wait_space);
+        vlc_mutex_unlock (&p_sys->lock);
+        vlc_join (p_sys->thread, NULL);
+
+        vlc_cond_destroy (&p_sys->wait_data);
+        vlc_cond_destroy (&p_sys->wait_space);
+        vlc_mutex_destroy (&p_sys->lock);
+        free (p_sys->p_ring);
+    }
     close (p_sys->fd);
     free (p_sys);
 }
@@ -329,6 +419,223 @@ static int FileSeek (access_t *p_access, uint64_t i_pos)
     return VLC_SUCCESS;
 }
 
+#ifdef HAVE_MMAP
+/**
+ * Maps the next window of a regular file.
+ */
+static block_t *MmapBlock (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+
+    /* The file may be growing, e.g. while it is being recorded */
+    if (i_pos >= p_sys->size)
+    {
+        struct stat st;
+
+        if (fstat (p_sys->fd, &st) == 0)
+            p_sys->size = st.st_size;
+        if (i_pos >= p_sys->size)
+        {
+            p_access->info.b_eof = true;
+            return NULL;
+        }
+    }
+
+    /* Never map beyond the end of the file, this would cause SIGBUS */
+    uint64_t i_offset = i_pos & ~(uint64_t)(p_sys->i_page - 1);
+    size_t i_skip = i_pos - i_offset;
+    size_t i_length = __MIN(p_sys->size - i_offset, MMAP_WINDOW);
+
+    void *addr = mmap (NULL, i_length, PROT_READ, MAP_PRIVATE, p_sys->fd,
+                       i_offset);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "memory mapping failed: %s",
+                 vlc_strerror_c(errno));
+        /* Fall back to plain reads */
+        size_t i_len = __MIN(p_sys->size - i_pos, MMAP_WINDOW);
+        block_t *p_block = block_Alloc (i_len);
+        if (unlikely(p_block == NULL))
+            return NULL;
+
+        ssize_t val = pread (p_sys->fd, p_block->p_buffer, i_len, i_pos);
+        if (val <= 0)
+        {
+            block_Release (p_block);
+            if (val == 0)
+                p_access->info.b_eof = true;
+            return NULL;
+        }
+        p_block->i_buffer = val;
+        p_access->info.i_pos += val;
+        return p_block;
+    }
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise (addr, i_length, POSIX_MADV_SEQUENTIAL);
+#endif
+
+    block_t *p_block = block_mmap_Alloc (addr, i_length);
+    if (unlikely(p_block == NULL))
+        return NULL;
+
+    p_block->p_buffer += i_skip;
+    p_block->i_buffer -= i_skip;
+    p_access->info.i_pos += p_block->i_buffer;
+    return p_block;
+}
+#endif
+
+/**
+ * Fills the ring ahead of the current position.
+ */
+static void *PrefetchThread (void *data)
+{
+    access_t *p_access = data;
+    access_sys_t *p_sys = p_access->p_sys;
+    int fd = p_sys->fd;
+    unsigned i_seek = 0;
+
+    vlc_mutex_lock (&p_sys->lock);
+    for (;;)
+    {
+        while (!p_sys->b_closing && p_sys->i_seek == i_seek
+            && (p_sys->i_fill == p_sys->i_ring || p_sys->b_eof
+             || p_sys->i_error))
+            vlc_cond_wait (&p_sys->wait_space, &p_sys->lock);
+        if (p_sys->b_closing)
+            break;
+
+        uint64_t i_pos = p_sys->i_offset + p_sys->i_fill;
+        if (p_sys->i_seek != i_seek)
+        {
+            i_seek = p_sys->i_seek;
+            lseek (fd, i_pos, SEEK_SET);
+        }
+
+        /* Read into the free part of the ring, up to its end */
+        size_t i_tail = (p_sys->i_head + p_sys->i_fill) % p_sys->i_ring;
+        size_t i_len = p_sys->i_ring - p_sys->i_fill;
+        i_len = __MIN(i_len, p_sys->i_ring - i_tail);
+        i_len = __MIN(i_len, PREFETCH_CHUNK);
+        vlc_mutex_unlock (&p_sys->lock);
+
+        /* Hint the kernel about what comes next */
+        posix_fadvise (fd, i_pos + i_len, PREFETCH_CHUNK,
+                       POSIX_FADV_WILLNEED);
+        ssize_t val = read (fd, p_sys->p_ring + i_tail, i_len);
+
+        vlc_mutex_lock (&p_sys->lock);
+        if (p_sys->i_seek != i_seek)
+            continue; /* Seeked meanwhile, data is stale */
+
+        if (val > 0)
+            p_sys->i_fill += val;
+        else if (val == 0)
+            p_sys->b_eof = true;
+        else if (errno != EINTR && errno != EAGAIN)
+            p_sys->i_error = errno;
+        else
+            continue;
+        vlc_cond_signal (&p_sys->wait_data);
+    }
+    vlc_mutex_unlock (&p_sys->lock);
+    return NULL;
+}
+
+/**
+ * Reads from the prefetch ring.
+ */
+static ssize_t PrefetchRead (access_t *p_access, uint8_t *p_buffer,
+                             size_t i_len)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    ssize_t val = 0;
+
+    vlc_mutex_lock (&p_sys->lock);
+    if (p_sys->i_fill == 0 && !p_sys->b_eof && !p_sys->i_error)
+    {
+        mtime_t i_start = mdate ();
+
+        p_sys->i_stalls++;
+        while (p_sys->i_fill == 0 && !p_sys->b_eof && !p_sys->i_error)
+            vlc_cond_wait (&p_sys->wait_data, &p_sys->lock);
+        p_sys->i_stall_time += mdate () - i_start;
+    }
+
+    if (p_sys->i_fill > 0)
+    {
+        /* Copy at most up to the end of the ring, the caller loops */
+        val = __MIN(i_len, p_sys->i_fill);
+        val = __MIN((size_t)val, p_sys->i_ring - p_sys->i_head);
+        memcpy (p_buffer, p_sys->p_ring + p_sys->i_head, val);
+        p_sys->i_head = (p_sys->i_head + val) % p_sys->i_ring;
+        p_sys->i_fill -= val;
+        p_sys->i_offset += val;
+    }
+    else if (p_sys->i_error)
+    {
+        int i_error = p_sys->i_error;
+
+        p_sys->i_error = 0;
+        vlc_mutex_unlock (&p_sys->lock);
+        msg_Err (p_access, "read error: %s", vlc_strerror_c(i_error));
+        dialog_Fatal (p_access, _("File reading failed"),
+                      _("VLC could not read the file (%s)."),
+                      vlc_strerror(i_error));
+        vlc_mutex_lock (&p_sys->lock);
+    }
+    else
+        /* The file may grow, try again on the next read */
+        p_sys->b_eof = false;
+    vlc_cond_signal (&p_sys->wait_space);
+    vlc_mutex_unlock (&p_sys->lock);
+
+    p_access->info.i_pos += val;
+    p_access->info.b_eof = !val;
+    if (p_access->info.i_pos >= p_sys->size)
+    {
+        struct stat st;
+
+        if (fstat (p_sys->fd, &st) == 0)
+            p_sys->size = st.st_size;
+    }
+    return val;
+}
+
+/**
+ * Seeks within the prefetch ring if possible, or restarts prefetching.
+ */
+static int PrefetchSeek (access_t *p_access, uint64_t i_pos)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    vlc_mutex_lock (&p_sys->lock);
+    if (i_pos >= p_sys->i_offset && i_pos <= p_sys->i_offset + p_sys->i_fill)
+    {
+        size_t i_skip = i_pos - p_sys->i_offset;
+
+        p_sys->i_head = (p_sys->i_head + i_skip) % p_sys->i_ring;
+        p_sys->i_fill -= i_skip;
+    }
+    else
+    {
+        p_sys->i_head = 0;
+        p_sys->i_fill = 0;
+        p_sys->i_seek++;
+        p_sys->b_eof = false;
+        p_sys->i_error = 0;
+        posix_fadvise (p_sys->fd, i_pos, PREFETCH_CHUNK, POSIX_FADV_WILLNEED);
+    }
+    p_sys->i_offset = i_pos;
+    vlc_cond_signal (&p_sys->wait_space);
+    vlc_mutex_unlock (&p_sys->lock);
+
+    p_access->info.i_pos = i_pos;
+    p_access->info.b_eof = false;
+    return VLC_SUCCESS;
+}
+
 /**
  * Reads from a non-seekable file.
  */
@@ -409,6 +716,16 @@ static int FileControl( access_t *p_access, int i_query, va_list args )
             *pi_64 *= 1000;
             break;
 
+        case ACCESS_GET_STALLS:
+            /* Only reads from the prefetch ring wait */
+            if (p_sys->p_ring == NULL)
+                return VLC_EGENERIC;
+            vlc_mutex_lock (&p_sys->lock);
+            *va_arg (args, uint64_t *) = p_sys->i_stalls;
+            *va_arg (args, int64_t *) = p_sys->i_stall_time;
+            vlc_mutex_unlock (&p_sys->lock);
+            break;
+
         case ACCESS_SET_PAUSE_STATE:
             /* Nothing to do */
             break;
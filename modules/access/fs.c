@@ -54,6 +54,18 @@ static const char *const psz_sort_list_text[] = {
     N_("Sort items in a natural order (for example: 1.ogg 2.ogg 10.ogg). This method does not take the current language's collation rules into account."),
     N_("Do not sort the items.") };
 
+#define PREFETCH_TEXT N_("Prefetch size (kB)")
+#define PREFETCH_LONGTEXT N_( \
+    "Read files ahead of the playback position from a separate thread, " \
+    "keeping up to this amount of data in memory. This avoids stalls " \
+    "on slow or busy disks. Set to 0 to disable." )
+
+#define MMAP_TEXT N_("Use memory mapping")
+#define MMAP_LONGTEXT N_( \
+    "Map regular files in memory instead of reading them. This saves a " \
+    "copy of the data, but VLC may crash if the file is truncated while " \
+    "it is being read." )
+
 #define SORT_TEXT N_("Directory sort order")
 #define SORT_LONGTEXT N_( \
     "Define the sort algorithm used when adding items from a directory." )
@@ -66,6 +78,12 @@ vlc_module_begin ()
     add_obsolete_string( "file-cat" )
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
+    add_integer( "file-prefetch", 0, PREFETCH_TEXT, PREFETCH_LONGTEXT, true )
+        change_integer_range( 0, 1 << 20 )
+        change_safe()
+#ifdef HAVE_MMAP
+    add_bool( "file-mmap", false, MMAP_TEXT, MMAP_LONGTEXT, true )
+#endif
     set_callbacks( FileOpen, FileClose )
 
     add_submodule()
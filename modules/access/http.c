@@ -88,6 +88,15 @@ static void Close( vlc_object_t * );
 #define REFERER_TEXT N_("HTTP referer value")
 #define REFERER_LONGTEXT N_("Customize the HTTP referer, simulating a previous document")
 
+#define RANGE_CACHE_TEXT N_("Range cache size (kB)")
+#define RANGE_CACHE_LONGTEXT N_("Amount of recently read data kept " \
+    "around seek targets, such as file headers and indexes, so that " \
+    "reading them again does not need a new request. 0 disables it." )
+
+#define READAHEAD_TEXT N_("Read-ahead size (kB)")
+#define READAHEAD_LONGTEXT N_("Data read in the background ahead of the " \
+    "current position of seekable streams. 0 disables it." )
+
 #define UA_TEXT N_("User Agent")
 #define UA_LONGTEXT N_("The name and version of the program will be " \
     "provided to the HTTP server. They must be separated by a forward " \
@@ -118,6 +127,13 @@ vlc_module_begin ()
         change_safe()
     add_bool( "http-forward-cookies", true, FORWARD_COOKIES_TEXT,
               FORWARD_COOKIES_LONGTEXT, true )
+    add_integer( "http-range-cache", 1024, RANGE_CACHE_TEXT,
+                 RANGE_CACHE_LONGTEXT, true )
+        change_integer_range( 0, 16384 )
+    add_integer( "http-readahead", 0, READAHEAD_TEXT,
+                 READAHEAD_LONGTEXT, true )
+        change_integer_range( 0, 65536 )
+        change_safe()
     /* 'itpc' = iTunes Podcast */
     add_shortcut( "http", "https", "unsv", "itpc", "icyx" )
     set_callbacks( Open, Close )
@@ -127,6 +143,23 @@ vlc_module_end ()
  * Local prototypes
  *****************************************************************************/
 
+/* Forward seeks up to this distance read through the current response */
+#define HTTP_SKIP_MAX (128 << 10)
+/* Size of one range cache entry */
+#define HTTP_CACHE_BLOCK (64 << 10)
+/* Amount of data cached after each seek */
+#define HTTP_CACHE_SPAN (256 << 10)
+/* Largest amount of data read at once by the read-ahead thread */
+#define HTTP_AHEAD_CHUNK (32 << 10)
+
+typedef struct
+{
+    uint8_t *p_buffer;
+    uint64_t i_start;
+    size_t   i_size;
+    unsigned i_used;    /* LRU stamp */
+} http_range_t;
+
 struct access_sys_t
 {
     int fd;
@@ -186,6 +219,34 @@ struct access_sys_t
     bool b_has_size;
 
     vlc_array_t * cookies;
+
+    /* Offset of the next byte on the connection */
+    uint64_t i_offset;
+
+    /* Range cache */
+    http_range_t *p_cache;
+    unsigned i_cache;
+    unsigned i_cache_stamp;
+    uint64_t i_cache_end;   /* data past this offset is not cached */
+
+    /* Read-ahead */
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t wait_space;
+    vlc_cond_t wait_data;
+    block_t *p_ahead;       /* ends at i_offset */
+    block_t **pp_ahead_last;
+    size_t i_ahead;
+    size_t i_ahead_max;
+    bool b_ahead;
+    bool b_ahead_stop;
+    bool b_ahead_done;
+
+    /* Statistics */
+    uint64_t i_cache_hits;
+    uint64_t i_cache_bytes;
+    uint64_t i_reuses;
+    uint64_t i_reconnects;
 };
 
 /* */
@@ -202,6 +263,17 @@ static int Control( access_t *, int, va_list );
 static int Connect( access_t *, uint64_t );
 static int Request( access_t *p_access, uint64_t i_tell );
 static void Disconnect( access_t * );
+static void ResetInfo( access_t *, uint64_t );
+static int Reposition( access_t *, uint64_t );
+
+/* Range cache and read-ahead */
+static ssize_t CacheRead( access_t *, uint8_t *, size_t );
+static void CacheStore( access_t *, uint64_t, const uint8_t *, size_t );
+static bool CacheHas( access_t *, uint64_t );
+static void StartAhead( access_t * );
+static void StopAhead( access_t * );
+static ssize_t ReadAhead( access_t *, uint8_t *, size_t );
+static bool AheadHas( access_t *, uint64_t );
 
 /* Small Cookie utilities. Cookies support is partial. */
 static char * cookie_get_content( const char * cookie );
@@ -587,6 +659,22 @@ connect:
 
     if( p_sys->b_reconnect ) msg_Dbg( p_access, "auto re-connect enabled" );
 
+    p_sys->i_cache = var_InheritInteger( p_access, "http-range-cache" )
+                     * 1024 / HTTP_CACHE_BLOCK;
+    if( p_sys->i_cache > 0 )
+    {
+        p_sys->p_cache = calloc( p_sys->i_cache, sizeof( *p_sys->p_cache ) );
+        if( p_sys->p_cache == NULL )
+            p_sys->i_cache = 0;
+    }
+    p_sys->i_cache_end = HTTP_CACHE_SPAN;
+
+    p_sys->i_ahead_max = var_InheritInteger( p_access, "http-readahead" ) * 1024;
+    p_sys->pp_ahead_last = &p_sys->p_ahead;
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait_space );
+    vlc_cond_init( &p_sys->wait_data );
+
     return VLC_SUCCESS;
 
 error:
@@ -641,6 +729,15 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->psz_user_agent );
     free( p_sys->psz_referrer );
 
+    StopAhead( p_access );
+    vlc_cond_destroy( &p_sys->wait_data );
+    vlc_cond_destroy( &p_sys->wait_space );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    for( unsigned i = 0; i < p_sys->i_cache; i++ )
+        free( p_sys->p_cache[i].p_buffer );
+    free( p_sys->p_cache );
+
     Disconnect( p_access );
     vlc_tls_Delete( p_sys->p_creds );
 
@@ -711,11 +808,56 @@ static int ReadData( access_t *p_access, int *pi_read,
 }
 
 /*****************************************************************************
- * Read: Read up to i_len bytes from the http connection and place in
+ * Read: Read up to i_len bytes at the current position and place in
  * p_buffer. Return the actual number of bytes read
  *****************************************************************************/
-static int ReadICYMeta( access_t *p_access );
+static ssize_t ReadStream( access_t *, uint8_t *, size_t );
 static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+    ssize_t i_read;
+
+    i_read = CacheRead( p_access, p_buffer, i_len );
+    if( i_read > 0 )
+    {
+        p_access->info.i_pos += i_read;
+        return i_read;
+    }
+
+    StartAhead( p_access );
+    if( p_sys->b_ahead )
+    {
+        i_read = ReadAhead( p_access, p_buffer, i_len );
+        if( i_read > 0 )
+        {
+            p_access->info.i_pos += i_read;
+            CacheStore( p_access, i_pos, p_buffer, i_read );
+            return i_read;
+        }
+        /* Outside of the read-ahead window, or the connection ended */
+        StopAhead( p_access );
+    }
+
+    if( i_pos != p_sys->i_offset && Reposition( p_access, i_pos ) )
+    {
+        p_access->info.b_eof = true;
+        return 0;
+    }
+
+    i_read = ReadStream( p_access, p_buffer, i_len );
+    p_sys->i_offset = p_access->info.i_pos;
+    if( i_read > 0 )
+        CacheStore( p_access, p_access->info.i_pos - i_read, p_buffer, i_read );
+    return i_read;
+}
+
+/*****************************************************************************
+ * ReadStream: Read up to i_len bytes from the http connection, which must be
+ * positioned at the current offset
+ *****************************************************************************/
+static int ReadICYMeta( access_t *p_access );
+static ssize_t ReadStream( access_t *p_access, uint8_t *p_buffer, size_t i_len )
 {
     access_sys_t *p_sys = p_access->p_sys;
     int i_read;
@@ -766,13 +908,14 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
         {
             Request( p_access, 0 );
             p_sys->b_continuous = false;
-            i_read = Read( p_access, p_buffer, i_len );
+            i_read = ReadStream( p_access, p_buffer, i_len );
             p_sys->b_continuous = true;
         }
         Disconnect( p_access );
         if( p_sys->b_reconnect && vlc_object_alive( p_access ) )
         {
             msg_Dbg( p_access, "got disconnected, trying to reconnect" );
+            p_sys->i_reconnects++;
             if( Connect( p_access, p_access->info.i_pos ) )
             {
                 msg_Dbg( p_access, "reconnection failed" );
@@ -780,7 +923,7 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
             else
             {
                 p_sys->b_reconnect = false;
-                i_read = Read( p_access, p_buffer, i_len );
+                i_read = ReadStream( p_access, p_buffer, i_len );
                 p_sys->b_reconnect = true;
 
                 return i_read;
@@ -919,14 +1062,14 @@ static ssize_t ReadCompressed( access_t *p_access, uint8_t *p_buffer,
 #endif
 
 /*****************************************************************************
- * Seek: close and re-open a connection at the right place
+ * Seek: serve the new position from buffered data if possible, otherwise
+ * move the connection to the right place
  *****************************************************************************/
 static int Seek( access_t *p_access, uint64_t i_pos )
 {
     access_sys_t *p_sys = p_access->p_sys;
 
     msg_Dbg( p_access, "trying to seek to %"PRId64, i_pos );
-    Disconnect( p_access );
 
     if( p_sys->size && i_pos >= p_sys->size )
     {
@@ -939,15 +1082,93 @@ static int Seek( access_t *p_access, uint64_t i_pos )
         }
         return retval;
     }
-    if( Connect( p_access, i_pos ) )
+
+    p_access->info.b_eof = false;
+    if( CacheHas( p_access, i_pos ) || AheadHas( p_access, i_pos ) )
+        p_access->info.i_pos = i_pos;
+    else
     {
-        msg_Err( p_access, "seek failed" );
-        p_access->info.b_eof = true;
-        return VLC_EGENERIC;
+        StopAhead( p_access );
+        if( Reposition( p_access, i_pos ) )
+        {
+            msg_Err( p_access, "seek failed" );
+            p_access->info.b_eof = true;
+            return VLC_EGENERIC;
+        }
     }
+    p_sys->i_cache_end = i_pos + HTTP_CACHE_SPAN;
     return VLC_SUCCESS;
 }
 
+/* Read and drop i_len bytes of the current response */
+static int Skip( access_t *p_access, uint64_t i_len )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint8_t buffer[4096];
+
+    while( i_len > 0 )
+    {
+        int i_read;
+
+        if( ReadData( p_access, &i_read, buffer,
+                      __MIN( i_len, sizeof( buffer ) ) ) || i_read <= 0 )
+        {
+            Disconnect( p_access );
+            return VLC_EGENERIC;
+        }
+        i_len -= i_read;
+        p_sys->i_offset += i_read;
+        if( p_sys->b_has_size )
+            p_sys->i_remaining -= i_read;
+    }
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Reposition: get the connection to deliver data from i_pos, reading through
+ * or reusing the current connection when possible. The read-ahead thread
+ * must not be running.
+ *****************************************************************************/
+static int Reposition( access_t *p_access, uint64_t i_pos )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    assert( !p_sys->b_ahead );
+
+    if( p_sys->fd != -1 && p_sys->i_icy_meta == 0 && !p_sys->b_continuous )
+    {
+        uint64_t i_skip = i_pos - p_sys->i_offset;
+
+        if( i_pos >= p_sys->i_offset && i_skip <= HTTP_SKIP_MAX &&
+            ( !p_sys->b_has_size || i_skip <= p_sys->i_remaining ) &&
+            Skip( p_access, i_skip ) == VLC_SUCCESS )
+        {
+            p_access->info.i_pos = i_pos;
+            return VLC_SUCCESS;
+        }
+
+        /* Finish the current response, then send the next request on the
+         * same connection */
+        if( p_sys->fd != -1 && p_sys->b_persist && p_sys->b_has_size &&
+            !p_sys->b_chunked && p_sys->i_remaining <= HTTP_SKIP_MAX &&
+            Skip( p_access, p_sys->i_remaining ) == VLC_SUCCESS )
+        {
+            ResetInfo( p_access, i_pos );
+            if( Request( p_access, i_pos ) == VLC_SUCCESS )
+            {
+                p_sys->i_reuses++;
+                return VLC_SUCCESS;
+            }
+            /* The server may have closed the idle connection */
+            msg_Dbg( p_access, "cannot reuse connection" );
+        }
+    }
+
+    Disconnect( p_access );
+    p_sys->i_reconnects++;
+    return Connect( p_access, i_pos ) ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * Control:
  *****************************************************************************/
@@ -1012,6 +1233,13 @@ static int Control( access_t *p_access, int i_query, va_list args )
                 p_sys->psz_mime ? strdup( p_sys->psz_mime ) : NULL;
             break;
 
+        case ACCESS_GET_CONNECTION_STATS:
+            *va_arg( args, uint64_t * ) = p_sys->i_cache_hits;
+            *va_arg( args, uint64_t * ) = p_sys->i_cache_bytes;
+            *va_arg( args, uint64_t * ) = p_sys->i_reuses;
+            *va_arg( args, uint64_t * ) = p_sys->i_reconnects;
+            break;
+
         default:
             return VLC_EGENERIC;
 
@@ -1020,14 +1248,12 @@ static int Control( access_t *p_access, int i_query, va_list args )
 }
 
 /*****************************************************************************
- * Connect:
+ * ResetInfo: forget about the previous response
  *****************************************************************************/
-static int Connect( access_t *p_access, uint64_t i_tell )
+static void ResetInfo( access_t *p_access, uint64_t i_tell )
 {
     access_sys_t   *p_sys = p_access->p_sys;
-    vlc_url_t      srv = p_sys->b_proxy ? p_sys->proxy : p_sys->url;
 
-    /* Clean info */
     free( p_sys->psz_location );
     free( p_sys->psz_mime );
     free( p_sys->psz_pragma );
@@ -1052,8 +1278,20 @@ static int Connect( access_t *p_access, uint64_t i_tell )
     p_sys->b_persist = false;
     p_sys->b_has_size = false;
     p_sys->size = 0;
+    p_sys->i_offset = i_tell;
     p_access->info.i_pos  = i_tell;
     p_access->info.b_eof  = false;
+}
+
+/*****************************************************************************
+ * Connect:
+ *****************************************************************************/
+static int Connect( access_t *p_access, uint64_t i_tell )
+{
+    access_sys_t   *p_sys = p_access->p_sys;
+    vlc_url_t      srv = p_sys->b_proxy ? p_sys->proxy : p_sys->url;
+
+    ResetInfo( p_access, i_tell );
 
     /* Open connection */
     assert( p_sys->fd == -1 ); /* No open sockets (leaking fds is BAD) */
@@ -1180,13 +1418,13 @@ static int Request( access_t *p_access, uint64_t i_tell )
         net_Printf( p_access, p_sys->fd, pvs, "Referer: %s\r\n",
                     p_sys->psz_referrer);
     }
-    /* Offset */
+    /* Offset. The connection is kept alive so that later seeks can reuse
+     * it once this response has been read. */
     if( p_sys->i_version == 1 && ! p_sys->b_continuous )
     {
         p_sys->b_persist = true;
         net_Printf( p_access, p_sys->fd, pvs,
                     "Range: bytes=%"PRIu64"-\r\n", i_tell );
-        net_Printf( p_access, p_sys->fd, pvs, "Connection: close\r\n" );
     }
 
     /* Cookies */
@@ -1244,6 +1482,9 @@ static int Request( access_t *p_access, uint64_t i_tell )
     {
         p_sys->psz_protocol = "HTTP";
         p_sys->i_code = atoi( &psz[9] );
+        /* HTTP/1.0 servers close the connection after the response */
+        if( psz[7] == '0' )
+            p_sys->b_persist = false;
     }
     else if( !strncmp( psz, "ICY", 3 ) )
     {
@@ -1343,6 +1584,7 @@ static int Request( access_t *p_access, uint64_t i_tell )
             sscanf(p,"bytes %"SCNu64"-%"SCNu64"/%"SCNu64,&i_ntell,&i_nend,&i_nsize);
             if(i_nend > i_ntell ) {
                 p_access->info.i_pos = i_ntell;
+                p_sys->i_offset = i_ntell;
                 p_sys->i_icy_offset  = i_ntell;
                 p_sys->i_remaining = i_nend+1-i_ntell;
                 uint64_t i_size = (i_nsize > i_nend) ? i_nsize : (i_nend + 1);
@@ -1564,6 +1806,272 @@ static void Disconnect( access_t *p_access )
 
 }
 
+/*****************************************************************************
+ * Range cache: a few blocks of data read right after the last seeks, such as
+ * headers and indexes, evicted least recently used first
+ *****************************************************************************/
+static http_range_t *CacheFind( access_sys_t *p_sys, uint64_t i_pos )
+{
+    for( unsigned i = 0; i < p_sys->i_cache; i++ )
+    {
+        http_range_t *p_range = &p_sys->p_cache[i];
+
+        if( i_pos >= p_range->i_start &&
+            i_pos < p_range->i_start + p_range->i_size )
+            return p_range;
+    }
+    return NULL;
+}
+
+static bool CacheHas( access_t *p_access, uint64_t i_pos )
+{
+    return CacheFind( p_access->p_sys, i_pos ) != NULL;
+}
+
+static ssize_t CacheRead( access_t *p_access, uint8_t *p_buffer, size_t i_len )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+    http_range_t *p_range = CacheFind( p_sys, i_pos );
+
+    if( p_range == NULL )
+        return 0;
+
+    size_t i_offset = i_pos - p_range->i_start;
+    size_t i_copy = __MIN( i_len, p_range->i_size - i_offset );
+
+    memcpy( p_buffer, p_range->p_buffer + i_offset, i_copy );
+    p_range->i_used = ++p_sys->i_cache_stamp;
+    p_sys->i_cache_hits++;
+    p_sys->i_cache_bytes += i_copy;
+    return i_copy;
+}
+
+static void CacheStore( access_t *p_access, uint64_t i_pos,
+                        const uint8_t *p_buffer, size_t i_len )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->i_cache == 0 || !p_sys->b_seekable || p_sys->b_continuous ||
+        p_sys->i_icy_meta > 0 || i_pos >= p_sys->i_cache_end )
+        return;
+    if( i_len > p_sys->i_cache_end - i_pos )
+        i_len = p_sys->i_cache_end - i_pos;
+
+    while( i_len > 0 )
+    {
+        http_range_t *p_range = NULL;
+
+        /* Extend the entry ending here, or recycle the oldest one */
+        for( unsigned i = 0; i < p_sys->i_cache; i++ )
+        {
+            http_range_t *p_cur = &p_sys->p_cache[i];
+
+            if( p_cur->i_size > 0 && p_cur->i_size < HTTP_CACHE_BLOCK &&
+                p_cur->i_start + p_cur->i_size == i_pos )
+            {
+                p_range = p_cur;
+                break;
+            }
+            if( p_range == NULL || p_cur->i_used < p_range->i_used )
+                p_range = p_cur;
+        }
+        if( p_range->i_start + p_range->i_size != i_pos || p_range->i_size == 0 )
+        {
+            if( p_range->p_buffer == NULL )
+            {
+                p_range->p_buffer = malloc( HTTP_CACHE_BLOCK );
+                if( p_range->p_buffer == NULL )
+                    return;
+            }
+            p_range->i_start = i_pos;
+            p_range->i_size = 0;
+        }
+
+        size_t i_copy = __MIN( i_len, HTTP_CACHE_BLOCK - p_range->i_size );
+
+        memcpy( p_range->p_buffer + p_range->i_size, p_buffer, i_copy );
+        p_range->i_size += i_copy;
+        p_range->i_used = ++p_sys->i_cache_stamp;
+        i_pos += i_copy;
+        p_buffer += i_copy;
+        i_len -= i_copy;
+    }
+}
+
+/*****************************************************************************
+ * Read-ahead: a thread reads the current response in the background. While it
+ * runs, it owns the connection.
+ *****************************************************************************/
+static void *AheadThread( void *data )
+{
+    access_t *p_access = data;
+    access_sys_t *p_sys = p_access->p_sys;
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_sys->lock );
+        while( !p_sys->b_ahead_stop && p_sys->i_ahead >= p_sys->i_ahead_max )
+            vlc_cond_wait( &p_sys->wait_space, &p_sys->lock );
+        bool b_stop = p_sys->b_ahead_stop;
+        vlc_mutex_unlock( &p_sys->lock );
+
+        size_t i_len = __MIN( p_sys->i_remaining, HTTP_AHEAD_CHUNK );
+        if( b_stop || i_len == 0 )
+            break;
+
+        block_t *p_block = block_Alloc( i_len );
+        int i_read;
+        if( p_block == NULL )
+            break;
+        if( ReadData( p_access, &i_read, p_block->p_buffer, i_len ) ||
+            i_read <= 0 )
+        {
+            block_Release( p_block );
+            break;
+        }
+        p_block->i_buffer = i_read;
+
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->i_remaining -= i_read;
+        p_sys->i_offset += i_read;
+        p_sys->i_ahead += i_read;
+        block_ChainLastAppend( &p_sys->pp_ahead_last, p_block );
+        vlc_cond_signal( &p_sys->wait_data );
+        vlc_mutex_unlock( &p_sys->lock );
+    }
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_ahead_done = true;
+    vlc_cond_signal( &p_sys->wait_data );
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void StartAhead( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->b_ahead || p_sys->i_ahead_max == 0 || p_sys->fd == -1 ||
+        !p_sys->b_seekable || !p_sys->b_has_size || p_sys->i_remaining == 0 ||
+        p_sys->i_icy_meta > 0 || p_sys->b_continuous ||
+        p_access->info.i_pos != p_sys->i_offset )
+        return;
+
+    p_sys->b_ahead_stop = false;
+    p_sys->b_ahead_done = false;
+    if( vlc_clone( &p_sys->thread, AheadThread, p_access,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+        return;
+    p_sys->b_ahead = true;
+}
+
+/* Stops the read-ahead thread. The data it read is only kept if the range
+ * cache wants it. */
+static void StopAhead( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->b_ahead )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_ahead_stop = true;
+    vlc_cond_signal( &p_sys->wait_space );
+    vlc_mutex_unlock( &p_sys->lock );
+    vlc_join( p_sys->thread, NULL );
+    p_sys->b_ahead = false;
+
+    uint64_t i_pos = p_sys->i_offset - p_sys->i_ahead;
+    for( block_t *p_block = p_sys->p_ahead; p_block; p_block = p_block->p_next )
+    {
+        CacheStore( p_access, i_pos, p_block->p_buffer, p_block->i_buffer );
+        i_pos += p_block->i_buffer;
+    }
+    block_ChainRelease( p_sys->p_ahead );
+    p_sys->p_ahead = NULL;
+    p_sys->pp_ahead_last = &p_sys->p_ahead;
+    p_sys->i_ahead = 0;
+}
+
+static bool AheadHas( access_t *p_access, uint64_t i_pos )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    bool b_has;
+
+    if( !p_sys->b_ahead )
+        return false;
+
+    vlc_mutex_lock( &p_sys->lock );
+    b_has = i_pos >= p_sys->i_offset - p_sys->i_ahead &&
+            i_pos <= p_sys->i_offset;
+    vlc_mutex_unlock( &p_sys->lock );
+    return b_has;
+}
+
+/* Takes i_len bytes out of the read-ahead data, copying them if p_buffer is
+ * not NULL */
+static size_t AheadConsume( access_sys_t *p_sys, uint8_t *p_buffer,
+                            size_t i_len )
+{
+    size_t i_total = 0;
+
+    while( i_len > 0 && p_sys->p_ahead != NULL )
+    {
+        block_t *p_block = p_sys->p_ahead;
+        size_t i_copy = __MIN( i_len, p_block->i_buffer );
+
+        if( p_buffer != NULL )
+        {
+            memcpy( p_buffer, p_block->p_buffer, i_copy );
+            p_buffer += i_copy;
+        }
+        p_block->p_buffer += i_copy;
+        p_block->i_buffer -= i_copy;
+        if( p_block->i_buffer == 0 )
+        {
+            p_sys->p_ahead = p_block->p_next;
+            if( p_sys->p_ahead == NULL )
+                p_sys->pp_ahead_last = &p_sys->p_ahead;
+            block_Release( p_block );
+        }
+        p_sys->i_ahead -= i_copy;
+        i_total += i_copy;
+        i_len -= i_copy;
+    }
+    return i_total;
+}
+
+/* Returns 0 when the current position is not in the read-ahead window, or
+ * the thread stopped */
+static ssize_t ReadAhead( access_t *p_access, uint8_t *p_buffer, size_t i_len )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+    size_t i_read = 0;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        uint64_t i_start = p_sys->i_offset - p_sys->i_ahead;
+
+        if( i_pos < i_start || i_pos > p_sys->i_offset )
+            break;
+        AheadConsume( p_sys, NULL, i_pos - i_start );
+        if( p_sys->i_ahead > 0 )
+        {
+            i_read = AheadConsume( p_sys, p_buffer, i_len );
+            vlc_cond_signal( &p_sys->wait_space );
+            break;
+        }
+        if( p_sys->b_ahead_done )
+            break;
+        vlc_cond_wait( &p_sys->wait_data, &p_sys->lock );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return i_read;
+}
+
 /*****************************************************************************
  * Cookies (FIXME: we may want to rewrite that using a nice structure to hold
  * them) (FIXME: only support the "domain=" param)
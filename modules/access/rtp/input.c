@@ -26,6 +26,7 @@
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
+#include <vlc_atomic.h>
 #include <vlc_block.h>
 #include <vlc_network.h>
 
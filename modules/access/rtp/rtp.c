@@ -29,6 +29,7 @@
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
+#include <vlc_atomic.h>
 #include <vlc_network.h>
 #include <vlc_plugin.h>
 #include <vlc_dialog.h>
@@ -75,6 +76,11 @@
     "RTP packets will be discarded if they are too far behind (i.e. in the " \
     "past) by this many packets from the last received packet." )
 
+#define RTP_LATENCY_TEXT N_("Maximum RTP re-ordering delay (ms)")
+#define RTP_LATENCY_LONGTEXT N_( \
+    "How long to wait at most for missing or misordered RTP packets. " \
+    "By default (0), the delay is estimated from the network jitter.")
+
 #define RTP_DYNAMIC_PT_TEXT N_("RTP payload format assumed for dynamic " \
                                "payloads")
 #define RTP_DYNAMIC_PT_LONGTEXT N_( \
@@ -122,6 +128,9 @@ vlc_module_begin ()
     add_integer ("rtp-max-misorder", 100, RTP_MAX_MISORDER_TEXT,
                  RTP_MAX_MISORDER_LONGTEXT, true)
         change_integer_range (0, 32767)
+    add_integer ("rtp-latency", 0, RTP_LATENCY_TEXT,
+                 RTP_LATENCY_LONGTEXT, true)
+        change_integer_range (0, 60000)
     add_string ("rtp-dynamic-pt", NULL, RTP_DYNAMIC_PT_TEXT,
                 RTP_DYNAMIC_PT_LONGTEXT, true)
         change_string_list (dynamic_pt_list, dynamic_pt_list_text)
@@ -264,6 +273,12 @@ static int Open (vlc_object_t *obj)
                         * CLOCK_FREQ;
     p_sys->max_dropout  = var_CreateGetInteger (obj, "rtp-max-dropout");
     p_sys->max_misorder = var_CreateGetInteger (obj, "rtp-max-misorder");
+    p_sys->latency      = var_CreateGetInteger (obj, "rtp-latency")
+                        * (CLOCK_FREQ / 1000);
+    atomic_init (&p_sys->lost, 0);
+    atomic_init (&p_sys->late, 0);
+    atomic_init (&p_sys->reordered, 0);
+    atomic_init (&p_sys->duplicate, 0);
     p_sys->thread_ready = false;
     p_sys->autodetect   = true;
 
@@ -393,6 +408,15 @@ static int Control (demux_t *demux, int query, va_list args)
             *v = false;
             return VLC_SUCCESS;
         }
+
+        case DEMUX_GET_PACKET_STATS:
+        {
+            *va_arg (args, uint64_t *) = atomic_load (&sys->lost);
+            *va_arg (args, uint64_t *) = atomic_load (&sys->late);
+            *va_arg (args, uint64_t *) = atomic_load (&sys->reordered);
+            *va_arg (args, uint64_t *) = atomic_load (&sys->duplicate);
+            return VLC_SUCCESS;
+        }
     }
 
     if (sys->chained_demux != NULL)
@@ -71,6 +71,13 @@ struct demux_sys_t
     vlc_thread_t  thread;
 
     mtime_t       timeout;
+    mtime_t       latency; /**< Max re-ordering delay (0 = jitter-based) */
+
+    /* Packet counts over all sources, for DEMUX_GET_PACKET_STATS */
+    atomic_uint   lost; /**< Packets never received */
+    atomic_uint   late; /**< Packets received after their turn */
+    atomic_uint   reordered; /**< Packets received out of order, in time */
+    atomic_uint   duplicate; /**< Packets received twice */
     uint16_t      max_dropout; /**< Max packet forward misordering */
     uint16_t      max_misorder; /**< Max packet backward misordering */
     uint8_t       max_src; /**< Max simultaneous RTP sources */
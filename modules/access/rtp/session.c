@@ -30,11 +30,15 @@
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
+#include <vlc_atomic.h>
 
 #include "rtp.h"
 
 typedef struct rtp_source_t rtp_source_t;
 
+/** Number of SSRC hash table buckets (power of two) */
+#define RTP_SSRC_BUCKETS 64
+
 /** State for a RTP session: */
 struct rtp_session_t
 {
@@ -42,12 +46,16 @@ struct rtp_session_t
     unsigned       srcc;
     uint8_t        ptc;
     rtp_pt_t      *ptv;
+    rtp_source_t  *hashv[RTP_SSRC_BUCKETS]; /* sources by SSRC */
+    mtime_t        next_gc; /* next sources garbage collection */
+    uint16_t       window_mask; /* re-ordering window size - 1 */
 };
 
 static rtp_source_t *
 rtp_source_create (demux_t *, const rtp_session_t *, uint32_t, uint16_t);
 static void
 rtp_source_destroy (demux_t *, const rtp_session_t *, rtp_source_t *);
+static void rtp_source_flush (const rtp_session_t *, rtp_source_t *);
 
 static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
 
@@ -61,12 +69,23 @@ rtp_session_create (demux_t *demux)
     if (session == NULL)
         return NULL;
 
+    demux_sys_t *p_sys = demux->p_sys;
+
     session->srcv = NULL;
     session->srcc = 0;
     session->ptc = 0;
     session->ptv = NULL;
-
-    (void)demux;
+    for (unsigned i = 0; i < RTP_SSRC_BUCKETS; i++)
+        session->hashv[i] = NULL;
+    session->next_gc = 0;
+
+    /* The re-ordering window must hold all the packets from the last
+     * dequeued one to the most ahead accepted one. */
+    unsigned size = 16;
+    while (size < 32768u
+        && size <= (unsigned)p_sys->max_dropout + p_sys->max_misorder)
+        size *= 2;
+    session->window_mask = size - 1;
     return session;
 }
 
@@ -136,6 +155,7 @@ int rtp_add_type (demux_t *demux, rtp_session_t *ses, const rtp_pt_t *pt)
 /** State for an RTP source */
 struct rtp_source_t
 {
+    rtp_source_t *hash_next; /* next source in the same SSRC bucket */
     uint32_t ssrc;
     uint32_t jitter;  /* interarrival delay jitter estimate */
     mtime_t  last_rx; /* last received packet local timestamp */
@@ -147,8 +167,10 @@ struct rtp_source_t
     uint16_t bad_seq; /* tentatively next expected sequence for resync */
     uint16_t max_seq; /* next expected sequence */
 
-    uint16_t last_seq; /* sequence of the next dequeued packet */
-    block_t *blocks; /* re-ordered blocks queue */
+    uint16_t last_seq; /* sequence of the last dequeued packet */
+    unsigned count; /* number of blocks in the re-ordering window */
+    block_t **window; /* re-ordered blocks, indexed by sequence number */
+
     void    *opaque[]; /* Per-source private payload data */
 };
 
@@ -172,7 +194,14 @@ rtp_source_create (demux_t *demux, const rtp_session_t *session,
     source->ref_ntp = UINT64_C (1) << 62;
     source->max_seq = source->bad_seq = init_seq;
     source->last_seq = init_seq - 1;
-    source->blocks = NULL;
+    source->count = 0;
+    source->window = calloc (session->window_mask + 1,
+                             sizeof (*source->window));
+    if (source->window == NULL)
+    {
+        free (source);
+        return NULL;
+    }
 
     /* Initializes all payload */
     for (unsigned i = 0; i < session->ptc; i++)
@@ -194,7 +223,8 @@ rtp_source_destroy (demux_t *demux, const rtp_session_t *session,
 
     for (unsigned i = 0; i < session->ptc; i++)
         session->ptv[i].destroy (demux, source->opaque[i]);
-    block_ChainRelease (source->blocks);
+    rtp_source_flush (session, source);
+    free (source->window);
     free (source);
 }
 
@@ -210,6 +240,73 @@ static inline uint32_t rtp_timestamp (const block_t *block)
     return GetDWBE (block->p_buffer + 4);
 }
 
+static inline unsigned rtp_ssrc_hash (uint32_t ssrc)
+{
+    return (ssrc ^ (ssrc >> 8) ^ (ssrc >> 16) ^ (ssrc >> 24))
+           & (RTP_SSRC_BUCKETS - 1);
+}
+
+/**
+ * Returns the queued block with the lowest sequence number.
+ * The re-ordering window of the source must not be empty.
+ */
+static block_t *rtp_source_first (const rtp_session_t *session,
+                                  const rtp_source_t *src)
+{
+    assert (src->count > 0);
+    for (uint16_t seq = src->last_seq + 1;; seq++)
+    {
+        block_t *block = src->window[seq & session->window_mask];
+        if (block != NULL)
+            return block;
+    }
+}
+
+/**
+ * Discards all the queued blocks of a source.
+ */
+static void rtp_source_flush (const rtp_session_t *session, rtp_source_t *src)
+{
+    for (unsigned i = 0; src->count > 0 && i <= session->window_mask; i++)
+    {
+        if (src->window[i] != NULL)
+        {
+            block_Release (src->window[i]);
+            src->window[i] = NULL;
+            src->count--;
+        }
+    }
+    assert (src->count == 0);
+}
+
+/**
+ * Removes and destroys RTP sources that have not sent anything for too long.
+ */
+static void rtp_source_gc (demux_t *demux, rtp_session_t *session,
+                           mtime_t now)
+{
+    demux_sys_t *p_sys = demux->p_sys;
+
+    for (unsigned i = 0; i < session->srcc;)
+    {
+        rtp_source_t *src = session->srcv[i];
+
+        if ((src->last_rx + p_sys->timeout) >= now)
+        {
+            i++;
+            continue;
+        }
+
+        rtp_source_t **pp = &session->hashv[rtp_ssrc_hash (src->ssrc)];
+        while (*pp != src)
+            pp = &(*pp)->hash_next;
+        *pp = src->hash_next;
+
+        rtp_source_destroy (demux, session, src);
+        session->srcv[i] = session->srcv[--session->srcc];
+    }
+}
+
 static const struct rtp_pt_t *
 rtp_find_ptype (const rtp_session_t *session, rtp_source_t *source,
                 const block_t *block, void **pt_data)
@@ -261,25 +358,22 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
     const uint16_t seq  = rtp_seq (block);
     const uint32_t ssrc = GetDWBE (block->p_buffer + 8);
 
-    /* In most case, we know this source already */
-    for (unsigned i = 0, max = session->srcc; i < max; i++)
+    /* RTP source garbage collection (the timeout is in seconds) */
+    if (now >= session->next_gc)
     {
-        rtp_source_t *tmp = session->srcv[i];
+        rtp_source_gc (demux, session, now);
+        session->next_gc = now + CLOCK_FREQ;
+    }
+
+    /* In most case, we know this source already */
+    rtp_source_t **bucket = &session->hashv[rtp_ssrc_hash (ssrc)];
+    for (rtp_source_t *tmp = *bucket; tmp != NULL; tmp = tmp->hash_next)
         if (tmp->ssrc == ssrc)
         {
             src = tmp;
             break;
         }
 
-        /* RTP source garbage collection */
-        if ((tmp->last_rx + p_sys->timeout) < now)
-        {
-            rtp_source_destroy (demux, session, tmp);
-            if (--session->srcc > 0)
-                session->srcv[i] = session->srcv[session->srcc - 1];
-        }
-    }
-
     if (src == NULL)
     {
         /* New source */
@@ -300,6 +394,8 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
             goto drop;
 
         tab[session->srcc++] = src;
+        src->hash_next = *bucket;
+        *bucket = src;
         /* Cannot compute jitter yet */
     }
     else
@@ -335,10 +431,10 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         if (seq == src->bad_seq)
         {
             src->max_seq = src->bad_seq = seq + 1;
-            src->last_seq = seq - 0x7fffe; /* hack for rtp_decode() */
+            src->last_seq = seq - 1;
             msg_Warn (demux, "sequence resynchronized");
-            block_ChainRelease (src->blocks);
-            src->blocks = NULL;
+            rtp_source_flush (session, src);
+            block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
         }
         else
         {
@@ -350,25 +446,42 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
     if (delta_seq >= 0)
         src->max_seq = seq + 1;
 
-    /* Queues the block in sequence order,
+    /* Queues the block in the re-ordering window of the source,
      * hence there is a single queue for all payload types. */
-    block_t **pp = &src->blocks;
-    for (block_t *prev = *pp; prev != NULL; prev = *pp)
+    uint16_t offset = seq - src->last_seq;
+    if (offset == 0 || offset >= 0x8000)
+    {   /* Trash too late packets (and PIM Assert duplicates) */
+        msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")", seq);
+        atomic_fetch_add (&p_sys->late, 1);
+        goto drop;
+    }
+
+    /* Give up on the oldest missing packets if the window is full */
+    while (offset > session->window_mask + 1u)
     {
-        int16_t delta_seq = seq - rtp_seq (prev);
-        if (delta_seq < 0)
-            break;
-        if (delta_seq == 0)
+        if (src->count == 0)
         {
-            msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
-            goto drop; /* duplicate */
+            atomic_fetch_add (&p_sys->lost,
+                              offset - (session->window_mask + 1u));
+            src->last_seq = seq - (session->window_mask + 1u);
+            break;
         }
-        pp = &prev->p_next;
+        rtp_decode (demux, session, src);
+        offset = seq - src->last_seq;
     }
-    block->p_next = *pp;
-    *pp = block;
 
-    /*rtp_decode (demux, session, src);*/
+    block_t **slot = &src->window[seq & session->window_mask];
+    if (*slot != NULL)
+    {
+        msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
+        atomic_fetch_add (&p_sys->duplicate, 1);
+        goto drop; /* duplicate */
+    }
+    block->p_next = NULL;
+    *slot = block;
+    src->count++;
+    if ((int16_t)(seq - src->max_seq) < -1)
+        atomic_fetch_add (&p_sys->reordered, 1);
     return;
 
 drop:
@@ -393,6 +506,7 @@ static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
 bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
                   mtime_t *restrict deadlinep)
 {
+    demux_sys_t *p_sys = demux->p_sys;
     mtime_t now = mdate ();
     bool pending = false;
 
@@ -419,10 +533,11 @@ bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
          * LibVLC E/S-out clock synchronization. Here, we need to bother about
          * re-ordering packets, as decoders can't cope with mis-ordered data.
          */
-        while (((block = src->blocks)) != NULL)
+        while (src->count > 0)
         {
-            if ((int16_t)(rtp_seq (block) - (src->last_seq + 1)) <= 0)
-            {   /* Next (or earlier) block ready, no need to wait */
+            block = rtp_source_first (session, src);
+            if (rtp_seq (block) == (uint16_t)(src->last_seq + 1))
+            {   /* Next block ready, no need to wait */
                 rtp_decode (demux, session, src);
                 continue;
             }
@@ -441,6 +556,10 @@ bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
             if (deadline < (CLOCK_FREQ / 40))
                 deadline = CLOCK_FREQ / 40;
 
+            /* But not more than the configured latency */
+            if (p_sys->latency > 0 && deadline > p_sys->latency)
+                deadline = p_sys->latency;
+
             /* Additionnaly, we implicitly wait for the packetization time
              * multiplied by the number of missing packets. block is the first
              * non-missing packet (lowest sequence number). We have no better
@@ -470,36 +589,30 @@ void rtp_dequeue_force (demux_t *demux, const rtp_session_t *session)
     for (unsigned i = 0, max = session->srcc; i < max; i++)
     {
         rtp_source_t *src = session->srcv[i];
-        block_t *block;
 
-        while (((block = src->blocks)) != NULL)
+        while (src->count > 0)
             rtp_decode (demux, session, src);
     }
 }
 
 /**
- * Decodes one RTP packet.
+ * Decodes the first queued RTP packet of a source.
  */
 static void
 rtp_decode (demux_t *demux, const rtp_session_t *session, rtp_source_t *src)
 {
-    block_t *block = src->blocks;
+    demux_sys_t *p_sys = demux->p_sys;
+    block_t *block = rtp_source_first (session, src);
 
-    assert (block);
-    src->blocks = block->p_next;
-    block->p_next = NULL;
+    src->window[rtp_seq (block) & session->window_mask] = NULL;
+    src->count--;
 
     /* Discontinuity detection */
     uint16_t delta_seq = rtp_seq (block) - (src->last_seq + 1);
     if (delta_seq != 0)
     {
-        if (delta_seq >= 0x8000)
-        {   /* Trash too late packets (and PIM Assert duplicates) */
-            msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")",
-                      rtp_seq (block));
-            goto drop;
-        }
         msg_Warn (demux, "%"PRIu16" packet(s) lost", delta_seq);
+        atomic_fetch_add (&p_sys->lost, delta_seq);
         block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
     }
     src->last_seq = rtp_seq (block);
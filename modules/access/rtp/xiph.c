@@ -28,6 +28,7 @@
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
+#include <vlc_atomic.h>
 #include <vlc_network.h>
 #include <vlc_plugin.h>
 
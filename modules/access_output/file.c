@@ -37,6 +37,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <assert.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -52,6 +53,7 @@
 
 #ifndef _WIN32
 #   include <unistd.h>
+#   include <sys/uio.h>
 #endif
 
 #ifndef O_LARGEFILE
@@ -76,6 +78,19 @@ static void Close( vlc_object_t * );
     "on the file path")
 #define SYNC_TEXT N_("Synchronous writing")
 #define SYNC_LONGTEXT N_( "Open the file with synchronous writing.")
+#define QUEUE_TEXT N_("Write queue size (kB)")
+#define QUEUE_LONGTEXT N_( "Data is written to the file by a separate " \
+    "thread, so that a slow disk does not stall the stream output. This " \
+    "is the amount of data that may wait to be written. A write error is " \
+    "then logged when it happens, but only reported to the stream output " \
+    "by its next write or seek. Set to 0 to write from the stream output " \
+    "thread." )
+#define PREALLOC_TEXT N_("Preallocation size (kB)")
+#define PREALLOC_LONGTEXT N_( "Reserve disk space ahead of the data by " \
+    "this amount, to limit file fragmentation. Set to 0 to disable." )
+#define WRITEBEHIND_TEXT N_("Write-behind")
+#define WRITEBEHIND_LONGTEXT N_( "Start writing data back to the disk as " \
+    "soon as it is written, and drop it from the page cache afterwards." )
 
 vlc_module_begin ()
     set_description( N_("File stream output") )
@@ -93,6 +108,18 @@ vlc_module_begin ()
 #ifdef O_SYNC
     add_bool( SOUT_CFG_PREFIX "sync", false, SYNC_TEXT,SYNC_LONGTEXT,
               false )
+#endif
+    add_integer( SOUT_CFG_PREFIX "queue", 4096, QUEUE_TEXT, QUEUE_LONGTEXT,
+                 true )
+        change_integer_range( 0, 1 << 20 )
+#if defined( HAVE_FALLOCATE ) && defined( FALLOC_FL_KEEP_SIZE )
+    add_integer( SOUT_CFG_PREFIX "prealloc", 0, PREALLOC_TEXT,
+                 PREALLOC_LONGTEXT, true )
+        change_integer_range( 0, 1 << 22 )
+#endif
+#ifdef HAVE_SYNC_FILE_RANGE
+    add_bool( SOUT_CFG_PREFIX "writebehind", false, WRITEBEHIND_TEXT,
+              WRITEBEHIND_LONGTEXT, true )
 #endif
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -107,14 +134,60 @@ static const char *const ppsz_sout_options[] = {
     "overwrite",
 #ifdef O_SYNC
     "sync",
+#endif
+    "queue",
+#if defined( HAVE_FALLOCATE ) && defined( FALLOC_FL_KEEP_SIZE )
+    "prealloc",
+#endif
+#ifdef HAVE_SYNC_FILE_RANGE
+    "writebehind",
 #endif
     NULL
 };
 
+/* Maximum number of blocks written with a single system call */
+#define FILE_WRITE_BATCH 64
+/* Amount of data written back at once by write-behind */
+#define FILE_WRITEBEHIND_SIZE (4 << 20)
+
+struct sout_access_out_sys_t
+{
+    int fd;
+
+    /* Asynchronous writer */
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+    vlc_cond_t   wait;       /* data queued or closing */
+    vlc_cond_t   wait_space; /* queued data written */
+    block_t     *p_queue;
+    block_t    **pp_queue_last;
+    size_t       i_queued;
+    size_t       i_queue_max;
+    bool         b_async;
+    bool         b_writing;
+    bool         b_closing;
+    bool         b_error;    /* write failed, not reported yet */
+
+    /* File position, for preallocation and write-behind */
+    off_t        i_offset;
+    off_t        i_allocated;
+    off_t        i_prealloc;
+    off_t        i_synced;
+    bool         b_writebehind;
+
+    /* Statistics */
+    size_t       i_queue_peak;
+    unsigned     i_writes;
+    uint64_t     i_written;
+    mtime_t      i_latency;
+    mtime_t      i_latency_max;
+};
+
 static ssize_t Write( sout_access_out_t *, block_t * );
 static int Seek ( sout_access_out_t *, off_t  );
 static ssize_t Read ( sout_access_out_t *, block_t * );
 static int Control( sout_access_out_t *, int, va_list );
+static void *WriterThread( void * );
 
 /*****************************************************************************
  * Open: open the file
@@ -213,16 +286,58 @@ static int Open( vlc_object_t *p_this )
             return VLC_EGENERIC;
     }
 
+    sout_access_out_sys_t *p_sys = calloc (1, sizeof (*p_sys));
+    if (unlikely(p_sys == NULL))
+    {
+        close (fd);
+        return VLC_ENOMEM;
+    }
+    p_sys->fd = fd;
+    p_sys->pp_queue_last = &p_sys->p_queue;
+    p_sys->i_queue_max = var_GetInteger (p_access, SOUT_CFG_PREFIX"queue")
+                         * 1024;
+
+    if (append)
+        lseek (fd, 0, SEEK_END);
+
+    /* Preallocation and write-behind only make sense on regular files */
+    struct stat st;
+    p_sys->i_offset = lseek (fd, 0, SEEK_CUR);
+    if (p_sys->i_offset != -1 && fstat (fd, &st) == 0 && S_ISREG (st.st_mode))
+    {
+        p_sys->i_allocated = p_sys->i_offset;
+        p_sys->i_synced = p_sys->i_offset;
+#if defined( HAVE_FALLOCATE ) && defined( FALLOC_FL_KEEP_SIZE )
+        p_sys->i_prealloc =
+            (off_t)var_GetInteger (p_access, SOUT_CFG_PREFIX"prealloc") * 1024;
+#endif
+#ifdef HAVE_SYNC_FILE_RANGE
+        p_sys->b_writebehind = var_GetBool (p_access,
+                                            SOUT_CFG_PREFIX"writebehind");
+#endif
+    }
+    else
+        p_sys->i_offset = -1;
+
     p_access->pf_write = Write;
     p_access->pf_read  = Read;
     p_access->pf_seek  = Seek;
     p_access->pf_control = Control;
-    p_access->p_sys    = (void *)(intptr_t)fd;
+    p_access->p_sys    = p_sys;
+
+    vlc_mutex_init (&p_sys->lock);
+    vlc_cond_init (&p_sys->wait);
+    vlc_cond_init (&p_sys->wait_space);
+    p_sys->b_async = p_sys->i_queue_max > 0;
+    if (p_sys->b_async
+     && vlc_clone (&p_sys->thread, WriterThread, p_access,
+                   VLC_THREAD_PRIORITY_OUTPUT))
+    {
+        msg_Warn (p_access, "cannot start writer thread, writing inline");
+        p_sys->b_async = false;
+    }
 
     msg_Dbg( p_access, "file access output opened (%s)", p_access->psz_path );
-    if (append)
-        lseek (fd, 0, SEEK_END);
-
     return VLC_SUCCESS;
 }
 
@@ -232,8 +347,40 @@ static int Open( vlc_object_t *p_this )
 static void Close( vlc_object_t * p_this )
 {
     sout_access_out_t *p_access = (sout_access_out_t*)p_this;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if (p_sys->b_async)
+    {
+        /* The writer thread flushes the queue before exiting */
+        vlc_mutex_lock (&p_sys->lock);
+        p_sys->b_closing = true;
+        vlc_cond_signal (&p_sys->wait);
+        vlc_mutex_unlock (&p_sys->lock);
+        vlc_join (p_sys->thread, NULL);
+    }
+    assert (p_sys->p_queue == NULL);
+    vlc_cond_destroy (&p_sys->wait_space);
+    vlc_cond_destroy (&p_sys->wait);
+    vlc_mutex_destroy (&p_sys->lock);
+
+#if defined( HAVE_FALLOCATE ) && defined( FALLOC_FL_KEEP_SIZE )
+    /* Give back the space reserved beyond the end of the file */
+    struct stat st;
+    if (p_sys->i_allocated > 0 && fstat (p_sys->fd, &st) == 0
+     && p_sys->i_allocated > st.st_size)
+        if (ftruncate (p_sys->fd, st.st_size))
+            msg_Dbg (p_access, "cannot trim file: %s", vlc_strerror_c(errno));
+#endif
 
-    close( (intptr_t)p_access->p_sys );
+    if (p_sys->i_writes > 0)
+        msg_Dbg (p_access, "%"PRIu64" bytes in %u writes, queue peak %zu "
+                 "bytes, write latency average %"PRId64" us, max %"PRId64
+                 " us", p_sys->i_written, p_sys->i_writes,
+                 p_sys->i_queue_peak, p_sys->i_latency / p_sys->i_writes,
+                 p_sys->i_latency_max);
+
+    close (p_sys->fd);
+    free (p_sys);
 
     msg_Dbg( p_access, "file access output closed" );
 }
@@ -253,7 +400,7 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
         {
             bool *pb = va_arg( args, bool * );
             struct stat st;
-            if( fstat( (intptr_t)p_access->p_sys, &st ) == -1 )
+            if( fstat( p_access->p_sys->fd, &st ) == -1 )
                 *pb = false;
             else
                 *pb = S_ISREG( st.st_mode ) || S_ISBLK( st.st_mode );
@@ -266,60 +413,290 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * Drain: wait until all queued data is written
+ *****************************************************************************/
+static int Drain( sout_access_out_sys_t *p_sys )
+{
+    int ret = 0;
+
+    if (!p_sys->b_async)
+        return 0;
+
+    vlc_mutex_lock (&p_sys->lock);
+    while (p_sys->p_queue != NULL || p_sys->b_writing)
+        vlc_cond_wait (&p_sys->wait_space, &p_sys->lock);
+    if (p_sys->b_error)
+    {
+        p_sys->b_error = false;
+        ret = -1;
+    }
+    vlc_mutex_unlock (&p_sys->lock);
+    return ret;
+}
+
 /*****************************************************************************
  * Read: standard read on a file descriptor.
  *****************************************************************************/
 static ssize_t Read( sout_access_out_t *p_access, block_t *p_buffer )
 {
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
     ssize_t val;
 
+    if (Drain (p_sys))
+        return -1;
+
     do
-        val = read( (intptr_t)p_access->p_sys, p_buffer->p_buffer,
-                    p_buffer->i_buffer );
+        val = read( p_sys->fd, p_buffer->p_buffer, p_buffer->i_buffer );
     while (val == -1 && errno == EINTR);
+    if (val > 0 && p_sys->i_offset != -1)
+        p_sys->i_offset += val;
     return val;
 }
 
 /*****************************************************************************
- * Write: standard write on a file descriptor.
+ * Reserve: preallocate disk space ahead of the data
  *****************************************************************************/
-static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+static void Reserve( sout_access_out_t *p_access, size_t i_size )
 {
+#if defined( HAVE_FALLOCATE ) && defined( FALLOC_FL_KEEP_SIZE )
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if (p_sys->i_prealloc == 0
+     || p_sys->i_offset + (off_t)i_size <= p_sys->i_allocated)
+        return;
+
+    off_t i_start = __MAX(p_sys->i_allocated, p_sys->i_offset);
+    off_t i_len = __MAX(p_sys->i_prealloc, (off_t)i_size);
+
+    if (fallocate (p_sys->fd, FALLOC_FL_KEEP_SIZE, i_start, i_len))
+    {
+        msg_Dbg (p_access, "cannot preallocate: %s", vlc_strerror_c(errno));
+        p_sys->i_prealloc = 0;
+        return;
+    }
+    p_sys->i_allocated = i_start + i_len;
+#else
+    VLC_UNUSED(p_access); VLC_UNUSED(i_size);
+#endif
+}
+
+/*****************************************************************************
+ * WriteBehind: start writing back data and drop it from the page cache
+ *****************************************************************************/
+static void WriteBehind( sout_access_out_t *p_access )
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if (!p_sys->b_writebehind
+     || p_sys->i_offset - p_sys->i_synced < FILE_WRITEBEHIND_SIZE)
+        return;
+
+    off_t i_len = p_sys->i_offset - p_sys->i_synced;
+
+    if (sync_file_range (p_sys->fd, p_sys->i_synced, i_len,
+                         SYNC_FILE_RANGE_WRITE))
+    {
+        msg_Dbg (p_access, "cannot write back: %s", vlc_strerror_c(errno));
+        p_sys->b_writebehind = false;
+        return;
+    }
+
+    /* Wait for the previous range, which should be on disk by now */
+    if (p_sys->i_synced >= FILE_WRITEBEHIND_SIZE)
+    {
+        off_t i_prev = p_sys->i_synced - FILE_WRITEBEHIND_SIZE;
+
+        sync_file_range (p_sys->fd, i_prev, FILE_WRITEBEHIND_SIZE,
+                         SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE
+                       | SYNC_FILE_RANGE_WAIT_AFTER);
+# ifdef HAVE_POSIX_FADVISE
+        posix_fadvise (p_sys->fd, i_prev, FILE_WRITEBEHIND_SIZE,
+                       POSIX_FADV_DONTNEED);
+# endif
+    }
+    p_sys->i_synced = p_sys->i_offset;
+#else
+    VLC_UNUSED(p_access);
+#endif
+}
+
+/*****************************************************************************
+ * WriteChain: write a chain of blocks, merging them into few system calls
+ *****************************************************************************/
+static ssize_t WriteChain( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
     size_t i_write = 0;
 
+    if (p_sys->i_offset != -1)
+    {
+        size_t i_size;
+        block_ChainProperties (p_buffer, NULL, &i_size, NULL);
+        Reserve (p_access, i_size);
+    }
+
     while( p_buffer )
     {
-        ssize_t val = write ((intptr_t)p_access->p_sys,
-                             p_buffer->p_buffer, p_buffer->i_buffer);
+        mtime_t i_start = mdate ();
+#ifndef _WIN32
+        struct iovec iov[FILE_WRITE_BATCH];
+        unsigned i_iov = 0;
+
+        for (block_t *b = p_buffer; b && i_iov < FILE_WRITE_BATCH;
+             b = b->p_next)
+        {
+            iov[i_iov].iov_base = b->p_buffer;
+            iov[i_iov].iov_len = b->i_buffer;
+            i_iov++;
+        }
+        ssize_t val = writev (p_sys->fd, iov, i_iov);
+#else
+        ssize_t val = write (p_sys->fd, p_buffer->p_buffer,
+                             p_buffer->i_buffer);
+#endif
         if (val <= 0)
         {
             if (errno == EINTR)
                 continue;
+
+            int i_errno = errno;
             block_ChainRelease (p_buffer);
-            msg_Err( p_access, "cannot write: %s", vlc_strerror_c(errno) );
+            errno = i_errno;
             return -1;
         }
 
-        if ((size_t)val >= p_buffer->i_buffer)
+        mtime_t i_latency = mdate () - i_start;
+        p_sys->i_latency += i_latency;
+        if (i_latency > p_sys->i_latency_max)
+            p_sys->i_latency_max = i_latency;
+        p_sys->i_writes++;
+        p_sys->i_written += val;
+        if (p_sys->i_offset != -1)
+            p_sys->i_offset += val;
+        i_write += val;
+
+        /* Skip what was written */
+        while (p_buffer && (size_t)val >= p_buffer->i_buffer)
         {
             block_t *p_next = p_buffer->p_next;
+            val -= p_buffer->i_buffer;
             block_Release (p_buffer);
             p_buffer = p_next;
         }
-        else
+        if (p_buffer)
         {
             p_buffer->p_buffer += val;
             p_buffer->i_buffer -= val;
         }
-        i_write += val;
     }
+
+    if (p_sys->i_offset != -1)
+        WriteBehind (p_access);
     return i_write;
 }
 
+/*****************************************************************************
+ * WriterThread: write queued blocks
+ *****************************************************************************/
+static void *WriterThread( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    vlc_mutex_lock (&p_sys->lock);
+    for (;;)
+    {
+        while (p_sys->p_queue == NULL && !p_sys->b_closing)
+            vlc_cond_wait (&p_sys->wait, &p_sys->lock);
+        if (p_sys->p_queue == NULL)
+            break;
+
+        /* Take everything queued so far and write it in one go */
+        block_t *p_chain = p_sys->p_queue;
+        size_t i_size = p_sys->i_queued;
+
+        p_sys->p_queue = NULL;
+        p_sys->pp_queue_last = &p_sys->p_queue;
+        p_sys->b_writing = true;
+        vlc_mutex_unlock (&p_sys->lock);
+
+        ssize_t val = WriteChain (p_access, p_chain);
+
+        int i_errno = errno;
+        vlc_mutex_lock (&p_sys->lock);
+        p_sys->i_queued -= i_size;
+        p_sys->b_writing = false;
+        if (val < 0 && !p_sys->b_error)
+        {
+            /* Logged once, until the caller gets the error */
+            msg_Err (p_access, "cannot write: %s", vlc_strerror_c(i_errno));
+            p_sys->b_error = true;
+        }
+        vlc_cond_broadcast (&p_sys->wait_space);
+    }
+    vlc_mutex_unlock (&p_sys->lock);
+    return NULL;
+}
+
+/*****************************************************************************
+ * Write: standard write on a file descriptor.
+ *****************************************************************************/
+static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if (!p_sys->b_async)
+    {
+        ssize_t val = WriteChain (p_access, p_buffer);
+        if (val < 0)
+            msg_Err (p_access, "cannot write: %s", vlc_strerror_c(errno));
+        return val;
+    }
+
+    size_t i_size;
+    block_ChainProperties (p_buffer, NULL, &i_size, NULL);
+
+    vlc_mutex_lock (&p_sys->lock);
+    /* Bounded queue: wait for the writer, unless the queue is empty */
+    while (p_sys->i_queued > 0 && p_sys->i_queued + i_size > p_sys->i_queue_max
+        && !p_sys->b_error)
+        vlc_cond_wait (&p_sys->wait_space, &p_sys->lock);
+
+    if (p_sys->b_error)
+    {
+        /* Reported once: the next write is queued again */
+        p_sys->b_error = false;
+        vlc_mutex_unlock (&p_sys->lock);
+        block_ChainRelease (p_buffer);
+        return -1;
+    }
+
+    block_ChainLastAppend (&p_sys->pp_queue_last, p_buffer);
+    p_sys->i_queued += i_size;
+    if (p_sys->i_queued > p_sys->i_queue_peak)
+        p_sys->i_queue_peak = p_sys->i_queued;
+    vlc_cond_signal (&p_sys->wait);
+    vlc_mutex_unlock (&p_sys->lock);
+    return i_size;
+}
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
 static int Seek( sout_access_out_t *p_access, off_t i_pos )
 {
-    return lseek( (intptr_t)p_access->p_sys, i_pos, SEEK_SET );
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if (Drain (p_sys))
+        return -1;
+
+    off_t i_ret = lseek( p_sys->fd, i_pos, SEEK_SET );
+    if (p_sys->i_offset != -1 && i_ret != -1)
+    {
+        p_sys->i_offset = i_ret;
+        p_sys->i_synced = __MIN(p_sys->i_synced, i_ret);
+    }
+    return i_ret;
 }
@@ -105,6 +105,19 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the segmented generated")
 
+#define MASTER_TEXT N_("Master playlist file")
+#define MASTER_LONGTEXT N_("Path to the master playlist to create. All the "\
+                           "livehttp outputs with the same master playlist "\
+                           "are listed in it as variants of the same stream, "\
+                           "and split their segments at the same times "\
+                           "(the encoders should use the same key frame "\
+                           "interval).")
+
+#define BANDWIDTH_TEXT N_("Variant bandwidth")
+#define BANDWIDTH_LONGTEXT N_("Peak bit rate (bits per second) of this "\
+                              "variant, for the master playlist. If zero, "\
+                              "it is measured from the segments.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -135,6 +148,10 @@ vlc_module_begin ()
                 KEYFILE_TEXT, KEYFILE_LONGTEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-loadfile", NULL,
                 KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT, true )
+    add_string( SOUT_CFG_PREFIX "master", NULL,
+                MASTER_TEXT, MASTER_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "bandwidth", 0,
+                 BANDWIDTH_TEXT, BANDWIDTH_LONGTEXT, true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -156,6 +173,8 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "master",
+    "bandwidth",
     NULL
 };
 
@@ -172,8 +191,32 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+    uint8_t aes_key[16];
+
+    /* Until the segment is published */
+    int i_handle;
+    block_t *p_data; /* data to encrypt */
+    block_t **pp_data_last;
+    uint64_t i_size;
+    bool b_isend;
+    struct output_segment *p_next; /* next segment waiting for the writer */
 } output_segment_t;
 
+/* Variant streams sharing a master playlist, across all instances */
+typedef struct
+{
+    char *psz_master;
+    char *psz_uri;
+    unsigned i_bandwidth;
+    bool b_active; /* Closed variants stay listed while others are active */
+    mtime_t i_splitgrid; /* last aligned split time */
+    mtime_t i_splitdts; /* dts of the key frame the variant split at */
+} output_variant_t;
+
+static vlc_mutex_t variants_lock = VLC_STATIC_MUTEX;
+static int i_variants = 0;
+static output_variant_t **pp_variants = NULL;
+
 struct sout_access_out_sys_t
 {
     char *psz_cursegPath;
@@ -196,11 +239,24 @@ struct sout_access_out_sys_t
     bool b_caching;
     bool b_generate_iv;
     uint8_t aes_ivs[16];
-    gcry_cipher_hd_t aes_ctx;
+    uint8_t aes_key[16];
     char *key_uri;
-    uint8_t stuffing_bytes[16];
-    ssize_t stuffing_size;
-    vlc_array_t *segments_t;
+    output_segment_t *p_cursegment; /* segment being muxed */
+    vlc_array_t *segments_t; /* published segments */
+
+    /* Encrypted segments are written and published by a separate thread */
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    output_segment_t *p_pending;
+    output_segment_t **pp_pending_last;
+    bool b_writer;
+    bool b_closing;
+
+    output_variant_t *p_variant;
+    bool b_bandwidth; /* measure variant bandwidth */
+    mtime_t i_nextsplit; /* aligned split time, if variant */
+    bool b_misaligned; /* last split did not line up with other variants */
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -208,6 +264,8 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int addVariant( sout_access_out_t *p_access, const char *psz_master );
+static void delVariant( output_variant_t *p_variant );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -243,8 +301,8 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->segments_t = vlc_array_new();
 
-    p_sys->stuffing_size = 0;
     p_sys->i_opendts = VLC_TS_INVALID;
+    p_sys->i_nextsplit = VLC_TS_INVALID;
 
     p_sys->psz_indexPath = NULL;
     psz_idx = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index" );
@@ -286,6 +344,24 @@ static int Open( vlc_object_t *p_this )
         return VLC_EGENERIC;
     }
 
+    char *psz_master = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "master" );
+    if( psz_master )
+    {
+        if( !p_sys->psz_indexPath )
+            msg_Warn( p_access, "no index file, not adding to master playlist" );
+        else if( addVariant( p_access, psz_master ) )
+            msg_Err( p_access, "cannot add variant to master playlist" );
+        free( psz_master );
+    }
+
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait );
+    p_sys->p_pending = NULL;
+    p_sys->pp_pending_last = &p_sys->p_pending;
+    p_sys->b_writer = false;
+    p_sys->b_closing = false;
+    p_sys->p_cursegment = NULL;
+
     p_sys->i_handle = -1;
     p_sys->i_segment = p_sys->i_initial_segment > 0 ? p_sys->i_initial_segment -1 : 0;
     p_sys->psz_cursegPath = NULL;
@@ -325,23 +401,12 @@ static int CryptSetup( sout_access_out_t *p_access, char *key_file )
 
     vlc_gcrypt_init();
 
-    /*Setup encryption cipher*/
-    gcry_error_t err = gcry_cipher_open( &p_sys->aes_ctx, GCRY_CIPHER_AES,
-                                         GCRY_CIPHER_MODE_CBC, 0 );
-    if( err )
-    {
-        msg_Err( p_access, "Openin AES Cipher failed: %s", gpg_strerror(err));
-        free( keyfile );
-        return VLC_EGENERIC;
-    }
-
     int keyfd = vlc_open( keyfile, O_RDONLY | O_NONBLOCK );
     if( unlikely( keyfd == -1 ) )
     {
         msg_Err( p_access, "Unable to open keyfile %s: %s", keyfile,
                  vlc_strerror_c(errno) );
         free( keyfile );
-        gcry_cipher_close( p_sys->aes_ctx );
         return VLC_EGENERIC;
     }
     free( keyfile );
@@ -352,17 +417,11 @@ static int CryptSetup( sout_access_out_t *p_access, char *key_file )
     if( keylen < 16 )
     {
         msg_Err( p_access, "No key at least 16 octects (you provided %zd), no encryption", keylen );
-        gcry_cipher_close( p_sys->aes_ctx );
         return VLC_EGENERIC;
     }
 
-    err = gcry_cipher_setkey( p_sys->aes_ctx, key, 16 );
-    if(err)
-    {
-        msg_Err(p_access, "Setting AES key failed: %s", gpg_strerror(err));
-        gcry_cipher_close( p_sys->aes_ctx );
-        return VLC_EGENERIC;
-    }
+    /* The cipher itself is set up for each segment by the writer thread */
+    memcpy( p_sys->aes_key, key, 16 );
 
     if( p_sys->b_generate_iv )
         vlc_rand_bytes( p_sys->aes_ivs, sizeof(uint8_t)*16);
@@ -436,31 +495,73 @@ static int LoadCryptFile( sout_access_out_t *p_access )
 }
 
 /************************************************************************
- * CryptKey: Set encryption IV to current segment number
+ * CryptKey: Set segment key and encryption IV to segment number
  ************************************************************************/
-static int CryptKey( sout_access_out_t *p_access, uint32_t i_segment )
+static void CryptKey( sout_access_out_sys_t *p_sys, output_segment_t *segment )
 {
-    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    uint32_t i_segment = segment->i_segment_number;
 
     if( !p_sys->b_generate_iv )
     {
         /* Use segment number as IV if randomIV isn't selected*/
-        memset( p_sys->aes_ivs, 0, 16 * sizeof(uint8_t));
-        p_sys->aes_ivs[15] = i_segment & 0xff;
-        p_sys->aes_ivs[14] = (i_segment >> 8 ) & 0xff;
-        p_sys->aes_ivs[13] = (i_segment >> 16 ) & 0xff;
-        p_sys->aes_ivs[12] = (i_segment >> 24 ) & 0xff;
+        memset( segment->aes_ivs, 0, 16 * sizeof(uint8_t));
+        segment->aes_ivs[15] = i_segment & 0xff;
+        segment->aes_ivs[14] = (i_segment >> 8 ) & 0xff;
+        segment->aes_ivs[13] = (i_segment >> 16 ) & 0xff;
+        segment->aes_ivs[12] = (i_segment >> 24 ) & 0xff;
     }
+    else
+        memcpy( segment->aes_ivs, p_sys->aes_ivs, 16 );
 
-    gcry_error_t err = gcry_cipher_setiv( p_sys->aes_ctx,
-                                          p_sys->aes_ivs, 16);
+    memcpy( segment->aes_key, p_sys->aes_key, 16 );
+}
+
+/************************************************************************
+ * CryptSegment: Encrypt all the data of a segment at once
+ ************************************************************************/
+static block_t *CryptSegment( sout_access_out_t *p_access,
+                              output_segment_t *segment )
+{
+    block_t *data = segment->p_data;
+    segment->p_data = NULL;
+    segment->pp_data_last = &segment->p_data;
+
+    data = data ? block_ChainGather( data ) : block_Alloc( 0 );
+    if( unlikely(data == NULL) )
+        return NULL;
+
+    /* PKCS#7 padding */
+    size_t len = data->i_buffer;
+    size_t pad = 16 - (len & 15);
+    data = block_Realloc( data, 0, len + pad );
+    if( unlikely(data == NULL) )
+        return NULL;
+    memset( &data->p_buffer[len], pad, pad );
+
+    gcry_cipher_hd_t aes_ctx;
+    gcry_error_t err = gcry_cipher_open( &aes_ctx, GCRY_CIPHER_AES,
+                                         GCRY_CIPHER_MODE_CBC, 0 );
     if( err )
     {
-        msg_Err(p_access, "Setting AES IVs failed: %s", gpg_strerror(err) );
-        gcry_cipher_close( p_sys->aes_ctx);
-        return VLC_EGENERIC;
+        msg_Err( p_access, "Openin AES Cipher failed: %s", gpg_strerror(err));
+        block_Release( data );
+        return NULL;
     }
-    return VLC_SUCCESS;
+
+    err = gcry_cipher_setkey( aes_ctx, segment->aes_key, 16 );
+    if( !err )
+        err = gcry_cipher_setiv( aes_ctx, segment->aes_ivs, 16 );
+    if( !err )
+        err = gcry_cipher_encrypt( aes_ctx, data->p_buffer, data->i_buffer,
+                                   NULL, 0 );
+    gcry_cipher_close( aes_ctx );
+    if( err )
+    {
+        msg_Err( p_access, "Encryption failure: %s ", gpg_strerror(err) );
+        block_Release( data );
+        return NULL;
+    }
+    return data;
 }
 
 
@@ -499,6 +600,7 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg, bool b_sanitize
 
 static void destroySegment( output_segment_t *segment )
 {
+    block_ChainRelease( segment->p_data );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -531,7 +633,8 @@ static uint32_t segmentAmountNeeded( sout_access_out_sys_t *p_sys )
  * check that the first item has been around outside playlist
  * segment->f_seglength + (p_sys->i_numsegs * p_sys->i_seglen) before it is removed.
  ************************************************************************/
-static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_firstseg, uint32_t i_index_offset )
+static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_lastseg,
+                                  uint32_t i_firstseg, uint32_t i_index_offset )
 {
     float duration = .0f;
 
@@ -540,7 +643,7 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
      */
     for( unsigned int index = 0; index < i_index_offset; index++ )
     {
-        output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, p_sys->i_segment - i_firstseg + index );
+        output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, i_lastseg - i_firstseg + index );
         duration += segment->f_seglength;
     }
     output_segment_t *first = vlc_array_item_at_index( p_sys->segments_t, 0 );
@@ -556,16 +659,20 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
 
     uint32_t i_firstseg;
     unsigned i_index_offset = 0;
+    /* Last published segment */
+    output_segment_t *last = vlc_array_item_at_index( p_sys->segments_t,
+                                vlc_array_count( p_sys->segments_t ) - 1 );
+    uint32_t i_lastseg = last->i_segment_number;
 
     if ( p_sys->i_numsegs == 0 ||
-         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
+         i_lastseg < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
     {
         i_firstseg = p_sys->i_initial_segment == 0 ? 1 : p_sys->i_initial_segment;
     }
     else
     {
         unsigned numsegs = segmentAmountNeeded( p_sys );
-        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
+        i_firstseg = ( i_lastseg - numsegs ) + 1;
         i_index_offset = vlc_array_count( p_sys->segments_t ) - numsegs;
     }
 
@@ -599,13 +706,13 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
         char *psz_current_uri=NULL;
 
 
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+        for ( uint32_t i = i_firstseg; i <= i_lastseg; i++ )
         {
             //scale to i_index_offset..numsegs + i_index_offset
             uint32_t index = i - i_firstseg + i_index_offset;
 
             output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, index );
-            if( p_sys->key_uri &&
+            if( segment->psz_key_uri &&
                 ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
               )
             {
@@ -676,7 +783,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
     while( p_sys->b_delsegs && p_sys->i_numsegs &&
-           isFirstItemRemovable( p_sys, i_firstseg, i_index_offset )
+           isFirstItemRemovable( p_sys, i_lastseg, i_firstseg, i_index_offset )
          )
     {
          output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, 0 );
@@ -696,51 +803,291 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     return 0;
 }
 
+/************************************************************************
+ * writeMaster: Write the master playlist (variants_lock must be held)
+ ************************************************************************/
+static void writeMaster( vlc_object_t *p_obj, const char *psz_master )
+{
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp", psz_master ) < 0 )
+        return;
+
+    FILE *fp = vlc_fopen( psz_tmp, "wt" );
+    if( !fp )
+    {
+        msg_Err( p_obj, "cannot open master playlist `%s'", psz_tmp );
+        free( psz_tmp );
+        return;
+    }
+
+    int val = fputs( "#EXTM3U\n", fp );
+    for( int i = 0; i < i_variants && val >= 0; i++ )
+    {
+        const output_variant_t *variant = pp_variants[i];
+
+        /* Variants are listed once their bandwidth is known */
+        if( strcmp( variant->psz_master, psz_master ) || !variant->i_bandwidth )
+            continue;
+        val = fprintf( fp, "#EXT-X-STREAM-INF:BANDWIDTH=%u\n%s\n",
+                       variant->i_bandwidth, variant->psz_uri );
+    }
+
+    if( fclose( fp ) || val < 0 || vlc_rename( psz_tmp, psz_master ) < 0 )
+    {
+        vlc_unlink( psz_tmp );
+        msg_Err( p_obj, "Error writing LiveHttp master playlist" );
+    }
+    free( psz_tmp );
+}
+
+/************************************************************************
+ * addVariant: Register this output in a master playlist
+ ************************************************************************/
+static int addVariant( sout_access_out_t *p_access, const char *psz_master )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    output_variant_t *variant = malloc( sizeof( *variant ) );
+    if( unlikely( !variant ) )
+        return VLC_ENOMEM;
+
+    variant->psz_master = str_format_time( psz_master );
+    if( unlikely( !variant->psz_master ) )
+    {
+        free( variant );
+        return VLC_ENOMEM;
+    }
+    path_sanitize( variant->psz_master );
+
+    /* Refer to the variant playlist relatively to the master playlist */
+    const char *psz_uri = p_sys->psz_indexPath;
+    const char *psz_sep = strrchr( variant->psz_master, DIR_SEP_CHAR );
+    if( psz_sep )
+    {
+        size_t i_dirlen = psz_sep + 1 - variant->psz_master;
+        if( !strncmp( psz_uri, variant->psz_master, i_dirlen ) )
+            psz_uri += i_dirlen;
+    }
+
+    variant->psz_uri = strdup( psz_uri );
+    if( unlikely( !variant->psz_uri ) )
+    {
+        free( variant->psz_master );
+        free( variant );
+        return VLC_ENOMEM;
+    }
+    variant->i_bandwidth = var_GetInteger( p_access, SOUT_CFG_PREFIX "bandwidth" );
+    variant->b_active = true;
+    variant->i_splitgrid = VLC_TS_INVALID;
+    variant->i_splitdts = VLC_TS_INVALID;
+    p_sys->b_bandwidth = variant->i_bandwidth == 0;
+
+    vlc_mutex_lock( &variants_lock );
+    /* Take over a closed instance of the same variant, if any */
+    for( int i = 0; i < i_variants; i++ )
+    {
+        output_variant_t *old = pp_variants[i];
+
+        if( !old->b_active && !strcmp( old->psz_master, variant->psz_master )
+         && !strcmp( old->psz_uri, variant->psz_uri ) )
+        {
+            TAB_REMOVE( i_variants, pp_variants, old );
+            free( old->psz_master );
+            free( old->psz_uri );
+            free( old );
+            break;
+        }
+    }
+    TAB_APPEND( i_variants, pp_variants, variant );
+    writeMaster( VLC_OBJECT(p_access), variant->psz_master );
+    vlc_mutex_unlock( &variants_lock );
+
+    p_sys->p_variant = variant;
+    return VLC_SUCCESS;
+}
+
+static void delVariant( output_variant_t *variant )
+{
+    bool b_last = true;
+
+    vlc_mutex_lock( &variants_lock );
+    variant->b_active = false;
+    for( int i = 0; i < i_variants && b_last; i++ )
+        if( pp_variants[i]->b_active
+         && !strcmp( pp_variants[i]->psz_master, variant->psz_master ) )
+            b_last = false;
+
+    /* Forget about the master playlist once all its variants are closed */
+    for( int i = 0; b_last && i < i_variants; )
+    {
+        output_variant_t *old = pp_variants[i];
+
+        if( old != variant && !strcmp( old->psz_master, variant->psz_master ) )
+        {
+            TAB_REMOVE( i_variants, pp_variants, old );
+            free( old->psz_master );
+            free( old->psz_uri );
+            free( old );
+        }
+        else
+            i++;
+    }
+    if( b_last )
+    {
+        TAB_REMOVE( i_variants, pp_variants, variant );
+        free( variant->psz_master );
+        free( variant->psz_uri );
+        free( variant );
+    }
+    vlc_mutex_unlock( &variants_lock );
+}
+
+/************************************************************************
+ * updateVariant: Update the measured peak bandwidth of this variant
+ ************************************************************************/
+static void updateVariant( sout_access_out_t *p_access, const output_segment_t *segment )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    output_variant_t *variant = p_sys->p_variant;
+
+    if( !variant || !p_sys->b_bandwidth || segment->f_seglength <= 0.f )
+        return;
+
+    unsigned i_bandwidth = segment->i_size * 8 / segment->f_seglength;
+
+    vlc_mutex_lock( &variants_lock );
+    /* Do not rewrite the master playlist for every small increase */
+    if( i_bandwidth > variant->i_bandwidth + variant->i_bandwidth / 10 )
+    {
+        variant->i_bandwidth = i_bandwidth;
+        writeMaster( VLC_OBJECT(p_access), variant->psz_master );
+    }
+    vlc_mutex_unlock( &variants_lock );
+}
+
 /*****************************************************************************
- * closeCurrentSegment: Close the segment file
+ * publishSegment: Finish writing a closed segment and add it to the index
  *****************************************************************************/
-static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+static void publishSegment( sout_access_out_t *p_access, output_segment_t *segment )
 {
-    if ( p_sys->i_handle >= 0 )
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( segment->psz_key_uri )
     {
-        output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, vlc_array_count( p_sys->segments_t ) - 1 );
+        block_t *data = CryptSegment( p_access, segment );
 
-        if( p_sys->key_uri )
+        for( size_t i = 0; data && i < data->i_buffer; )
         {
-            size_t pad = 16 - p_sys->stuffing_size;
-            memset(&p_sys->stuffing_bytes[p_sys->stuffing_size], pad, pad);
-            gcry_error_t err = gcry_cipher_encrypt( p_sys->aes_ctx, p_sys->stuffing_bytes, 16, NULL, 0 );
-
-            if( err ) {
-               msg_Err( p_access, "Couldn't encrypt 16 bytes: %s", gpg_strerror(err) );
-            } else {
-            int ret = write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
-            if( ret != 16 )
-                msg_Err( p_access, "Couldn't write 16 bytes" );
+            ssize_t val = write( segment->i_handle, &data->p_buffer[i],
+                                 data->i_buffer - i );
+            if( val == -1 )
+            {
+                if( errno == EINTR )
+                    continue;
+                msg_Err( p_access, "cannot write `%s' (%s)",
+                         segment->psz_filename, vlc_strerror_c(errno) );
+                break;
             }
-            p_sys->stuffing_size = 0;
+            i += val;
         }
+        if( data )
+            block_Release( data );
+    }
+
+    close( segment->i_handle );
+    segment->i_handle = -1;
 
+    msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , segment->psz_filename, segment->i_segment_number );
+    vlc_array_append( p_sys->segments_t, segment );
+    updateVariant( p_access, segment );
+    updateIndexAndDel( p_access, p_sys, segment->b_isend );
+}
+
+/*****************************************************************************
+ * WriterThread: Encrypt and publish the closed segments
+ *****************************************************************************/
+static void *WriterThread( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
 
-        close( p_sys->i_handle );
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( !p_sys->p_pending && !p_sys->b_closing )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+
+        output_segment_t *segment = p_sys->p_pending;
+        if( !segment )
+            break;
+        p_sys->p_pending = segment->p_next;
+        if( !p_sys->p_pending )
+            p_sys->pp_pending_last = &p_sys->p_pending;
+        segment->p_next = NULL;
+        vlc_mutex_unlock( &p_sys->lock );
+
+        publishSegment( p_access, segment );
+
+        vlc_mutex_lock( &p_sys->lock );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void queueSegment( sout_access_out_t *p_access, output_segment_t *segment )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->b_writer )
+    {
+        if( vlc_clone( &p_sys->thread, WriterThread, p_access,
+                       VLC_THREAD_PRIORITY_LOW ) )
+        {
+            msg_Err( p_access, "cannot spawn segment writer thread" );
+            publishSegment( p_access, segment );
+            return;
+        }
+        p_sys->b_writer = true;
+    }
+
+    vlc_mutex_lock( &p_sys->lock );
+    *p_sys->pp_pending_last = segment;
+    p_sys->pp_pending_last = &segment->p_next;
+    vlc_cond_signal( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
+/*****************************************************************************
+ * closeCurrentSegment: Close the segment file
+ *****************************************************************************/
+static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+{
+    if ( p_sys->i_handle >= 0 )
+    {
+        output_segment_t *segment = p_sys->p_cursegment;
+
+        segment->i_handle = p_sys->i_handle;
         p_sys->i_handle = -1;
+        p_sys->p_cursegment = NULL;
+        free( p_sys->psz_cursegPath );
+        p_sys->psz_cursegPath = NULL;
 
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
         {
             msg_Err( p_access, "Couldn't set duration on closed segment");
+            close( segment->i_handle );
+            destroySegment( segment );
             return;
         }
         segment->f_seglength = p_sys->f_seglen;
+        segment->b_isend = b_isend;
 
-        segment->i_segment_number = p_sys->i_segment;
-
-        if ( p_sys->psz_cursegPath )
-        {
-            msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , p_sys->psz_cursegPath, p_sys->i_segment );
-            free( p_sys->psz_cursegPath );
-            p_sys->psz_cursegPath = 0;
-            updateIndexAndDel( p_access, p_sys, b_isend );
-        }
+        /* Encryption is done off the muxer thread. Once that thread exists,
+         * all segments go through it so that they are published in order. */
+        if( segment->psz_key_uri || p_sys->b_writer )
+            queueSegment( p_access, segment );
+        else
+            publishSegment( p_access, segment );
     }
 }
 
@@ -790,11 +1137,21 @@ static void Close( vlc_object_t * p_this )
 
     closeCurrentSegment( p_access, p_sys, true );
 
-    if( p_sys->key_uri )
+    if( p_sys->b_writer )
     {
-        gcry_cipher_close( p_sys->aes_ctx );
-        free( p_sys->key_uri );
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->b_closing = true;
+        vlc_cond_signal( &p_sys->wait );
+        vlc_mutex_unlock( &p_sys->lock );
+        vlc_join( p_sys->thread, NULL );
     }
+    vlc_cond_destroy( &p_sys->wait );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    if( p_sys->p_variant )
+        delVariant( p_sys->p_variant );
+
+    free( p_sys->key_uri );
 
     while( vlc_array_count( p_sys->segments_t ) > 0 )
     {
@@ -852,6 +1209,7 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
 
     segment->i_segment_number = i_newseg;
+    segment->pp_data_last = &segment->p_data;
     segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg, true );
     char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
     segment->psz_uri = formatSegmentPath( psz_idxFormat , i_newseg, false );
@@ -873,8 +1231,6 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
     }
 
-    vlc_array_append( p_sys->segments_t, segment);
-
     if( p_sys->psz_keyfile )
     {
         LoadCryptFile( p_access );
@@ -883,17 +1239,47 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
     if( p_sys->key_uri )
     {
         segment->psz_key_uri = strdup( p_sys->key_uri );
-        CryptKey( p_access, i_newseg );
-        if( p_sys->b_generate_iv )
-            memcpy( segment->aes_ivs, p_sys->aes_ivs, sizeof(uint8_t)*16 );
+        CryptKey( p_sys, segment );
     }
     msg_Dbg( p_access, "Successfully opened livehttp file: %s (%"PRIu32")" , segment->psz_filename, i_newseg );
 
     p_sys->psz_cursegPath = strdup(segment->psz_filename);
+    p_sys->p_cursegment = segment;
     p_sys->i_handle = fd;
     p_sys->i_segment = i_newseg;
     return fd;
 }
+/*****************************************************************************
+ * CheckVariantSplit: Check that the variants split at the same key frame
+ *****************************************************************************/
+static void CheckVariantSplit( sout_access_out_t *p_access, mtime_t i_dts )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    output_variant_t *variant = p_sys->p_variant;
+    bool b_aligned = true;
+
+    vlc_mutex_lock( &variants_lock );
+    variant->i_splitgrid = p_sys->i_nextsplit;
+    variant->i_splitdts = i_dts;
+    for( int i = 0; i < i_variants && b_aligned; i++ )
+    {
+        const output_variant_t *other = pp_variants[i];
+
+        if( other != variant && other->b_active
+         && other->i_splitgrid == variant->i_splitgrid
+         && !strcmp( other->psz_master, variant->psz_master )
+         && other->i_splitdts != i_dts )
+            b_aligned = false;
+    }
+    vlc_mutex_unlock( &variants_lock );
+
+    if( !b_aligned && !p_sys->b_misaligned )
+        msg_Warn( p_access, "variant segments do not line up at %"PRId64
+                  ", the encoders must use the same key frame interval",
+                  p_sys->i_nextsplit );
+    p_sys->b_misaligned = !b_aligned;
+}
+
 /*****************************************************************************
  * CheckSegmentChange: Check if segment needs to be closed and new opened
  *****************************************************************************/
@@ -902,6 +1288,17 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     block_t *output = p_sys->block_buffer;
 
+    if( p_sys->p_variant )
+    {
+        /* Variants split at the same times, so that their segments line up
+         * if the encoders use the same key frame interval. */
+        if( p_sys->i_handle > 0 && p_buffer->i_dts >= p_sys->i_nextsplit )
+        {
+            CheckVariantSplit( p_access, p_buffer->i_dts );
+            closeCurrentSegment( p_access, p_sys, false );
+        }
+    }
+    else
     if( p_sys->i_handle > 0 &&
         ( ( p_buffer->i_dts - p_sys->i_opendts +
           ( p_buffer->i_length * CLOCK_FREQ / INT64_C(1000000) )
@@ -917,6 +1314,8 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         if( ( p_sys->i_opendts != VLC_TS_INVALID ) &&
             ( p_buffer->i_dts < p_sys->i_opendts ) )
             p_sys->i_opendts = p_buffer->i_dts;
+        p_sys->i_nextsplit = ( p_buffer->i_dts / p_sys->i_seglenm + 1 )
+                           * p_sys->i_seglenm;
 
         if ( openNextFile( p_access, p_sys ) < 0 )
            return VLC_EGENERIC;
@@ -927,60 +1326,51 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
 static ssize_t writeSegment( sout_access_out_t *p_access )
 {
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+    output_segment_t *segment = p_sys->p_cursegment;
     block_t *output = p_sys->block_buffer;
     p_sys->block_buffer = NULL;
     ssize_t i_write=0;
-    bool crypted = false;
-    while( output )
+
+    if( !output )
+        return 0;
+    if( !segment )
     {
-        if( p_sys->key_uri && !crypted )
-        {
-            if( p_sys->stuffing_size )
-            {
-                output = block_Realloc( output, p_sys->stuffing_size, output->i_buffer );
-                if( unlikely(!output ) )
-                    return VLC_ENOMEM;
-                memcpy( output->p_buffer, p_sys->stuffing_bytes, p_sys->stuffing_size );
-                p_sys->stuffing_size = 0;
-            }
-            size_t original = output->i_buffer;
-            size_t padded = (output->i_buffer + 15 ) & ~15;
-            size_t pad = padded - original;
-            if( pad )
-            {
-                p_sys->stuffing_size = 16-pad;
-                output->i_buffer -= p_sys->stuffing_size;
-                memcpy(p_sys->stuffing_bytes, &output->p_buffer[output->i_buffer], p_sys->stuffing_size);
-            }
+        block_ChainRelease( output );
+        return -1;
+    }
 
-            gcry_error_t err = gcry_cipher_encrypt( p_sys->aes_ctx,
-                                output->p_buffer, output->i_buffer, NULL, 0 );
-            if( err )
-            {
-                msg_Err( p_access, "Encryption failure: %s ", gpg_strerror(err) );
-                return -1;
-            }
-            crypted=true;
+    while( output )
+    {
+        p_sys->f_seglen =
+            (float)(output->i_length / INT64_C(1000000) ) +
+            (float)(output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
 
+        /* Encrypted segments are written at once when they are complete */
+        if( segment->psz_key_uri )
+        {
+            block_t *p_next = output->p_next;
+            output->p_next = NULL;
+            i_write += output->i_buffer;
+            segment->i_size += output->i_buffer;
+            block_ChainLastAppend( &segment->pp_data_last, output );
+            output = p_next;
+            continue;
         }
+
         ssize_t val = write( p_sys->i_handle, output->p_buffer, output->i_buffer );
         if ( val == -1 )
         {
            if ( errno == EINTR )
               continue;
+           block_ChainRelease( output );
            return -1;
         }
 
-        p_sys->f_seglen =
-            (float)(output->i_length / INT64_C(1000000) ) +
-            (float)(output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
-
         if ( (size_t)val >= output->i_buffer )
         {
            block_t *p_next = output->p_next;
            block_Release (output);
            output = p_next;
-           crypted=false;
         }
         else
         {
@@ -988,6 +1378,7 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
            output->i_buffer -= val;
         }
         i_write += val;
+        segment->i_size += val;
     }
     return i_write;
 }
@@ -465,6 +465,22 @@ int OpenEncoder( vlc_object_t *p_this )
 
         if( p_sys->i_key_int > 0 )
             p_context->gop_size = p_sys->i_key_int;
+        /* Fixed key frame interval requested by the caller, unless keyint
+         * was set explicitly */
+        if( p_enc->i_iframes > 0 && p_sys->i_key_int > 0
+         && p_sys->i_key_int != p_enc->i_iframes )
+        {
+            msg_Warn( p_enc, "keyint=%d kept instead of a key frame every %d "
+                      "frames: key frames may not match other renditions",
+                      p_sys->i_key_int, p_enc->i_iframes );
+        }
+        else if( p_enc->i_iframes > 0 )
+        {
+            p_context->gop_size = p_enc->i_iframes;
+            p_context->keyint_min = p_enc->i_iframes;
+            p_context->scenechange_threshold = 1000000000; /* no scene cut */
+            p_context->flags |= CODEC_FLAG_CLOSED_GOP;
+        }
         p_context->max_b_frames =
             VLC_CLIP( p_sys->i_b_frames, 0, FF_MAX_B_FRAMES );
         p_context->b_frame_strategy = 0;
@@ -680,7 +696,8 @@ int OpenEncoder( vlc_object_t *p_this )
         /* Lets give bitrate tolerance */
         p_context->bit_rate_tolerance = __MAX(2 * (int)p_enc->fmt_out.i_bitrate, p_sys->i_vtolerance );
         /* default to 120 frames between keyframe */
-        if( !var_GetInteger( p_enc, ENC_CFG_PREFIX "keyint" ) )
+        if( !var_GetInteger( p_enc, ENC_CFG_PREFIX "keyint" )
+         && p_enc->i_iframes <= 0 )
             p_context->gop_size = 120;
         /* Don't set rc-values atm, they were from time before
            libvpx was officially in FFmpeg */
@@ -1114,6 +1114,44 @@ static int  Open ( vlc_object_t *p_this )
     if( i_val >= -1 && i_val <= 100 && i_val != 40 )
         p_sys->param.i_scenecut_threshold = i_val;
 
+    /* The caller asked for a fixed key frame interval, e.g. so that several
+     * renditions of the same source can be switched at the same frames.
+     * A maximum GOP size set explicitly still wins. */
+    i_val = var_GetInteger( p_enc, SOUT_CFG_PREFIX "keyint" );
+    if( p_enc->i_iframes > 0 && i_val != 250 && i_val != p_enc->i_iframes )
+    {
+        msg_Warn( p_enc, "keyint=%d kept instead of a key frame every %d "
+                  "frames: key frames may not match other renditions",
+                  i_val, p_enc->i_iframes );
+    }
+    else if( p_enc->i_iframes > 0 )
+    {
+        bool b_open_gop;
+#if X264_BUILD >= 102 && X264_BUILD <= 114
+        psz_val = var_GetString( p_enc, SOUT_CFG_PREFIX "opengop" );
+        b_open_gop = strcmp( psz_val, "none" ) != 0;
+        free( psz_val );
+#elif X264_BUILD >= 115
+        b_open_gop = var_GetBool( p_enc, SOUT_CFG_PREFIX "opengop" );
+#else
+        b_open_gop = false;
+#endif
+        if( var_GetInteger( p_enc, SOUT_CFG_PREFIX "min-keyint" ) != 25
+         || var_GetInteger( p_enc, SOUT_CFG_PREFIX "scenecut" ) != 40
+         || b_open_gop )
+            msg_Warn( p_enc, "min-keyint, scenecut and opengop ignored for "
+                      "a key frame every %d frames", p_enc->i_iframes );
+
+        p_sys->param.i_keyint_max = p_enc->i_iframes;
+        p_sys->param.i_keyint_min = p_enc->i_iframes;
+        p_sys->param.i_scenecut_threshold = 0;
+#if X264_BUILD >= 102 && X264_BUILD <= 114
+        p_sys->param.i_open_gop = X264_OPEN_GOP_NONE;
+#elif X264_BUILD >= 115
+        p_sys->param.b_open_gop = false;
+#endif
+    }
+
     p_sys->param.b_deterministic = var_GetBool( p_enc,
                         SOUT_CFG_PREFIX "non-deterministic" );
 
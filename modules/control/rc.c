@@ -1756,6 +1756,31 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
             p_item->p_stats->i_demux_corrupted );
     msg_rc(_("| discontinuities  :    %5"PRIi64),
             p_item->p_stats->i_demux_discontinuity );
+    msg_rc(_("| stream cache     : %8.0f KiB"),
+            (float)(p_item->p_stats->i_stream_cache_size)/1024 );
+    msg_rc(_("| stream read size : %8"PRIi64" B"),
+            p_item->p_stats->i_stream_read_size );
+    msg_rc(_("| stream seeks     :    %5"PRIi64),
+            p_item->p_stats->i_stream_seeks );
+    msg_rc(_("| packets lost     :    %5"PRIi64),
+            p_item->p_stats->i_packets_lost );
+    msg_rc(_("| packets late     :    %5"PRIi64),
+            p_item->p_stats->i_packets_late );
+    msg_rc(_("| packets reordered:    %5"PRIi64),
+            p_item->p_stats->i_packets_reordered );
+    msg_rc(_("| packets duplicate:    %5"PRIi64),
+            p_item->p_stats->i_packets_duplicate );
+    msg_rc(_("| read stalls      :    %5"PRIi64),
+            p_item->p_stats->i_read_stalls );
+    msg_rc(_("| read stall time  : %8"PRIi64" ms"),
+            p_item->p_stats->i_read_stall_time / 1000 );
+    msg_rc(_("| cache hits       :    %5"PRIi64" (%.0f KiB)"),
+            p_item->p_stats->i_cache_hits,
+            (float)(p_item->p_stats->i_cache_hit_bytes)/1024 );
+    msg_rc(_("| reused connection:    %5"PRIi64),
+            p_item->p_stats->i_connection_reuses );
+    msg_rc(_("| reconnections    :    %5"PRIi64),
+            p_item->p_stats->i_reconnections );
     msg_rc("|");
     /* Video */
     msg_rc("%s", _("+-[Video Decoding]"));
@@ -30,6 +30,7 @@
 #endif
 #include <assert.h>
 #include <ctype.h>
+#include <sys/stat.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -42,6 +43,9 @@
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <vlc_atomic.h>
 
 #include "libavi.h"
 #include "../rawdv.h"
@@ -57,6 +61,11 @@
     "Recreate a index for the AVI file. Use this if your AVI file is damaged "\
     "or incomplete (not seekable)." )
 
+#define INDEX_CACHE_TEXT N_("Cache rebuilt index")
+#define INDEX_CACHE_LONGTEXT N_( \
+    "Save the index rebuilt for a local AVI file in the user cache " \
+    "directory, so that the file opens instantly the next time it is played." )
+
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
@@ -79,6 +88,8 @@ vlc_module_begin ()
     add_integer( "avi-index", 0,
               INDEX_TEXT, INDEX_LONGTEXT, false )
         change_integer_list( pi_index, ppsz_indexes )
+    add_bool( "avi-index-cache", true,
+              INDEX_CACHE_TEXT, INDEX_CACHE_LONGTEXT, true )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -162,6 +173,24 @@ typedef struct
 
 } avi_track_t;
 
+/* Background index reconstruction */
+typedef struct
+{
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+    stream_t     *s;
+
+    off_t        i_movi_begin;
+    off_t        i_movi_end;
+    off_t        i_last_pos;
+
+    avi_index_t  *p_index;      /* one per track, protected by lock */
+    unsigned int *pi_merged;    /* entries already given to the tracks */
+
+    bool         b_done;        /* protected by lock */
+    atomic_bool  b_abort;
+} avi_index_scan_t;
+
 struct demux_sys_t
 {
     mtime_t i_time;
@@ -184,6 +213,8 @@ struct demux_sys_t
 
     unsigned int       i_attachment;
     input_attachment_t **attachment;
+
+    avi_index_scan_t   *p_scan;
 };
 
 static inline off_t __EVEN( off_t i )
@@ -206,13 +237,17 @@ static int AVI_StreamBytesSet ( demux_t *,
 vlc_fourcc_t AVI_FourccGetCodec( unsigned int i_cat, vlc_fourcc_t );
 static int   AVI_GetKeyFlag    ( vlc_fourcc_t , uint8_t * );
 
-static int AVI_PacketGetHeader( demux_t *, avi_packet_t *p_pk );
-static int AVI_PacketNext     ( demux_t * );
+static int AVI_PacketGetHeader( stream_t *, avi_packet_t *p_pk );
+static int AVI_PacketNext     ( stream_t * );
 static int AVI_PacketRead     ( demux_t *, avi_packet_t *, block_t **);
-static int AVI_PacketSearch   ( demux_t * );
+static int AVI_PacketSearch   ( demux_t *, stream_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
+static int  AVI_IndexCacheLoad( demux_t * );
+static int  AVI_IndexScanStart( demux_t *, avi_chunk_list_t *p_movi );
+static void AVI_IndexScanMerge( demux_t * );
+static void AVI_IndexScanStop ( demux_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
@@ -628,7 +663,11 @@ static int Open( vlc_object_t * p_this )
 aviindex:
         if( p_sys->b_seekable )
         {
-            AVI_IndexCreate( p_demux );
+            /* Prefer a cached index, then a background scan, and only block
+             * on a full scan when the file cannot be reopened */
+            if( AVI_IndexCacheLoad( p_demux ) &&
+                AVI_IndexScanStart( p_demux, p_movi ) )
+                AVI_IndexCreate( p_demux );
         }
         else
         {
@@ -643,6 +682,13 @@ aviindex:
 
     /* *** movie length in sec *** */
     p_sys->i_length = AVI_MovieGetLength( p_demux );
+    if( p_sys->p_scan )
+    {
+        /* The index is still being built, trust the header meanwhile */
+        p_sys->i_length = (mtime_t)p_avih->i_totalframes *
+                          (mtime_t)p_avih->i_microsecperframe /
+                          (mtime_t)1000000;
+    }
 
     /* Check the index completeness */
     unsigned int i_idx_totalframes = 0;
@@ -756,6 +802,7 @@ error:
     if( p_sys->meta )
         vlc_meta_Delete( p_sys->meta );
 
+    AVI_IndexScanStop( p_demux );
     AVI_ChunkFreeRoot( p_demux->s, &p_sys->ck_root );
     free( p_sys );
     return b_aborted ? VLC_ETIMEOUT : VLC_EGENERIC;
@@ -769,6 +816,8 @@ static void Close ( vlc_object_t * p_this )
     demux_t *    p_demux = (demux_t *)p_this;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    AVI_IndexScanStop( p_demux );
+
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -816,6 +865,7 @@ static int Demux_Seekable( demux_t *p_demux )
     /* cannot be more than 100 stream (dcXX or wbXX) */
     avi_track_toread_t toread[100];
 
+    AVI_IndexScanMerge( p_demux );
 
     /* detect new selected/unselected streams */
     for( i_track = 0; i_track < p_sys->i_track; i_track++ )
@@ -957,7 +1007,7 @@ static int Demux_Seekable( demux_t *p_demux )
             if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
             {
                 stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( AVI_TrackStopFinishedStreams( p_demux ) ? 0 : 1 );
                 }
@@ -971,7 +1021,7 @@ static int Demux_Seekable( demux_t *p_demux )
             {
                 avi_packet_t avi_pk;
 
-                if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+                if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
                 {
                     msg_Warn( p_demux,
                              "cannot get packet header, track disabled" );
@@ -980,7 +1030,7 @@ static int Demux_Seekable( demux_t *p_demux )
                 if( avi_pk.i_stream >= p_sys->i_track ||
                     ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
                 {
-                    if( AVI_PacketNext( p_demux ) )
+                    if( AVI_PacketNext( p_demux->s ) )
                     {
                         msg_Warn( p_demux,
                                   "cannot skip packet, track disabled" );
@@ -1021,7 +1071,7 @@ static int Demux_Seekable( demux_t *p_demux )
                     }
                     else
                     {
-                        if( AVI_PacketNext( p_demux ) )
+                        if( AVI_PacketNext( p_demux->s ) )
                         {
                             msg_Warn( p_demux,
                                       "cannot skip packet, track disabled" );
@@ -1209,7 +1259,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
 
         avi_packet_t    avi_pk;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             return( 0 );
         }
@@ -1226,17 +1276,17 @@ static int Demux_UnSeekable( demux_t *p_demux )
                 case AVIFOURCC_JUNK:
                 case AVIFOURCC_LIST:
                 case AVIFOURCC_RIFF:
-                    return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                    return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                 case AVIFOURCC_idx1:
                     if( p_sys->b_odml )
                     {
-                        return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                        return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                     }
                     return( 0 );    /* eof */
                 default:
                     msg_Warn( p_demux,
                               "seems to have lost position, resync" );
-                    if( AVI_PacketSearch( p_demux ) )
+                    if( AVI_PacketSearch( p_demux, p_demux->s ) )
                     {
                         msg_Err( p_demux, "resync failed" );
                         return( -1 );
@@ -1271,7 +1321,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
             }
             else
             {
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( 0 );
                 }
@@ -1309,6 +1359,8 @@ static int Seek( demux_t *p_demux, mtime_t i_date, int i_percent )
 
     if( p_sys->b_seekable )
     {
+        AVI_IndexScanMerge( p_demux );
+
         if( !p_sys->i_length )
         {
             avi_track_t *p_stream = NULL;
@@ -1594,7 +1646,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
     {
         stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-        if( AVI_PacketNext( p_demux ) )
+        if( AVI_PacketNext( p_demux->s ) )
         {
             return VLC_EGENERIC;
         }
@@ -1608,7 +1660,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     {
         if( !vlc_object_alive (p_demux) ) return VLC_EGENERIC;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             msg_Warn( p_demux, "cannot get packet header" );
             return VLC_EGENERIC;
@@ -1616,7 +1668,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
         if( avi_pk.i_stream >= p_sys->i_track ||
             ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
         {
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1650,7 +1702,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
                 return VLC_SUCCESS;
             }
 
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1948,17 +2000,17 @@ static void AVI_ParseStreamHeader( vlc_fourcc_t i_id,
 /****************************************************************************
  *
  ****************************************************************************/
-static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
+static int AVI_PacketGetHeader( stream_t *s, avi_packet_t *p_pk )
 {
     const uint8_t *p_peek;
 
-    if( stream_Peek( p_demux->s, &p_peek, 16 ) < 16 )
+    if( stream_Peek( s, &p_peek, 16 ) < 16 )
     {
         return VLC_EGENERIC;
     }
     p_pk->i_fourcc  = VLC_FOURCC( p_peek[0], p_peek[1], p_peek[2], p_peek[3] );
     p_pk->i_size    = GetDWLE( p_peek + 4 );
-    p_pk->i_pos     = stream_Tell( p_demux->s );
+    p_pk->i_pos     = stream_Tell( s );
     if( p_pk->i_fourcc == AVIFOURCC_LIST || p_pk->i_fourcc == AVIFOURCC_RIFF )
     {
         p_pk->i_type = VLC_FOURCC( p_peek[8],  p_peek[9],
@@ -1975,12 +2027,12 @@ static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketNext( demux_t *p_demux )
+static int AVI_PacketNext( stream_t *s )
 {
     avi_packet_t    avi_ck;
     int             i_skip = 0;
 
-    if( AVI_PacketGetHeader( p_demux, &avi_ck ) )
+    if( AVI_PacketGetHeader( s, &avi_ck ) )
     {
         return VLC_EGENERIC;
     }
@@ -2000,7 +2052,7 @@ static int AVI_PacketNext( demux_t *p_demux )
         i_skip = __EVEN( avi_ck.i_size ) + 8;
     }
 
-    if( stream_Read( p_demux->s, NULL, i_skip ) != i_skip )
+    if( stream_Read( s, NULL, i_skip ) != i_skip )
     {
         return VLC_EGENERIC;
     }
@@ -2030,7 +2082,7 @@ static int AVI_PacketRead( demux_t   *p_demux,
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketSearch( demux_t *p_demux )
+static int AVI_PacketSearch( demux_t *p_demux, stream_t *s )
 {
     demux_sys_t     *p_sys = p_demux->p_sys;
     avi_packet_t    avi_pk;
@@ -2038,11 +2090,11 @@ static int AVI_PacketSearch( demux_t *p_demux )
 
     for( ;; )
     {
-        if( stream_Read( p_demux->s, NULL, 1 ) != 1 )
+        if( stream_Read( s, NULL, 1 ) != 1 )
         {
             return VLC_EGENERIC;
         }
-        AVI_PacketGetHeader( p_demux, &avi_pk );
+        AVI_PacketGetHeader( s, &avi_pk );
         if( avi_pk.i_stream < p_sys->i_track &&
             ( avi_pk.i_cat == AUDIO_ES || avi_pk.i_cat == VIDEO_ES ) )
         {
@@ -2064,6 +2116,8 @@ static int AVI_PacketSearch( demux_t *p_demux )
         if( !(++i_count % 1024) )
         {
             if( !vlc_object_alive (p_demux) ) return VLC_EGENERIC;
+            if( p_sys->p_scan && atomic_load( &p_sys->p_scan->b_abort ) )
+                return VLC_EGENERIC;
 
             msleep( 10000 );
             if( !(i_count % (1024 * 10)) )
@@ -2351,6 +2405,76 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
+static int AVI_IndexScanPacket( demux_t *p_demux, stream_t *s,
+                                avi_index_t p_index[], off_t *pi_last_pos,
+                                off_t i_movi_end, vlc_mutex_t *p_lock )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_packet_t pk;
+
+    if( AVI_PacketGetHeader( s, &pk ) )
+        return VLC_EGENERIC;
+
+    if( pk.i_stream < p_sys->i_track &&
+        pk.i_cat == p_sys->track[pk.i_stream]->i_cat )
+    {
+        avi_track_t *tk = p_sys->track[pk.i_stream];
+
+        avi_entry_t index;
+        index.i_id      = pk.i_fourcc;
+        index.i_flags   = AVI_GetKeyFlag(tk->i_codec, pk.i_peek);
+        index.i_pos     = pk.i_pos;
+        index.i_length  = pk.i_size;
+        if( p_lock )
+            vlc_mutex_lock( p_lock );
+        avi_index_Append( &p_index[pk.i_stream], pi_last_pos, &index );
+        if( p_lock )
+            vlc_mutex_unlock( p_lock );
+    }
+    else
+    {
+        switch( pk.i_fourcc )
+        {
+        case AVIFOURCC_idx1:
+            if( p_sys->b_odml )
+            {
+                avi_chunk_list_t *p_sysx;
+                p_sysx = AVI_ChunkFind( &p_sys->ck_root,
+                                        AVIFOURCC_RIFF, 1 );
+
+                msg_Dbg( p_demux, "looking for new RIFF chunk" );
+                if( stream_Seek( s, p_sysx->i_chunk_pos + 24 ) )
+                    return VLC_EGENERIC;
+                break;
+            }
+            return VLC_EGENERIC;
+
+        case AVIFOURCC_RIFF:
+                msg_Dbg( p_demux, "new RIFF chunk found" );
+                break;
+
+        case AVIFOURCC_rec:
+        case AVIFOURCC_JUNK:
+            break;
+
+        default:
+            msg_Warn( p_demux, "need resync, probably broken avi" );
+            if( AVI_PacketSearch( p_demux, s ) )
+            {
+                msg_Warn( p_demux, "lost sync, abord index creation" );
+                return VLC_EGENERIC;
+            }
+        }
+    }
+
+    if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
+        AVI_PacketNext( s ) )
+    {
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
 static void AVI_IndexCreate( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -2373,8 +2497,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
         return;
     }
 
+    assert( p_sys->i_track <= 100 );
+    avi_index_t p_index[p_sys->i_track];
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-        avi_index_Init( &p_sys->track[i_stream]->idx );
+        avi_index_Init( &p_index[i_stream] );
 
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
                         stream_Size( p_demux->s ) );
@@ -2391,8 +2517,6 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
     for( ;; )
     {
-        avi_packet_t pk;
-
         if( !vlc_object_alive (p_demux) )
             break;
 
@@ -2410,73 +2534,362 @@ static void AVI_IndexCreate( demux_t *p_demux )
             i_dialog_update = mdate();
         }
 
-        if( AVI_PacketGetHeader( p_demux, &pk ) )
+        if( AVI_IndexScanPacket( p_demux, p_demux->s, p_index,
+                                 &p_sys->i_movi_lastchunk_pos, i_movi_end,
+                                 NULL ) )
             break;
+    }
 
-        if( pk.i_stream < p_sys->i_track &&
-            pk.i_cat == p_sys->track[pk.i_stream]->i_cat )
-        {
-            avi_track_t *tk = p_sys->track[pk.i_stream];
+    if( p_dialog != NULL )
+        dialog_ProgressDestroy( p_dialog );
 
-            avi_entry_t index;
-            index.i_id      = pk.i_fourcc;
-            index.i_flags   = AVI_GetKeyFlag(tk->i_codec, pk.i_peek);
-            index.i_pos     = pk.i_pos;
-            index.i_length  = pk.i_size;
-            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
-        }
-        else
-        {
-            switch( pk.i_fourcc )
-            {
-            case AVIFOURCC_idx1:
-                if( p_sys->b_odml )
-                {
-                    avi_chunk_list_t *p_sysx;
-                    p_sysx = AVI_ChunkFind( &p_sys->ck_root,
-                                            AVIFOURCC_RIFF, 1 );
+    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        avi_index_Clean( &p_sys->track[i_stream]->idx );
+        p_sys->track[i_stream]->idx = p_index[i_stream];
 
-                    msg_Dbg( p_demux, "looking for new RIFF chunk" );
-                    if( stream_Seek( p_demux->s, p_sysx->i_chunk_pos + 24 ) )
-                        goto print_stat;
-                    break;
-                }
-                goto print_stat;
+        msg_Dbg( p_demux, "stream[%d] creating %d index entries",
+                i_stream, p_sys->track[i_stream]->idx.i_size );
+    }
+}
 
-            case AVIFOURCC_RIFF:
-                    msg_Dbg( p_demux, "new RIFF chunk found" );
-                    break;
+/*****************************************************************************
+ * Index cache: the index rebuilt for a local file is stored in the user
+ * cache directory, keyed by the file path and checked against the file size
+ * and modification time.
+ *****************************************************************************/
+#define AVI_INDEX_CACHE_MAGIC "VLCAVIX1"
 
-            case AVIFOURCC_rec:
-            case AVIFOURCC_JUNK:
-                break;
+static char *AVI_IndexCachePath( demux_t *p_demux, uint64_t *pi_size,
+                                 int64_t *pi_mtime, bool b_create )
+{
+    struct stat st;
+    struct md5_s md5;
 
-            default:
-                msg_Warn( p_demux, "need resync, probably broken avi" );
-                if( AVI_PacketSearch( p_demux ) )
-                {
-                    msg_Warn( p_demux, "lost sync, abord index creation" );
-                    goto print_stat;
-                }
+    if( !p_demux->psz_file ||
+        !var_InheritBool( p_demux, "avi-index-cache" ) ||
+        vlc_stat( p_demux->psz_file, &st ) )
+        return NULL;
+    *pi_size  = st.st_size;
+    *pi_mtime = st.st_mtime;
+
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( !psz_cachedir )
+        return NULL;
+
+    char *psz_dir;
+    if( asprintf( &psz_dir, "%s" DIR_SEP "avi-index", psz_cachedir ) < 0 )
+    {
+        free( psz_cachedir );
+        return NULL;
+    }
+    if( b_create )
+    {
+        vlc_mkdir( psz_cachedir, 0700 );
+        vlc_mkdir( psz_dir, 0700 );
+    }
+    free( psz_cachedir );
+
+    InitMD5( &md5 );
+    AddMD5( &md5, p_demux->psz_file, strlen( p_demux->psz_file ) );
+    EndMD5( &md5 );
+    char *psz_hash = psz_md5_hash( &md5 );
+
+    char *psz_path = NULL;
+    if( psz_hash == NULL ||
+        asprintf( &psz_path, "%s" DIR_SEP "%s.idx", psz_dir, psz_hash ) < 0 )
+        psz_path = NULL;
+    free( psz_hash );
+    free( psz_dir );
+    return psz_path;
+}
+
+static int AVI_IndexCacheLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t i_size;
+    int64_t  i_mtime;
+
+    char *psz_path = AVI_IndexCachePath( p_demux, &i_size, &i_mtime, false );
+    if( !psz_path )
+        return VLC_EGENERIC;
+
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    free( psz_path );
+    if( !p_file )
+        return VLC_EGENERIC;
+
+    assert( p_sys->i_track <= 100 );
+    avi_index_t p_index[p_sys->i_track];
+    uint32_t    pi_count[p_sys->i_track];
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Init( &p_index[i] );
+    off_t i_last_pos = 0;
+
+    uint8_t p_buffer[28];
+    bool b_ok = fread( p_buffer, 1, 28, p_file ) == 28 &&
+                !memcmp( p_buffer, AVI_INDEX_CACHE_MAGIC, 8 ) &&
+                GetQWLE( &p_buffer[8] ) == i_size &&
+                (int64_t)GetQWLE( &p_buffer[16] ) == i_mtime &&
+                GetDWLE( &p_buffer[24] ) == p_sys->i_track;
+
+    for( unsigned i = 0; b_ok && i < p_sys->i_track; i++ )
+    {
+        b_ok = fread( p_buffer, 1, 4, p_file ) == 4;
+        pi_count[i] = GetDWLE( p_buffer );
+    }
+    for( unsigned i = 0; b_ok && i < p_sys->i_track; i++ )
+    {
+        for( uint32_t j = 0; b_ok && j < pi_count[i]; j++ )
+        {
+            if( fread( p_buffer, 1, 20, p_file ) != 20 )
+            {
+                b_ok = false;
+                break;
             }
+            avi_entry_t index;
+            index.i_id     = GetDWLE( &p_buffer[0] );
+            index.i_flags  = GetDWLE( &p_buffer[4] );
+            index.i_length = GetDWLE( &p_buffer[8] );
+            index.i_pos    = GetQWLE( &p_buffer[12] );
+            avi_index_Append( &p_index[i], &i_last_pos, &index );
+            b_ok = p_index[i].p_entry != NULL;
         }
+    }
+    fclose( p_file );
+
+    if( !b_ok )
+    {
+        msg_Dbg( p_demux, "no usable cached index" );
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+            avi_index_Clean( &p_index[i] );
+        return VLC_EGENERIC;
+    }
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_index_Clean( &p_sys->track[i]->idx );
+        p_sys->track[i]->idx = p_index[i];
+        msg_Dbg( p_demux, "stream[%u] loaded %u cached index entries",
+                 i, p_index[i].i_size );
+    }
+    p_sys->i_movi_lastchunk_pos = i_last_pos;
+    return VLC_SUCCESS;
+}
+
+static void AVI_IndexCacheSave( demux_t *p_demux, const avi_index_t p_index[] )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t i_size;
+    int64_t  i_mtime;
+
+    char *psz_path = AVI_IndexCachePath( p_demux, &i_size, &i_mtime, true );
+    if( !psz_path )
+        return;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.part", psz_path ) < 0 )
+    {
+        free( psz_path );
+        return;
+    }
 
-        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( !p_file )
+    {
+        msg_Warn( p_demux, "cannot write index cache %s", psz_tmp );
+        goto end;
+    }
+
+    uint8_t p_buffer[28];
+    memcpy( p_buffer, AVI_INDEX_CACHE_MAGIC, 8 );
+    SetQWLE( &p_buffer[8], i_size );
+    SetQWLE( &p_buffer[16], i_mtime );
+    SetDWLE( &p_buffer[24], p_sys->i_track );
+    bool b_ok = fwrite( p_buffer, 1, 28, p_file ) == 28;
+
+    for( unsigned i = 0; b_ok && i < p_sys->i_track; i++ )
+    {
+        SetDWLE( p_buffer, p_index[i].i_size );
+        b_ok = fwrite( p_buffer, 1, 4, p_file ) == 4;
+    }
+    for( unsigned i = 0; b_ok && i < p_sys->i_track; i++ )
+    {
+        for( unsigned j = 0; b_ok && j < p_index[i].i_size; j++ )
         {
-            break;
+            const avi_entry_t *p_entry = &p_index[i].p_entry[j];
+            SetDWLE( &p_buffer[0], p_entry->i_id );
+            SetDWLE( &p_buffer[4], p_entry->i_flags );
+            SetDWLE( &p_buffer[8], p_entry->i_length );
+            SetQWLE( &p_buffer[12], p_entry->i_pos );
+            b_ok = fwrite( p_buffer, 1, 20, p_file ) == 20;
         }
     }
+    if( fclose( p_file ) )
+        b_ok = false;
 
-print_stat:
-    if( p_dialog != NULL )
-        dialog_ProgressDestroy( p_dialog );
+    if( b_ok && !vlc_rename( psz_tmp, psz_path ) )
+        msg_Dbg( p_demux, "index saved to %s", psz_path );
+    else
+        vlc_unlink( psz_tmp );
+end:
+    free( psz_tmp );
+    free( psz_path );
+}
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+/*****************************************************************************
+ * Background index reconstruction: a second stream on the same file is
+ * scanned from a dedicated thread while the demuxer plays. The entries are
+ * handed over to the tracks from the demuxer thread by AVI_IndexScanMerge.
+ *****************************************************************************/
+static void *AVI_IndexScanThread( void *p_data )
+{
+    demux_t *p_demux = p_data;
+    avi_index_scan_t *p_scan = p_demux->p_sys->p_scan;
+    mtime_t i_start = mdate();
+
+    int canc = vlc_savecancel();
+
+    if( !stream_Seek( p_scan->s, p_scan->i_movi_begin + 12 ) )
     {
-        msg_Dbg( p_demux, "stream[%d] creating %d index entries",
-                i_stream, p_sys->track[i_stream]->idx.i_size );
+        while( !atomic_load( &p_scan->b_abort ) &&
+               !AVI_IndexScanPacket( p_demux, p_scan->s, p_scan->p_index,
+                                     &p_scan->i_last_pos, p_scan->i_movi_end,
+                                     &p_scan->lock ) );
     }
+
+    /* Only this thread modifies the index, it is safe to read it unlocked */
+    if( !atomic_load( &p_scan->b_abort ) )
+    {
+        msg_Dbg( p_demux, "index rebuilt in %"PRId64" ms",
+                 ( mdate() - i_start ) / 1000 );
+        AVI_IndexCacheSave( p_demux, p_scan->p_index );
+    }
+
+    vlc_mutex_lock( &p_scan->lock );
+    p_scan->b_done = true;
+    vlc_mutex_unlock( &p_scan->lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static int AVI_IndexScanStart( demux_t *p_demux, avi_chunk_list_t *p_movi )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_movi || !p_demux->psz_file || p_sys->p_scan )
+        return VLC_EGENERIC;
+
+    char *psz_url;
+    if( asprintf( &psz_url, "%s://%s", p_demux->psz_access,
+                  p_demux->psz_location ) < 0 )
+        return VLC_EGENERIC;
+
+    avi_index_scan_t *p_scan = calloc( 1, sizeof(*p_scan) );
+    if( !p_scan )
+    {
+        free( psz_url );
+        return VLC_EGENERIC;
+    }
+    p_scan->p_index   = calloc( p_sys->i_track, sizeof(*p_scan->p_index) );
+    p_scan->pi_merged = calloc( p_sys->i_track, sizeof(*p_scan->pi_merged) );
+    p_scan->s         = stream_UrlNew( p_demux, psz_url );
+    free( psz_url );
+    if( !p_scan->p_index || !p_scan->pi_merged || !p_scan->s )
+        goto error;
+
+    p_scan->i_movi_begin = p_movi->i_chunk_pos;
+    p_scan->i_movi_end   = __MIN( (off_t)(p_movi->i_chunk_pos +
+                                          p_movi->i_chunk_size),
+                                  stream_Size( p_scan->s ) );
+    vlc_mutex_init( &p_scan->lock );
+    atomic_init( &p_scan->b_abort, false );
+
+    /* The demuxer indexes what it reads on its own, and picks up the
+     * entries of the scan lying after what it has already seen */
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_index_Clean( &p_sys->track[i]->idx );
+        avi_index_Init( &p_sys->track[i]->idx );
+    }
+    p_sys->i_movi_lastchunk_pos = 0;
+
+    p_sys->p_scan = p_scan;
+    if( vlc_clone( &p_scan->thread, AVI_IndexScanThread, p_demux,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        p_sys->p_scan = NULL;
+        vlc_mutex_destroy( &p_scan->lock );
+        goto error;
+    }
+    msg_Dbg( p_demux, "creating index from LIST-movi in background" );
+    return VLC_SUCCESS;
+
+error:
+    if( p_scan->s )
+        stream_Delete( p_scan->s );
+    free( p_scan->pi_merged );
+    free( p_scan->p_index );
+    free( p_scan );
+    return VLC_EGENERIC;
+}
+
+static void AVI_IndexScanMerge( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_scan_t *p_scan = p_sys->p_scan;
+
+    if( !p_scan )
+        return;
+
+    /* Entries up to the last chunk seen by the demuxer are already known */
+    const off_t i_known = p_sys->i_movi_lastchunk_pos;
+    bool b_done;
+
+    vlc_mutex_lock( &p_scan->lock );
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        const avi_index_t *p_index = &p_scan->p_index[i];
+        avi_track_t *tk = p_sys->track[i];
+
+        for( ; p_scan->pi_merged[i] < p_index->i_size; p_scan->pi_merged[i]++ )
+        {
+            avi_entry_t index = p_index->p_entry[p_scan->pi_merged[i]];
+            if( index.i_pos > i_known )
+                avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos,
+                                  &index );
+        }
+    }
+    b_done = p_scan->b_done;
+    vlc_mutex_unlock( &p_scan->lock );
+
+    if( b_done )
+    {
+        AVI_IndexScanStop( p_demux );
+        p_sys->i_length = AVI_MovieGetLength( p_demux );
+    }
+}
+
+static void AVI_IndexScanStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_scan_t *p_scan = p_sys->p_scan;
+
+    if( !p_scan )
+        return;
+
+    atomic_store( &p_scan->b_abort, true );
+    vlc_join( p_scan->thread, NULL );
+    p_sys->p_scan = NULL;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Clean( &p_scan->p_index[i] );
+    vlc_mutex_destroy( &p_scan->lock );
+    stream_Delete( p_scan->s );
+    free( p_scan->pi_merged );
+    free( p_scan->p_index );
+    free( p_scan );
 }
 
 /* */
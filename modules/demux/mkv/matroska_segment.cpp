@@ -28,6 +28,10 @@
 #include "util.hpp"
 #include "Ebml_parser.hpp"
 
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <sys/stat.h>
+
 matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estream )
     :segment(NULL)
     ,es(estream)
@@ -576,12 +580,18 @@ void matroska_segment_c::InformationCreate( )
  *****************************************************************************/
 
 void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
+{
+    IndexAppendCluster( cluster->GetElementPosition(),
+                        cluster->GlobalTimecode()/ (mtime_t) 1000 );
+}
+
+void matroska_segment_c::IndexAppendCluster( int64_t i_position, mtime_t i_time )
 {
 #define idx p_indexes[i_index]
     idx.i_track       = -1;
     idx.i_block_number= -1;
-    idx.i_position    = cluster->GetElementPosition();
-    idx.i_time        = cluster->GlobalTimecode()/ (mtime_t) 1000;
+    idx.i_position    = i_position;
+    idx.i_time        = i_time;
     idx.b_key         = true;
 
     i_index++;
@@ -594,6 +604,324 @@ void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
 #undef idx
 }
 
+/*****************************************************************************
+ * Cluster index for files without cues
+ *****************************************************************************
+ * The clusters are located by reading only the EBML ID and size of each
+ * top level element, and the timecode that starts each cluster. The index
+ * of a local file is kept in the user cache directory, tagged with the file
+ * size and modification time.
+ *****************************************************************************/
+#define MKV_ID_CLUSTER          0x1F43B675
+#define MKV_ID_CLUSTERTIMECODE  0xE7
+#define MKV_ID_CRC32            0xBF
+#define MKV_ID_VOID             0xEC
+
+#define MKV_INDEX_CACHE_MAGIC   "VLCMKVX1"
+
+/* Returns the length of the EBML variable size integer, or 0 if invalid */
+static int EbmlReadVint( const uint8_t *p_buf, size_t i_buf,
+                         uint64_t *pi_value, bool b_keep_marker )
+{
+    if( i_buf == 0 || p_buf[0] == 0 )
+        return 0;
+
+    int i_len = 1;
+    uint8_t i_mask = 0x80;
+    while( !( p_buf[0] & i_mask ) )
+    {
+        i_mask >>= 1;
+        i_len++;
+    }
+    if( (size_t)i_len > i_buf )
+        return 0;
+
+    uint64_t i_value = b_keep_marker ? p_buf[0] : ( p_buf[0] & ( i_mask - 1 ) );
+    for( int i = 1; i < i_len; i++ )
+        i_value = ( i_value << 8 ) | p_buf[i];
+    *pi_value = i_value;
+    return i_len;
+}
+
+static bool EbmlSizeUnknown( uint64_t i_size, int i_len )
+{
+    return i_size == ( UINT64_C(1) << ( 7 * i_len ) ) - 1;
+}
+
+bool matroska_segment_c::IndexScanClusters()
+{
+    bool b_fastseek;
+    if( stream_Control( sys.demuxer.s, STREAM_CAN_FASTSEEK, &b_fastseek ) ||
+        !b_fastseek )
+        return false;
+
+    const int64_t i_sav_position = (int64_t)es.I_O().getFilePointer();
+    const int64_t i_end = segment->IsFiniteSize() ?
+                          (int64_t)segment->GetEndPosition() : INT64_MAX;
+    const int i_index_start = i_index;
+    const mtime_t i_scan_start = mdate();
+
+    int64_t i_pos = i_index > 0 ? p_indexes[i_index - 1].i_position
+                                : i_start_pos;
+    bool b_complete = false;
+
+    while( vlc_object_alive( &sys.demuxer ) )
+    {
+        if( i_pos >= i_end )
+        {
+            b_complete = true;
+            break;
+        }
+
+        uint8_t p_buf[32];
+        es.I_O().setFilePointer( i_pos, seek_beginning );
+        size_t i_buf = es.I_O().read( p_buf, sizeof(p_buf) );
+        if( i_buf == 0 )
+        {
+            b_complete = true;
+            break;
+        }
+
+        uint64_t i_id, i_size;
+        int i_id_len = EbmlReadVint( p_buf, i_buf, &i_id, true );
+        int i_size_len = i_id_len ? EbmlReadVint( &p_buf[i_id_len],
+                                                  i_buf - i_id_len,
+                                                  &i_size, false ) : 0;
+        if( i_size_len == 0 || EbmlSizeUnknown( i_size, i_size_len ) )
+        {
+            msg_Dbg( &sys.demuxer, "cluster scan stopped at %" PRId64, i_pos );
+            break;
+        }
+        const size_t i_header = i_id_len + i_size_len;
+
+        if( i_id == MKV_ID_CLUSTER &&
+            ( i_index == 0 || p_indexes[i_index - 1].i_position < i_pos ) )
+        {
+            /* The timecode is the first child, after an optional CRC-32 */
+            size_t i_off = i_header;
+            while( i_off < i_buf )
+            {
+                uint64_t i_child_id, i_child_size;
+                int i_cid_len = EbmlReadVint( &p_buf[i_off], i_buf - i_off,
+                                              &i_child_id, true );
+                int i_csize_len = i_cid_len ?
+                    EbmlReadVint( &p_buf[i_off + i_cid_len],
+                                  i_buf - i_off - i_cid_len,
+                                  &i_child_size, false ) : 0;
+                if( i_csize_len == 0 )
+                    break;
+                i_off += i_cid_len + i_csize_len;
+
+                if( i_child_id == MKV_ID_CLUSTERTIMECODE )
+                {
+                    if( i_child_size > 8 || i_off + i_child_size > i_buf )
+                        break;
+                    uint64_t i_timecode = 0;
+                    for( size_t i = 0; i < i_child_size; i++ )
+                        i_timecode = ( i_timecode << 8 ) | p_buf[i_off + i];
+                    IndexAppendCluster( i_pos, (mtime_t)( i_timecode *
+                                        i_timescale / 1000 ) );
+                    break;
+                }
+                if( i_child_id != MKV_ID_CRC32 && i_child_id != MKV_ID_VOID )
+                    break;
+                i_off += i_child_size;
+            }
+        }
+        i_pos += i_header + i_size;
+    }
+
+    es.I_O().setFilePointer( i_sav_position, seek_beginning );
+
+    msg_Dbg( &sys.demuxer, "cluster scan found %d clusters in %" PRId64 " ms%s",
+             i_index - i_index_start, ( mdate() - i_scan_start ) / 1000,
+             b_complete ? "" : " (incomplete)" );
+    return b_complete;
+}
+
+char *matroska_segment_c::IndexCachePath( uint64_t *pi_size, int64_t *pi_mtime,
+                                          bool b_create ) const
+{
+    /* Only the segments of the opened file itself can be keyed */
+    if( !sys.demuxer.psz_file || sys.streams.empty() ||
+        sys.streams[0]->p_estream != &es ||
+        !var_InheritBool( &sys.demuxer, "mkv-index-cache" ) )
+        return NULL;
+
+    struct stat st;
+    if( vlc_stat( sys.demuxer.psz_file, &st ) )
+        return NULL;
+    *pi_size  = st.st_size;
+    *pi_mtime = st.st_mtime;
+
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( !psz_cachedir )
+        return NULL;
+
+    char *psz_dir;
+    if( asprintf( &psz_dir, "%s" DIR_SEP "mkv-index", psz_cachedir ) < 0 )
+    {
+        free( psz_cachedir );
+        return NULL;
+    }
+    if( b_create )
+    {
+        vlc_mkdir( psz_cachedir, 0700 );
+        vlc_mkdir( psz_dir, 0700 );
+    }
+    free( psz_cachedir );
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, sys.demuxer.psz_file, strlen( sys.demuxer.psz_file ) );
+    EndMD5( &md5 );
+    char *psz_hash = psz_md5_hash( &md5 );
+
+    char *psz_path = NULL;
+    if( psz_hash == NULL ||
+        asprintf( &psz_path, "%s" DIR_SEP "%s-%" PRId64 ".idx", psz_dir,
+                  psz_hash, i_start_pos ) < 0 )
+        psz_path = NULL;
+    free( psz_hash );
+    free( psz_dir );
+    return psz_path;
+}
+
+bool matroska_segment_c::IndexCacheLoad()
+{
+    uint64_t i_size;
+    int64_t  i_mtime;
+
+    char *psz_path = IndexCachePath( &i_size, &i_mtime, false );
+    if( !psz_path )
+        return false;
+
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    free( psz_path );
+    if( !p_file )
+        return false;
+
+    struct stat st;
+    uint8_t p_buf[36];
+    if( fstat( fileno( p_file ), &st ) ||
+        fread( p_buf, 1, 36, p_file ) != 36 ||
+        memcmp( p_buf, MKV_INDEX_CACHE_MAGIC, 8 ) ||
+        GetQWLE( &p_buf[8] ) != i_size ||
+        (int64_t)GetQWLE( &p_buf[16] ) != i_mtime ||
+        (int64_t)GetQWLE( &p_buf[24] ) != i_start_pos )
+    {
+        fclose( p_file );
+        return false;
+    }
+
+    /* The count must match the entries actually in the file, and fit the
+     * int index with the room added below */
+    const uint32_t i_count = GetDWLE( &p_buf[32] );
+    if( (uint64_t)i_count * 16 > (uint64_t)st.st_size - 36 ||
+        i_count > INT_MAX - 1024 ||
+        i_count + 1024 > SIZE_MAX / sizeof( mkv_index_t ) )
+    {
+        msg_Warn( &sys.demuxer, "invalid index cache (%" PRIu32 " entries)",
+                  i_count );
+        fclose( p_file );
+        return false;
+    }
+
+    mkv_index_t *p_cached = (mkv_index_t*)malloc( sizeof( mkv_index_t ) *
+                                                  ( (size_t)i_count + 1024 ) );
+    bool b_ok = p_cached != NULL;
+    for( uint32_t i = 0; b_ok && i < i_count; i++ )
+    {
+        b_ok = fread( p_buf, 1, 16, p_file ) == 16;
+        p_cached[i].i_track        = -1;
+        p_cached[i].i_block_number = -1;
+        p_cached[i].i_position     = GetQWLE( &p_buf[0] );
+        p_cached[i].i_time         = GetQWLE( &p_buf[8] );
+        p_cached[i].b_key          = true;
+    }
+    fclose( p_file );
+
+    if( !b_ok )
+    {
+        free( p_cached );
+        return false;
+    }
+
+    free( p_indexes );
+    p_indexes   = p_cached;
+    i_index     = i_count;
+    i_index_max = i_count + 1024;
+    msg_Dbg( &sys.demuxer, "loaded %d cached cluster index entries", i_index );
+    return true;
+}
+
+void matroska_segment_c::IndexCacheSave() const
+{
+    uint64_t i_size;
+    int64_t  i_mtime;
+
+    char *psz_path = IndexCachePath( &i_size, &i_mtime, true );
+    if( !psz_path )
+        return;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.part", psz_path ) < 0 )
+    {
+        free( psz_path );
+        return;
+    }
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( !p_file )
+    {
+        msg_Warn( &sys.demuxer, "cannot write index cache %s", psz_tmp );
+        free( psz_tmp );
+        free( psz_path );
+        return;
+    }
+
+    uint8_t p_buf[36];
+    memcpy( p_buf, MKV_INDEX_CACHE_MAGIC, 8 );
+    SetQWLE( &p_buf[8], i_size );
+    SetQWLE( &p_buf[16], i_mtime );
+    SetQWLE( &p_buf[24], i_start_pos );
+    SetDWLE( &p_buf[32], i_index );
+    bool b_ok = fwrite( p_buf, 1, 36, p_file ) == 36;
+
+    for( int i = 0; b_ok && i < i_index; i++ )
+    {
+        SetQWLE( &p_buf[0], p_indexes[i].i_position );
+        SetQWLE( &p_buf[8], p_indexes[i].i_time );
+        b_ok = fwrite( p_buf, 1, 16, p_file ) == 16;
+    }
+    if( fclose( p_file ) )
+        b_ok = false;
+
+    if( b_ok && !vlc_rename( psz_tmp, psz_path ) )
+        msg_Dbg( &sys.demuxer, "cluster index saved to %s", psz_path );
+    else
+        vlc_unlink( psz_tmp );
+    free( psz_tmp );
+    free( psz_path );
+}
+
+bool matroska_segment_c::IndexClusters()
+{
+    if( b_cues )
+        return true;
+
+    if( IndexCacheLoad() )
+    {
+        b_cues = true;
+    }
+    else if( IndexScanClusters() )
+    {
+        b_cues = true;
+        IndexCacheSave();
+    }
+    return b_cues;
+}
+
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
 {
     if ( b_preloaded )
@@ -905,10 +1233,16 @@ void matroska_segment_c::Seek( mtime_t i_date, mtime_t i_time_offset, int64_t i_
     int i_idx = 0;
     if ( i_index > 0 )
     {
-
-        for( ; i_idx < i_index; i_idx++ )
-            if( p_indexes[i_idx].i_time + i_time_offset > i_date )
-                break;
+        /* Find the first entry after i_date, the index is sorted by time */
+        int i_high = i_index;
+        while( i_idx < i_high )
+        {
+            int i_mid = ( i_idx + i_high ) / 2;
+            if( p_indexes[i_mid].i_time + i_time_offset > i_date )
+                i_high = i_mid;
+            else
+                i_idx = i_mid + 1;
+        }
 
         if( i_idx > 0 )
             i_idx--;
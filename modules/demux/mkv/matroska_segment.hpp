@@ -145,6 +145,8 @@ public:
     bool Select( mtime_t i_start_time );
     void UnSelect();
 
+    bool IndexClusters();
+
     static bool CompareSegmentUIDs( const matroska_segment_c * item_a, const matroska_segment_c * item_b );
 
 private:
@@ -161,6 +163,11 @@ private:
     void ParseCluster( bool b_update_start_time = true );
     SimpleTag * ParseSimpleTags( KaxTagSimple *tag, int level = 50 );
     void IndexAppendCluster( KaxCluster *cluster );
+    void IndexAppendCluster( int64_t i_position, mtime_t i_time );
+    bool IndexScanClusters();
+    char *IndexCachePath( uint64_t *pi_size, int64_t *pi_mtime, bool b_create ) const;
+    bool IndexCacheLoad();
+    void IndexCacheSave() const;
     int32_t TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
 };
@@ -70,6 +70,10 @@ vlc_module_begin ()
             N_("Dummy Elements"),
             N_("Read and discard unknown EBML elements (not good for broken files)."), true );
 
+    add_bool( "mkv-index-cache", true,
+            N_("Cache cluster index"),
+            N_("Save the cluster index built for local files without cues in the user cache directory."), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -446,6 +450,10 @@ static void Seek( demux_t *p_demux, mtime_t i_date, double f_percent, virtual_ch
         return;
     }
 
+    /* without cues, index the clusters once */
+    if( !p_segment->b_cues )
+        p_segment->IndexClusters();
+
     /* seek without index or without date */
     if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !p_segment->b_cues || i_date < 0 ))
     {
@@ -752,6 +752,24 @@ static void MP4_FreeBox_trun( MP4_Box_t *p_box )
     FREENULL( p_box->data.p_trun->p_samples );
 }
 
+static int MP4_ReadBox_tfdt( stream_t *p_stream, MP4_Box_t *p_box )
+{
+    MP4_READBOX_ENTER( MP4_Box_data_tfdt_t );
+
+    MP4_GETVERSIONFLAGS( p_box->data.p_tfdt );
+    if( p_box->data.p_tfdt->i_version == 1 )
+        MP4_GET8BYTES( p_box->data.p_tfdt->i_base_media_decode_time );
+    else /* version == 0 */
+        MP4_GET4BYTES( p_box->data.p_tfdt->i_base_media_decode_time );
+
+#ifdef MP4_VERBOSE
+    msg_Dbg( p_stream, "read box: \"tfdt\" decode time %"PRIu64,
+             p_box->data.p_tfdt->i_base_media_decode_time );
+#endif
+
+    MP4_READBOX_EXIT( 1 );
+}
+
 
 static int MP4_ReadBox_tkhd(  stream_t *p_stream, MP4_Box_t *p_box )
 {
@@ -2992,8 +3010,8 @@ static int MP4_ReadBox_tfra( stream_t *p_stream, MP4_Box_t *p_box )
     {
         if( p_tfra->i_version == 1 )
         {
-            MP4_GET8BYTES( p_tfra->p_time[i*2] );
-            MP4_GET8BYTES( p_tfra->p_moof_offset[i*2] );
+            MP4_GET8BYTES( ((uint64_t *)p_tfra->p_time)[i] );
+            MP4_GET8BYTES( ((uint64_t *)p_tfra->p_moof_offset)[i] );
         }
         else
         {
@@ -3377,6 +3395,7 @@ static const struct
     { ATOM_sidx,    MP4_ReadBox_sidx,         MP4_FreeBox_sidx },
     { ATOM_tfhd,    MP4_ReadBox_tfhd,         MP4_FreeBox_Common },
     { ATOM_trun,    MP4_ReadBox_trun,         MP4_FreeBox_trun },
+    { ATOM_tfdt,    MP4_ReadBox_tfdt,         MP4_FreeBox_Common },
     { ATOM_trex,    MP4_ReadBox_trex,         MP4_FreeBox_Common },
     { ATOM_mehd,    MP4_ReadBox_mehd,         MP4_FreeBox_Common },
     { ATOM_sdtp,    MP4_ReadBox_sdtp,         MP4_FreeBox_sdtp },
@@ -3557,6 +3576,16 @@ MP4_Box_t *MP4_BoxGetNextChunk( stream_t *s )
     return p_chunk;
 }
 
+MP4_Box_t *MP4_BoxGetNextBox( stream_t *s )
+{
+    MP4_Box_t *p_box = MP4_ReadBox( s, NULL );
+
+    /* leave the stream after the box, like MP4_NextBox */
+    if( p_box )
+        stream_Seek( s, p_box->i_pos + p_box->i_size );
+    return p_box;
+}
+
 /*****************************************************************************
  * MP4_BoxGetRoot : Parse the entire file, and create all boxes in memory
  *****************************************************************************
@@ -83,6 +83,7 @@
 #define ATOM_sidx VLC_FOURCC( 's', 'i', 'd', 'x' )
 #define ATOM_tfhd VLC_FOURCC( 't', 'f', 'h', 'd' )
 #define ATOM_trun VLC_FOURCC( 't', 'r', 'u', 'n' )
+#define ATOM_tfdt VLC_FOURCC( 't', 'f', 'd', 't' )
 #define ATOM_cprt VLC_FOURCC( 'c', 'p', 'r', 't' )
 #define ATOM_iods VLC_FOURCC( 'i', 'o', 'd', 's' )
 #define ATOM_pasp VLC_FOURCC( 'p', 'a', 's', 'p' )
@@ -959,6 +960,15 @@ typedef struct MP4_Box_data_trun_s
 
 } MP4_Box_data_trun_t;
 
+typedef struct MP4_Box_data_tfdt_s
+{
+    uint8_t  i_version;
+    uint32_t i_flags;
+
+    uint64_t i_base_media_decode_time;
+
+} MP4_Box_data_tfdt_t;
+
 
 typedef struct
 {
@@ -1175,6 +1185,7 @@ typedef union MP4_Box_data_s
     MP4_Box_data_sidx_t *p_sidx;
     MP4_Box_data_tfhd_t *p_tfhd;
     MP4_Box_data_trun_t *p_trun;
+    MP4_Box_data_tfdt_t *p_tfdt;
     MP4_Box_data_tkhd_t *p_tkhd;
     MP4_Box_data_mdhd_t *p_mdhd;
     MP4_Box_data_hdlr_t *p_hdlr;
@@ -1300,6 +1311,22 @@ typedef struct
 
 } mp4_chunk_t;
 
+/* Run-length timing table of a track (stts or ctts). The runs point into
+ * the box data; a checkpoint is kept every MP4_TIME_CHECKPOINT_RUNS runs so
+ * that lookups do not have to walk the table from the first sample. The
+ * checkpoints are only built on the first lookup. */
+#define MP4_TIME_CHECKPOINT_RUNS 64
+typedef struct
+{
+    uint32_t        i_runs;
+    const uint32_t *p_count;    /* samples in each run */
+    const int32_t  *p_value;    /* dts delta or pts-dts offset of each run */
+
+    uint32_t        i_checkpoints;
+    uint32_t       *p_checkpoint_sample; /* first sample of the run */
+    int64_t        *p_checkpoint_time;   /* sum of the values before it */
+} mp4_time_table_t;
+
  /* Contain all needed information for read all track with vlc */
 typedef struct
 {
@@ -1346,6 +1373,10 @@ typedef struct
     uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
                                     too much time to do sumations each time*/
 
+    /* sample timing, only used if b_fragmented is false */
+    mp4_time_table_t dts_table; /* from stts */
+    mp4_time_table_t pts_table; /* from ctts, i_runs is 0 without ctts */
+
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
     uint64_t     i_first_dts;    /* i_first_dts value
@@ -1497,6 +1528,13 @@ MP4_Box_t *MP4_BoxGetSmooBox( stream_t * );
  *****************************************************************************/
 MP4_Box_t *MP4_BoxGetNextChunk( stream_t * );
 
+/*****************************************************************************
+ * MP4_BoxGetNextBox : Parse the box at the current position
+ *****************************************************************************
+ *  The box has no father, and is freed with MP4_BoxFree.
+ *****************************************************************************/
+MP4_Box_t *MP4_BoxGetNextBox( stream_t * );
+
 /*****************************************************************************
  * MP4_BoxGetRoot : Parse the entire file, and create all boxes in memory
  *****************************************************************************
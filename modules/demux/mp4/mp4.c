@@ -64,6 +64,13 @@ static int   DemuxFrg( demux_t * );
 static int   Seek    ( demux_t *, mtime_t );
 static int   Control ( demux_t *, int, va_list );
 
+/* Fragment of a seekable fragmented file */
+typedef struct
+{
+    uint64_t i_pos;     /* of its moof */
+    mtime_t  i_time;    /* of its first sample in the index track */
+} mp4_fragment_t;
+
 struct demux_sys_t
 {
     MP4_Box_t    *p_root;      /* container for the whole file */
@@ -80,6 +87,14 @@ struct demux_sys_t
 
     bool         b_fragmented;   /* fMP4 */
 
+    /* index of the fragments, for seekable fragmented files */
+    bool           b_frag_index;
+    uint32_t       i_frag_track_ID;  /* track the index times refer to */
+    unsigned int   i_frag_count;
+    mp4_fragment_t *p_frag;
+    uint64_t       i_frag_scan_pos;  /* next box to index, 0 once complete */
+    uint64_t       i_frag_scan_dts;  /* of the next fragment, without tfdt */
+
     /* */
     MP4_Box_t    *p_tref_chap;
 
@@ -92,6 +107,9 @@ struct demux_sys_t
  *****************************************************************************/
 static void MP4_TrackCreate ( demux_t *, mp4_track_t *, MP4_Box_t  *, bool b_force_enable );
 static int MP4_frg_TrackCreate( demux_t *, mp4_track_t *, MP4_Box_t *);
+static mp4_track_t *MP4_frg_GetTrack( demux_t *, const uint32_t );
+static void FragIndexInit( demux_t * );
+static int  FragSeek( demux_t *, mtime_t );
 static void MP4_TrackDestroy(  mp4_track_t * );
 
 static int  MP4_TrackSelect ( demux_t *, mp4_track_t *, mtime_t );
@@ -107,33 +125,179 @@ static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, int64_t );
 static void     MP4_UpdateSeekpoint( demux_t * );
 static const char *MP4_ConvertMacCode( uint16_t );
 
+/* Sample timing tables */
+static void TimeTableInit( mp4_time_table_t *p_table, uint32_t i_runs,
+                           const uint32_t *p_count, const int32_t *p_value )
+{
+    p_table->i_runs  = i_runs;
+    p_table->p_count = p_count;
+    p_table->p_value = p_value;
+    p_table->i_checkpoints = 0;
+    p_table->p_checkpoint_sample = NULL;
+    p_table->p_checkpoint_time = NULL;
+}
+
+static void TimeTableClean( mp4_time_table_t *p_table )
+{
+    FREENULL( p_table->p_checkpoint_sample );
+    FREENULL( p_table->p_checkpoint_time );
+    p_table->i_checkpoints = 0;
+    p_table->i_runs = 0;
+}
+
+static void TimeTableIndex( mp4_time_table_t *p_table )
+{
+    if( p_table->i_checkpoints > 0 || p_table->i_runs == 0 )
+        return;
+
+    const uint32_t i_count = ( p_table->i_runs + MP4_TIME_CHECKPOINT_RUNS - 1 )
+                             / MP4_TIME_CHECKPOINT_RUNS;
+    p_table->p_checkpoint_sample = malloc( i_count * sizeof( uint32_t ) );
+    p_table->p_checkpoint_time = malloc( i_count * sizeof( int64_t ) );
+    if( !p_table->p_checkpoint_sample || !p_table->p_checkpoint_time )
+    {
+        /* Lookups will walk the table from the first run */
+        FREENULL( p_table->p_checkpoint_sample );
+        FREENULL( p_table->p_checkpoint_time );
+        return;
+    }
+
+    uint32_t i_sample = 0;
+    int64_t i_time = 0;
+    for( uint32_t i_run = 0; i_run < p_table->i_runs; i_run++ )
+    {
+        if( i_run % MP4_TIME_CHECKPOINT_RUNS == 0 )
+        {
+            p_table->p_checkpoint_sample[i_run / MP4_TIME_CHECKPOINT_RUNS] = i_sample;
+            p_table->p_checkpoint_time[i_run / MP4_TIME_CHECKPOINT_RUNS] = i_time;
+        }
+        i_sample += p_table->p_count[i_run];
+        i_time += (int64_t)p_table->p_count[i_run] * p_table->p_value[i_run];
+    }
+    p_table->i_checkpoints = i_count;
+}
+
+/* Returns the run holding i_sample (the last one if the table is too short),
+ * with the first sample of that run and the sum of the values before it */
+static uint32_t TimeTableFindSample( mp4_time_table_t *p_table, uint32_t i_sample,
+                                     uint32_t *pi_first, int64_t *pi_time )
+{
+    uint32_t i_run = 0;
+    uint32_t i_first = 0;
+    int64_t i_time = 0;
+
+    TimeTableIndex( p_table );
+    if( p_table->i_checkpoints > 0 )
+    {
+        uint32_t i_low = 0, i_high = p_table->i_checkpoints;
+        while( i_high - i_low > 1 )
+        {
+            const uint32_t i_mid = ( i_low + i_high ) / 2;
+            if( p_table->p_checkpoint_sample[i_mid] <= i_sample )
+                i_low = i_mid;
+            else
+                i_high = i_mid;
+        }
+        i_run = i_low * MP4_TIME_CHECKPOINT_RUNS;
+        i_first = p_table->p_checkpoint_sample[i_low];
+        i_time = p_table->p_checkpoint_time[i_low];
+    }
+
+    while( i_run + 1 < p_table->i_runs &&
+           i_sample - i_first >= p_table->p_count[i_run] )
+    {
+        i_first += p_table->p_count[i_run];
+        i_time += (int64_t)p_table->p_count[i_run] * p_table->p_value[i_run];
+        i_run++;
+    }
+
+    *pi_first = i_first;
+    *pi_time = i_time;
+    return i_run;
+}
+
+/* Returns the sample at time i_time (track timescale) of a dts table */
+static uint32_t TimeTableFindTime( mp4_time_table_t *p_table, int64_t i_time )
+{
+    uint32_t i_run = 0;
+    uint32_t i_sample = 0;
+    int64_t i_run_time = 0;
+
+    if( p_table->i_runs == 0 )
+        return 0;
+
+    TimeTableIndex( p_table );
+    if( p_table->i_checkpoints > 0 )
+    {
+        uint32_t i_low = 0, i_high = p_table->i_checkpoints;
+        while( i_high - i_low > 1 )
+        {
+            const uint32_t i_mid = ( i_low + i_high ) / 2;
+            if( p_table->p_checkpoint_time[i_mid] <= i_time )
+                i_low = i_mid;
+            else
+                i_high = i_mid;
+        }
+        i_run = i_low * MP4_TIME_CHECKPOINT_RUNS;
+        i_sample = p_table->p_checkpoint_sample[i_low];
+        i_run_time = p_table->p_checkpoint_time[i_low];
+    }
+
+    while( i_run + 1 < p_table->i_runs &&
+           i_run_time + (int64_t)p_table->p_count[i_run] *
+                        p_table->p_value[i_run] < i_time )
+    {
+        i_sample += p_table->p_count[i_run];
+        i_run_time += (int64_t)p_table->p_count[i_run] * p_table->p_value[i_run];
+        i_run++;
+    }
+
+    if( p_table->p_value[i_run] > 0 && i_time > i_run_time )
+        i_sample += ( i_time - i_run_time ) / p_table->p_value[i_run];
+    return i_sample;
+}
+
 /* Return time in microsecond of a track */
 static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    mp4_chunk_t chunk;
-    if( p_sys->b_fragmented )
-        chunk = *p_track->cchunk;
-    else
-        chunk = p_track->chunk[p_track->i_chunk];
-
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - chunk.i_sample_first;
-    int64_t i_dts = chunk.i_first_dts;
+    int64_t i_dts;
 
-    while( i_sample > 0 )
+    if( p_sys->b_fragmented )
     {
-        if( i_sample > chunk.p_sample_count_dts[i_index] )
+        mp4_chunk_t chunk = *p_track->cchunk;
+        unsigned int i_index = 0;
+        unsigned int i_sample = p_track->i_sample - chunk.i_sample_first;
+
+        i_dts = chunk.i_first_dts;
+        while( i_sample > 0 )
         {
-            i_dts += chunk.p_sample_count_dts[i_index] *
-                chunk.p_sample_delta_dts[i_index];
-            i_sample -= chunk.p_sample_count_dts[i_index];
-            i_index++;
+            if( i_sample > chunk.p_sample_count_dts[i_index] )
+            {
+                i_dts += chunk.p_sample_count_dts[i_index] *
+                    chunk.p_sample_delta_dts[i_index];
+                i_sample -= chunk.p_sample_count_dts[i_index];
+                i_index++;
+            }
+            else
+            {
+                i_dts += i_sample * chunk.p_sample_delta_dts[i_index];
+                break;
+            }
         }
-        else
+    }
+    else
+    {
+        mp4_time_table_t *p_table = &p_track->dts_table;
+        uint32_t i_first;
+
+        i_dts = 0;
+        if( p_table->i_runs > 0 )
         {
-            i_dts += i_sample * chunk.p_sample_delta_dts[i_index];
-            break;
+            uint32_t i_run = TimeTableFindSample( p_table, p_track->i_sample,
+                                                  &i_first, &i_dts );
+            i_dts += (int64_t)( p_track->i_sample - i_first ) *
+                     p_table->p_value[i_run];
         }
     }
 
@@ -168,7 +332,19 @@ static inline int64_t MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_tra
     if( p_sys->b_fragmented )
         ck = p_track->cchunk;
     else
-        ck = &p_track->chunk[p_track->i_chunk];
+    {
+        mp4_time_table_t *p_table = &p_track->pts_table;
+        uint32_t i_first;
+        int64_t i_time;
+
+        if( p_table->i_runs == 0 )
+            return -1;
+
+        uint32_t i_run = TimeTableFindSample( p_table, p_track->i_sample,
+                                              &i_first, &i_time );
+        return p_table->p_value[i_run] * INT64_C(1000000) /
+               (int64_t)p_track->i_timescale;
+    }
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
@@ -378,16 +554,6 @@ static int Open( vlc_object_t * p_this )
         CreateTracksFromSmooBox( p_demux );
         return VLC_SUCCESS;
     }
-    else if( p_sys->b_fragmented && b_seekable )
-    {
-        /* We are not yet able to demux a fragmented MP4 file, using the 'mfra'
-         * box. So if STREAM_CAN_FASTSEEK is true, we're assuming we've got such
-         * a file, and we let avformat do the job. */
-        msg_Warn( p_demux, "MP4 plugin discarded "\
-                "(fast-seekable and fragmented, let avformat demux it)" );
-        stream_Seek( p_demux->s, 0 ); /* rewind, for other demux */
-        goto error;
-    }
     else if( !p_sys->b_fragmented && !b_seekable )
     {
         msg_Warn( p_demux, "MP4 plugin discarded (not fast-seekable)" );
@@ -628,6 +794,10 @@ static int Open( vlc_object_t * p_this )
         }
     }
 
+    /* A fragmented file is read fragment by fragment, and seeked by index */
+    if( p_sys->b_fragmented && b_seekable )
+        FragIndexInit( p_demux );
+
     /* */
     LoadChapter( p_demux );
 
@@ -850,6 +1020,352 @@ static int Seek( demux_t *p_demux, mtime_t i_date )
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * Fragments index: where the fragments of a seekable file start, and when.
+ * It is read from the mfra at the end of the file when there is one, else
+ * it is built while needed by following the sidx, or the moof boxes.
+ *****************************************************************************/
+static int FragIndexAdd( demux_sys_t *p_sys, uint64_t i_pos, mtime_t i_time )
+{
+    /* entries come in file order, keep the first one of each fragment */
+    if( p_sys->i_frag_count > 0 &&
+        p_sys->p_frag[p_sys->i_frag_count - 1].i_pos >= i_pos )
+        return VLC_SUCCESS;
+
+    if( ( p_sys->i_frag_count % 256 ) == 0 )
+    {
+        mp4_fragment_t *p_frag = realloc( p_sys->p_frag,
+                        ( p_sys->i_frag_count + 256 ) * sizeof( *p_frag ) );
+        if( !p_frag )
+            return VLC_ENOMEM;
+        p_sys->p_frag = p_frag;
+    }
+    p_sys->p_frag[p_sys->i_frag_count].i_pos = i_pos;
+    p_sys->p_frag[p_sys->i_frag_count].i_time = i_time;
+    p_sys->i_frag_count++;
+    return VLC_SUCCESS;
+}
+
+/* Duration of the samples of a traf, in its track timescale */
+static uint64_t FragTrafDuration( demux_t *p_demux, MP4_Box_t *p_traf )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    MP4_Box_t *p_tfhd = MP4_BoxGet( p_traf, "tfhd" );
+    uint32_t i_default = 0;
+    uint64_t i_duration = 0;
+
+    if( !p_tfhd )
+        return 0;
+
+    if( p_tfhd->data.p_tfhd->i_flags & MP4_TFHD_DFLT_SAMPLE_DURATION )
+        i_default = p_tfhd->data.p_tfhd->i_default_sample_duration;
+    else
+    {
+        MP4_Box_t *p_mvex = MP4_BoxGet( p_sys->p_root, "/moov/mvex" );
+        for( MP4_Box_t *p_trex = p_mvex ? p_mvex->p_first : NULL; p_trex;
+             p_trex = p_trex->p_next )
+            if( p_trex->i_type == ATOM_trex && p_trex->data.p_trex &&
+                p_trex->data.p_trex->i_track_ID == p_tfhd->data.p_tfhd->i_track_ID )
+                i_default = p_trex->data.p_trex->i_default_sample_duration;
+    }
+
+    for( MP4_Box_t *p_trun = p_traf->p_first; p_trun; p_trun = p_trun->p_next )
+    {
+        if( p_trun->i_type != ATOM_trun || !p_trun->data.p_trun )
+            continue;
+
+        MP4_Box_data_trun_t *p_data = p_trun->data.p_trun;
+        if( !( p_data->i_flags & MP4_TRUN_SAMPLE_DURATION ) )
+            i_duration += (uint64_t)p_data->i_sample_count * i_default;
+        else
+            for( uint32_t i = 0; i < p_data->i_sample_count; i++ )
+                i_duration += p_data->p_samples[i].i_duration;
+    }
+    return i_duration;
+}
+
+/* Traf of the index track in a moof */
+static MP4_Box_t *FragGetIndexTraf( demux_sys_t *p_sys, MP4_Box_t *p_moof )
+{
+    for( MP4_Box_t *p_traf = p_moof->p_first; p_traf; p_traf = p_traf->p_next )
+    {
+        if( p_traf->i_type != ATOM_traf )
+            continue;
+
+        MP4_Box_t *p_tfhd = MP4_BoxGet( p_traf, "tfhd" );
+        if( p_tfhd && p_tfhd->data.p_tfhd->i_track_ID == p_sys->i_frag_track_ID )
+            return p_traf;
+    }
+    return NULL;
+}
+
+static int FragIndexLoadMfra( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int64_t i_size = stream_Size( p_demux->s );
+    uint8_t mfro[16];
+
+    /* the mfro closing the file gives the size of the mfra */
+    if( i_size < 16 || stream_Seek( p_demux->s, i_size - 16 ) ||
+        stream_Read( p_demux->s, mfro, 16 ) < 16 ||
+        memcmp( &mfro[4], "mfro", 4 ) )
+        return VLC_EGENERIC;
+
+    const uint32_t i_mfra = GetDWBE( &mfro[12] );
+    if( i_mfra < 16 || i_mfra > i_size ||
+        stream_Seek( p_demux->s, i_size - i_mfra ) )
+        return VLC_EGENERIC;
+
+    MP4_Box_t *p_mfra = MP4_BoxGetNextBox( p_demux->s );
+    if( !p_mfra )
+        return VLC_EGENERIC;
+
+    /* use the random access points of the index track, or of any track */
+    MP4_Box_t *p_tfra = NULL;
+    for( MP4_Box_t *p_box = p_mfra->i_type == ATOM_mfra ? p_mfra->p_first : NULL;
+         p_box; p_box = p_box->p_next )
+    {
+        if( p_box->i_type != ATOM_tfra || !p_box->data.p_tfra )
+            continue;
+        if( !p_tfra || p_box->data.p_tfra->i_track_ID == p_sys->i_frag_track_ID )
+            p_tfra = p_box;
+    }
+
+    mp4_track_t *p_track = NULL;
+    if( p_tfra )
+        p_track = MP4_frg_GetTrack( p_demux, p_tfra->data.p_tfra->i_track_ID );
+    if( !p_track || !p_track->i_timescale )
+    {
+        MP4_BoxFree( p_demux->s, p_mfra );
+        return VLC_EGENERIC;
+    }
+    p_sys->i_frag_track_ID = p_track->i_track_ID;
+
+    MP4_Box_data_tfra_t *p_data = p_tfra->data.p_tfra;
+    for( uint32_t i = 0; i < p_data->i_number_of_entries; i++ )
+    {
+        uint64_t i_time, i_pos;
+        if( p_data->i_version == 1 )
+        {
+            i_time = ((uint64_t *)p_data->p_time)[i];
+            i_pos  = ((uint64_t *)p_data->p_moof_offset)[i];
+        }
+        else
+        {
+            i_time = p_data->p_time[i];
+            i_pos  = p_data->p_moof_offset[i];
+        }
+        if( FragIndexAdd( p_sys, i_pos, INT64_C(1000000) * i_time /
+                                        p_track->i_timescale ) )
+            break;
+    }
+    MP4_BoxFree( p_demux->s, p_mfra );
+
+    if( p_sys->i_frag_count == 0 )
+        return VLC_EGENERIC;
+
+    p_sys->i_frag_scan_pos = 0;
+    msg_Dbg( p_demux, "indexed %u fragments from the mfra", p_sys->i_frag_count );
+    return VLC_SUCCESS;
+}
+
+/* Extend the index until it covers i_time, or the end of the file */
+static void FragIndexScan( demux_t *p_demux, mtime_t i_time )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_track_t *p_track = MP4_frg_GetTrack( p_demux, p_sys->i_frag_track_ID );
+    const uint64_t i_size = stream_Size( p_demux->s );
+
+    while( p_sys->i_frag_scan_pos > 0 &&
+           ( p_sys->i_frag_count == 0 ||
+             p_sys->p_frag[p_sys->i_frag_count - 1].i_time <= i_time ) )
+    {
+        const uint64_t i_pos = p_sys->i_frag_scan_pos;
+        MP4_Box_t box;
+
+        if( i_pos + 8 > i_size || stream_Seek( p_demux->s, i_pos ) ||
+            !MP4_ReadBoxCommon( p_demux->s, &box ) || box.i_size < 8 )
+        {
+            p_sys->i_frag_scan_pos = 0;
+            break;
+        }
+        p_sys->i_frag_scan_pos = i_pos + box.i_size < i_size ?
+                                 i_pos + box.i_size : 0;
+
+        if( box.i_type == ATOM_sidx )
+        {
+            /* a sidx gives the position and time of the next fragments */
+            MP4_Box_t *p_sidx = MP4_BoxGetNextBox( p_demux->s );
+            if( !p_sidx )
+                break;
+
+            MP4_Box_data_sidx_t *p_data = p_sidx->data.p_sidx;
+            uint64_t i_ref_pos = i_pos + box.i_size + p_data->i_first_offset;
+            uint64_t i_ref_time = p_data->i_earliest_presentation_time;
+            bool b_media = p_data->i_timescale > 0;
+
+            for( uint16_t i = 0; b_media && i < p_data->i_reference_count; i++ )
+            {
+                /* no support for hierarchical indexes, scan the boxes */
+                if( p_data->p_items[i].b_reference_type )
+                {
+                    b_media = false;
+                    break;
+                }
+                FragIndexAdd( p_sys, i_ref_pos, INT64_C(1000000) * i_ref_time /
+                                                p_data->i_timescale );
+                i_ref_pos += p_data->p_items[i].i_referenced_size;
+                i_ref_time += p_data->p_items[i].i_subsegment_duration;
+            }
+            if( b_media && p_data->i_reference_count > 0 )
+            {
+                p_sys->i_frag_scan_pos = i_ref_pos < i_size ? i_ref_pos : 0;
+                if( p_track )
+                    p_sys->i_frag_scan_dts = i_ref_time * p_track->i_timescale /
+                                             p_data->i_timescale;
+            }
+            MP4_BoxFree( p_demux->s, p_sidx );
+        }
+        else if( box.i_type == ATOM_moof && p_track && p_track->i_timescale )
+        {
+            /* else the decode time of the index track in the moof */
+            MP4_Box_t *p_moof = MP4_BoxGetNextBox( p_demux->s );
+            if( !p_moof )
+                break;
+
+            MP4_Box_t *p_traf = FragGetIndexTraf( p_sys, p_moof );
+            if( p_traf )
+            {
+                MP4_Box_t *p_tfdt = MP4_BoxGet( p_traf, "tfdt" );
+                if( p_tfdt )
+                    p_sys->i_frag_scan_dts =
+                        p_tfdt->data.p_tfdt->i_base_media_decode_time;
+                FragIndexAdd( p_sys, i_pos, INT64_C(1000000) *
+                              p_sys->i_frag_scan_dts / p_track->i_timescale );
+                p_sys->i_frag_scan_dts += FragTrafDuration( p_demux, p_traf );
+            }
+            MP4_BoxFree( p_demux->s, p_moof );
+        }
+        else if( box.i_type == ATOM_mfra || box.i_size == 0 )
+        {
+            p_sys->i_frag_scan_pos = 0;
+        }
+        /* other boxes (mdat, free, styp...) are skipped */
+    }
+}
+
+static void FragIndexInit( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint64_t i_start = stream_Tell( p_demux->s );
+
+    /* times refer to the first video track, or the first track */
+    for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+    {
+        mp4_track_t *tk = &p_sys->track[i];
+        if( !tk->b_ok || tk->b_chapter )
+            continue;
+        if( !p_sys->i_frag_track_ID )
+            p_sys->i_frag_track_ID = tk->i_track_ID;
+        if( tk->fmt.i_cat == VIDEO_ES )
+        {
+            p_sys->i_frag_track_ID = tk->i_track_ID;
+            break;
+        }
+    }
+    if( !p_sys->i_frag_track_ID )
+        return;
+    p_sys->b_frag_index = true;
+
+    if( FragIndexLoadMfra( p_demux ) != VLC_SUCCESS )
+    {
+        msg_Dbg( p_demux, "no mfra, indexing the fragments while seeking" );
+        p_sys->i_frag_count = 0;
+        p_sys->i_frag_scan_pos = i_start;
+        p_sys->i_frag_scan_dts = 0;
+        FragIndexScan( p_demux, 0 );
+    }
+
+    /* The length of the file is the end of the last fragment */
+    MP4_Box_t *p_mehd = MP4_BoxGet( p_sys->p_root, "/moov/mvex/mehd" );
+    if( p_sys->i_duration == 0 && p_mehd )
+        p_sys->i_duration = p_mehd->data.p_mehd->i_fragment_duration;
+
+    mp4_track_t *p_track = MP4_frg_GetTrack( p_demux, p_sys->i_frag_track_ID );
+    if( p_sys->i_duration == 0 && p_sys->i_frag_scan_pos == 0 &&
+        p_sys->i_frag_count > 0 && p_track && p_track->i_timescale &&
+        !stream_Seek( p_demux->s, p_sys->p_frag[p_sys->i_frag_count - 1].i_pos ) )
+    {
+        MP4_Box_t *p_moof = MP4_BoxGetNextBox( p_demux->s );
+        MP4_Box_t *p_traf = p_moof && p_moof->i_type == ATOM_moof ?
+                            FragGetIndexTraf( p_sys, p_moof ) : NULL;
+        if( p_traf )
+        {
+            mtime_t i_end = p_sys->p_frag[p_sys->i_frag_count - 1].i_time +
+                            INT64_C(1000000) * FragTrafDuration( p_demux, p_traf ) /
+                            p_track->i_timescale;
+            p_sys->i_duration = i_end * p_sys->i_timescale / 1000000;
+        }
+        if( p_moof )
+            MP4_BoxFree( p_demux->s, p_moof );
+    }
+
+    /* Start with the first fragment */
+    if( p_sys->i_frag_count > 0 )
+    {
+        p_sys->i_time = p_sys->p_frag[0].i_time * p_sys->i_timescale / 1000000;
+        p_sys->i_pcr  = p_sys->p_frag[0].i_time;
+    }
+    stream_Seek( p_demux->s, i_start );
+}
+
+/* Seek to the last fragment starting before i_date */
+static int FragSeek( demux_t *p_demux, mtime_t i_date )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    FragIndexScan( p_demux, i_date );
+    if( p_sys->i_frag_count == 0 )
+        return VLC_EGENERIC;
+
+    unsigned i_lo = 0, i_hi = p_sys->i_frag_count;
+    while( i_hi - i_lo > 1 )
+    {
+        unsigned i_mid = ( i_lo + i_hi ) / 2;
+        if( p_sys->p_frag[i_mid].i_time <= i_date )
+            i_lo = i_mid;
+        else
+            i_hi = i_mid;
+    }
+    const mp4_fragment_t *p_frag = &p_sys->p_frag[i_lo];
+
+    if( stream_Seek( p_demux->s, p_frag->i_pos ) )
+        return VLC_EGENERIC;
+    msg_Dbg( p_demux, "seeking to fragment %u at %"PRId64, i_lo, p_frag->i_time );
+
+    /* update global time */
+    p_sys->i_time = i_date * p_sys->i_timescale / 1000000;
+    p_sys->i_pcr  = p_frag->i_time;
+
+    for( unsigned i_track = 0; i_track < p_sys->i_tracks; i_track++ )
+    {
+        mp4_track_t *tk = &p_sys->track[i_track];
+
+        /* We don't want the current chunk to be flushed */
+        tk->cchunk->i_sample = tk->cchunk->i_sample_count;
+
+        /* The tfdt of the fragment gives the exact time */
+        tk->i_sample = tk->i_sample_first = 0;
+        tk->i_first_dts = p_frag->i_time * tk->i_timescale / 1000000;
+
+        tk->b_has_non_empty_cchunk = false;
+    }
+    MP4_UpdateSeekpoint( p_demux );
+
+    es_out_Control( p_demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME, i_date );
+    return VLC_SUCCESS;
+}
+
 static int MP4_frg_Seek( demux_t *p_demux, double f )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -910,7 +1426,13 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         case DEMUX_SET_POSITION:
             f = (double)va_arg( args, double );
-            if( p_sys->b_fragmented )
+            if( p_sys->b_frag_index && p_sys->i_duration > 0 )
+            {
+                return FragSeek( p_demux, (int64_t)( f * (double)1000000 *
+                                 (double)p_sys->i_duration /
+                                 (double)p_sys->i_timescale ) );
+            }
+            else if( p_sys->b_fragmented )
             {
                 return MP4_frg_Seek( p_demux, f );
             }
@@ -936,6 +1458,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         case DEMUX_SET_TIME:
             i64 = (int64_t)va_arg( args, int64_t );
+            if( p_sys->b_frag_index )
+                return FragSeek( p_demux, i64 );
             return Seek( p_demux, i64 );
 
         case DEMUX_GET_LENGTH:
@@ -1173,6 +1697,7 @@ static void Close ( vlc_object_t * p_this )
         MP4_TrackDestroy(  &p_sys->track[i_track] );
     }
     FREENULL( p_sys->track );
+    free( p_sys->p_frag );
 
     if( p_sys->p_title )
         vlc_input_title_Delete( p_sys->p_title );
@@ -1381,7 +1906,6 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     MP4_Box_data_stts_t *stts;
     /* TODO use also stss and stsh table for seeking */
     /* FIXME use edit table */
-    int64_t i_sample;
     int64_t i_chunk;
 
     int64_t i_index;
@@ -1422,62 +1946,30 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     else
     {
-        /* 2: each sample can have a different size */
+        /* 2: each sample can have a different size, the stsz box stays
+         * around until the demuxer is closed so use its table */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
-    /* Use stts table to create a sample number -> dts table.
-     * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
+    /* The stts and ctts tables are already run-length coded: they are used
+     * as is for the sample <-> time lookups. Only the first and last dts of
+     * each chunk are computed here. */
+    TimeTableInit( &p_demux_track->dts_table, stts->i_entry_count,
+                   stts->i_sample_count, stts->i_sample_delta );
 
     i_next_dts = 0;
     i_index = 0; i_index_sample_used = 0;
     for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
     {
         mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-        int64_t i_entry, i_sample_count, i;
+        int64_t i_sample_count = ck->i_sample_count;
 
         /* save first dts */
         ck->i_first_dts = i_next_dts;
         ck->i_last_dts  = i_next_dts;
 
-        /* count how many entries are needed for this chunk
-         * for p_sample_delta_dts and p_sample_count_dts */
-        i_sample_count = ck->i_sample_count;
-
-        i_entry = 0;
-        while( i_sample_count > 0 )
-        {
-            i_sample_count -= stts->i_sample_count[i_index+i_entry];
-            /* don't count already used sample in this entry */
-            if( i_entry == 0 )
-                i_sample_count += i_index_sample_used;
-
-            i_entry++;
-        }
-
-        /* allocate them */
-        ck->p_sample_count_dts = calloc( i_entry, sizeof( uint32_t ) );
-        ck->p_sample_delta_dts = calloc( i_entry, sizeof( uint32_t ) );
-
-        if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            return VLC_ENOMEM;
-
-        /* now copy */
-        i_sample_count = ck->i_sample_count;
-        for( i = 0; i < i_entry; i++ )
+        while( i_sample_count > 0 && i_index < stts->i_entry_count )
         {
             int64_t i_used;
             int64_t i_rest;
@@ -1490,10 +1982,8 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
             i_sample_count -= i_used;
             i_next_dts += i_used * stts->i_sample_delta[i_index];
 
-            ck->p_sample_count_dts[i] = i_used;
-            ck->p_sample_delta_dts[i] = stts->i_sample_delta[i_index];
             if( i_used > 0 )
-                ck->i_last_dts = i_next_dts - ck->p_sample_delta_dts[i];
+                ck->i_last_dts = i_next_dts - stts->i_sample_delta[i_index];
 
             if( i_index_sample_used >= stts->i_sample_count[i_index] )
             {
@@ -1513,60 +2003,8 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "CTTS table" );
 
-        /* Create pts-dts table per chunk */
-        i_index = 0; i_index_sample_used = 0;
-        for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            int64_t i_entry, i_sample_count, i;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            i_sample_count = ck->i_sample_count;
-
-            i_entry = 0;
-            while( i_sample_count > 0 )
-            {
-                i_sample_count -= ctts->i_sample_count[i_index+i_entry];
-
-                /* don't count already used sample in this entry */
-                if( i_entry == 0 )
-                    i_sample_count += i_index_sample_used;
-
-                i_entry++;
-            }
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( i_entry, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( i_entry, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-                return VLC_ENOMEM;
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-            for( i = 0; i < i_entry; i++ )
-            {
-                int64_t i_used;
-                int64_t i_rest;
-
-                i_rest = ctts->i_sample_count[i_index] -
-                    i_index_sample_used;
-
-                i_used = __MIN( i_rest, i_sample_count );
-
-                i_index_sample_used += i_used;
-                i_sample_count -= i_used;
-
-                ck->p_sample_count_pts[i] = i_used;
-                ck->p_sample_offset_pts[i] = ctts->i_sample_offset[i_index];
-
-                if( i_index_sample_used >= ctts->i_sample_count[i_index] )
-                {
-                    i_index++;
-                    i_index_sample_used = 0;
-                }
-            }
-        }
+        TimeTableInit( &p_demux_track->pts_table, ctts->i_entry_count,
+                       ctts->i_sample_count, ctts->i_sample_offset );
     }
 
     msg_Dbg( p_demux, "track[Id 0x%x] read %d samples length:%"PRId64"s",
@@ -2273,10 +2711,8 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     MP4_Box_t   *p_box_stss;
-    uint64_t     i_dts;
     unsigned int i_sample;
     unsigned int i_chunk;
-    int          i_index;
 
     /* FIXME see if it's needed to check p_track->i_chunk_count */
     if( p_track->i_chunk_count == 0 )
@@ -2320,52 +2756,20 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = i_start * p_track->i_timescale / (int64_t)1000000;
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
-    /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
-    {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
-
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
-    }
+    /* *** find sample *** */
+    i_sample = TimeTableFindTime( &p_track->dts_table, i_start );
 
-    /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    /* *** find the last chunk starting at or before it *** */
+    unsigned int i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
     {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
-        {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
-
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
-            i_index++;
-        }
+        const unsigned int i_mid = ( i_low + i_high ) / 2;
+        if( p_track->chunk[i_mid].i_sample_first <= i_sample )
+            i_low = i_mid;
         else
-        {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
-            {
-                break;
-            }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
-            break;
-        }
+            i_high = i_mid;
     }
+    i_chunk = i_low;
 
     if( i_sample >= p_track->i_sample_count )
     {
@@ -2717,35 +3121,23 @@ static void FreeAndResetChunk( mp4_chunk_t *ck )
  ****************************************************************************/
 static void MP4_TrackDestroy( mp4_track_t *p_track )
 {
-    unsigned int i_chunk;
-
     p_track->b_ok = false;
     p_track->b_enable   = false;
     p_track->b_selected = false;
 
     es_format_Clean( &p_track->fmt );
 
-    for( i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-    {
-        if( p_track->chunk )
-        {
-           FREENULL(p_track->chunk[i_chunk].p_sample_count_dts);
-           FREENULL(p_track->chunk[i_chunk].p_sample_delta_dts );
-
-           FREENULL(p_track->chunk[i_chunk].p_sample_count_pts);
-           FREENULL(p_track->chunk[i_chunk].p_sample_offset_pts );
-        }
-    }
     FREENULL( p_track->chunk );
     if( p_track->cchunk ) {
         FreeAndResetChunk( p_track->cchunk );
         FREENULL( p_track->cchunk );
     }
 
-    if( !p_track->i_sample_size )
-    {
-        FREENULL( p_track->p_sample_size );
-    }
+    /* points into the stsz box */
+    p_track->p_sample_size = NULL;
+
+    TimeTableClean( &p_track->dts_table );
+    TimeTableClean( &p_track->pts_table );
 }
 
 static int MP4_TrackSelect( demux_t *p_demux, mp4_track_t *p_track,
@@ -3382,27 +3774,16 @@ static int ReInitDecoder( demux_t *p_demux, mp4_track_t *p_track )
 }
 
 /**
- * This function fills a mp4_chunk_t structure from a MP4_Box_t (p_chunk).
- * The 'i_tk_id' argument returns the ID of the track the chunk belongs to.
- * \note p_chunk usually contains a 'moof' and a 'mdat', and might contain a 'sidx'.
+ * This function fills the mp4_chunk_t structure of a track from one 'traf'
+ * of a 'moof'.
+ * \note the sample data follows the previous traf, or is found by the data
+ * offset of the trun in seekable fragmented files.
  * \return VLC_SUCCESS, VLC_EGENERIC or VLC_ENOMEM.
  */
-static int MP4_frg_GetChunk( demux_t *p_demux, MP4_Box_t *p_chunk, unsigned *i_tk_id )
+static int MP4_frg_GetTraf( demux_t *p_demux, MP4_Box_t *p_sidx,
+                            MP4_Box_t *p_moof, MP4_Box_t *p_traf )
 {
-    MP4_Box_t *p_sidx = MP4_BoxGet( p_chunk, "sidx" );
-    MP4_Box_t *p_moof = MP4_BoxGet( p_chunk, "moof" );
-    if( p_moof == NULL)
-    {
-        msg_Warn( p_demux, "no moof box found!" );
-        return VLC_EGENERIC;
-    }
-
-    MP4_Box_t *p_traf = MP4_BoxGet( p_moof, "traf" );
-    if( p_traf == NULL)
-    {
-        msg_Warn( p_demux, "no traf box found!" );
-        return VLC_EGENERIC;
-    }
+    demux_sys_t *p_sys = p_demux->p_sys;
 
     MP4_Box_t *p_tfhd = MP4_BoxGet( p_traf, "tfhd" );
     if( p_tfhd == NULL)
@@ -3412,13 +3793,12 @@ static int MP4_frg_GetChunk( demux_t *p_demux, MP4_Box_t *p_chunk, unsigned *i_t
     }
 
     uint32_t i_track_ID = p_tfhd->data.p_tfhd->i_track_ID;
-    *i_tk_id = i_track_ID;
     assert( i_track_ID > 0 );
     msg_Dbg( p_demux, "GetChunk: track ID is %"PRIu32"", i_track_ID );
 
     mp4_track_t *p_track = MP4_frg_GetTrack( p_demux, i_track_ID );
     if( !p_track )
-        return VLC_EGENERIC;
+        return p_sys->b_frag_index ? VLC_SUCCESS : VLC_EGENERIC;
 
     mp4_chunk_t *ret = p_track->cchunk;
 
@@ -3465,6 +3845,11 @@ static int MP4_frg_GetChunk( demux_t *p_demux, MP4_Box_t *p_chunk, unsigned *i_t
     ret->i_sample_first = p_track->i_sample_first;
     p_track->i_sample_first += ret->i_sample_count;
 
+    /* Files seeked by index restart at the decode time of the fragment */
+    MP4_Box_t *p_tfdt = MP4_BoxGet( p_traf, "tfdt" );
+    if( p_sys->b_frag_index && p_tfdt )
+        p_track->i_first_dts = p_tfdt->data.p_tfdt->i_base_media_decode_time;
+
     ret->i_first_dts = p_track->i_first_dts;
 
     /* XXX I already saw DASH content with no default_duration and no
@@ -3515,12 +3900,21 @@ static int MP4_frg_GetChunk( demux_t *p_demux, MP4_Box_t *p_chunk, unsigned *i_t
     if( !ret->p_sample_data )
         return VLC_ENOMEM;
 
+    if( p_sys->b_frag_index && ( p_trun_data->i_flags & MP4_TRUN_DATA_OFFSET ) )
+    {
+        uint64_t i_base = p_moof->i_pos;
+        if( p_tfhd->data.p_tfhd->i_flags & MP4_TFHD_BASE_DATA_OFFSET )
+            i_base = p_tfhd->data.p_tfhd->i_base_data_offset;
+
+        uint64_t i_data = i_base + p_trun_data->i_data_offset;
+        if( (uint64_t)stream_Tell( p_demux->s ) != i_data &&
+            stream_Seek( p_demux->s, i_data ) )
+            return VLC_EGENERIC;
+    }
+
     uint32_t dur = 0, len;
     uint32_t chunk_duration = 0, chunk_size = 0;
 
-    /* Skip header of mdat */
-    stream_Read( p_demux->s, NULL, 8 );
-
     for( uint32_t i = 0; i < ret->i_sample_count; i++)
     {
         if( p_trun_data->i_flags & MP4_TRUN_SAMPLE_DURATION )
@@ -3562,6 +3956,54 @@ static int MP4_frg_GetChunk( demux_t *p_demux, MP4_Box_t *p_chunk, unsigned *i_t
     return VLC_SUCCESS;
 }
 
+/**
+ * This function fills the mp4_chunk_t structures of the tracks from a
+ * MP4_Box_t (p_chunk), one for each 'traf' of the 'moof'.
+ * \note p_chunk usually contains a 'moof' and a 'mdat', and might contain a 'sidx'.
+ * \return VLC_SUCCESS, VLC_EGENERIC or VLC_ENOMEM.
+ */
+static int MP4_frg_GetChunk( demux_t *p_demux, MP4_Box_t *p_chunk )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    MP4_Box_t *p_sidx = MP4_BoxGet( p_chunk, "sidx" );
+    MP4_Box_t *p_moof = MP4_BoxGet( p_chunk, "moof" );
+    if( p_moof == NULL)
+    {
+        msg_Warn( p_demux, "no moof box found!" );
+        return VLC_EGENERIC;
+    }
+
+    if( MP4_BoxGet( p_moof, "traf" ) == NULL)
+    {
+        msg_Warn( p_demux, "no traf box found!" );
+        return VLC_EGENERIC;
+    }
+
+    /* The next fragment starts after the mdat */
+    uint64_t i_next = stream_Tell( p_demux->s );
+    MP4_Box_t mdat;
+    if( MP4_ReadBoxCommon( p_demux->s, &mdat ) && mdat.i_type == ATOM_mdat )
+        i_next += mdat.i_size;
+
+    /* Skip header of mdat */
+    stream_Read( p_demux->s, NULL, 8 );
+
+    for( MP4_Box_t *p_traf = p_moof->p_first; p_traf; p_traf = p_traf->p_next )
+    {
+        if( p_traf->i_type != ATOM_traf )
+            continue;
+
+        int i_ret = MP4_frg_GetTraf( p_demux, p_sidx, p_moof, p_traf );
+        if( i_ret != VLC_SUCCESS )
+            return i_ret;
+    }
+
+    if( p_sys->b_frag_index && (uint64_t)stream_Tell( p_demux->s ) != i_next )
+        stream_Seek( p_demux->s, i_next );
+
+    return VLC_SUCCESS;
+}
+
 /**
  * Get the next chunk of the track identified by i_tk_id.
  * \Note We don't want to seek all the time, so if the first chunk given by the
@@ -3620,12 +4062,13 @@ static int MP4_frg_GetChunks( demux_t *p_demux, const unsigned i_tk_id )
             return MP4_frg_GetChunks( p_demux, i_tk_id );
         }
 
-        if( MP4_frg_GetChunk( p_demux, p_chunk, &tid ) != VLC_SUCCESS )
+        if( MP4_frg_GetChunk( p_demux, p_chunk ) != VLC_SUCCESS )
             goto MP4_frg_GetChunks_Error;
 
         MP4_BoxFree( p_demux->s, p_chunk );
 
-        if( tid == i_tk_id )
+        p_track = MP4_frg_GetTrack( p_demux, i_tk_id );
+        if( p_track && p_track->b_has_non_empty_cchunk )
             break;
         else
             continue;
@@ -384,6 +384,8 @@ static int Demux( demux_t * p_demux )
                 continue;
             }
 
+            /* remember where we've been, for later seeks */
+            Oggseek_IndexLearnPage( p_demux, p_stream, &p_sys->current_page );
         }
 
         /* clear the finished flag if pages after eos (ex: after a seek) */
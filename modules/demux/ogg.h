@@ -87,6 +87,8 @@ typedef struct logical_stream_s
 
     /* keyframe index for seeking, created as we discover keyframes */
     demux_index_entry_t *idx;
+    /* timestamp of the last page added to the index during playback */
+    int64_t i_idx_learnt;
 
     /* Skeleton data */
     ogg_skeleton_t *p_skel;
@@ -90,6 +90,7 @@ static demux_index_entry_t *index_entry_new( void )
     if ( !idx ) return NULL;
     idx->p_next = idx->p_prev = NULL;
     idx->i_pagepos_end = -1;
+    idx->b_keyframe = idx->b_page = false;
     return idx;
 }
 
@@ -183,32 +184,36 @@ const demux_index_entry_t *oggseek_theora_index_entry_add ( logical_stream_t *p_
     return idx;
 }
 
+/* true if decoding can start on any page of the stream */
+static inline bool OggSeekCanStartAnywhere( logical_stream_t *p_stream )
+{
+    return p_stream->fmt.i_cat == AUDIO_ES &&
+           Ogg_GetKeyframeGranule( p_stream, 0xFF00FF00 ) == 0xFF00FF00;
+}
+
+/* true if idx carries at least the information of a new entry */
+static inline bool index_entry_covers( const demux_index_entry_t *idx,
+                                       bool b_keyframe, bool b_page )
+{
+    return ( idx->b_keyframe || !b_keyframe ) && ( idx->b_page || !b_page );
+}
+
 /* We insert into index, sorting by pagepos (as a page can match multiple
-   time stamps) */
-const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
-                                             int64_t i_timestamp,
-                                             int64_t i_pagepos )
+   time stamps). Entries learnt from pages are kept at least
+   OGGSEEK_INDEX_INTERVAL apart. */
+static const demux_index_entry_t *OggSeekIndexInsert( logical_stream_t *p_stream,
+                                                      int64_t i_timestamp,
+                                                      int64_t i_pagepos,
+                                                      bool b_keyframe, bool b_page )
 {
     demux_index_entry_t *idx;
-    demux_index_entry_t *oidx;
     demux_index_entry_t *last_idx = NULL;
 
     if ( p_stream == NULL ) return NULL;
 
-    oidx = idx = p_stream->idx;
-
     if ( i_timestamp < 1 || i_pagepos < 1 ) return NULL;
 
-    if ( idx == NULL )
-    {
-        demux_index_entry_t *ie = index_entry_new();
-        if ( !ie ) return NULL;
-        ie->i_value = i_timestamp;
-        ie->i_pagepos = i_pagepos;
-        p_stream->idx = ie;
-        return ie;
-    }
-
+    idx = p_stream->idx;
     while ( idx != NULL )
     {
         if ( idx->i_pagepos > i_pagepos ) break;
@@ -216,6 +221,18 @@ const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
         idx = idx->p_next;
     }
 
+    /* already known, or too close to a neighbour to be worth it */
+    const demux_index_entry_t *neighbours[2] = { last_idx, idx };
+    for ( int i = 0; i < 2; i++ )
+    {
+        const demux_index_entry_t *n = neighbours[i];
+        if ( n == NULL || !index_entry_covers( n, b_keyframe, b_page ) )
+            continue;
+        if ( n->i_pagepos == i_pagepos ||
+             ( b_page && llabs( n->i_value - i_timestamp ) < OGGSEEK_INDEX_INTERVAL ) )
+            return n;
+    }
+
     /* new entry; insert after last_idx */
     idx = index_entry_new();
     if ( !idx ) return NULL;
@@ -227,8 +244,8 @@ const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
     }
     else
     {
-        idx->p_next = oidx;
-        oidx = idx;
+        idx->p_next = p_stream->idx;
+        p_stream->idx = idx;
     }
 
     if ( idx->p_next != NULL )
@@ -238,35 +255,90 @@ const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
 
     idx->i_value = i_timestamp;
     idx->i_pagepos = i_pagepos;
+    idx->b_keyframe = b_keyframe;
+    idx->b_page = b_page;
 
     return idx;
 }
 
+/* Adds the result of a seek: decoding from i_pagepos reaches i_timestamp */
+const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
+                                             int64_t i_timestamp,
+                                             int64_t i_pagepos )
+{
+    return OggSeekIndexInsert( p_stream, i_timestamp, i_pagepos, true, false );
+}
+
+/* Adds a page seen while bisecting or playing */
+static void OggSeekIndexAddPage( logical_stream_t *p_stream,
+                                 int64_t i_timestamp, int64_t i_pagepos )
+{
+    OggSeekIndexInsert( p_stream, i_timestamp, i_pagepos,
+                        OggSeekCanStartAnywhere( p_stream ), true );
+}
+
+/* Learns the page just read by the demuxer; cheap enough to be called on
+   every page */
+void Oggseek_IndexLearnPage( demux_t *p_demux, logical_stream_t *p_stream,
+                             ogg_page *p_page )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if ( p_stream->i_secondary_header_packets > 0 ) return;
+
+    int64_t i_granule = ogg_page_granulepos( p_page );
+    if ( i_granule < 0 ) return;
+
+    int64_t i_timestamp = Oggseek_GranuleToAbsTimestamp( p_stream, i_granule, false );
+    if ( i_timestamp < 1 ||
+         llabs( i_timestamp - p_stream->i_idx_learnt ) < OGGSEEK_INDEX_INTERVAL )
+        return;
+
+    /* The sync buffer always holds contiguous data ending at the current
+     * stream position, with the page just before its unconsumed part */
+    int64_t i_pagepos = stream_Tell( p_demux->s )
+                      - ( p_sys->oy.fill - p_sys->oy.returned )
+                      - p_page->header_len - p_page->body_len;
+
+    OggSeekIndexAddPage( p_stream, i_timestamp, i_pagepos );
+    p_stream->i_idx_learnt = i_timestamp;
+}
+
+/* Lower bound is the last entry reaching at most i_timestamp, upper bound
+   the first page entry past it. With b_keyframe, the lower bound is meant to
+   be played from: only entries decoding can start from, and no more than
+   OGGSEEK_INDEX_INTERVAL before i_timestamp, are used. */
 static bool OggSeekIndexFind ( logical_stream_t *p_stream, int64_t i_timestamp,
+                               bool b_keyframe,
                                int64_t *pi_pos_lower, int64_t *pi_pos_upper )
 {
-    demux_index_entry_t *idx = p_stream->idx;
+    const demux_index_entry_t *lower = NULL;
+    const demux_index_entry_t *upper = NULL;
 
-    while ( idx != NULL )
+    for ( const demux_index_entry_t *idx = p_stream->idx; idx; idx = idx->p_next )
     {
         if ( idx->i_value <= i_timestamp )
         {
-            if ( !idx->p_next ) /* found on last index */
+            if ( idx->b_keyframe || !b_keyframe )
             {
-                *pi_pos_lower = idx->i_pagepos;
-                return true;
-            }
-            if ( idx->p_next->i_value > i_timestamp )
-            {
-                *pi_pos_lower = idx->i_pagepos;
-                *pi_pos_upper = idx->p_next->i_pagepos;
-                return true;
+                lower = idx;
+                upper = NULL;
             }
         }
-        idx = idx->p_next;
+        else if ( idx->b_page && upper == NULL )
+        {
+            upper = idx;
+        }
     }
 
-    return false;
+    if ( upper )
+        *pi_pos_upper = upper->i_pagepos;
+    if ( !lower || ( b_keyframe &&
+                     i_timestamp - lower->i_value > OGGSEEK_INDEX_INTERVAL ) )
+        return false;
+
+    *pi_pos_lower = lower->i_pagepos;
+    return true;
 }
 
 /*********************************************************************
@@ -909,6 +981,7 @@ static int64_t OggBisectSearchByTime( demux_t *p_demux, logical_stream_t *p_stre
         if ( current.i_pos != -1 && current.i_granule != -1 )
         {
             /* found a page */
+            OggSeekIndexAddPage( p_stream, current.i_timestamp, current.i_pos );
 
             if ( current.i_timestamp <= i_targettime )
             {
@@ -937,7 +1010,32 @@ static int64_t OggBisectSearchByTime( demux_t *p_demux, logical_stream_t *p_stre
         i_segsize = ( i_end_pos - i_start_pos + 1 ) >> 1;
         i_start_pos += i_segsize;
 
-    } while ( i_segsize > 64 );
+    } while ( i_segsize > OGGSEEK_BYTES_TO_READ / 2 );
+
+    /* The remaining window fits in a single read: walk its pages in order
+     * instead of re-syncing on every further bisection step */
+    i_start_pos = __MAX( i_start_pos - i_segsize, bestlower.i_pos );
+    while ( i_start_pos < i_end_pos )
+    {
+        current.i_pos = find_first_page_granule( p_demux,
+                                                 i_start_pos, i_end_pos,
+                                                 p_stream,
+                                                 &current.i_granule );
+        if ( current.i_pos == -1 || current.i_granule == -1 )
+            break;
+
+        current.i_timestamp = Oggseek_GranuleToAbsTimestamp( p_stream,
+                                                             current.i_granule, false );
+        if ( current.i_timestamp == -1 || current.i_timestamp > i_targettime )
+            break;
+
+        if ( current.i_timestamp > bestlower.i_timestamp )
+            bestlower = current;
+
+        /* -> start of next page */
+        i_start_pos = p_sys->i_input_position + p_sys->current_page.header_len
+                                              + p_sys->current_page.body_len;
+    }
 
     if ( bestlower.i_granule == -1 ) return -1;
 
@@ -989,7 +1087,7 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
     if ( i_lowerpos != -1 ) b_found = true;
 
     /* And also search in our own index */
-    if ( !b_found && OggSeekIndexFind( p_stream, i_time, &i_lowerpos, &i_upperpos ) )
+    if ( !b_found && OggSeekIndexFind( p_stream, i_time, true, &i_lowerpos, &i_upperpos ) )
     {
         b_found = true;
     }
@@ -1007,9 +1105,16 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
     /* or search */
     if ( !b_found && b_fastseek )
     {
+        /* pages learnt so far still narrow the search */
+        int64_t i_searchlower = p_stream->i_data_start;
+        int64_t i_searchupper = p_sys->i_total_length;
+        OggSeekIndexFind( p_stream, i_time, false, &i_searchlower, &i_searchupper );
+
         i_lowerpos = OggBisectSearchByTime( p_demux, p_stream, i_time,
-                                            p_stream->i_data_start, p_sys->i_total_length );
+                                            i_searchlower, i_searchupper );
         b_found = ( i_lowerpos != -1 );
+        if ( b_found )
+            OggSeek_IndexAdd( p_stream, i_time, i_lowerpos );
     }
 
     if ( !b_found ) return -1;
@@ -1086,7 +1191,7 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
     OggDebug( msg_Dbg( p_demux, "Search bounds set to %"PRId64" %"PRId64" using skeleton index", i_offset_lower, i_offset_upper ) );
 
     OggNoDebug(
-        OggSeekIndexFind( p_stream, i_time, &i_offset_lower, &i_offset_upper )
+        OggSeekIndexFind( p_stream, i_time, false, &i_offset_lower, &i_offset_upper )
     );
 
     i_offset_lower = __MAX( i_offset_lower, p_stream->i_data_start );
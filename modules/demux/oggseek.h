@@ -30,6 +30,9 @@
 
 #define OGGSEEK_BYTES_TO_READ 8500
 
+/* minimum distance between two index entries learnt from pages */
+#define OGGSEEK_INDEX_INTERVAL ( 2 * CLOCK_FREQ )
+
 /* index entries are structured as follows:
  *   - for theora, highest granulepos -> pagepos (bytes) where keyframe begins
  *  - for dirac, kframe (sync point) -> pagepos of sequence start (?)
@@ -47,6 +50,12 @@ struct oggseek_index_entry
 
     /* not used for theora because the granulepos tells us this */
     int64_t i_pagepos_end;
+
+    /* decoding can start at i_pagepos (usable as a blind seek point) */
+    bool b_keyframe;
+    /* i_value is the timestamp of the page at i_pagepos (usable as an
+     * upper search bound) */
+    bool b_page;
 };
 
 int64_t Ogg_GetKeyframeGranule ( logical_stream_t *p_stream, int64_t i_granule );
@@ -59,6 +68,7 @@ int     Oggseek_BlindSeektoAbsoluteTime ( demux_t *, logical_stream_t *, int64_t
 int     Oggseek_BlindSeektoPosition ( demux_t *, logical_stream_t *, double f, bool );
 int     Oggseek_SeektoAbsolutetime ( demux_t *, logical_stream_t *, int64_t i_granulepos );
 const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *, int64_t, int64_t );
+void    Oggseek_IndexLearnPage ( demux_t *, logical_stream_t *, ogg_page * );
 void    Oggseek_ProbeEnd( demux_t * );
 
 const demux_index_entry_t *oggseek_theora_index_entry_add ( logical_stream_t *,
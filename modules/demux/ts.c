@@ -404,6 +404,7 @@ static inline int PIDGet( block_t *p )
 static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static int ReadTSBatch( demux_t *p_demux, block_t **pp_pkt, int i_max );
 static mtime_t GetPCR( block_t *p_pkt );
 static int SeekToPCR( demux_t *p_demux, int64_t i_pos );
 static int Seek( demux_t *p_demux, double f_percent );
@@ -1068,12 +1069,34 @@ static int Demux( demux_t *p_demux )
     demux_sys_t *p_sys = p_demux->p_sys;
     bool b_wait_es = p_sys->i_pmt_es <= 0;
 
+    /* With CSA, packets are read and descrambled in batches */
+    block_t *pp_batch[CSA_BATCH];
+    int i_batch = 0, i_batch_count = 0;
+    bool b_done = false;
+
     /* We read at most 100 TS packet or until a frame is completed */
     for( int i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
         block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        if( i_batch < i_batch_count )
+        {
+            p_pkt = pp_batch[i_batch++];
+        }
+        else if( b_done )
+        {
+            break;
+        }
+        else if( p_sys->csa && !p_sys->b_udp_out )
+        {
+            i_batch_count = ReadTSBatch( p_demux, pp_batch,
+                                         __MIN( p_sys->i_ts_read - i_pkt, CSA_BATCH ) );
+            if( i_batch_count <= 0 )
+                return 0;
+            p_pkt = pp_batch[0];
+            i_batch = 1;
+        }
+        else if( !(p_pkt = ReadTSPacket( p_demux )) )
         {
             return 0;
         }
@@ -1144,7 +1167,10 @@ static int Demux( demux_t *p_demux )
         }
         p_pid->b_seen = true;
 
+        /* the rest of the batch is demuxed first */
         if( b_frame || ( b_wait_es && p_sys->i_pmt_es > 0 ) )
+            b_done = true;
+        if( b_done && i_batch >= i_batch_count )
             break;
     }
 
@@ -2075,6 +2101,36 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+/* Reads up to i_max packets, and descrambles the elementary stream ones
+ * together. GatherData() still descrambles packets of PIDs that become valid
+ * while the batch is demuxed. */
+static int ReadTSBatch( demux_t *p_demux, block_t **pp_pkt, int i_max )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t     *pp_buffer[CSA_BATCH];
+    int          i_count, i_scrambled = 0;
+
+    for( i_count = 0; i_count < i_max; i_count++ )
+    {
+        block_t *p_pkt = ReadTSPacket( p_demux );
+        if( !p_pkt )
+            break;
+        pp_pkt[i_count] = p_pkt;
+
+        const ts_pid_t *pid = &p_sys->pid[PIDGet( p_pkt )];
+        if( pid->b_valid && !pid->psi )
+            pp_buffer[i_scrambled++] = p_pkt->p_buffer;
+    }
+
+    if( i_scrambled > 0 )
+    {
+        vlc_mutex_lock( &p_sys->csa_lock );
+        csa_DecryptBatch( p_sys->csa, pp_buffer, i_scrambled, p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_sys->csa_lock );
+    }
+    return i_count;
+}
+
 static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
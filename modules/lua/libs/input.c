@@ -191,6 +191,9 @@ static int vlclua_input_item_stats( lua_State *L )
         STATS_FLOAT( average_demux_bitrate )
         STATS_INT( demux_corrupted )
         STATS_INT( demux_discontinuity )
+        STATS_INT( stream_cache_size )
+        STATS_INT( stream_read_size )
+        STATS_INT( stream_seeks )
         STATS_INT( decoded_audio )
         STATS_INT( decoded_video )
         STATS_INT( displayed_pictures )
@@ -200,6 +203,16 @@ static int vlclua_input_item_stats( lua_State *L )
         STATS_FLOAT( send_bitrate )
         STATS_INT( played_abuffers )
         STATS_INT( lost_abuffers )
+        STATS_INT( packets_lost )
+        STATS_INT( packets_late )
+        STATS_INT( packets_reordered )
+        STATS_INT( packets_duplicate )
+        STATS_INT( read_stalls )
+        STATS_INT( read_stall_time )
+        STATS_INT( cache_hits )
+        STATS_INT( cache_hit_bytes )
+        STATS_INT( connection_reuses )
+        STATS_INT( reconnections )
 #undef STATS_INT
 #undef STATS_FLOAT
         vlc_mutex_unlock( &p_item->p_stats->lock );
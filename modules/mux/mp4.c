@@ -49,6 +49,14 @@
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
 
+#define FRAGMENT_TEXT N_("Fragment duration (ms)")
+#define FRAGMENT_LONGTEXT N_(\
+    "Write a fragmented file, with a movie fragment about every given " \
+    "number of milliseconds, starting on a video key frame. Fragmented " \
+    "files are written in one pass with a constant amount of memory, and " \
+    "can be streamed. 0 writes a regular file, unless the mp4frag muxer " \
+    "is used.")
+
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
 
@@ -63,8 +71,10 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer(SOUT_CFG_PREFIX "fragment", 0,
+                FRAGMENT_TEXT, FRAGMENT_LONGTEXT, true)
     set_capability("sout mux", 5)
-    add_shortcut("mp4", "mov", "3gp")
+    add_shortcut("mp4", "mov", "3gp", "mp4frag")
     set_callbacks(Open, Close)
 vlc_module_end ()
 
@@ -72,9 +82,12 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "fragment", NULL
 };
 
+/* Fragment duration of the mp4frag muxer (ms) */
+#define FRAGMENT_DEFAULT 2000
+
 static int Control(sout_mux_t *, int, va_list);
 static int AddStream(sout_mux_t *, sout_input_t *);
 static int DelStream(sout_mux_t *, sout_input_t *);
@@ -94,6 +107,14 @@ typedef struct
 
 } mp4_entry_t;
 
+/* Random access point of a fragmented track, for the mfra */
+typedef struct
+{
+    uint64_t i_time;
+    uint64_t i_moof_pos;
+    uint8_t  i_traf;
+} mp4_tfra_t;
+
 typedef struct
 {
     es_format_t   fmt;
@@ -108,6 +129,7 @@ typedef struct
     /* stats */
     int64_t      i_dts_start;
     int64_t      i_duration;
+    bool         b_started;
 
     /* for later stco fix-up (fast start files) */
     uint64_t i_stco_pos;
@@ -116,6 +138,14 @@ typedef struct
     /* for spu */
     int64_t i_last_dts;
 
+    /* fragmented output */
+    block_t      *p_frag;         /* samples of the current fragment */
+    block_t      **pp_frag_last;
+    int64_t      i_decode_time;   /* of the next fragment, since start */
+    int          i_trun_pos;      /* data offset of the trun in the moof */
+    unsigned int i_tfra_count;
+    mp4_tfra_t   *p_tfra;
+
 } mp4_stream_t;
 
 struct sout_mux_sys_t
@@ -132,6 +162,13 @@ struct sout_mux_sys_t
 
     int          i_nb_streams;
     mp4_stream_t **pp_streams;
+
+    /* fragmented output */
+    mtime_t      i_fragment;      /* fragment duration, 0 if not fragmented */
+    bool         b_moov_sent;
+    mtime_t      i_frag_dts;      /* first dts of the current fragment */
+    uint32_t     i_frag_seq;
+    mp4_stream_t *p_ref_stream;   /* fragments start on its key frames */
 };
 
 typedef struct bo_t
@@ -161,6 +198,10 @@ static void box_send(sout_mux_t *p_mux,  bo_t *box);
 
 static bo_t *GetMoovBox(sout_mux_t *p_mux);
 
+static void WriteSample(sout_mux_t *, mp4_stream_t *, block_t *);
+static void WriteFragment(sout_mux_t *, bool);
+static bo_t *GetMfraBox(sout_mux_t *);
+
 static block_t *ConvertSUBT(block_t *);
 static block_t *ConvertAVC1(block_t *);
 
@@ -193,6 +234,19 @@ static int Open(vlc_object_t *p_this)
     p_sys->b_3gp        = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "3gp");
     p_sys->i_dts_start  = 0;
 
+    p_sys->i_fragment   = var_GetInteger(p_mux, SOUT_CFG_PREFIX "fragment");
+    if (p_sys->i_fragment <= 0 && p_mux->psz_mux &&
+        !strcmp(p_mux->psz_mux, "mp4frag"))
+        p_sys->i_fragment = FRAGMENT_DEFAULT;
+    if (p_sys->i_fragment > 0 && p_sys->b_mov) {
+        msg_Warn(p_mux, "fragments are not supported in mov files");
+        p_sys->i_fragment = 0;
+    }
+    p_sys->i_fragment   = __MAX(p_sys->i_fragment, 0) * 1000;
+    p_sys->b_moov_sent  = false;
+    p_sys->i_frag_dts   = VLC_TS_INVALID;
+    p_sys->i_frag_seq   = 0;
+    p_sys->p_ref_stream = NULL;
 
     if (!p_sys->b_mov) {
         /* Now add ftyp header */
@@ -204,15 +258,23 @@ static int Open(vlc_object_t *p_this)
         bo_add_32be  (box, 0);
         if (p_sys->b_3gp)
             bo_add_fourcc(box, "3gp4");
-        else
+        else if (p_sys->i_fragment > 0) {
+            bo_add_fourcc(box, "isom");
+            bo_add_fourcc(box, "iso6");
+            bo_add_fourcc(box, "dash");
+        } else
             bo_add_fourcc(box, "mp41");
         bo_add_fourcc(box, "avc1");
-        bo_add_fourcc(box, "qt  ");
+        if (p_sys->i_fragment <= 0)
+            bo_add_fourcc(box, "qt  ");
         box_fix(box);
 
         p_sys->i_pos += box->len;
         p_sys->i_mdat_pos = p_sys->i_pos;
 
+        /* with the moov, the initialization segment of the stream */
+        if (p_sys->i_fragment > 0)
+            box->b->i_flags |= BLOCK_FLAG_HEADER;
         box_send(p_mux, box);
     }
 
@@ -220,6 +282,13 @@ static int Open(vlc_object_t *p_this)
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
 
+    /* The fragments carry their own mdat, after the moov */
+    if (p_sys->i_fragment > 0) {
+        msg_Dbg(p_mux, "writing %"PRId64" ms fragments",
+                p_sys->i_fragment / 1000);
+        return VLC_SUCCESS;
+    }
+
     /* Now add mdat header */
     box = box_new("mdat");
     bo_add_64be  (box, 0); // enough to store an extended size
@@ -241,6 +310,15 @@ static void Close(vlc_object_t *p_this)
 
     msg_Dbg(p_mux, "Close");
 
+    if (p_sys->i_fragment > 0) {
+        /* Last fragment, and the index of all of them */
+        if (p_sys->b_moov_sent) {
+            WriteFragment(p_mux, true);
+            box_send(p_mux, GetMfraBox(p_mux));
+        }
+        goto cleanup;
+    }
+
     /* Update mdat size */
     bo_t bo;
     bo_init(&bo);
@@ -323,11 +401,14 @@ static void Close(vlc_object_t *p_this)
     sout_AccessOutSeek(p_mux->p_access, i_moov_pos);
     box_send(p_mux, moov);
 
+cleanup:
     /* Clean-up */
     for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
 
         es_format_Clean(&p_stream->fmt);
+        block_ChainRelease(p_stream->p_frag);
+        free(p_stream->p_tfra);
         free(p_stream->entry);
         free(p_stream);
     }
@@ -341,8 +422,8 @@ static void Close(vlc_object_t *p_this)
  *****************************************************************************/
 static int Control(sout_mux_t *p_mux, int i_query, va_list args)
 {
-    VLC_UNUSED(p_mux);
     bool *pb_bool;
+    char **ppsz;
 
     switch(i_query)
     {
@@ -356,7 +437,13 @@ static int Control(sout_mux_t *p_mux, int i_query, va_list args)
         *pb_bool = true;
         return VLC_SUCCESS;
 
-    case MUX_GET_MIME:   /* Not needed, as not streamable */
+    case MUX_GET_MIME:   /* Only fragmented files are streamable */
+        if (p_mux->p_sys->i_fragment <= 0)
+            return VLC_EGENERIC;
+        ppsz = (char**)va_arg(args, char **);
+        *ppsz = strdup("video/mp4");
+        return VLC_SUCCESS;
+
     default:
         return VLC_EGENERIC;
     }
@@ -409,6 +496,12 @@ static int AddStream(sout_mux_t *p_mux, sout_input_t *p_input)
         calloc(p_stream->i_entry_max, sizeof(mp4_entry_t));
     p_stream->i_dts_start   = 0;
     p_stream->i_duration    = 0;
+    p_stream->b_started     = false;
+    p_stream->p_frag        = NULL;
+    p_stream->pp_frag_last  = &p_stream->p_frag;
+    p_stream->i_decode_time = 0;
+    p_stream->i_tfra_count  = 0;
+    p_stream->p_tfra        = NULL;
 
     p_input->p_sys          = p_stream;
 
@@ -440,6 +533,23 @@ static int Mux(sout_mux_t *p_mux)
         if (i_stream < 0)
             return(VLC_SUCCESS);
 
+        if (p_sys->i_fragment > 0 && !p_sys->b_moov_sent) {
+            /* Fragments start on the key frames of the first video track */
+            p_sys->p_ref_stream = p_sys->pp_streams[0];
+            for (int i = 0; i < p_sys->i_nb_streams; i++)
+                if (p_sys->pp_streams[i]->fmt.i_cat == VIDEO_ES) {
+                    p_sys->p_ref_stream = p_sys->pp_streams[i];
+                    break;
+                }
+
+            /* The sample tables are empty, the samples are in fragments */
+            bo_t *moov = GetMoovBox(p_mux);
+            p_sys->i_pos += moov->len;
+            moov->b->i_flags |= BLOCK_FLAG_HEADER;
+            box_send(p_mux, moov);
+            p_sys->b_moov_sent = true;
+        }
+
         sout_input_t *p_input  = p_mux->pp_inputs[i_stream];
         mp4_stream_t *p_stream = (mp4_stream_t*)p_input->p_sys;
 
@@ -474,12 +584,36 @@ static int Mux(sout_mux_t *p_mux)
         }
 
         /* Save starting time */
-        if (p_stream->i_entry_count == 0) {
+        if (!p_stream->b_started) {
             p_stream->i_dts_start = p_data->i_dts;
+            p_stream->b_started = true;
 
-            /* Update global dts_start */
-            if (p_sys->i_dts_start <= 0 || p_stream->i_dts_start < p_sys->i_dts_start)
+            /* Update global dts_start. The decode times of the fragments
+             * already written depend on it, so it is fixed by the first
+             * sample in fragmented mode */
+            if (p_sys->i_dts_start <= 0 ||
+                (p_sys->i_fragment <= 0 && p_stream->i_dts_start < p_sys->i_dts_start))
                 p_sys->i_dts_start = p_stream->i_dts_start;
+
+            /* Tracks starting late begin with a later decode time */
+            p_stream->i_decode_time = __MAX(p_stream->i_dts_start - p_sys->i_dts_start, 0);
+        }
+
+        if (p_sys->i_fragment > 0) {
+            if (p_sys->i_frag_dts == VLC_TS_INVALID)
+                p_sys->i_frag_dts = p_data->i_dts;
+            else if (p_data->i_dts - p_sys->i_frag_dts >= p_sys->i_fragment) {
+                mtime_t i_elapsed = p_data->i_dts - p_sys->i_frag_dts;
+                mp4_stream_t *p_ref = p_sys->p_ref_stream;
+
+                /* Wait for a key frame, but not forever */
+                if (p_ref->fmt.i_cat != VIDEO_ES ||
+                    (p_stream == p_ref && (p_data->i_flags & BLOCK_FLAG_TYPE_I)) ||
+                    i_elapsed >= 4 * p_sys->i_fragment) {
+                    WriteFragment(p_mux, false);
+                    p_sys->i_frag_dts = p_data->i_dts;
+                }
+            }
         }
 
         if (p_stream->fmt.i_cat == SPU_ES && p_stream->i_entry_count > 0) {
@@ -513,13 +647,12 @@ static int Mux(sout_mux_t *p_mux)
 
         /* update */
         p_stream->i_duration = p_stream->i_last_dts - p_stream->i_dts_start + p_data->i_length;
-        p_sys->i_pos += p_data->i_buffer;
 
         /* Save the DTS */
         p_stream->i_last_dts = p_data->i_dts;
 
         /* write data */
-        sout_AccessOutWrite(p_mux->p_access, p_data);
+        WriteSample(p_mux, p_stream, p_data);
 
         if (p_stream->fmt.i_cat == SPU_ES) {
             int64_t i_length = p_stream->entry[p_stream->i_entry_count-1].i_length;
@@ -548,9 +681,7 @@ static int Mux(sout_mux_t *p_mux)
                 p_data->p_buffer[1] = 1;
                 p_data->p_buffer[2] = ' ';
 
-                p_sys->i_pos += p_data->i_buffer;
-
-                sout_AccessOutWrite(p_mux->p_access, p_data);
+                WriteSample(p_mux, p_stream, p_data);
             }
 
             /* Fix duration */
@@ -561,6 +692,204 @@ static int Mux(sout_mux_t *p_mux)
     return(VLC_SUCCESS);
 }
 
+/*****************************************************************************
+ * WriteSample: write a sample, or hold it until its fragment is complete
+ *****************************************************************************/
+static void WriteSample(sout_mux_t *p_mux, mp4_stream_t *p_stream,
+                        block_t *p_data)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if (p_sys->i_fragment > 0) {
+        block_ChainLastAppend(&p_stream->pp_frag_last, p_data);
+        return;
+    }
+
+    p_sys->i_pos += p_data->i_buffer;
+    sout_AccessOutWrite(p_mux->p_access, p_data);
+}
+
+static uint32_t GetTimescale(mp4_stream_t *p_stream)
+{
+    if (p_stream->fmt.i_cat == AUDIO_ES)
+        return p_stream->fmt.audio.i_rate;
+    return CLOCK_FREQ;
+}
+
+/* Number of samples of the stream going in the fragment. The last subtitle
+ * lasts until the next one, so it waits for the next fragment unless it is
+ * the last fragment. */
+static unsigned FragmentEntries(mp4_stream_t *p_stream, bool b_flush)
+{
+    if (!b_flush && p_stream->fmt.i_cat == SPU_ES && p_stream->i_entry_count > 0 &&
+        p_stream->entry[p_stream->i_entry_count - 1].i_length <= 0)
+        return p_stream->i_entry_count - 1;
+    return p_stream->i_entry_count;
+}
+
+/*****************************************************************************
+ * WriteFragment: write the held samples as sidx + moof + mdat
+ *****************************************************************************/
+static void WriteFragment(sout_mux_t *p_mux, bool b_flush)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    mp4_stream_t   *p_ref = p_sys->p_ref_stream;
+    uint64_t        i_mdat_size = 8;
+    int64_t         i_ref_start = p_ref->i_decode_time;
+    bool            b_ref_sync  = true;
+
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        unsigned i_count = FragmentEntries(p_stream, b_flush);
+
+        for (unsigned i = 0; i < i_count; i++)
+            i_mdat_size += p_stream->entry[i].i_size;
+    }
+    if (i_mdat_size == 8)
+        return;
+
+    bo_t *moof = box_new("moof");
+    bo_t *mfhd = box_full_new("mfhd", 0, 0);
+    bo_add_32be(mfhd, ++p_sys->i_frag_seq); // sequence number
+    box_gather(moof, mfhd);
+
+    uint8_t i_traf = 0;
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        uint32_t i_timescale = GetTimescale(p_stream);
+        int64_t  i_dts = p_stream->i_decode_time;
+        unsigned i_count = FragmentEntries(p_stream, b_flush);
+
+        if (i_count == 0)
+            continue;
+
+        bo_t *traf = box_new("traf");
+
+        /* data offsets are relative to the moof */
+        bo_t *tfhd = box_full_new("tfhd", 0, 0x020000);
+        bo_add_32be(tfhd, p_stream->i_track_id);
+        box_gather(traf, tfhd);
+
+        bo_t *tfdt = box_full_new("tfdt", 1, 0);
+        bo_add_64be(tfdt, i_dts * i_timescale / CLOCK_FREQ);
+        box_gather(traf, tfdt);
+
+        /* data-offset, sample duration, size, flags and cts offset */
+        bool b_first_sync = true;
+        bo_t *trun = box_full_new("trun", 0, 0x000f01);
+        bo_add_32be(trun, i_count);
+        bo_add_32be(trun, 0);     // data-offset (fixed later)
+        for (unsigned i = 0; i < i_count; i++) {
+            mp4_entry_t *e = &p_stream->entry[i];
+            int64_t i_next = i_dts + e->i_length;
+            bool b_sync = p_stream->fmt.i_cat != VIDEO_ES ||
+                          (e->i_flags & BLOCK_FLAG_TYPE_I);
+
+            if (i == 0)
+                b_first_sync = b_sync;
+
+            bo_add_32be(trun, i_next * i_timescale / CLOCK_FREQ -
+                              i_dts * i_timescale / CLOCK_FREQ);
+            bo_add_32be(trun, e->i_size);
+            bo_add_32be(trun, b_sync ? 0x02000000 : 0x01010000);
+            bo_add_32be(trun, e->i_pts_dts * i_timescale / CLOCK_FREQ);
+            i_dts = i_next;
+        }
+        p_stream->i_trun_pos = moof->len + traf->len + 16;
+        box_gather(traf, trun);
+
+        box_gather(moof, traf);
+        i_traf++;
+
+        if (p_stream == p_ref)
+            b_ref_sync = b_first_sync;
+
+        /* random access point for the mfra, its offset is set below */
+        if (b_first_sync) {
+            p_stream->p_tfra = xrealloc(p_stream->p_tfra,
+                        (p_stream->i_tfra_count + 1) * sizeof(mp4_tfra_t));
+            mp4_tfra_t *p_tfra = &p_stream->p_tfra[p_stream->i_tfra_count++];
+            p_tfra->i_time = p_stream->i_decode_time * i_timescale / CLOCK_FREQ;
+            p_tfra->i_moof_pos = 0;
+            p_tfra->i_traf = i_traf;
+        }
+
+        p_stream->i_decode_time = i_dts;
+    }
+    box_fix(moof);
+
+    /* Now that the moof size is known, point each trun to its samples */
+    uint64_t i_data_offset = moof->len + 8;
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        unsigned i_count = FragmentEntries(p_stream, b_flush);
+
+        if (i_count == 0)
+            continue;
+        bo_fix_32be(moof, p_stream->i_trun_pos, i_data_offset);
+        for (unsigned i = 0; i < i_count; i++)
+            i_data_offset += p_stream->entry[i].i_size;
+    }
+
+    /* Segment index of this fragment, for players and segmenters */
+    uint32_t i_timescale = GetTimescale(p_ref);
+    bo_t *sidx = box_full_new("sidx", 1, 0);
+    bo_add_32be(sidx, p_ref->i_track_id);   // reference ID
+    bo_add_32be(sidx, i_timescale);
+    bo_add_64be(sidx, i_ref_start * i_timescale / CLOCK_FREQ);
+    bo_add_64be(sidx, 0);                   // first offset
+    bo_add_16be(sidx, 0);                   // reserved
+    bo_add_16be(sidx, 1);                   // reference count
+    bo_add_32be(sidx, moof->len + i_mdat_size);
+    bo_add_32be(sidx, p_ref->i_decode_time * i_timescale / CLOCK_FREQ -
+                      i_ref_start * i_timescale / CLOCK_FREQ);
+    bo_add_32be(sidx, b_ref_sync ? 0x90000000 : 0); // starts with SAP 1
+    box_fix(sidx);
+
+    uint64_t i_moof_pos = p_sys->i_pos + sidx->len;
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        if (p_stream->i_tfra_count > 0 &&
+            p_stream->p_tfra[p_stream->i_tfra_count - 1].i_moof_pos == 0)
+            p_stream->p_tfra[p_stream->i_tfra_count - 1].i_moof_pos = i_moof_pos;
+    }
+    p_sys->i_pos += sidx->len + moof->len + i_mdat_size;
+
+    sidx->b->i_dts = p_sys->i_frag_dts;
+    box_send(p_mux, sidx);
+    box_send(p_mux, moof);
+
+    bo_t *mdat = box_new("mdat");
+    bo_fix_32be(mdat, 0, i_mdat_size);
+    box_send(p_mux, mdat);
+
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        unsigned i_count = FragmentEntries(p_stream, b_flush);
+        block_t *p_held = NULL;
+
+        /* One block per entry: keep the held ones for the next fragment */
+        if (i_count < p_stream->i_entry_count) {
+            block_t **pp_held = &p_stream->p_frag;
+            for (unsigned i = 0; i < i_count; i++)
+                pp_held = &(*pp_held)->p_next;
+            p_held  = *pp_held;
+            *pp_held = NULL;
+            memmove(p_stream->entry, &p_stream->entry[i_count],
+                    (p_stream->i_entry_count - i_count) * sizeof(mp4_entry_t));
+        }
+
+        if (p_stream->p_frag)
+            sout_AccessOutWrite(p_mux->p_access, p_stream->p_frag);
+        p_stream->p_frag        = NULL;
+        p_stream->pp_frag_last  = &p_stream->p_frag;
+        p_stream->i_entry_count -= i_count;
+        if (p_held)
+            block_ChainLastAppend(&p_stream->pp_frag_last, p_held);
+    }
+}
+
 /*****************************************************************************
  *
  *****************************************************************************/
@@ -1222,6 +1551,55 @@ static bo_t *GetStblBox(sout_mux_t *p_mux, mp4_stream_t *p_stream)
 
 static int64_t get_timestamp(void);
 
+static bo_t *GetMvexBox(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    bo_t *mvex = box_new("mvex");
+
+    /* No defaults, every trun carries its sample properties */
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        bo_t *trex = box_full_new("trex", 0, 0);
+        bo_add_32be(trex, p_sys->pp_streams[i_trak]->i_track_id);
+        bo_add_32be(trex, 1);     // default sample description index
+        bo_add_32be(trex, 0);     // default sample duration
+        bo_add_32be(trex, 0);     // default sample size
+        bo_add_32be(trex, 0);     // default sample flags
+        box_gather(mvex, trex);
+    }
+
+    return mvex;
+}
+
+static bo_t *GetMfraBox(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    bo_t *mfra = box_new("mfra");
+
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        bo_t *tfra = box_full_new("tfra", 1, 0);
+        bo_add_32be(tfra, p_stream->i_track_id);
+        bo_add_32be(tfra, 0);     // 8 bit traf, trun and sample numbers
+        bo_add_32be(tfra, p_stream->i_tfra_count);
+        for (unsigned i = 0; i < p_stream->i_tfra_count; i++) {
+            bo_add_64be(tfra, p_stream->p_tfra[i].i_time);
+            bo_add_64be(tfra, p_stream->p_tfra[i].i_moof_pos);
+            bo_add_8   (tfra, p_stream->p_tfra[i].i_traf);
+            bo_add_8   (tfra, 1); // trun number
+            bo_add_8   (tfra, 1); // sample number
+        }
+        box_gather(mfra, tfra);
+    }
+
+    bo_t *mfro = box_full_new("mfro", 0, 0);
+    bo_add_32be(mfro, mfra->len + 16);
+    box_gather(mfra, mfro);
+    box_fix(mfra);
+
+    return mfra;
+}
+
 static const uint32_t mvhd_matrix[9] =
     { 0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000 };
 
@@ -1541,6 +1919,10 @@ static bo_t *GetMoovBox(sout_mux_t *p_mux)
         box_gather(moov, trak);
     }
 
+    /* Fragmented files announce their movie fragments */
+    if (p_sys->i_fragment > 0)
+        box_gather(moov, GetMvexBox(p_mux));
+
     /* Add user data tags */
     box_gather(moov, GetUdtaTag(p_mux));
 
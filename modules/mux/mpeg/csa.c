@@ -47,8 +47,18 @@ struct csa_t
     int     p, q, r;
 
     bool    use_odd;
+
+    /* batch scratch: key stream and cypher blocks of each packet, the
+     * blocks being packed in little endian words */
+    uint8_t  stream[CSA_BATCH][184];
+    uint64_t ib[CSA_BATCH][184/8+1];
+    uint64_t bd[CSA_BATCH*(184/8)];
 };
 
+/* Below this many packets sharing a key, the batch functions fall back to
+ * the per packet code */
+#define CSA_BATCH_MIN 4
+
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
 
 static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb );
@@ -56,6 +66,11 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
 
+static void csa_BsStream( const uint8_t ck[8], const uint64_t *p_sb,
+                          int i_lanes, int i_steps, uint8_t stream[][184] );
+static void csa_BsBlockDecypher( const uint8_t kk[57], uint64_t *bd, int n );
+static void csa_BsBlockCypher( const uint8_t kk[57], uint64_t *bd, int n );
+
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
@@ -307,6 +322,243 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
 }
 
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************/
+static void csa_DecryptLanes( csa_t *c, uint8_t *ck, uint8_t *kk,
+                              uint8_t **pp_pkt, int i_count, int i_pkt_size )
+{
+    uint64_t sb[CSA_BATCH];
+    int      pi_hdr[CSA_BATCH];
+    int      i_lanes = 0, i_steps = 0, i_blocks = 0;
+
+    if( i_count < CSA_BATCH_MIN )
+    {
+        for( int i = 0; i < i_count; i++ )
+            csa_Decrypt( c, pp_pkt[i], i_pkt_size );
+        return;
+    }
+
+    for( int i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkt[i];
+
+        /* clear transport scrambling control */
+        pkt[3] &= 0x3f;
+
+        int i_hdr = 4;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+
+        const int n = (i_pkt_size - i_hdr) / 8;
+        const int i_residue = (i_pkt_size - i_hdr) % 8;
+        if( 188 - i_hdr < 8 || n < 0 )
+            continue;
+
+        const int i_pkt_steps = (n > 0 ? n - 1 : 0) + (i_residue > 0);
+        if( i_pkt_steps > i_steps )
+            i_steps = i_pkt_steps;
+
+        pp_pkt[i_lanes] = pkt;
+        pi_hdr[i_lanes] = i_hdr;
+        sb[i_lanes] = GetQWLE( &pkt[i_hdr] );
+        i_lanes++;
+    }
+    if( i_lanes == 0 )
+        return;
+
+    /* the key stream only depends on the first block */
+    csa_BsStream( ck, sb, i_lanes, i_steps, c->stream );
+
+    /* then every block can be decyphered at once */
+    for( int l = 0; l < i_lanes; l++ )
+    {
+        const uint8_t *pkt = pp_pkt[l];
+        const int i_hdr = pi_hdr[l];
+        const int n = (i_pkt_size - i_hdr) / 8;
+
+        c->ib[l][0] = sb[l];
+        for( int i = 1; i < n; i++ )
+            c->ib[l][i] = GetQWLE( &pkt[i_hdr+8*i] ) ^
+                          GetQWLE( &c->stream[l][8*(i-1)] );
+        c->ib[l][n > 0 ? n : 0] = 0;
+
+        memcpy( &c->bd[i_blocks], c->ib[l], n * sizeof(*c->bd) );
+        i_blocks += n;
+    }
+    csa_BsBlockDecypher( kk, c->bd, i_blocks );
+
+    i_blocks = 0;
+    for( int l = 0; l < i_lanes; l++ )
+    {
+        uint8_t *pkt = pp_pkt[l];
+        const int i_hdr = pi_hdr[l];
+        const int n = (i_pkt_size - i_hdr) / 8;
+        const int i_residue = (i_pkt_size - i_hdr) % 8;
+
+        for( int i = 0; i < n; i++ )
+            SetQWLE( &pkt[i_hdr+8*i], c->ib[l][i+1] ^ c->bd[i_blocks++] );
+
+        if( i_residue > 0 )
+        {
+            const uint8_t *stream = &c->stream[l][8 * (n > 0 ? n - 1 : 0)];
+            for( int j = 0; j < i_residue; j++ )
+                pkt[i_pkt_size - i_residue + j] ^= stream[j];
+        }
+    }
+}
+
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkt, int i_count, int i_pkt_size )
+{
+    uint8_t *pp_odd[CSA_BATCH], *pp_even[CSA_BATCH];
+    int      i_odd = 0, i_even = 0;
+
+    /* packets are sorted by key, each key has its own stream cypher */
+    for( int i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkt[i];
+
+        if( (pkt[3]&0x80) == 0 )
+        {
+            /* not scrambled */
+            continue;
+        }
+        if( pkt[3]&0x40 )
+        {
+            pp_odd[i_odd++] = pkt;
+            if( i_odd == CSA_BATCH )
+            {
+                csa_DecryptLanes( c, c->o_ck, c->o_kk, pp_odd, i_odd, i_pkt_size );
+                i_odd = 0;
+            }
+        }
+        else
+        {
+            pp_even[i_even++] = pkt;
+            if( i_even == CSA_BATCH )
+            {
+                csa_DecryptLanes( c, c->e_ck, c->e_kk, pp_even, i_even, i_pkt_size );
+                i_even = 0;
+            }
+        }
+    }
+    csa_DecryptLanes( c, c->o_ck, c->o_kk, pp_odd, i_odd, i_pkt_size );
+    csa_DecryptLanes( c, c->e_ck, c->e_kk, pp_even, i_even, i_pkt_size );
+}
+
+/*****************************************************************************
+ * csa_EncryptBatch:
+ *****************************************************************************/
+static void csa_EncryptLanes( csa_t *c, uint8_t **pp_pkt, int i_count,
+                              int i_pkt_size )
+{
+    uint8_t *ck = c->use_odd ? c->o_ck : c->e_ck;
+    uint8_t *kk = c->use_odd ? c->o_kk : c->e_kk;
+    uint64_t sb[CSA_BATCH];
+    int      pi_hdr[CSA_BATCH], pi_n[CSA_BATCH];
+    int      i_lanes = 0, i_steps = 0, i_chain = 0;
+
+    for( int i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkt[i];
+
+        /* set transport scrambling control */
+        pkt[3] |= c->use_odd ? 0xc0 : 0x80;
+
+        int i_hdr = 4;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+
+        const int n = (i_pkt_size - i_hdr) / 8;
+        const int i_residue = (i_pkt_size - i_hdr) % 8;
+        if( n <= 0 )
+        {
+            pkt[3] &= 0x3f;
+            continue;
+        }
+
+        const int i_pkt_steps = n - 1 + (i_residue > 0);
+        if( i_pkt_steps > i_steps )
+            i_steps = i_pkt_steps;
+        if( n > i_chain )
+            i_chain = n;
+
+        pp_pkt[i_lanes] = pkt;
+        pi_hdr[i_lanes] = i_hdr;
+        pi_n[i_lanes] = n;
+        c->ib[i_lanes][n] = 0;
+        i_lanes++;
+    }
+    if( i_lanes == 0 )
+        return;
+
+    /* the block cypher chains from the last block of each packet, so the
+     * packets advance in step, one block each */
+    for( int k = 0; k < i_chain; k++ )
+    {
+        int i_blocks = 0;
+
+        for( int l = 0; l < i_lanes; l++ )
+        {
+            const int i = pi_n[l] - 1 - k;
+            if( i >= 0 )
+                c->bd[i_blocks++] = GetQWLE( &pp_pkt[l][pi_hdr[l]+8*i] ) ^
+                                    c->ib[l][i+1];
+        }
+        csa_BsBlockCypher( kk, c->bd, i_blocks );
+
+        i_blocks = 0;
+        for( int l = 0; l < i_lanes; l++ )
+        {
+            const int i = pi_n[l] - 1 - k;
+            if( i >= 0 )
+                c->ib[l][i] = c->bd[i_blocks++];
+        }
+    }
+
+    for( int l = 0; l < i_lanes; l++ )
+        sb[l] = c->ib[l][0];
+    csa_BsStream( ck, sb, i_lanes, i_steps, c->stream );
+
+    for( int l = 0; l < i_lanes; l++ )
+    {
+        uint8_t *pkt = pp_pkt[l];
+        const int i_hdr = pi_hdr[l];
+        const int n = pi_n[l];
+        const int i_residue = (i_pkt_size - i_hdr) % 8;
+
+        SetQWLE( &pkt[i_hdr], c->ib[l][0] );
+        for( int i = 1; i < n; i++ )
+            SetQWLE( &pkt[i_hdr+8*i], c->ib[l][i] ^
+                                      GetQWLE( &c->stream[l][8*(i-1)] ) );
+        if( i_residue > 0 )
+        {
+            const uint8_t *stream = &c->stream[l][8 * (n - 1)];
+            for( int j = 0; j < i_residue; j++ )
+                pkt[i_pkt_size - i_residue + j] ^= stream[j];
+        }
+    }
+}
+
+void csa_EncryptBatch( csa_t *c, uint8_t **pp_pkt, int i_count, int i_pkt_size )
+{
+    if( i_count < CSA_BATCH_MIN )
+    {
+        for( int i = 0; i < i_count; i++ )
+            csa_Encrypt( c, pp_pkt[i], i_pkt_size );
+        return;
+    }
+
+    for( int i = 0; i < i_count; i += CSA_BATCH )
+    {
+        uint8_t *pp_lanes[CSA_BATCH];
+        const int i_lanes = __MIN( i_count - i, CSA_BATCH );
+
+        memcpy( pp_lanes, &pp_pkt[i], i_lanes * sizeof(*pp_lanes) );
+        csa_EncryptLanes( c, pp_lanes, i_lanes, i_pkt_size );
+    }
+}
+
 /*****************************************************************************
  * Divers
  *****************************************************************************/
@@ -494,6 +746,191 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 }
 
 
+/*****************************************************************************
+ * Bitsliced stream cypher
+ *****************************************************************************
+ * Bit l of every word belongs to the l-th packet of the batch, so the nibble
+ * and bit operations of csa_StreamCypher run on CSA_BATCH packets at once.
+ *****************************************************************************/
+typedef uint64_t csa_word_t;
+
+typedef struct
+{
+    csa_word_t A[11][4];
+    csa_word_t B[11][4];
+    csa_word_t X[4], Y[4], Z[4];
+    csa_word_t D[4], E[4], F[4];
+    csa_word_t p, q, r;
+} csa_bs_t;
+
+static inline csa_word_t csa_BsMux( csa_word_t a, csa_word_t b, csa_word_t s )
+{
+    return a ^ ( ( a ^ b ) & s );
+}
+
+#define CSA_BS_LEAF( sbox, b, i ) ( ( (sbox)[i] >> (b) ) & 1 ? ~(csa_word_t)0 : 0 )
+#define CSA_BS_PAIR( sbox, b, i, s ) \
+    csa_BsMux( CSA_BS_LEAF( sbox, b, i ), CSA_BS_LEAF( sbox, b, (i)+1 ), s )
+#define CSA_BS_QUAD( sbox, b, i, s1, s0 ) \
+    csa_BsMux( CSA_BS_PAIR( sbox, b, i, s0 ), CSA_BS_PAIR( sbox, b, (i)+2, s0 ), s1 )
+
+/* out = bit b of sbox[i4 i3 i2 i1 i0] as a multiplexer tree. It is a macro
+ * so that the leaves are always constants and fold away. */
+#define CSA_BS_SBOX( out, sbox, b, i4, i3, i2, i1, i0 ) do { \
+    const csa_word_t u4 = (i4), u3 = (i3), u2 = (i2), u1 = (i1), u0 = (i0); \
+    const csa_word_t t0 = csa_BsMux( CSA_BS_QUAD( sbox, b,  0, u1, u0 ), \
+                                     CSA_BS_QUAD( sbox, b,  4, u1, u0 ), u2 ); \
+    const csa_word_t t1 = csa_BsMux( CSA_BS_QUAD( sbox, b,  8, u1, u0 ), \
+                                     CSA_BS_QUAD( sbox, b, 12, u1, u0 ), u2 ); \
+    const csa_word_t t2 = csa_BsMux( CSA_BS_QUAD( sbox, b, 16, u1, u0 ), \
+                                     CSA_BS_QUAD( sbox, b, 20, u1, u0 ), u2 ); \
+    const csa_word_t t3 = csa_BsMux( CSA_BS_QUAD( sbox, b, 24, u1, u0 ), \
+                                     CSA_BS_QUAD( sbox, b, 28, u1, u0 ), u2 ); \
+    (out) = csa_BsMux( csa_BsMux( t0, t1, u3 ), csa_BsMux( t2, t3, u3 ), u4 ); \
+} while(0)
+
+/* One iteration of csa_StreamCypher: in_A/in_B are the input nibbles fed to
+ * A and B during the initialisation (NULL otherwise), out gets the 2 output
+ * bits, low bit first */
+static void csa_BsClock( csa_bs_t *c, const csa_word_t *in_A,
+                         const csa_word_t *in_B, csa_word_t out[2] )
+{
+    csa_word_t (*A)[4] = c->A;
+    csa_word_t (*B)[4] = c->B;
+    csa_word_t s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+    csa_word_t extra_B[4], next_A1[4], next_B1[4], next_E[4];
+
+    CSA_BS_SBOX( s1[0], sbox1, 0, A[4][0], A[1][2], A[6][1], A[7][3], A[9][0] );
+    CSA_BS_SBOX( s1[1], sbox1, 1, A[4][0], A[1][2], A[6][1], A[7][3], A[9][0] );
+    CSA_BS_SBOX( s2[0], sbox2, 0, A[2][1], A[3][2], A[6][3], A[7][0], A[9][1] );
+    CSA_BS_SBOX( s2[1], sbox2, 1, A[2][1], A[3][2], A[6][3], A[7][0], A[9][1] );
+    CSA_BS_SBOX( s3[0], sbox3, 0, A[1][3], A[2][0], A[5][1], A[5][3], A[6][2] );
+    CSA_BS_SBOX( s3[1], sbox3, 1, A[1][3], A[2][0], A[5][1], A[5][3], A[6][2] );
+    CSA_BS_SBOX( s4[0], sbox4, 0, A[3][3], A[1][1], A[2][3], A[4][2], A[8][0] );
+    CSA_BS_SBOX( s4[1], sbox4, 1, A[3][3], A[1][1], A[2][3], A[4][2], A[8][0] );
+    CSA_BS_SBOX( s5[0], sbox5, 0, A[5][2], A[4][3], A[6][0], A[8][1], A[9][2] );
+    CSA_BS_SBOX( s5[1], sbox5, 1, A[5][2], A[4][3], A[6][0], A[8][1], A[9][2] );
+    CSA_BS_SBOX( s6[0], sbox6, 0, A[3][1], A[4][1], A[5][0], A[7][2], A[9][3] );
+    CSA_BS_SBOX( s6[1], sbox6, 1, A[3][1], A[4][1], A[5][0], A[7][2], A[9][3] );
+    CSA_BS_SBOX( s7[0], sbox7, 0, A[2][2], A[3][0], A[7][1], A[8][2], A[8][3] );
+    CSA_BS_SBOX( s7[1], sbox7, 1, A[2][2], A[3][0], A[7][1], A[8][2], A[8][3] );
+
+    extra_B[3] = B[3][0] ^ B[6][1] ^ B[7][2] ^ B[9][3];
+    extra_B[2] = B[6][0] ^ B[8][1] ^ B[3][3] ^ B[4][2];
+    extra_B[1] = B[5][3] ^ B[8][2] ^ B[4][0] ^ B[5][1];
+    extra_B[0] = B[9][2] ^ B[6][3] ^ B[3][1] ^ B[8][0];
+
+    for( int b = 0; b < 4; b++ )
+    {
+        next_A1[b] = A[10][b] ^ c->X[b];
+        next_B1[b] = B[7][b] ^ B[10][b] ^ c->Y[b];
+        if( in_A )
+        {
+            next_A1[b] ^= c->D[b] ^ in_A[b];
+            next_B1[b] ^= in_B[b];
+        }
+    }
+
+    /* if p=1, rotate left */
+    csa_word_t rot_B1[4];
+    for( int b = 0; b < 4; b++ )
+        rot_B1[b] = csa_BsMux( next_B1[b], next_B1[(b+3)&3], c->p );
+
+    /* T3, then T4 = sum, carry of Z + E + r when q=1 */
+    csa_word_t carry = c->r;
+    for( int b = 0; b < 4; b++ )
+    {
+        const csa_word_t t = c->Z[b] ^ c->E[b];
+        const csa_word_t sum = t ^ carry;
+
+        c->D[b] = t ^ extra_B[b];
+        carry = ( c->Z[b] & c->E[b] ) | ( carry & t );
+        next_E[b] = c->F[b];
+        c->F[b] = csa_BsMux( c->E[b], sum, c->q );
+        c->E[b] = next_E[b];
+    }
+    c->r = csa_BsMux( c->r, carry, c->q );
+
+    memmove( &A[2], &A[1], 9 * sizeof(A[1]) );
+    memmove( &B[2], &B[1], 9 * sizeof(B[1]) );
+    memcpy( A[1], next_A1, sizeof(A[1]) );
+    memcpy( B[1], rot_B1, sizeof(B[1]) );
+
+    c->X[3] = s4[0]; c->X[2] = s3[0]; c->X[1] = s2[1]; c->X[0] = s1[1];
+    c->Y[3] = s6[0]; c->Y[2] = s5[0]; c->Y[1] = s4[1]; c->Y[0] = s3[1];
+    c->Z[3] = s2[0]; c->Z[2] = s1[0]; c->Z[1] = s6[1]; c->Z[0] = s5[1];
+    c->p = s7[1];
+    c->q = s7[0];
+
+    out[0] = c->D[0] ^ c->D[1];
+    out[1] = c->D[2] ^ c->D[3];
+}
+
+/* 64x64 bits transposition: bit l of w[k] is swapped with bit k of w[l] */
+static void csa_BsTranspose( csa_word_t w[64] )
+{
+    csa_word_t m = 0x00000000ffffffffULL;
+
+    for( int j = 32; j != 0; j >>= 1, m ^= m << j )
+    {
+        for( int k = 0; k < 64; k = ( ( k | j ) + 1 ) & ~j )
+        {
+            const csa_word_t t = ( ( w[k] >> j ) ^ w[k|j] ) & m;
+            w[k]   ^= t << j;
+            w[k|j] ^= t;
+        }
+    }
+}
+
+/* Computes i_steps * 8 bytes of key stream for each of the i_lanes packets,
+ * starting from their first block p_sb */
+static void csa_BsStream( const uint8_t ck[8], const uint64_t *p_sb,
+                          int i_lanes, int i_steps, uint8_t stream[][184] )
+{
+    csa_bs_t   c;
+    csa_word_t w[64];
+
+    /* every lane uses the same key */
+    memset( &c, 0, sizeof(c) );
+    for( int i = 0; i < 4; i++ )
+    {
+        for( int b = 0; b < 4; b++ )
+        {
+            c.A[1+2*i+0][b] = -(csa_word_t)( ( ck[i] >> (4+b) )&1 );
+            c.A[1+2*i+1][b] = -(csa_word_t)( ( ck[i] >> b )&1 );
+            c.B[1+2*i+0][b] = -(csa_word_t)( ( ck[4+i] >> (4+b) )&1 );
+            c.B[1+2*i+1][b] = -(csa_word_t)( ( ck[4+i] >> b )&1 );
+        }
+    }
+
+    /* w[8*i+b] holds bit b of the byte i of every lane */
+    for( int l = 0; l < 64; l++ )
+        w[l] = l < i_lanes ? p_sb[l] : 0;
+    csa_BsTranspose( w );
+
+    for( int i = 0; i < 8; i++ )
+    {
+        const csa_word_t *in1 = &w[8*i+4];
+        const csa_word_t *in2 = &w[8*i];
+        csa_word_t out[2];
+
+        for( int j = 0; j < 4; j++ )
+            csa_BsClock( &c, j%2 ? in2 : in1, j%2 ? in1 : in2, out );
+    }
+
+    for( int t = 0; t < i_steps; t++ )
+    {
+        for( int i = 0; i < 8; i++ )
+        {
+            for( int j = 0; j < 4; j++ )
+                csa_BsClock( &c, NULL, NULL, &w[8*i+6-2*j] );
+        }
+        csa_BsTranspose( w );
+        for( int l = 0; l < i_lanes; l++ )
+            SetQWLE( &stream[l][8*t], w[l] );
+    }
+}
+
 // block - sbox
 static const uint8_t block_sbox[256] =
 {
@@ -610,3 +1047,39 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+/* csa_BlockDecypher and csa_BlockCypher on n independent blocks, packed in
+ * little endian words (R[1] in the low byte). The rounds are interleaved
+ * across the blocks so that their table lookups overlap. */
+static void csa_BsBlockDecypher( const uint8_t kk[57], uint64_t *bd, int n )
+{
+    for( int i = 56; i > 0; i-- )
+    {
+        for( int b = 0; b < n; b++ )
+        {
+            const uint64_t R = bd[b];
+            const int sbox_out = block_sbox[ kk[i] ^ ((R >> 48)&0xff) ];
+            const uint64_t x = (R >> 56) ^ sbox_out;
+
+            /* R[1] = R[8]^s, R[3..5] ^= R[8]^s, R[7] ^= perm, others shift */
+            bd[b] = ( R << 8 ) ^ ( x * 0x0000000101010001ULL ) ^
+                    ( (uint64_t)block_perm[sbox_out] << 48 );
+        }
+    }
+}
+
+static void csa_BsBlockCypher( const uint8_t kk[57], uint64_t *bd, int n )
+{
+    for( int i = 1; i <= 56; i++ )
+    {
+        for( int b = 0; b < n; b++ )
+        {
+            const uint64_t R = bd[b];
+            const int sbox_out = block_sbox[ kk[i] ^ (R >> 56) ];
+
+            /* R[8] = R[1]^s, R[2..4] ^= R[1], R[6] ^= perm, others shift */
+            bd[b] = ( R >> 8 ) ^ ( (R & 0xff) * 0x0100000001010100ULL ) ^
+                    ( (uint64_t)sbox_out << 56 ) ^
+                    ( (uint64_t)block_perm[sbox_out] << 40 );
+        }
+    }
+}
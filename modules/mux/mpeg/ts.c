@@ -39,6 +39,7 @@
 #include <vlc_sout.h>
 #include <vlc_block.h>
 #include <vlc_rand.h>
+#include <vlc_atomic.h>
 
 #include <vlc_iso_lang.h>
 
@@ -173,9 +174,24 @@ static void    Close  ( vlc_object_t * );
     "The encryption routines subtract the TS-header from the value before " \
     "encrypting." )
 
+#define MUXRATE_TEXT N_("Constant mux rate (bits/s)")
+#define MUXRATE_LONGTEXT N_("If not zero, the TS is sent at this constant " \
+    "bitrate: the free packet slots are filled with null packets and the " \
+    "PCRs are stamped with the time of their slot. It must be above the " \
+    "bitrate of the muxed streams.")
+
+#define SLAB_TEXT N_("TS packets per output block")
+#define SLAB_LONGTEXT N_("Number of TS packets gathered in each block " \
+    "given to the access output. 7 packets fill a typical UDP datagram.")
+
 #define SOUT_CFG_PREFIX "sout-ts-"
 #define MAX_PMT 64       /* Maximum number of programs. FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #define MAX_PMT_PID 64       /* Maximum pids in each pmt.  FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
+#define TS_SLAB_MAX 64       /* Maximum TS packets per output block */
+#define TS_SLAB_BLOCKS 8     /* Output blocks worth of packets per slab */
+#define TS_POOL_MAX 1024     /* Maximum TS packet descriptors kept for reuse */
+#define TS_PACKET_TICKS (INT64_C(188) * 8 * 27000000) /* bits x 27MHz */
+#define TS_CBR_STATS_PERIOD (INT64_C(5) * 27000000) /* 27MHz */
 
 vlc_module_begin ()
     set_description( N_("TS muxer (libdvbpsi)") )
@@ -204,6 +220,7 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "bmin", 0, BMIN_TEXT, BMIN_LONGTEXT, true)
     add_integer( SOUT_CFG_PREFIX "bmax", 0, BMAX_TEXT, BMAX_LONGTEXT, true)
     add_integer( SOUT_CFG_PREFIX "dts-delay", 400, DTS_TEXT, DTS_LONGTEXT, true)
+    add_integer( SOUT_CFG_PREFIX "muxrate", 0, MUXRATE_TEXT, MUXRATE_LONGTEXT, true)
 
     add_bool( SOUT_CFG_PREFIX "crypt-audio", true, ACRYPT_TEXT, ACRYPT_LONGTEXT, true)
     add_bool( SOUT_CFG_PREFIX "crypt-video", true, VCRYPT_TEXT, VCRYPT_LONGTEXT, true)
@@ -212,6 +229,9 @@ vlc_module_begin ()
     add_string( SOUT_CFG_PREFIX "csa-use", "1",  CU_TEXT,   CU_LONGTEXT,   true)
     add_integer(SOUT_CFG_PREFIX "csa-pkt", 188,  CPKT_TEXT, CPKT_LONGTEXT, true)
 
+    add_integer_with_range(SOUT_CFG_PREFIX "slab", 7, 1, TS_SLAB_MAX,
+                           SLAB_TEXT, SLAB_LONGTEXT, true)
+
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -223,7 +243,7 @@ static const char *const ppsz_sout_options[] = {
     "netid", "sdtdesc",
     "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "slab", "muxrate",
     NULL
 };
 
@@ -335,6 +355,26 @@ typedef struct ts_stream_t
 
 } ts_stream_t;
 
+/* TS packets are built in place in slabs, in the order they are created.
+ * The blocks given to the access output are views on runs of consecutive
+ * packets of a slab, so the packets are never copied. The muxer holds one
+ * reference to the slab while it fills it or while some of its packets
+ * are not written yet, and each view holds one. */
+typedef struct
+{
+    atomic_uint     i_refs;
+    unsigned        i_used;         /* packets handed out */
+    unsigned        i_count;        /* capacity, in packets */
+    unsigned        i_pending;      /* packets not written yet */
+    uint8_t         p_data[];
+} ts_slab_t;
+
+typedef struct
+{
+    block_t         self;
+    ts_slab_t       *p_slab;
+} ts_packet_t;
+
 struct sout_mux_sys_t
 {
     int             i_pcr_pid;
@@ -388,6 +428,28 @@ struct sout_mux_sys_t
     int             i_csa_pkt_size;
     bool            b_crypt_audio;
     bool            b_crypt_video;
+
+    /* constant bitrate output */
+    int64_t         i_muxrate;      /* 0 when disabled */
+    bool            b_cbr_started;
+    int64_t         i_cbr_clock;    /* 27MHz date of the next output slot */
+    int64_t         i_cbr_frac;     /* remainder of i_cbr_clock, 1/i_muxrate */
+    bool            b_cbr_discontinuity; /* clock reset, flag the next PCR */
+    uint64_t        i_cbr_resets;
+    uint64_t        i_cbr_packets;
+    uint64_t        i_cbr_nulls;
+    uint64_t        i_cbr_late;
+    unsigned        i_cbr_pcrs;
+    int64_t         i_cbr_last_pcr;
+    int64_t         i_cbr_pcr_shift_max;
+    int64_t         i_cbr_pcr_interval_max;
+    int64_t         i_cbr_stats_pcr; /* PCR of the last statistics */
+
+    /* TS packets are written in place in slabs */
+    ts_slab_t       *p_slab;        /* slab being filled */
+    block_t         *p_free_ts;     /* unused packet descriptors */
+    int             i_free_ts;
+    int             i_slab_packets;
 };
 
 /* Reserve a pid and return it */
@@ -447,7 +509,16 @@ static void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 
 static block_t *TSNew( sout_mux_t *p_mux, ts_stream_t *p_stream, bool b_pcr );
+static block_t *TSPacketNew( sout_mux_sys_t *p_sys );
+static void TSPacketRelease( sout_mux_sys_t *p_sys, block_t *p_ts );
+static void TSSlabRelease( ts_slab_t *p_slab );
+static void TSViewRelease( block_t *p_block );
 static void TSSetPCR( block_t *p_ts, mtime_t i_dts );
+static void TSWrite( sout_mux_t *p_mux, block_t **pp_slab, block_t *p_ts );
+static void TSScramble( sout_mux_sys_t *p_sys, sout_buffer_chain_t *p_chain_ts );
+static void TSStuff( sout_mux_t *p_mux, block_t **pp_slab, mtime_t i_date );
+static void TSSetCBRPCR( sout_mux_t *p_mux, block_t *p_ts, mtime_t i_date );
+static void TSCBRStats( sout_mux_t *p_mux );
 
 static csa_t *csaSetup( vlc_object_t *p_this )
 {
@@ -466,6 +537,8 @@ static csa_t *csaSetup( vlc_object_t *p_this )
         return NULL;
     }
 
+    /* the key callbacks below use it */
+    p_sys->csa = csa;
     vlc_mutex_init( &p_sys->csa_lock );
     p_sys->b_crypt_audio = var_GetBool( p_mux, SOUT_CFG_PREFIX "crypt-audio" );
     p_sys->b_crypt_video = var_GetBool( p_mux, SOUT_CFG_PREFIX "crypt-video" );
@@ -722,13 +795,34 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->b_use_key_frames = var_GetBool( p_mux, SOUT_CFG_PREFIX "use-key-frames" );
 
+    p_sys->i_muxrate = var_GetInteger( p_mux, SOUT_CFG_PREFIX "muxrate" );
+    if( p_sys->i_muxrate < 0 )
+        p_sys->i_muxrate = 0;
+    if( p_sys->i_muxrate > 0 )
+    {
+        msg_Dbg( p_mux, "constant mux rate %"PRId64" bit/s", p_sys->i_muxrate );
+
+        /* Statistics, updated every few seconds of stream */
+        var_Create( p_mux, SOUT_CFG_PREFIX "muxrate-packets", VLC_VAR_INTEGER );
+        var_Create( p_mux, SOUT_CFG_PREFIX "muxrate-nulls", VLC_VAR_INTEGER );
+        var_Create( p_mux, SOUT_CFG_PREFIX "muxrate-late", VLC_VAR_INTEGER );
+        var_Create( p_mux, SOUT_CFG_PREFIX "muxrate-resets", VLC_VAR_INTEGER );
+        var_Create( p_mux, SOUT_CFG_PREFIX "muxrate-pcr-restamp", VLC_VAR_INTEGER );
+        var_Create( p_mux, SOUT_CFG_PREFIX "muxrate-pcr-interval", VLC_VAR_INTEGER );
+    }
+
+    p_sys->i_slab_packets = var_GetInteger( p_mux, SOUT_CFG_PREFIX "slab" );
+    if( p_sys->i_slab_packets < 1 || p_sys->i_slab_packets > TS_SLAB_MAX )
+        p_sys->i_slab_packets = 7;
+
+    /* csaSetup() gets p_sys from the mux */
+    p_mux->p_sys        = p_sys;
     p_sys->csa = csaSetup(p_this);
 
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
     p_mux->pf_delstream = DelStream;
     p_mux->pf_mux       = Mux;
-    p_mux->p_sys        = p_sys;
 
     return VLC_SUCCESS;
 }
@@ -761,6 +855,17 @@ static void Close( vlc_object_t * p_this )
         free( p_sys->sdt_descriptors[i].psz_provider );
     }
 
+    if( p_sys->i_muxrate > 0 )
+        TSCBRStats( p_mux );
+    if( p_sys->p_slab != NULL )
+        TSSlabRelease( p_sys->p_slab );
+    while( p_sys->p_free_ts != NULL )
+    {
+        block_t *p_next = p_sys->p_free_ts->p_next;
+        free( p_sys->p_free_ts );
+        p_sys->p_free_ts = p_next;
+    }
+
     free( p_sys->dvbpmt );
     free( p_sys );
 }
@@ -1773,38 +1878,348 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
         i_pcr_length = i_packet_count;
     }
 
+    if( p_sys->csa != NULL )
+        TSScramble( p_sys, p_chain_ts );
+
     /* msg_Dbg( p_mux, "real pck=%d", i_packet_count ); */
+    block_t *p_slab = NULL;
     for (int i = 0; i < i_packet_count; i++ )
     {
         block_t *p_ts = BufferChainGet( p_chain_ts );
         mtime_t i_new_dts = i_pcr_dts + i_pcr_length * i / i_packet_count;
 
-        p_ts->i_dts    = i_new_dts;
-        p_ts->i_length = i_pcr_length / i_packet_count;
+        if( p_sys->i_muxrate > 0 )
+        {
+            /* The packet goes in the next free slot, stuffing until its
+             * date */
+            TSStuff( p_mux, &p_slab, i_new_dts );
+            p_ts->i_dts    = p_sys->i_cbr_clock / 27;
+            p_ts->i_length = TS_PACKET_TICKS / p_sys->i_muxrate / 27;
+        }
+        else
+        {
+            p_ts->i_dts    = i_new_dts;
+            p_ts->i_length = i_pcr_length / i_packet_count;
+        }
 
         if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
         {
             /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
-            TSSetPCR( p_ts, p_ts->i_dts - p_sys->i_dts_delay );
+            if( p_sys->i_muxrate > 0 )
+                TSSetCBRPCR( p_mux, p_ts, i_new_dts );
+            else
+                TSSetPCR( p_ts, p_ts->i_dts - p_sys->i_dts_delay );
+        }
+
+        TSWrite( p_mux, &p_slab, p_ts );
+    }
+
+    if( p_slab != NULL )
+        sout_AccessOutWrite( p_mux->p_access, p_slab );
+}
+
+/* Scrambles the packets of the chain, CSA_BATCH at a time. Only the payload
+ * is scrambled, so the PCR can still be written afterwards. */
+static void TSScramble( sout_mux_sys_t *p_sys, sout_buffer_chain_t *p_chain_ts )
+{
+    uint8_t *pp_pkt[CSA_BATCH];
+    int      i_pkt = 0;
+
+    vlc_mutex_lock( &p_sys->csa_lock );
+    for( block_t *p_ts = p_chain_ts->p_first; p_ts != NULL; p_ts = p_ts->p_next )
+    {
+        if( !( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED ) )
+            continue;
+
+        pp_pkt[i_pkt++] = p_ts->p_buffer;
+        if( i_pkt == CSA_BATCH )
+        {
+            csa_EncryptBatch( p_sys->csa, pp_pkt, i_pkt, p_sys->i_csa_pkt_size );
+            i_pkt = 0;
         }
-        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+    }
+    csa_EncryptBatch( p_sys->csa, pp_pkt, i_pkt, p_sys->i_csa_pkt_size );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+}
+
+/* Adds a dated TS packet to the output block, sending the block when it is
+ * full. The output block is a view on the packets, which were built in
+ * place, so it only grows while the packets follow each other in their
+ * slab. */
+static void TSWrite( sout_mux_t *p_mux, block_t **pp_slab, block_t *p_ts )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    ts_packet_t *p_pkt = (ts_packet_t *)p_ts;
+    block_t *p_slab = *pp_slab;
+
+    /* latency */
+    p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
+
+    if( p_sys->i_muxrate > 0 )
+    {
+        /* next output slot */
+        p_sys->i_cbr_clock += TS_PACKET_TICKS / p_sys->i_muxrate;
+        p_sys->i_cbr_frac  += TS_PACKET_TICKS % p_sys->i_muxrate;
+        if( p_sys->i_cbr_frac >= p_sys->i_muxrate )
+        {
+            p_sys->i_cbr_clock++;
+            p_sys->i_cbr_frac -= p_sys->i_muxrate;
+        }
+        p_sys->i_cbr_packets++;
+    }
+
+    /* Header packets (PAT) are sent alone, as access outputs use them
+     * to split or to replay the stream */
+    if( p_slab != NULL &&
+        ( ( p_ts->i_flags & BLOCK_FLAG_HEADER ) ||
+          p_slab->i_buffer >= (size_t)p_sys->i_slab_packets * 188 ||
+          ((ts_packet_t *)p_slab)->p_slab != p_pkt->p_slab ||
+          &p_slab->p_buffer[p_slab->i_buffer] != p_ts->p_buffer ) )
+    {
+        sout_AccessOutWrite( p_mux->p_access, p_slab );
+        p_slab = NULL;
+    }
+
+    if( p_slab == NULL )
+    {
+        ts_packet_t *p_view = malloc( sizeof(*p_view) );
+        if( unlikely(p_view == NULL) )
+        {
+            TSPacketRelease( p_sys, p_ts );
+            *pp_slab = NULL;
+            return;
+        }
+        block_Init( &p_view->self, p_ts->p_buffer, 0 );
+        p_view->self.pf_release = TSViewRelease;
+        p_view->p_slab = p_pkt->p_slab;
+        atomic_fetch_add( &p_view->p_slab->i_refs, 1 );
+
+        p_slab = &p_view->self;
+        p_slab->i_flags = p_ts->i_flags & BLOCK_FLAG_HEADER;
+        p_slab->i_dts   = p_ts->i_dts;
+    }
+
+    /* The packet is already there, only extend the view over it. The size
+     * is kept to the view, so that the next packets cannot be overwritten
+     * through it. */
+    p_slab->i_buffer += 188;
+    p_slab->i_size   += 188;
+    p_slab->i_length += p_ts->i_length;
+    p_slab->i_flags  |= p_ts->i_flags & BLOCK_FLAG_CLOCK;
+
+    if( p_slab->i_flags & BLOCK_FLAG_HEADER )
+    {
+        sout_AccessOutWrite( p_mux->p_access, p_slab );
+        p_slab = NULL;
+    }
+
+    TSPacketRelease( p_sys, p_ts );
+    *pp_slab = p_slab;
+}
+
+/* Constant bitrate: fills the output slots with null packets up to i_date */
+static void TSStuff( sout_mux_t *p_mux, block_t **pp_slab, mtime_t i_date )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    const mtime_t i_slot = p_sys->i_cbr_clock / 27;
+
+    if( !p_sys->b_cbr_started || i_date - i_slot > CLOCK_FREQ ||
+        i_slot - i_date > CLOCK_FREQ )
+    {
+        if( p_sys->b_cbr_started )
         {
-            vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
-            vlc_mutex_unlock( &p_sys->csa_lock );
+            msg_Warn( p_mux, "muxrate clock is %"PRId64" us away from the "
+                      "stream, resetting it", i_slot - i_date );
+            /* The PCR jumps: signal it in the next one */
+            p_sys->b_cbr_discontinuity = true;
+            p_sys->i_cbr_resets++;
         }
+        p_sys->i_cbr_clock = i_date * 27;
+        p_sys->i_cbr_frac = 0;
+        p_sys->b_cbr_started = true;
+        return;
+    }
+
+    if( i_slot > i_date + TS_PACKET_TICKS / p_sys->i_muxrate / 27 )
+    {
+        /* The input is above the mux rate */
+        p_sys->i_cbr_late++;
+        return;
+    }
+
+    while( p_sys->i_cbr_clock / 27 < i_date )
+    {
+        block_t *p_null = TSPacketNew( p_sys );
+        if( unlikely(p_null == NULL) )
+            return;
+
+        p_null->p_buffer[0] = 0x47;
+        p_null->p_buffer[1] = 0x1f;
+        p_null->p_buffer[2] = 0xff;
+        p_null->p_buffer[3] = 0x10;
+        memset( &p_null->p_buffer[4], 0xff, 184 );
+        p_null->i_dts    = p_sys->i_cbr_clock / 27;
+        p_null->i_length = TS_PACKET_TICKS / p_sys->i_muxrate / 27;
+
+        p_sys->i_cbr_nulls++;
+        TSWrite( p_mux, pp_slab, p_null );
+    }
+}
+
+/* Constant bitrate: stamps the PCR with the time of the packet output slot
+ * instead of its scheduled date, and keeps statistics on the difference */
+static void TSSetCBRPCR( sout_mux_t *p_mux, block_t *p_ts, mtime_t i_date )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    const int64_t i_pcr = p_sys->i_cbr_clock - p_sys->i_dts_delay * 27;
+    const int64_t i_base = i_pcr / 300;
+    const int64_t i_ext = i_pcr % 300;
+
+    p_ts->p_buffer[6]  = ( i_base >> 25 )&0xff;
+    p_ts->p_buffer[7]  = ( i_base >> 17 )&0xff;
+    p_ts->p_buffer[8]  = ( i_base >> 9  )&0xff;
+    p_ts->p_buffer[9]  = ( i_base >> 1  )&0xff;
+    p_ts->p_buffer[10] = ( ( i_base << 7 )&0x80 ) | 0x7e | ( ( i_ext >> 8 )&0x01 );
+    p_ts->p_buffer[11] = i_ext & 0xff;
+
+    if( p_sys->b_cbr_discontinuity )
+    {
+        /* discontinuity_indicator: the time base changes with this PCR */
+        p_ts->p_buffer[5] |= 0x80;
+        p_sys->b_cbr_discontinuity = false;
+        p_sys->i_cbr_stats_pcr = i_pcr;
+    }
+    else if( p_sys->i_cbr_pcrs > 0 &&
+             i_pcr - p_sys->i_cbr_last_pcr > p_sys->i_cbr_pcr_interval_max )
+    {
+        p_sys->i_cbr_pcr_interval_max = i_pcr - p_sys->i_cbr_last_pcr;
+    }
+
+    /* statistics, in 27MHz units */
+    const int64_t i_shift = llabs( p_sys->i_cbr_clock - i_date * 27 );
+    if( i_shift > p_sys->i_cbr_pcr_shift_max )
+        p_sys->i_cbr_pcr_shift_max = i_shift;
+    if( p_sys->i_cbr_pcrs == 0 )
+        p_sys->i_cbr_stats_pcr = i_pcr;
+    p_sys->i_cbr_last_pcr = i_pcr;
+    p_sys->i_cbr_pcrs++;
+
+    if( i_pcr - p_sys->i_cbr_stats_pcr >= TS_CBR_STATS_PERIOD )
+    {
+        TSCBRStats( p_mux );
+        p_sys->i_cbr_stats_pcr = i_pcr;
+    }
+}
 
-        /* latency */
-        p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
+/* Publishes the constant bitrate statistics in the muxer variables, and logs
+ * them */
+static void TSCBRStats( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( p_sys->i_cbr_packets == 0 )
+        return;
 
-        sout_AccessOutWrite( p_mux->p_access, p_ts );
+    var_SetInteger( p_mux, SOUT_CFG_PREFIX "muxrate-packets", p_sys->i_cbr_packets );
+    var_SetInteger( p_mux, SOUT_CFG_PREFIX "muxrate-nulls", p_sys->i_cbr_nulls );
+    var_SetInteger( p_mux, SOUT_CFG_PREFIX "muxrate-late", p_sys->i_cbr_late );
+    var_SetInteger( p_mux, SOUT_CFG_PREFIX "muxrate-resets", p_sys->i_cbr_resets );
+    /* in ns and us */
+    var_SetInteger( p_mux, SOUT_CFG_PREFIX "muxrate-pcr-restamp",
+                    p_sys->i_cbr_pcr_shift_max * 1000 / 27 );
+    var_SetInteger( p_mux, SOUT_CFG_PREFIX "muxrate-pcr-interval",
+                    p_sys->i_cbr_pcr_interval_max / 27 );
+
+    msg_Dbg( p_mux, "muxrate %"PRId64" bit/s: %"PRIu64" packets, %"PRIu64
+             " null (%"PRIu64"%%), %"PRIu64" over the rate, %"PRIu64" resets, "
+             "%u PCR, max restamp %"PRId64" ns, max interval %"PRId64" us",
+             p_sys->i_muxrate, p_sys->i_cbr_packets, p_sys->i_cbr_nulls,
+             p_sys->i_cbr_nulls * 100 / p_sys->i_cbr_packets,
+             p_sys->i_cbr_late, p_sys->i_cbr_resets, p_sys->i_cbr_pcrs,
+             p_sys->i_cbr_pcr_shift_max * 1000 / 27,
+             p_sys->i_cbr_pcr_interval_max / 27 );
+}
+
+static void TSSlabRelease( ts_slab_t *p_slab )
+{
+    if( atomic_fetch_sub( &p_slab->i_refs, 1 ) == 1 )
+        free( p_slab );
+}
+
+/* Releases an output block, maybe from the access output thread */
+static void TSViewRelease( block_t *p_block )
+{
+    ts_packet_t *p_view = (ts_packet_t *)p_block;
+
+    TSSlabRelease( p_view->p_slab );
+    free( p_view );
+}
+
+/* Returns a TS packet taken from the slab being filled. The packet
+ * descriptors are only short lived: they are released by TSWrite() once
+ * the packet is in an output block, and reused. */
+static block_t *TSPacketNew( sout_mux_sys_t *p_sys )
+{
+    ts_slab_t *p_slab = p_sys->p_slab;
+
+    if( p_slab == NULL || p_slab->i_used >= p_slab->i_count )
+    {
+        const unsigned i_count = p_sys->i_slab_packets * TS_SLAB_BLOCKS;
+
+        if( p_slab != NULL && p_slab->i_pending == 0 )
+            TSSlabRelease( p_slab );
+        p_sys->p_slab = p_slab = malloc( sizeof(*p_slab) + i_count * 188 );
+        if( unlikely(p_slab == NULL) )
+            return NULL;
+        atomic_init( &p_slab->i_refs, 1 );
+        p_slab->i_used    = 0;
+        p_slab->i_count   = i_count;
+        p_slab->i_pending = 0;
+    }
+
+    ts_packet_t *p_pkt = (ts_packet_t *)p_sys->p_free_ts;
+    if( p_pkt != NULL )
+    {
+        p_sys->p_free_ts = p_pkt->self.p_next;
+        p_sys->i_free_ts--;
+    }
+    else
+    {
+        p_pkt = malloc( sizeof(*p_pkt) );
+        if( unlikely(p_pkt == NULL) )
+            return NULL;
+    }
+
+    /* Only released with TSPacketRelease() */
+    block_Init( &p_pkt->self, &p_slab->p_data[p_slab->i_used++ * 188], 188 );
+    p_pkt->self.i_dts = 0;
+    p_pkt->p_slab = p_slab;
+    p_slab->i_pending++;
+    return &p_pkt->self;
+}
+
+static void TSPacketRelease( sout_mux_sys_t *p_sys, block_t *p_ts )
+{
+    ts_packet_t *p_pkt = (ts_packet_t *)p_ts;
+    ts_slab_t *p_slab = p_pkt->p_slab;
+
+    /* The slab is released by the muxer when it neither fills it nor has
+     * packets left in it */
+    if( --p_slab->i_pending == 0 && p_slab != p_sys->p_slab )
+        TSSlabRelease( p_slab );
+    if( p_sys->i_free_ts >= TS_POOL_MAX )
+    {
+        free( p_pkt );
+        return;
     }
+    p_ts->p_next = p_sys->p_free_ts;
+    p_sys->p_free_ts = p_ts;
+    p_sys->i_free_ts++;
 }
 
 static block_t *TSNew( sout_mux_t *p_mux, ts_stream_t *p_stream,
                        bool b_pcr )
 {
-    VLC_UNUSED(p_mux);
     block_t *p_pes = p_stream->chain_pes.p_first;
 
     bool b_new_pes = false;
@@ -1824,7 +2239,7 @@ static block_t *TSNew( sout_mux_t *p_mux, ts_stream_t *p_stream,
         b_adaptation_field = true;
     }
 
-    block_t *p_ts = block_Alloc( 188 );
+    block_t *p_ts = TSPacketNew( p_mux->p_sys );
 
     if (b_new_pes && !(p_pes->i_flags & BLOCK_FLAG_NO_KEYFRAME) && p_pes->i_flags & BLOCK_FLAG_TYPE_I)
     {
@@ -1928,8 +2343,8 @@ static void TSSetPCR( block_t *p_ts, mtime_t i_dts )
     p_ts->p_buffer[10]|= ( i_pcr << 7  )&0x80;
 }
 
-static void PEStoTS( sout_buffer_chain_t *c, block_t *p_pes,
-                     ts_stream_t *p_stream )
+static void PEStoTS( sout_mux_sys_t *p_sys, sout_buffer_chain_t *c,
+                     block_t *p_pes, ts_stream_t *p_stream )
 {
     /* get PES total size */
     uint8_t *p_data = p_pes->p_buffer;
@@ -1952,7 +2367,7 @@ static void PEStoTS( sout_buffer_chain_t *c, block_t *p_pes,
 
         int i_copy = __MIN( i_size, 184 );
         bool b_adaptation_field = i_size < 184;
-        block_t *p_ts = block_Alloc( 188 );
+        block_t *p_ts = TSPacketNew( p_sys );
 
         p_ts->p_buffer[0] = 0x47;
         p_ts->p_buffer[1] = ( b_new_pes ? 0x40 : 0x00 )|
@@ -2064,7 +2479,7 @@ static void GetPAT( sout_mux_t *p_mux,
 #endif
     p_pat = WritePSISection( p_section );
 
-    PEStoTS( c, p_pat, &p_sys->pat );
+    PEStoTS( p_sys, c, p_pat, &p_sys->pat );
 
     dvbpsi_DeletePSISections( p_section );
     dvbpsi_EmptyPAT( &pat );
@@ -2411,7 +2826,7 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
         sect = dvbpsi_GenPMTSections( &p_sys->dvbpmt[i] );
 #endif
         block_t *pmt = WritePSISection( sect );
-        PEStoTS( c, pmt, &p_sys->pmt[i] );
+        PEStoTS( p_sys, c, pmt, &p_sys->pmt[i] );
         dvbpsi_DeletePSISections(sect);
         dvbpsi_EmptyPMT( &p_sys->dvbpmt[i] );
     }
@@ -2425,7 +2840,7 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
         sect = dvbpsi_GenSDTSections( &sdt );
 #endif
         block_t *p_sdt = WritePSISection( sect );
-        PEStoTS( c, p_sdt, &p_sys->sdt );
+        PEStoTS( p_sys, c, p_sdt, &p_sys->sdt );
         dvbpsi_DeletePSISections( sect );
         dvbpsi_EmptySDT( &sdt );
     }
@@ -49,6 +49,9 @@ DASHManager::DASHManager    ( MPD *mpd,
 }
 DASHManager::~DASHManager   ()
 {
+    /* wake the downloader if it waits for a chunk */
+    if(this->conManager)
+        this->conManager->closeAllConnections();
     delete this->downloader;
     delete this->buffer;
     delete this->conManager;
@@ -70,11 +73,14 @@ bool    DASHManager::start()
 
     this->conManager = new dash::http::HTTPConnectionManager(this->adaptationLogic, this->stream);
     this->buffer     = new BlockBuffer(this->stream);
-    this->downloader = new DASHDownloader(this->conManager, this->buffer);
 
     this->conManager->attach(this->adaptationLogic);
     this->buffer->attach(this->adaptationLogic);
 
+    if(!this->conManager->start())
+        return false;
+
+    this->downloader = new DASHDownloader(this->conManager, this->buffer);
     return this->downloader->start();
 }
 int     DASHManager::read( void *p_buffer, size_t len )
@@ -37,6 +37,7 @@ RateBasedAdaptationLogic::RateBasedAdaptationLogic  (IMPDManager *mpdManager, st
                           mpdManager                (mpdManager),
                           count                     (0),
                           currentPeriod             (mpdManager->getFirstPeriod()),
+                          currentRepresentation     (NULL),
                           width                     (0),
                           height                    (0)
 {
@@ -52,25 +53,38 @@ Chunk*  RateBasedAdaptationLogic::getNextChunk()
     if(this->currentPeriod == NULL)
         return NULL;
 
-    uint64_t bitrate = this->getBpsAvg();
+    uint64_t bitrate        = this->getBpsAvg();
+    int      bufferPercent  = this->getBufferPercent();
 
-    if(this->getBufferPercent() < MINBUFFER)
+    /* Throughput estimate weighted by the buffer level: the fuller the
+     * buffer, the closer to the measured rate we dare to go. */
+    if(bufferPercent < MINBUFFER)
         bitrate = 0;
+    else
+        bitrate = bitrate * (50 + __MIN(bufferPercent, 100) / 2) / 100;
 
     Representation *rep = this->mpdManager->getRepresentation(this->currentPeriod, bitrate, this->width, this->height);
 
     if ( rep == NULL )
         return NULL;
 
+    /* Do not switch up until the buffer can absorb a wrong guess */
+    if ( this->currentRepresentation != NULL && bufferPercent < UPSWITCHBUFFER &&
+         rep->getBandwidth() > this->currentRepresentation->getBandwidth() )
+        rep = this->currentRepresentation;
+
     std::vector<Segment *> segments = this->mpdManager->getSegments(rep);
 
     if ( this->count == segments.size() )
     {
         this->currentPeriod = this->mpdManager->getNextPeriod(this->currentPeriod);
+        this->currentRepresentation = NULL;
         this->count = 0;
         return this->getNextChunk();
     }
 
+    this->currentRepresentation = rep;
+
     if ( segments.size() > this->count )
     {
         Segment *seg = segments.at( this->count );
@@ -86,5 +100,7 @@ Chunk*  RateBasedAdaptationLogic::getNextChunk()
 
 const Representation *RateBasedAdaptationLogic::getCurrentRepresentation() const
 {
+    if ( this->currentRepresentation != NULL )
+        return this->currentRepresentation;
     return this->mpdManager->getRepresentation( this->currentPeriod, this->getBpsAvg() );
 }
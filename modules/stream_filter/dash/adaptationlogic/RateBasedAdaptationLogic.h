@@ -34,7 +34,8 @@
 #include <vlc_common.h>
 #include <vlc_stream.h>
 
-#define MINBUFFER 30
+#define MINBUFFER       30
+#define UPSWITCHBUFFER  50
 
 namespace dash
 {
@@ -52,6 +53,7 @@ namespace dash
                 dash::mpd::IMPDManager  *mpdManager;
                 size_t                  count;
                 dash::mpd::Period       *currentPeriod;
+                dash::mpd::Representation *currentRepresentation;
                 int                     width;
                 int                     height;
         };
@@ -57,6 +57,9 @@ static void Close   (vlc_object_t *);
 #define DASH_BUFFER_TEXT N_("Buffer Size (Seconds)")
 #define DASH_BUFFER_LONGTEXT N_("Buffer size in seconds")
 
+#define DASH_CONNECTIONS_TEXT N_("Concurrent connections")
+#define DASH_CONNECTIONS_LONGTEXT N_("Number of segments fetched in parallel, each over its own connection")
+
 vlc_module_begin ()
         set_shortname( N_("DASH"))
         set_description( N_("Dynamic Adaptive Streaming over HTTP") )
@@ -66,6 +69,8 @@ vlc_module_begin ()
         add_integer( "dash-prefwidth",  480, DASH_WIDTH_TEXT,  DASH_WIDTH_LONGTEXT,  true )
         add_integer( "dash-prefheight", 360, DASH_HEIGHT_TEXT, DASH_HEIGHT_LONGTEXT, true )
         add_integer( "dash-buffersize", 30, DASH_BUFFER_TEXT, DASH_BUFFER_LONGTEXT, true )
+        add_integer( "dash-connections", 2, DASH_CONNECTIONS_TEXT, DASH_CONNECTIONS_LONGTEXT, true )
+            change_integer_range( 1, 8 )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -201,14 +206,13 @@ static int  Read            (stream_t *p_stream, void *p_ptr, unsigned int i_len
     while( i_len > 0 )
     {
         i_read = p_dashManager->read( p_buffer, i_len );
-        if( i_read < 0 )
+        if( i_read <= 0 ) /* error or end of stream */
             break;
-        p_buffer += i_read;
+        if( p_buffer != NULL ) /* NULL when skipping */
+            p_buffer += i_read;
         i_ret += i_read;
         i_len -= i_read;
     }
-    p_buffer -= i_ret;
-
     if (i_read < 0)
     {
         switch (errno)
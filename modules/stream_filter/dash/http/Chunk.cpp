@@ -37,8 +37,15 @@ Chunk::Chunk        () :
        isHostname   (false),
        length       (0),
        bytesRead    (0),
-       connection   (NULL)
+       connection   (NULL),
+       data         (NULL),
+       downloaded   (false)
 {
+    this->dataLast = &this->data;
+}
+Chunk::~Chunk       ()
+{
+    block_ChainRelease(this->data);
 }
 
 int                 Chunk::getEndByte           () const
@@ -149,3 +156,39 @@ void                Chunk::setConnection   (IHTTPConnection *connection)
 {
     this->connection = connection;
 }
+void                Chunk::putData         (block_t *block)
+{
+    block_ChainLastAppend(&this->dataLast, block);
+}
+size_t              Chunk::getData         (uint8_t *p_buffer, size_t len)
+{
+    size_t ret = 0;
+
+    while(this->data != NULL && ret < len)
+    {
+        block_t *block  = this->data;
+        size_t  size    = __MIN(len - ret, block->i_buffer);
+
+        memcpy(p_buffer + ret, block->p_buffer, size);
+        block->p_buffer += size;
+        block->i_buffer -= size;
+        ret             += size;
+
+        if(block->i_buffer == 0)
+        {
+            this->data = block->p_next;
+            if(this->data == NULL)
+                this->dataLast = &this->data;
+            block_Release(block);
+        }
+    }
+    return ret;
+}
+bool                Chunk::isDownloaded    () const
+{
+    return this->downloaded;
+}
+void                Chunk::setDownloaded   (bool value)
+{
+    this->downloaded = value;
+}
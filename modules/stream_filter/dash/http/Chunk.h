@@ -27,6 +27,7 @@
 
 #include <vlc_common.h>
 #include <vlc_url.h>
+#include <vlc_block.h>
 
 #include "IHTTPConnection.h"
 
@@ -42,6 +43,7 @@ namespace dash
         {
             public:
                 Chunk           ();
+                virtual ~Chunk  ();
 
                 int                 getEndByte              () const;
                 int                 getStartByte            () const;
@@ -67,6 +69,10 @@ namespace dash
                 void                setUseByteRange (bool value);
                 void                setBitrate      (uint64_t bitrate);
                 int                 getBitrate      ();
+                void                putData         (block_t *block);
+                size_t              getData         (uint8_t *p_buffer, size_t len);
+                bool                isDownloaded    () const;
+                void                setDownloaded   (bool value);
 
             private:
                 std::string                 url;
@@ -82,6 +88,9 @@ namespace dash
                 size_t                      length;
                 uint64_t                    bytesRead;
                 IHTTPConnection             *connection;
+                block_t                     *data;
+                block_t                     **dataLast;
+                bool                        downloaded;
         };
     }
 }
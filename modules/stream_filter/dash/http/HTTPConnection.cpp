@@ -30,6 +30,7 @@
 using namespace dash::http;
 
 HTTPConnection::HTTPConnection  (stream_t *stream) :
+                httpSocket      (-1),
                 stream          (stream),
                 peekBufferLen   (0),
                 contentLength   (0)
@@ -166,7 +167,9 @@ bool            HTTPConnection::sendData        (const std::string& data)
 }
 void            HTTPConnection::closeSocket     ()
 {
-    net_Close(this->httpSocket);
+    if(this->httpSocket != -1)
+        net_Close(this->httpSocket);
+    this->httpSocket = -1;
 }
 bool            HTTPConnection::setUrlRelative  (Chunk *chunk)
 {
@@ -31,68 +31,100 @@
 using namespace dash::http;
 using namespace dash::logic;
 
-const size_t    HTTPConnectionManager::PIPELINE               = 80;
-const size_t    HTTPConnectionManager::PIPELINELENGTH         = 2;
+const size_t    HTTPConnectionManager::CHUNKBLOCKSIZE         = 32768;
 const uint64_t  HTTPConnectionManager::CHUNKDEFAULTBITRATE    = 1;
 
 HTTPConnectionManager::HTTPConnectionManager    (logic::IAdaptationLogic *adaptationLogic, stream_t *stream) :
                        adaptationLogic          (adaptationLogic),
                        stream                   (stream),
+                       isEOS                    (false),
+                       isClosing                (false),
                        chunkCount               (0),
+                       activeDownloads          (0),
                        bpsAvg                   (0),
+                       bpsFast                  (0),
+                       bpsSlow                  (0),
                        bpsLastChunk             (0),
-                       bpsCurrentChunk          (0),
-                       bytesReadSession         (0),
-                       bytesReadChunk           (0),
-                       timeSession              (0),
-                       timeChunk                (0)
+                       bytesReadSample          (0),
+                       timeSample               (0),
+                       busySince                (0)
 {
+    this->connections = var_InheritInteger(stream, "dash-connections");
+    if(this->connections < 1)
+        this->connections = 1;
+
+    vlc_mutex_init(&this->lock);
+    vlc_cond_init(&this->wait);
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     this->closeAllConnections();
+    vlc_delete_all(this->downloadQueue);
+
+    vlc_mutex_destroy(&this->lock);
+    vlc_cond_destroy(&this->wait);
 }
 
+bool                                HTTPConnectionManager::start                    ()
+{
+    for(size_t i = 0; i < this->connections; i++)
+    {
+        vlc_thread_t thread;
+        if(vlc_clone(&thread, fetch, this, VLC_THREAD_PRIORITY_LOW))
+            break;
+        this->fetchThreads.push_back(thread);
+    }
+    msg_Dbg(this->stream, "fetching chunks over %zu connections", this->fetchThreads.size());
+
+    return this->fetchThreads.size() > 0;
+}
 void                                HTTPConnectionManager::closeAllConnections      ()
 {
-    vlc_delete_all(this->connectionPool);
-    vlc_delete_all(this->downloadQueue);
+    vlc_mutex_lock(&this->lock);
+    this->isClosing = true;
+    vlc_cond_broadcast(&this->wait);
+    vlc_mutex_unlock(&this->lock);
+
+    /* each fetch thread closes its own connection */
+    for(size_t i = 0; i < this->fetchThreads.size(); i++)
+        vlc_join(this->fetchThreads.at(i), NULL);
+    this->fetchThreads.clear();
 }
 int                                 HTTPConnectionManager::read                     (block_t *block)
 {
-    if(this->downloadQueue.size() == 0)
-        if(!this->addChunk(this->adaptationLogic->getNextChunk()))
-            return 0;
-
-    if(this->downloadQueue.front()->getPercentDownloaded() > HTTPConnectionManager::PIPELINE &&
-       this->downloadQueue.size() < HTTPConnectionManager::PIPELINELENGTH)
-        this->addChunk(this->adaptationLogic->getNextChunk());
-
     int ret = 0;
 
-    mtime_t start = mdate();
-    ret = this->downloadQueue.front()->getConnection()->read(block->p_buffer, block->i_buffer);
-    mtime_t end = mdate();
-
-    block->i_length = (mtime_t)((ret * 8) / ((float)this->downloadQueue.front()->getBitrate() / 1000000));
-
-    double time = ((double)(end - start)) / 1000000;
-
-    if(ret <= 0)
+    vlc_mutex_lock(&this->lock);
+    while(!this->isClosing)
     {
-        this->bpsLastChunk   = this->bpsCurrentChunk;
-        this->bytesReadChunk = 0;
-        this->timeChunk      = 0;
+        if(this->downloadQueue.size() == 0)
+        {
+            if(this->isEOS)
+                break;
+        }
+        else
+        {
+            /* chunks are fetched concurrently but handed out in order */
+            Chunk *chunk = this->downloadQueue.front();
 
-        delete(this->downloadQueue.front());
-        this->downloadQueue.pop_front();
+            ret = chunk->getData(block->p_buffer, block->i_buffer);
+            if(ret > 0)
+            {
+                block->i_length = (mtime_t)((ret * 8) / ((float)chunk->getBitrate() / 1000000));
+                break;
+            }
 
-        return this->read(block);
-    }
-    else
-    {
-        this->updateStatistics(ret, time);
+            if(chunk->isDownloaded())
+            {
+                delete chunk;
+                this->downloadQueue.pop_front();
+                vlc_cond_broadcast(&this->wait);
+                continue;
+            }
+        }
+        vlc_cond_wait(&this->wait, &this->lock);
     }
+    vlc_mutex_unlock(&this->lock);
 
     return ret;
 }
@@ -107,60 +139,128 @@ void                                HTTPConnectionManager::notify
     for(size_t i = 0; i < this->rateObservers.size(); i++)
         this->rateObservers.at(i)->downloadRateChanged(this->bpsAvg, this->bpsLastChunk);
 }
-std::vector<PersistentConnection *> HTTPConnectionManager::getConnectionsForHost    (const std::string &hostname)
+void*                               HTTPConnectionManager::fetch                    (void *p_data)
 {
-    std::vector<PersistentConnection *> cons;
+    HTTPConnectionManager   *manager    = (HTTPConnectionManager *) p_data;
+    PersistentConnection    *con        = NULL;
+    Chunk                   *chunk;
 
-    for(size_t i = 0; i < this->connectionPool.size(); i++)
-        if(!this->connectionPool.at(i)->getHostname().compare(hostname) || !this->connectionPool.at(i)->isConnected())
-            cons.push_back(this->connectionPool.at(i));
+    while((chunk = manager->getNextChunk()) != NULL)
+        con = manager->download(con, chunk);
 
-    return cons;
+    delete con;
+    return NULL;
 }
-void                                HTTPConnectionManager::updateStatistics         (int bytes, double time)
+Chunk*                              HTTPConnectionManager::getNextChunk             ()
 {
-    this->bytesReadSession  += bytes;
-    this->bytesReadChunk    += bytes;
-    this->timeSession       += time;
-    this->timeChunk         += time;
+    Chunk *chunk = NULL;
 
-    this->bpsAvg            = (int64_t) ((this->bytesReadSession * 8) / this->timeSession);
-    this->bpsCurrentChunk   = (int64_t) ((this->bytesReadChunk * 8) / this->timeChunk);
+    vlc_mutex_lock(&this->lock);
+    /* in flight and not yet consumed chunks, one per connection */
+    while(!this->isClosing && this->downloadQueue.size() >= this->connections)
+        vlc_cond_wait(&this->wait, &this->lock);
 
-    if(this->bpsAvg < 0)
-        this->bpsAvg = 0;
+    if(!this->isClosing && !this->isEOS)
+    {
+        chunk = this->adaptationLogic->getNextChunk();
+        if(chunk != NULL)
+        {
+            if(chunk->getBitrate() <= 0)
+                chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
 
-    if(this->bpsCurrentChunk < 0)
-        this->bpsCurrentChunk = 0;
+            this->downloadQueue.push_back(chunk);
+            this->chunkCount++;
+            if(this->activeDownloads++ == 0)
+                this->busySince = mdate();
+        }
+        else
+            this->isEOS = true;
+    }
+    vlc_cond_broadcast(&this->wait);
+    vlc_mutex_unlock(&this->lock);
 
-    this->notify();
+    return chunk;
 }
-bool                                HTTPConnectionManager::addChunk                 (Chunk *chunk)
+PersistentConnection*               HTTPConnectionManager::download                 (PersistentConnection *con, Chunk *chunk)
 {
-    if(chunk == NULL)
-        return false;
-
-    this->downloadQueue.push_back(chunk);
+    /* reuse the keep-alive connection unless the chunk is on another host */
+    if(con != NULL && !con->addChunk(chunk))
+    {
+        delete con;
+        con = NULL;
+    }
+    if(con == NULL)
+    {
+        con = new PersistentConnection(this->stream);
+        if(!con->addChunk(chunk))
+        {
+            delete con;
+            con = NULL;
+        }
+    }
 
-    std::vector<PersistentConnection *> cons = this->getConnectionsForHost(chunk->getHostname());
+    mtime_t start = mdate();
+    int64_t bytes = 0;
 
-    if(cons.size() == 0)
+    while(con != NULL)
     {
-        PersistentConnection *con = new PersistentConnection(this->stream);
-        this->connectionPool.push_back(con);
-        cons.push_back(con);
+        block_t *block = block_Alloc(HTTPConnectionManager::CHUNKBLOCKSIZE);
+        if(block == NULL)
+            break;
+
+        int ret = con->read(block->p_buffer, block->i_buffer);
+        if(ret <= 0)
+        {
+            block_Release(block);
+            break;
+        }
+        block->i_buffer = ret;
+        bytes          += ret;
+
+        vlc_mutex_lock(&this->lock);
+        chunk->putData(block);
+        this->bytesReadSample += ret;
+        bool closing = this->isClosing;
+        vlc_cond_broadcast(&this->wait);
+        vlc_mutex_unlock(&this->lock);
+
+        if(closing)
+            break;
     }
 
-    size_t pos = this->chunkCount % cons.size();
+    vlc_mutex_lock(&this->lock);
+    chunk->setDownloaded(true);
+    this->updateStatistics(bytes, mdate() - start);
+    vlc_cond_broadcast(&this->wait);
+    vlc_mutex_unlock(&this->lock);
 
-    cons.at(pos)->addChunk(chunk);
+    return con;
+}
+void                                HTTPConnectionManager::updateStatistics         (int64_t bytes, mtime_t time)
+{
+    /* Throughput is measured over the time during which at least one chunk
+     * is being fetched, so that concurrent downloads add up and idle periods
+     * (buffer full) do not count. */
+    mtime_t now = mdate();
+    this->timeSample += now - this->busySince;
+    this->busySince   = now;
+    this->activeDownloads--;
 
-    chunk->setConnection(cons.at(pos));
+    if(this->timeSample > 0 && this->bytesReadSample > 0)
+    {
+        int64_t bps = this->bytesReadSample * 8 * CLOCK_FREQ / this->timeSample;
+
+        /* a fast and a slow moving average: follow drops at once, rises slowly */
+        this->bpsFast = this->bpsFast ? (this->bpsFast + bps) / 2 : bps;
+        this->bpsSlow = this->bpsSlow ? (this->bpsSlow * 7 + bps) / 8 : bps;
+        this->bpsAvg  = __MIN(this->bpsFast, this->bpsSlow);
 
-    this->chunkCount++;
+        this->bytesReadSample   = 0;
+        this->timeSample        = 0;
+    }
 
-    if(chunk->getBitrate() <= 0)
-        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+    if(time > 0)
+        this->bpsLastChunk = bytes * 8 * CLOCK_FREQ / time;
 
-    return true;
+    this->notify();
 }
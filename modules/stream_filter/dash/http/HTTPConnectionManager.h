@@ -47,8 +47,8 @@ namespace dash
                 HTTPConnectionManager           (logic::IAdaptationLogic *adaptationLogic, stream_t *stream);
                 virtual ~HTTPConnectionManager  ();
 
+                bool    start               ();
                 void    closeAllConnections ();
-                bool    addChunk            (Chunk *chunk);
                 int     read                (block_t *block);
                 void    attach              (dash::logic::IDownloadRateObserver *observer);
                 void    notify              ();
@@ -56,24 +56,31 @@ namespace dash
             private:
                 std::vector<dash::logic::IDownloadRateObserver *>   rateObservers;
                 std::deque<Chunk *>                                 downloadQueue;
-                std::vector<PersistentConnection *>                 connectionPool;
+                std::vector<vlc_thread_t>                           fetchThreads;
                 logic::IAdaptationLogic                             *adaptationLogic;
                 stream_t                                            *stream;
+                vlc_mutex_t                                         lock;
+                vlc_cond_t                                          wait;
+                size_t                                              connections;
+                bool                                                isEOS;
+                bool                                                isClosing;
                 int                                                 chunkCount;
+                int                                                 activeDownloads;
                 int64_t                                             bpsAvg;
+                int64_t                                             bpsFast;
+                int64_t                                             bpsSlow;
                 int64_t                                             bpsLastChunk;
-                int64_t                                             bpsCurrentChunk;
-                int64_t                                             bytesReadSession;
-                int64_t                                             bytesReadChunk;
-                double                                              timeSession;
-                double                                              timeChunk;
+                int64_t                                             bytesReadSample;
+                mtime_t                                             timeSample;
+                mtime_t                                             busySince;
 
-                static const size_t     PIPELINE;
-                static const size_t     PIPELINELENGTH;
+                static const size_t     CHUNKBLOCKSIZE;
                 static const uint64_t   CHUNKDEFAULTBITRATE;
 
-                std::vector<PersistentConnection *>     getConnectionsForHost   (const std::string &hostname);
-                void                                    updateStatistics        (int bytes, double time);
+                static void*                            fetch                   (void *);
+                Chunk*                                  getNextChunk            ();
+                PersistentConnection*                   download                (PersistentConnection *con, Chunk *chunk);
+                void                                    updateStatistics        (int64_t bytes, mtime_t time);
 
         };
     }
@@ -178,6 +178,7 @@ bool                PersistentConnection::reconnect         (Chunk *chunk)
 
     while(count < this->RETRY)
     {
+        this->closeSocket();
         this->httpSocket = net_ConnectTCP(this->stream, chunk->getHostname().c_str(), chunk->getPort());
         if(this->httpSocket != -1)
             if(this->resendAllRequests())
@@ -46,14 +46,24 @@
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
+#define HLS_MAX_AHEAD 6                 /* segments downloaded ahead of playback */
+#define HLS_BANDWIDTH_WINDOW (10 * CLOCK_FREQ) /* bandwidth averaging period */
+
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
+#define THREADS_TEXT N_("Concurrent segment downloads")
+#define THREADS_LONGTEXT N_("Number of media segments fetched in parallel. " \
+    "Several connections fill the buffer faster on high latency links.")
+
 vlc_module_begin()
     set_category(CAT_INPUT)
     set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
     set_description(N_("Http Live Streaming stream filter"))
     set_capability("stream_filter", 20)
+    add_integer("hls-threads", 3, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range(1, HLS_MAX_AHEAD)
+        change_safe()
     set_callbacks(Open, Close)
 vlc_module_end()
 
@@ -102,7 +112,8 @@ struct stream_sys_t
 {
     char         *m3u8;         /* M3U8 url */
     vlc_thread_t  reload;       /* HLS m3u8 reload thread */
-    vlc_thread_t  thread;       /* HLS segment download thread */
+    vlc_thread_t *threads;      /* HLS segment download threads */
+    int           i_threads;
 
     block_t      *peeked;
 
@@ -116,8 +127,16 @@ struct stream_sys_t
         int         stream;     /* current hls_stream  */
         int         segment;    /* current segment for downloading */
         int         seek;       /* segment requested by seek (default -1) */
+        int         pending;    /* segments claimed and not yet stored */
+        bool        b_close;    /* download threads must exit */
         vlc_mutex_t lock_wait;  /* protect segment download counter */
         vlc_cond_t  wait;       /* some condition to wait on */
+
+        /* aggregate throughput of all concurrent downloads */
+        int         active;     /* downloads in progress */
+        mtime_t     busy_since; /* last time the busy period was accounted */
+        mtime_t     busy_time;  /* time with at least one download running */
+        uint64_t    busy_bytes; /* bytes received during busy_time */
     } download;
 
     /* Playback */
@@ -166,7 +185,7 @@ static ssize_t read_M3U8_from_stream(stream_t *s, uint8_t **buffer);
 static ssize_t read_M3U8_from_url(stream_t *s, const char *psz_url, uint8_t **buffer);
 static char *ReadLine(uint8_t *buffer, uint8_t **pos, size_t len);
 
-static int hls_Download(stream_t *s, segment_t *segment);
+static int hls_Download(stream_t *s, segment_t *segment, block_t **pp_data);
 
 static void* hls_Thread(void *);
 static void* hls_Reload(void *);
@@ -1186,16 +1205,17 @@ static int parse_M3U8(stream_t *s, vlc_array_t *streams, uint8_t *buffer, const
 }
 
 
-static int hls_DownloadSegmentKey(stream_t *s, segment_t *seg)
+static int hls_DownloadSegmentKey(stream_t *s, const char *psz_key_path,
+                                  int sequence, uint8_t *aes_key)
 {
-    stream_t *p_m3u8 = stream_UrlNew(s, seg->psz_key_path);
+    stream_t *p_m3u8 = stream_UrlNew(s, psz_key_path);
     if (p_m3u8 == NULL)
     {
-        msg_Err(s, "Failed to load the AES key for segment sequence %d", seg->sequence);
+        msg_Err(s, "Failed to load the AES key for segment sequence %d", sequence);
         return VLC_EGENERIC;
     }
 
-    int len = stream_Read(p_m3u8, seg->aes_key, sizeof(seg->aes_key));
+    int len = stream_Read(p_m3u8, aes_key, AES_BLOCK_SIZE);
     stream_Delete(p_m3u8);
     if (len != AES_BLOCK_SIZE)
     {
@@ -1231,26 +1251,93 @@ static int hls_ManageSegmentKeys(stream_t *s, hls_stream_t *hls)
             seg->b_key_loaded = true;
             continue;
         }
-        if (hls_DownloadSegmentKey(s, seg) != VLC_SUCCESS)
+        if (hls_DownloadSegmentKey(s, seg->psz_key_path, seg->sequence,
+                                   seg->aes_key) != VLC_SUCCESS)
             return VLC_EGENERIC;
        seg->b_key_loaded = true;
     }
     return VLC_SUCCESS;
 }
 
-static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment)
+/* Copy the key of another segment using the same key URL, if loaded.
+ * The caller holds hls->lock. */
+static bool hls_CopySegmentKey(hls_stream_t *hls, segment_t *segment)
 {
+    int count = vlc_array_count(hls->segments);
+
+    for (int i = 0; i < count; i++)
+    {
+        segment_t *other = segment_GetSegment(hls, i);
+        if (other == NULL || other == segment || !other->b_key_loaded ||
+            other->psz_key_path == NULL ||
+            strcmp(other->psz_key_path, segment->psz_key_path) != 0)
+            continue;
+
+        memcpy(segment->aes_key, other->aes_key, AES_BLOCK_SIZE);
+        segment->b_key_loaded = true;
+        return true;
+    }
+    return false;
+}
+
+static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment,
+                                 block_t *data)
+{
+    /* Several download threads decode concurrently: take a private copy
+     * of the key and IV so that the cipher runs without any lock held. */
+    uint8_t key[AES_BLOCK_SIZE], iv[AES_BLOCK_SIZE];
+
+    vlc_mutex_lock(&hls->lock);
+    while (segment->psz_key_path != NULL && !segment->b_key_loaded &&
+           !hls_CopySegmentKey(hls, segment))
+    {
+        /* The key is fetched without holding the lock, so that the other
+         * download threads and the reader are not held up meanwhile. */
+        char *psz_key_path = strdup(segment->psz_key_path);
+        int sequence = segment->sequence;
+        vlc_mutex_unlock(&hls->lock);
+
+        if (unlikely(psz_key_path == NULL))
+            return VLC_ENOMEM;
+
+        uint8_t aes_key[AES_BLOCK_SIZE];
+        int ret = hls_DownloadSegmentKey(s, psz_key_path, sequence, aes_key);
+
+        vlc_mutex_lock(&hls->lock);
+        if (ret != VLC_SUCCESS)
+        {
+            vlc_mutex_unlock(&hls->lock);
+            free(psz_key_path);
+            return VLC_EGENERIC;
+        }
+        /* The playlist may have changed the key meanwhile: fetch again */
+        if (!segment->b_key_loaded && segment->psz_key_path != NULL &&
+            strcmp(segment->psz_key_path, psz_key_path) == 0)
+        {
+            memcpy(segment->aes_key, aes_key, AES_BLOCK_SIZE);
+            segment->b_key_loaded = true;
+        }
+        free(psz_key_path);
+    }
+
     /* Did the segment need to be decoded ? */
     if (segment->psz_key_path == NULL)
+    {
+        vlc_mutex_unlock(&hls->lock);
         return VLC_SUCCESS;
-
-    /* Do we have loaded the key ? */
-    if (!segment->b_key_loaded)
+    }
+    memcpy(key, segment->aes_key, sizeof(key));
+    if (hls->b_iv_loaded)
+        memcpy(iv, hls->psz_AES_IV, sizeof(iv));
+    else
     {
-        /* No ? try to download it now */
-        if (hls_ManageSegmentKeys(s, hls) != VLC_SUCCESS)
-            return VLC_EGENERIC;
+        memset(iv, 0, AES_BLOCK_SIZE);
+        iv[15] = segment->sequence & 0xff;
+        iv[14] = (segment->sequence >> 8)& 0xff;
+        iv[13] = (segment->sequence >> 16)& 0xff;
+        iv[12] = (segment->sequence >> 24)& 0xff;
     }
+    vlc_mutex_unlock(&hls->lock);
 
     /* For now, we only decode AES-128 data */
     gcry_error_t i_gcrypt_err;
@@ -1266,8 +1353,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     }
 
     /* Set key */
-    i_gcrypt_err = gcry_cipher_setkey(aes_ctx, segment->aes_key,
-                                       sizeof(segment->aes_key));
+    i_gcrypt_err = gcry_cipher_setkey(aes_ctx, key, sizeof(key));
     if (i_gcrypt_err)
     {
         msg_Err(s, "gcry_cipher_setkey failed: %s", gpg_strerror(i_gcrypt_err));
@@ -1275,17 +1361,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
         return VLC_EGENERIC;
     }
 
-    if (hls->b_iv_loaded == false)
-    {
-        memset(hls->psz_AES_IV, 0, AES_BLOCK_SIZE);
-        hls->psz_AES_IV[15] = segment->sequence & 0xff;
-        hls->psz_AES_IV[14] = (segment->sequence >> 8)& 0xff;
-        hls->psz_AES_IV[13] = (segment->sequence >> 16)& 0xff;
-        hls->psz_AES_IV[12] = (segment->sequence >> 24)& 0xff;
-    }
-
-    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, hls->psz_AES_IV,
-                                      sizeof(hls->psz_AES_IV));
+    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, iv, sizeof(iv));
 
     if (i_gcrypt_err)
     {
@@ -1295,8 +1371,8 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     }
 
     i_gcrypt_err = gcry_cipher_decrypt(aes_ctx,
-                                       segment->data->p_buffer, /* out */
-                                       segment->data->i_buffer,
+                                       data->p_buffer, /* out */
+                                       data->i_buffer,
                                        NULL, /* in */
                                        0);
     if (i_gcrypt_err)
@@ -1307,7 +1383,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     }
     gcry_cipher_close(aes_ctx);
     /* remove the PKCS#7 padding from the buffer */
-    int pad = segment->data->p_buffer[segment->data->i_buffer-1];
+    int pad = data->p_buffer[data->i_buffer-1];
     if (pad <= 0 || pad > AES_BLOCK_SIZE)
     {
         msg_Err(s, "Bad padding character (0x%x), perhaps we failed to decrypt the segment with the correct key", pad);
@@ -1316,7 +1392,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     int count = pad;
     while (count--)
     {
-        if (segment->data->p_buffer[segment->data->i_buffer-1-count] != pad)
+        if (data->p_buffer[data->i_buffer-1-count] != pad)
         {
                 msg_Err(s, "Bad ending buffer, perhaps we failed to decrypt the segment with the correct key");
                 return VLC_EGENERIC;
@@ -1324,7 +1400,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     }
 
     /* not all the data is readable because of padding */
-    segment->data->i_buffer -= pad;
+    data->i_buffer -= pad;
 
     return VLC_SUCCESS;
 }
@@ -1556,6 +1632,47 @@ static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
     return candidate;
 }
 
+static void hls_DownloadStart(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    if (p_sys->download.active++ == 0)
+        p_sys->download.busy_since = mdate();
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+}
+
+/* Account for a finished download and return the aggregate bandwidth.
+ * Only the time during which at least one download is running counts, so
+ * that concurrent downloads add up instead of each one seeing its own share
+ * of the link, and idle periods while the buffer is full do not count. */
+static uint64_t hls_DownloadDone(stream_t *s, uint64_t size)
+{
+    stream_sys_t *p_sys = s->p_sys;
+    mtime_t now = mdate();
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    assert(p_sys->download.active > 0);
+    p_sys->download.active--;
+    p_sys->download.busy_time += now - p_sys->download.busy_since;
+    p_sys->download.busy_since = now;
+    p_sys->download.busy_bytes += size;
+
+    uint64_t bw = p_sys->download.busy_bytes * 8 * CLOCK_FREQ /
+                  __MAX(1, p_sys->download.busy_time); /* bits / s */
+    if (size > 0)
+        p_sys->bandwidth = bw;
+
+    /* forget older samples progressively */
+    if (p_sys->download.busy_time > HLS_BANDWIDTH_WINDOW)
+    {
+        p_sys->download.busy_time /= 2;
+        p_sys->download.busy_bytes /= 2;
+    }
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    return bw;
+}
+
 static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur_stream)
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1570,12 +1687,16 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
         vlc_mutex_unlock(&segment->lock);
         return VLC_SUCCESS;
     }
+    vlc_mutex_unlock(&segment->lock);
 
     /* sanity check - can we download this segment on time? */
-    if ((p_sys->bandwidth > 0) && (hls->bandwidth > 0))
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    uint64_t link_bw = p_sys->bandwidth, stream_bw = hls->bandwidth;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    if ((link_bw > 0) && (stream_bw > 0))
     {
-        uint64_t size = (segment->duration * hls->bandwidth); /* bits */
-        int estimated = (int)(size / p_sys->bandwidth);
+        uint64_t size = (segment->duration * stream_bw); /* bits */
+        int estimated = (int)(size / link_bw);
         if (estimated > segment->duration)
         {
             msg_Warn(s,"downloading segment %d predicted to take %ds, which exceeds its length (%ds)",
@@ -1583,50 +1704,70 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
         }
     }
 
-    mtime_t start = mdate();
-    if (hls_Download(s, segment) != VLC_SUCCESS)
+    /* The segment lock is not held while downloading and decoding, so that
+     * playback of the previous segments goes on in the meantime. */
+    block_t *data = NULL;
+    hls_DownloadStart(s);
+    int ret = hls_Download(s, segment, &data);
+    uint64_t bw = hls_DownloadDone(s, (ret == VLC_SUCCESS) ? data->i_buffer : 0);
+    if (ret != VLC_SUCCESS)
     {
         msg_Err(s, "downloading segment %d from stream %d failed",
                     segment->sequence, *cur_stream);
-        vlc_mutex_unlock(&segment->lock);
         return VLC_EGENERIC;
     }
-    mtime_t duration = mdate() - start;
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
     if (hls->bandwidth == 0 && segment->duration > 0)
     {
         /* Try to estimate the bandwidth for this stream */
-        hls->bandwidth = (uint64_t)(((double)segment->size * 8) / ((double)segment->duration));
+        hls->bandwidth = (uint64_t)(((double)data->i_buffer * 8) / ((double)segment->duration));
     }
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     /* If the segment is encrypted, decode it */
-    if (hls_DecodeSegmentData(s, hls, segment) != VLC_SUCCESS)
+    if (hls_DecodeSegmentData(s, hls, segment, data) != VLC_SUCCESS)
     {
-        vlc_mutex_unlock(&segment->lock);
+        block_Release(data);
         return VLC_EGENERIC;
     }
 
+    vlc_mutex_lock(&segment->lock);
+    if (segment->data == NULL)
+    {
+        segment->size = data->i_buffer;
+        segment->data = data;
+    }
+    else /* fetched twice around a seek */
+        block_Release(data);
     vlc_mutex_unlock(&segment->lock);
 
     msg_Dbg(s, "downloaded segment %d from stream %d",
                 segment->sequence, *cur_stream);
 
-    uint64_t bw = segment->size * 8 * 1000000 / __MAX(1, duration); /* bits / s */
-    p_sys->bandwidth = bw;
-    if (p_sys->b_meta && (hls->bandwidth != bw))
+    if (p_sys->b_meta)
     {
-        int newstream = BandwidthAdaptation(s, hls->id, &bw);
+        /* The download threads update the bandwidths concurrently */
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        uint64_t stream_bw = hls->bandwidth;
+        int newstream = (stream_bw != bw) ?
+                        BandwidthAdaptation(s, hls->id, &bw) : -1;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
 
         /* FIXME: we need an average here */
         if ((newstream >= 0) && (newstream != *cur_stream))
         {
             msg_Dbg(s, "detected %s bandwidth (%"PRIu64") stream",
-                     (bw >= hls->bandwidth) ? "faster" : "lower", bw);
+                     (bw >= stream_bw) ? "faster" : "lower", bw);
             *cur_stream = newstream;
         }
     }
     return VLC_SUCCESS;
 }
 
+/* Each download thread claims the next segment in playlist order, so up to
+ * hls-threads segments are in flight. Segments complete out of order; the
+ * reader consumes them in order as they become ready. */
 static void* hls_Thread(void *p_this)
 {
     stream_t *s = (stream_t *)p_this;
@@ -1636,7 +1777,11 @@ static void* hls_Thread(void *p_this)
 
     while (vlc_object_alive(s))
     {
-        hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        int stream = p_sys->download.stream;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+
+        hls_stream_t *hls = hls_Get(p_sys->hls_stream, stream);
         assert(hls);
 
         /* Sliding window (~60 seconds worth of movie) */
@@ -1644,15 +1789,15 @@ static void* hls_Thread(void *p_this)
         int count = vlc_array_count(hls->segments);
         vlc_mutex_unlock(&hls->lock);
 
+        vlc_mutex_lock(&p_sys->download.lock_wait);
         /* Is there a new segment to process? */
-        if ((!p_sys->b_live && (p_sys->playback.segment < (count - 6))) ||
+        if ((!p_sys->b_live && (p_sys->playback.segment < (count - HLS_MAX_AHEAD))) ||
             (p_sys->download.segment >= count))
         {
             /* wait */
-            vlc_mutex_lock(&p_sys->download.lock_wait);
-            while (((p_sys->download.segment - p_sys->playback.segment > 6) ||
+            while (((p_sys->download.segment - p_sys->playback.segment > HLS_MAX_AHEAD) ||
                     (p_sys->download.segment >= count)) &&
-                   (p_sys->download.seek == -1))
+                   (p_sys->download.seek == -1) && !p_sys->download.b_close)
             {
                 vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
                 if (p_sys->b_live /*&& (mdate() >= p_sys->playlist.wakeup)*/)
@@ -1660,46 +1805,51 @@ static void* hls_Thread(void *p_this)
                 if (!vlc_object_alive(s))
                     break;
             }
-            /* */
-            if (p_sys->download.seek >= 0)
-            {
-                p_sys->download.segment = p_sys->download.seek;
-                p_sys->download.seek = -1;
-            }
-            vlc_mutex_unlock(&p_sys->download.lock_wait);
         }
-
-        if (!vlc_object_alive(s)) break;
-
-        vlc_mutex_lock(&hls->lock);
-        segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
-        vlc_mutex_unlock(&hls->lock);
-
-        if ((segment != NULL) &&
-            (hls_DownloadSegmentData(s, hls, segment, &p_sys->download.stream) != VLC_SUCCESS))
+        if (p_sys->download.b_close || p_sys->b_error)
         {
-            if (!vlc_object_alive(s)) break;
-
-            if (!p_sys->b_live)
-            {
-                p_sys->b_error = true;
-                break;
-            }
+            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            break;
         }
 
-        /* download succeeded */
         /* determine next segment to download */
-        vlc_mutex_lock(&p_sys->download.lock_wait);
+        int i_segment = -1;
         if (p_sys->download.seek >= 0)
         {
             p_sys->download.segment = p_sys->download.seek;
             p_sys->download.seek = -1;
         }
-        else if (p_sys->download.segment < count)
-            p_sys->download.segment++;
-        vlc_cond_signal(&p_sys->download.wait);
+        if (p_sys->download.segment < count)
+        {
+            i_segment = p_sys->download.segment++;
+            p_sys->download.pending++;
+            /* let another thread claim the following segment */
+            vlc_cond_broadcast(&p_sys->download.wait);
+        }
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+
+        if (!vlc_object_alive(s)) break;
+        if (i_segment < 0) continue;
+
+        vlc_mutex_lock(&hls->lock);
+        segment_t *segment = segment_GetSegment(hls, i_segment);
+        vlc_mutex_unlock(&hls->lock);
+
+        bool b_failed = (segment != NULL) &&
+            (hls_DownloadSegmentData(s, hls, segment, &stream) != VLC_SUCCESS);
+
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        p_sys->download.pending--;
+        if (b_failed && !p_sys->b_live)
+            p_sys->b_error = true;
+        else if (hls_Get(p_sys->hls_stream, stream) != hls)
+            p_sys->download.stream = stream; /* bandwidth adaptation */
+        vlc_cond_broadcast(&p_sys->download.wait);
         vlc_mutex_unlock(&p_sys->download.lock_wait);
 
+        if (b_failed && (!vlc_object_alive(s) || !p_sys->b_live))
+            break;
+
         // In case of a successful download signal the read thread that data is available
         vlc_mutex_lock(&p_sys->read.lock_wait);
         vlc_cond_signal(&p_sys->read.wait);
@@ -1816,7 +1966,7 @@ static int Prefetch(stream_t *s, int *current)
 /****************************************************************************
  *
  ****************************************************************************/
-static int hls_Download(stream_t *s, segment_t *segment)
+static int hls_Download(stream_t *s, segment_t *segment, block_t **pp_data)
 {
     stream_sys_t *p_sys = s->p_sys;
     assert(segment);
@@ -1830,50 +1980,54 @@ static int hls_Download(stream_t *s, segment_t *segment)
     if (p_ts == NULL)
         return VLC_EGENERIC;
 
-    segment->size = stream_Size(p_ts);
-    assert(segment->size > 0);
+    uint64_t size = stream_Size(p_ts);
+    assert(size > 0);
 
-    segment->data = block_Alloc(segment->size);
-    if (segment->data == NULL)
+    block_t *data = block_Alloc(size);
+    if (data == NULL)
     {
         stream_Delete(p_ts);
         return VLC_ENOMEM;
     }
 
-    assert(segment->data->i_buffer == segment->size);
-
     ssize_t length = 0, curlen = 0;
-    uint64_t size;
     do
     {
         /* NOTE: Beware the size reported for a segment by the HLS server may not
          * be correct, when downloading the segment data. Therefore check the size
          * and enlarge the segment data block if necessary.
          */
-        size = stream_Size(p_ts);
-        if (size > segment->size)
+        uint64_t newsize = stream_Size(p_ts);
+        if (newsize > size)
         {
-            msg_Dbg(s, "size changed %"PRIu64, segment->size);
-            block_t *p_block = block_Realloc(segment->data, 0, size);
+            msg_Dbg(s, "size changed %"PRIu64, size);
+            block_t *p_block = block_Realloc(data, 0, newsize);
             if (p_block == NULL)
             {
                 stream_Delete(p_ts);
-                block_Release(segment->data);
-                segment->data = NULL;
+                block_Release(data);
                 return VLC_ENOMEM;
             }
-            segment->data = p_block;
-            segment->size = size;
-            assert(segment->data->i_buffer == segment->size);
-            p_block = NULL;
+            data = p_block;
+            size = newsize;
+            assert(data->i_buffer == size);
         }
-        length = stream_Read(p_ts, segment->data->p_buffer + curlen, segment->size - curlen);
+        length = stream_Read(p_ts, data->p_buffer + curlen, size - curlen);
         if (length <= 0)
             break;
         curlen += length;
     } while (vlc_object_alive(s));
 
     stream_Delete(p_ts);
+    if (curlen == 0)
+    {
+        block_Release(data);
+        return VLC_EGENERIC;
+    }
+
+    /* do not hand out the unfilled tail if the server sent less */
+    data->i_buffer = curlen;
+    *pp_data = data;
     return VLC_SUCCESS;
 }
 
@@ -2037,6 +2191,13 @@ static int Open(vlc_object_t *p_this)
     vlc_cond_init(&p_sys->wait);
     vlc_mutex_init(&p_sys->lock);
 
+    p_sys->download.seek = -1;
+    vlc_mutex_init(&p_sys->download.lock_wait);
+    vlc_cond_init(&p_sys->download.wait);
+
+    vlc_mutex_init(&p_sys->read.lock_wait);
+    vlc_cond_init(&p_sys->read.wait);
+
     /* Parse HLS m3u8 content. */
     uint8_t *buffer = NULL;
     ssize_t len = read_M3U8_from_stream(s->p_source, &buffer);
@@ -2068,13 +2229,11 @@ static int Open(vlc_object_t *p_this)
 
     p_sys->download.stream = current;
     p_sys->playback.stream = current;
-    p_sys->download.seek = -1;
-
-    vlc_mutex_init(&p_sys->download.lock_wait);
-    vlc_cond_init(&p_sys->download.wait);
 
-    vlc_mutex_init(&p_sys->read.lock_wait);
-    vlc_cond_init(&p_sys->read.wait);
+    int i_threads = var_InheritInteger(s, "hls-threads");
+    p_sys->threads = malloc(__MAX(1, i_threads) * sizeof(*p_sys->threads));
+    if (p_sys->threads == NULL)
+        goto fail;
 
     /* Initialize HLS live stream */
     if (p_sys->b_live)
@@ -2086,27 +2245,37 @@ static int Open(vlc_object_t *p_this)
 
         if (vlc_clone(&p_sys->reload, hls_Reload, s, VLC_THREAD_PRIORITY_LOW))
         {
-            goto fail_thread;
+            goto fail;
         }
     }
 
-    if (vlc_clone(&p_sys->thread, hls_Thread, s, VLC_THREAD_PRIORITY_INPUT))
+    do
+    {
+        if (vlc_clone(&p_sys->threads[p_sys->i_threads], hls_Thread, s,
+                      VLC_THREAD_PRIORITY_INPUT))
+            break;
+    }
+    while (++p_sys->i_threads < i_threads);
+
+    if (p_sys->i_threads == 0)
     {
         if (p_sys->b_live)
             vlc_join(p_sys->reload, NULL);
-        goto fail_thread;
+        goto fail;
     }
+    msg_Dbg(s, "downloading with %d threads", p_sys->i_threads);
 
     return VLC_SUCCESS;
 
-fail_thread:
+fail:
+    free(p_sys->threads);
+
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
 
     vlc_mutex_destroy(&p_sys->read.lock_wait);
     vlc_cond_destroy(&p_sys->read.wait);
 
-fail:
     /* Free hls streams */
     for (int i = 0; i < vlc_array_count(p_sys->hls_stream); i++)
     {
@@ -2144,13 +2313,16 @@ static void Close(vlc_object_t *p_this)
     /* negate the condition variable's predicate */
     p_sys->download.segment = p_sys->playback.segment = 0;
     p_sys->download.seek = 0; /* better safe than sorry */
-    vlc_cond_signal(&p_sys->download.wait);
+    p_sys->download.b_close = true;
+    vlc_cond_broadcast(&p_sys->download.wait);
     vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     /* */
     if (p_sys->b_live)
         vlc_join(p_sys->reload, NULL);
-    vlc_join(p_sys->thread, NULL);
+    for (int i = 0; i < p_sys->i_threads; i++)
+        vlc_join(p_sys->threads[i], NULL);
+    free(p_sys->threads);
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
 
@@ -2266,6 +2438,14 @@ check:
     return segment;
 }
 
+static bool segment_IsReady(segment_t *segment)
+{
+    vlc_mutex_lock(&segment->lock);
+    bool b_ready = segment->data != NULL;
+    vlc_mutex_unlock(&segment->lock);
+    return b_ready;
+}
+
 static int segment_RestorePos(segment_t *segment)
 {
     if (segment->data)
@@ -2342,6 +2522,24 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
     return used;
 }
 
+/* A VOD stream ends with its last segment, nothing more will come */
+static bool hls_EndOfStream(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if (p_sys->b_live)
+        return false;
+
+    hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->playback.stream);
+    if (hls == NULL)
+        return false;
+
+    vlc_mutex_lock(&hls->lock);
+    int count = vlc_array_count(hls->segments);
+    vlc_mutex_unlock(&hls->lock);
+    return p_sys->playback.segment >= count;
+}
+
 static int Read(stream_t *s, void *buffer, unsigned int i_read)
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -2374,6 +2572,11 @@ static int Read(stream_t *s, void *buffer, unsigned int i_read)
         // Download thread will signal once download is finished.
         // A timed wait is used to avoid deadlock in case data never arrives since the thread
         // running this read operation is also responsible for closing the stream
+        if (length == 0 && hls_EndOfStream(s))
+        {
+            vlc_mutex_unlock(&p_sys->read.lock_wait);
+            return 0;
+        }
         if (length == 0)
         {
             mtime_t start = mdate();
@@ -2624,11 +2827,13 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
         p_sys->download.seek = p_sys->playback.segment;
         vlc_cond_signal(&p_sys->download.wait);
 
-        /* Wait for download to be finished */
+        /* Wait for download to be finished. Download threads claim
+         * segments before fetching them, so also wait for the data. */
         msg_Dbg(s, "seek to segment %d", p_sys->playback.segment);
         while ((p_sys->download.seek != -1) ||
            ((p_sys->download.segment - p_sys->playback.segment < 3) &&
-                (p_sys->download.segment < count)))
+                (p_sys->download.segment < count)) ||
+           ((p_sys->download.pending > 0) && !segment_IsReady(segment)))
         {
             vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
             if (!vlc_object_alive(s) || s->b_error) break;
@@ -40,6 +40,7 @@
 #include <vlc_network.h>
 #include <vlc_fs.h>
 #include <vlc_rand.h>
+#include <vlc_atomic.h>
 #ifdef HAVE_SRTP
 # include <srtp.h>
 # include <gcrypt.h>
@@ -283,8 +284,10 @@ static int               MuxSend( sout_stream_t *, sout_stream_id_t *,
                                   block_t* );
 
 static sout_access_out_t *GrabberCreate( sout_stream_t *p_sout );
-static void* ThreadSend( void * );
+static void *ThreadSend( void * );
 static void *rtp_listen_thread( void * );
+static void rtp_input_begin( sout_stream_id_t *, block_t * );
+static void rtp_input_end( sout_stream_id_t * );
 
 static void SDPHandleUrl( sout_stream_t *, const char * );
 
@@ -343,6 +346,21 @@ struct sout_stream_sys_t
     vlc_mutex_t      lock_es;
     int              i_es;
     sout_stream_id_t **es;
+
+    /* Packet sender shared by all ES */
+    vlc_thread_t      sender;
+    vlc_mutex_t       lock_send;
+    vlc_cond_t        wait_send;
+    bool              b_sender;   /* sender thread started */
+    bool              b_sending;  /* sender is transmitting a batch */
+    int               i_send;
+    sout_stream_id_t **send;
+
+    /* Recycled packet buffers */
+    vlc_mutex_t      lock_pool;
+    block_t         *p_pool;
+    unsigned         i_pool;
+    size_t           i_pool_size;
 };
 
 typedef struct rtp_sink_t
@@ -373,9 +391,10 @@ struct sout_stream_id_t
 #ifdef HAVE_SRTP
     srtp_session_t     *srtp;
 #endif
+    block_t            *p_in;          /* block being packetized */
+    struct rtp_payload_t *p_in_payload; /* its holder, once packets refer to it */
 
     /* Packets sinks */
-    vlc_thread_t      thread;
     vlc_mutex_t       lock_sink;
     int               sinkc;
     rtp_sink_t       *sinkv;
@@ -385,7 +404,9 @@ struct sout_stream_id_t
         vlc_thread_t  thread;
     } listen;
 
-    block_fifo_t     *p_fifo;
+    /* Packets waiting for their send time (protected by lock_send) */
+    block_t          *p_queue;
+    block_t         **pp_queue_last;
     int64_t           i_caching;
 };
 
@@ -548,6 +569,20 @@ static int Open( vlc_object_t *p_this )
     vlc_mutex_init( &p_sys->lock_ts );
     vlc_mutex_init( &p_sys->lock_es );
 
+    vlc_mutex_init( &p_sys->lock_send );
+    vlc_cond_init( &p_sys->wait_send );
+    p_sys->b_sender = false;
+    p_sys->b_sending = false;
+    p_sys->i_send = 0;
+    p_sys->send = NULL;
+
+    vlc_mutex_init( &p_sys->lock_pool );
+    p_sys->p_pool = NULL;
+    p_sys->i_pool = 0;
+    p_sys->i_pool_size = var_InheritInteger( p_stream, "mtu" );
+    if( p_sys->i_pool_size <= 12 + 16 )
+        p_sys->i_pool_size = 576 - 20 - 8;
+
     psz = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "mux" );
     if( psz != NULL )
     {
@@ -561,6 +596,9 @@ static int Open( vlc_object_t *p_this )
             vlc_mutex_destroy( &p_sys->lock_sdp );
             vlc_mutex_destroy( &p_sys->lock_ts );
             vlc_mutex_destroy( &p_sys->lock_es );
+            vlc_mutex_destroy( &p_sys->lock_send );
+            vlc_cond_destroy( &p_sys->wait_send );
+            vlc_mutex_destroy( &p_sys->lock_pool );
             free( p_sys->psz_vod_session );
             free( p_sys->psz_destination );
             free( p_sys );
@@ -578,6 +616,9 @@ static int Open( vlc_object_t *p_this )
             vlc_mutex_destroy( &p_sys->lock_sdp );
             vlc_mutex_destroy( &p_sys->lock_ts );
             vlc_mutex_destroy( &p_sys->lock_es );
+            vlc_mutex_destroy( &p_sys->lock_send );
+            vlc_cond_destroy( &p_sys->wait_send );
+            vlc_mutex_destroy( &p_sys->lock_pool );
             free( p_sys->psz_vod_session );
             free( p_sys->psz_destination );
             free( p_sys );
@@ -667,9 +708,26 @@ static void Close( vlc_object_t * p_this )
     if( p_sys->rtsp != NULL )
         RtspUnsetup( p_sys->rtsp );
 
+    if( p_sys->b_sender )
+    {
+        vlc_cancel( p_sys->sender );
+        vlc_join( p_sys->sender, NULL );
+    }
+    assert( p_sys->i_send == 0 );
+
+    while( p_sys->p_pool != NULL )
+    {
+        block_t *p_next = p_sys->p_pool->p_next;
+        free( p_sys->p_pool );
+        p_sys->p_pool = p_next;
+    }
+
     vlc_mutex_destroy( &p_sys->lock_sdp );
     vlc_mutex_destroy( &p_sys->lock_ts );
     vlc_mutex_destroy( &p_sys->lock_es );
+    vlc_mutex_destroy( &p_sys->lock_send );
+    vlc_cond_destroy( &p_sys->wait_send );
+    vlc_mutex_destroy( &p_sys->lock_pool );
 
     if( p_sys->p_httpd_file )
         httpd_FileDelete( p_sys->p_httpd_file );
@@ -976,7 +1034,10 @@ static sout_stream_id_t *Add( sout_stream_t *p_stream, es_format_t *p_fmt )
     id->sinkc = 0;
     id->sinkv = NULL;
     id->rtsp_id = NULL;
-    id->p_fifo = NULL;
+    id->p_queue = NULL;
+    id->pp_queue_last = &id->p_queue;
+    id->p_in = NULL;
+    id->p_in_payload = NULL;
     id->listen.fd = NULL;
 
     id->b_first_packet = true;
@@ -1181,15 +1242,20 @@ static sout_stream_id_t *Add( sout_stream_t *p_stream, es_format_t *p_fmt )
         id->rtsp_id = RtspAddId( p_sys->rtsp, id, GetDWBE( id->ssrc ),
                                  id->rtp_fmt.clock_rate, mcast_fd );
 
-    id->p_fifo = block_FifoNew();
-    if( unlikely(id->p_fifo == NULL) )
-        goto error;
-    if( vlc_clone( &id->thread, ThreadSend, id, VLC_THREAD_PRIORITY_HIGHEST ) )
+    /* All ES of this output share a single sender thread */
+    vlc_mutex_lock( &p_sys->lock_send );
+    if( !p_sys->b_sender )
     {
-        block_FifoRelease( id->p_fifo );
-        id->p_fifo = NULL;
-        goto error;
+        if( vlc_clone( &p_sys->sender, ThreadSend, p_stream,
+                       VLC_THREAD_PRIORITY_HIGHEST ) )
+        {
+            vlc_mutex_unlock( &p_sys->lock_send );
+            goto error;
+        }
+        p_sys->b_sender = true;
     }
+    TAB_APPEND( p_sys->i_send, p_sys->send, id );
+    vlc_mutex_unlock( &p_sys->lock_send );
 
     /* Update p_sys context */
     vlc_mutex_lock( &p_sys->lock_es );
@@ -1224,12 +1290,13 @@ static int Del( sout_stream_t *p_stream, sout_stream_id_t *id )
     TAB_REMOVE( p_sys->i_es, p_sys->es, id );
     vlc_mutex_unlock( &p_sys->lock_es );
 
-    if( likely(id->p_fifo != NULL) )
-    {
-        vlc_cancel( id->thread );
-        vlc_join( id->thread, NULL );
-        block_FifoRelease( id->p_fifo );
-    }
+    /* Detach from the sender, and wait until it does not use us anymore */
+    vlc_mutex_lock( &p_sys->lock_send );
+    TAB_REMOVE( p_sys->i_send, p_sys->send, id );
+    while( p_sys->b_sending )
+        vlc_cond_wait( &p_sys->wait_send, &p_sys->lock_send );
+    vlc_mutex_unlock( &p_sys->lock_send );
+    block_ChainRelease( id->p_queue );
 
     free( id->rtp_fmt.fmtp );
 
@@ -1285,10 +1352,12 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_t *id,
                                           p_buffer->i_pts);
         }
 
-        if( id->rtp_fmt.pf_packetize( id, p_buffer ) )
+        rtp_input_begin( id, p_buffer );
+        int i_ret = id->rtp_fmt.pf_packetize( id, p_buffer );
+        rtp_input_end( id );
+        if( i_ret )
             break;
 
-        block_Release( p_buffer );
         p_buffer = p_next;
     }
     return VLC_SUCCESS;
@@ -1392,92 +1461,457 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
 }
 
 /****************************************************************************
- * RTP send
+ * RTP packets
  ****************************************************************************/
-static void* ThreadSend( void *data )
+/* Packet buffers are recycled, as many are allocated and released per second
+ * with always the same size. */
+#define RTP_POOL_MAX 256
+
+/* Room for the SRTP authentication tag */
+#define RTP_PACKET_TRAILER 10
+
+/* Most pieces of payload a packet refers to instead of holding them */
+#define RTP_PACKET_REFS 8
+
+/* Pieces smaller than this are copied, which costs less than referring to
+ * them and handing them separately to the kernel: MPEG-TS packets from the
+ * muxer are. */
+#define RTP_PACKET_COPY_MAX 256
+
+/* Input block shared by the packets that refer to its data */
+typedef struct rtp_payload_t
+{
+    block_t    *p_block;
+    atomic_uint i_refs;
+} rtp_payload_t;
+
+typedef struct
+{
+    block_t            self;
+    sout_stream_sys_t *owner;
+    /* Payload left in the input blocks, following the first i_data bytes
+     * of the buffer. It is counted in i_buffer. */
+    size_t             i_data;
+    unsigned           i_ref;
+    struct
+    {
+        rtp_payload_t *p_payload;
+        const uint8_t *p_data;
+        size_t         i_data;
+    } refv[RTP_PACKET_REFS];
+    /* followed by the packet buffer */
+} rtp_packet_t;
+
+static void rtp_payload_release( rtp_payload_t *p_payload )
+{
+    if( atomic_fetch_sub( &p_payload->i_refs, 1 ) == 1 )
+    {
+        block_Release( p_payload->p_block );
+        free( p_payload );
+    }
+}
+
+/* Sets the block being packetized, which packets may refer to */
+static void rtp_input_begin( sout_stream_id_t *id, block_t *in )
+{
+    id->p_in = in;
+    id->p_in_payload = NULL;
+}
+
+/* Releases the block being packetized, or leaves it to the packets that
+ * refer to it */
+static void rtp_input_end( sout_stream_id_t *id )
+{
+    if( id->p_in_payload != NULL )
+        rtp_payload_release( id->p_in_payload );
+    else
+        block_Release( id->p_in );
+    id->p_in = NULL;
+    id->p_in_payload = NULL;
+}
+
+static void rtp_packet_release( block_t *block )
+{
+    rtp_packet_t *pkt = (rtp_packet_t *)block;
+    sout_stream_sys_t *p_sys = pkt->owner;
+
+    for( unsigned i = 0; i < pkt->i_ref; i++ )
+        rtp_payload_release( pkt->refv[i].p_payload );
+    pkt->i_ref = 0;
+
+    vlc_mutex_lock( &p_sys->lock_pool );
+    if( p_sys->i_pool < RTP_POOL_MAX )
+    {
+        block->p_next = p_sys->p_pool;
+        p_sys->p_pool = block;
+        p_sys->i_pool++;
+        block = NULL;
+    }
+    vlc_mutex_unlock( &p_sys->lock_pool );
+    free( block );
+}
+
+/**
+ * Allocates a block for an RTP packet of the given size (including the RTP
+ * header). Packets up to the MTU come from a pool of recycled buffers.
+ */
+block_t *rtp_packet_alloc( sout_stream_id_t *id, size_t size )
+{
+    sout_stream_sys_t *p_sys = id->p_stream->p_sys;
+    const size_t bufsize = p_sys->i_pool_size + RTP_PACKET_TRAILER;
+
+    if( size > p_sys->i_pool_size )
+        return block_Alloc( size );
+
+    vlc_mutex_lock( &p_sys->lock_pool );
+    block_t *block = p_sys->p_pool;
+    if( block != NULL )
+    {
+        p_sys->p_pool = block->p_next;
+        p_sys->i_pool--;
+    }
+    vlc_mutex_unlock( &p_sys->lock_pool );
+
+    if( block == NULL )
+    {
+        rtp_packet_t *pkt = malloc( sizeof (*pkt) + bufsize );
+        if( unlikely(pkt == NULL) )
+            return NULL;
+        pkt->owner = p_sys;
+        pkt->i_ref = 0;
+        block = &pkt->self;
+    }
+
+    block_Init( block, (rtp_packet_t *)block + 1, bufsize );
+    block->i_buffer = size;
+    block->pf_release = rtp_packet_release;
+    return block;
+}
+
+/* Copies the payload a packet refers to into its buffer */
+static void rtp_packet_flatten( block_t *block )
+{
+    if( block->pf_release != rtp_packet_release )
+        return;
+
+    rtp_packet_t *pkt = (rtp_packet_t *)block;
+    uint8_t *p = block->p_buffer + pkt->i_data;
+
+    for( unsigned i = 0; i < pkt->i_ref; i++ )
+    {
+        memcpy( p, pkt->refv[i].p_data, pkt->refv[i].i_data );
+        p += pkt->refv[i].i_data;
+        rtp_payload_release( pkt->refv[i].p_payload );
+    }
+    pkt->i_ref = 0;
+}
+
+#ifdef HAVE_SENDMMSG
+/* Points iov to the pieces of a packet, and returns how many there are */
+static unsigned rtp_packet_iov( const block_t *block, struct iovec *iov )
 {
+    const rtp_packet_t *pkt = (const rtp_packet_t *)block;
+
+    iov[0].iov_base = block->p_buffer;
+    iov[0].iov_len = block->i_buffer;
+    if( block->pf_release != rtp_packet_release || pkt->i_ref == 0 )
+        return 1;
+
+    iov[0].iov_len = pkt->i_data;
+    for( unsigned i = 0; i < pkt->i_ref; i++ )
+    {
+        iov[1 + i].iov_base = (void *)pkt->refv[i].p_data;
+        iov[1 + i].iov_len = pkt->refv[i].i_data;
+    }
+    return 1 + pkt->i_ref;
+}
+#endif
+
+/**
+ * Appends payload from the block being packetized to an RTP packet. Packets
+ * from rtp_packet_alloc() only refer to it, so that it is not copied before
+ * the kernel does. Nothing can be written to the packet buffer afterwards.
+ */
+void rtp_packet_attach( sout_stream_id_t *id, block_t *out,
+                        const uint8_t *p_data, size_t i_data )
+{
+    rtp_packet_t *pkt = (rtp_packet_t *)out;
+
+    assert( id->p_in != NULL );
+    assert( p_data >= id->p_in->p_buffer
+         && p_data + i_data <= id->p_in->p_buffer + id->p_in->i_buffer );
+
+    if( out->pf_release != rtp_packet_release
+     || ( pkt->i_ref == 0 && i_data < RTP_PACKET_COPY_MAX ) )
+    {
+        /* Larger than the MTU, allocated with room for the payload, or
+         * small enough to copy */
+        memcpy( out->p_buffer + out->i_buffer, p_data, i_data );
+        out->i_buffer += i_data;
+        return;
+    }
+
+    if( id->p_in_payload == NULL )
+    {
+        rtp_payload_t *p_payload = malloc( sizeof (*p_payload) );
+        if( likely(p_payload != NULL) )
+        {
+            p_payload->p_block = id->p_in;
+            atomic_init( &p_payload->i_refs, 1 ); /* the packetizer one */
+            id->p_in_payload = p_payload;
+        }
+    }
+
+    if( pkt->i_ref == RTP_PACKET_REFS || id->p_in_payload == NULL )
+    {
+        /* Too many pieces, or out of memory: copy */
+        rtp_packet_flatten( out );
+        memcpy( out->p_buffer + out->i_buffer, p_data, i_data );
+        out->i_buffer += i_data;
+        return;
+    }
+
+    if( pkt->i_ref == 0 )
+        pkt->i_data = out->i_buffer;
+    atomic_fetch_add( &id->p_in_payload->i_refs, 1 );
+    pkt->refv[pkt->i_ref].p_payload = id->p_in_payload;
+    pkt->refv[pkt->i_ref].p_data = p_data;
+    pkt->refv[pkt->i_ref].i_data = i_data;
+    pkt->i_ref++;
+    out->i_buffer += i_data;
+}
+
+/****************************************************************************
+ * RTP send
+ ****************************************************************************/
 #ifdef _WIN32
 # define ENOBUFS      WSAENOBUFS
 # define EAGAIN       WSAEWOULDBLOCK
 # define EWOULDBLOCK  WSAEWOULDBLOCK
 #endif
-    sout_stream_id_t *id = data;
-    unsigned i_caching = id->i_caching;
 
-    for (;;)
+/* Maximum number of packets handed to the kernel in one go */
+#define RTP_SEND_BATCH 32
+
+/**
+ * Checks why an RTP packet could not be sent.
+ * @return -1 if the sink is broken and must be removed, 1 if the packet
+ * should be sent again, 0 if it is lost
+ */
+static int SendFailed( int fd )
+{
+    if( net_errno == EAGAIN || net_errno == EWOULDBLOCK
+     || net_errno == ENOBUFS || net_errno == ENOMEM )
+        return 0;
+
+    int type;
+    getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &(socklen_t){ sizeof(type) });
+    if( type != SOCK_DGRAM )
+        return -1; /* Broken connection */
+
+    /* ICMP soft error: ignore and retry */
+    return 1;
+}
+
+/**
+ * Sends a batch of RTP packets to one sink.
+ * @return true if the sink is broken and must be removed
+ */
+static bool SendBatch( int fd, block_t *const *pktv, unsigned pktc )
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgv[pktc];
+    struct iovec iov[pktc][1 + RTP_PACKET_REFS];
+
+    for( unsigned i = 0; i < pktc; i++ )
+    {
+        memset( &msgv[i], 0, sizeof (msgv[i]) );
+        msgv[i].msg_hdr.msg_iov = iov[i];
+        msgv[i].msg_hdr.msg_iovlen = rtp_packet_iov( pktv[i], iov[i] );
+    }
+
+    for( unsigned i = 0; i < pktc; )
+    {
+        int val = sendmmsg( fd, msgv + i, pktc - i, 0 );
+        if( val > 0 )
+        {
+            i += val;
+            continue;
+        }
+
+        val = SendFailed( fd );
+        if( val < 0 )
+            return true;
+        if( val > 0 )
+            sendmsg( fd, &msgv[i].msg_hdr, 0 );
+        i++;
+    }
+#else
+    for( unsigned i = 0; i < pktc; i++ )
+    {
+        if( send( fd, pktv[i]->p_buffer, pktv[i]->i_buffer, 0 ) != -1 )
+            continue;
+
+        int val = SendFailed( fd );
+        if( val < 0 )
+            return true;
+        if( val > 0 )
+            send( fd, pktv[i]->p_buffer, pktv[i]->i_buffer, 0 );
+    }
+#endif
+    return false;
+}
+
+/* Sends packets of one ES to all its sinks */
+static void SendPackets( sout_stream_id_t *id, block_t *const *pktv,
+                         unsigned pktc )
+{
+    vlc_mutex_lock( &id->lock_sink );
+    unsigned deadc = 0; /* How many dead sockets? */
+    int deadv[id->sinkc]; /* Dead sockets list */
+
+    for( int i = 0; i < id->sinkc; i++ )
     {
-        block_t *out = block_FifoGet( id->p_fifo );
-        block_cleanup_push (out);
+#ifdef HAVE_SRTP
+        if( !id->srtp ) /* FIXME: SRTCP support */
+#endif
+            for( unsigned j = 0; j < pktc; j++ )
+                SendRTCP( id->sinkv[i].rtcp, pktv[j] );
+
+        if( SendBatch( id->sinkv[i].rtp_fd, pktv, pktc ) )
+            deadv[deadc++] = id->sinkv[i].rtp_fd;
+    }
+    id->i_seq_sent_next = ntohs(((uint16_t *) pktv[pktc - 1]->p_buffer)[1]) + 1;
+    vlc_mutex_unlock( &id->lock_sink );
 
+    for( unsigned i = 0; i < deadc; i++ )
+    {
+        msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
+        rtp_del_sink( id, deadv[i] );
+    }
+}
+
+/* Sends all the packets from a queue of one ES */
+static void SendQueue( sout_stream_id_t *id, block_t *p_queue )
+{
+    block_t *pktv[RTP_SEND_BATCH];
+    unsigned pktc = 0;
+
+    while( p_queue != NULL )
+    {
+        block_t *out = p_queue;
+        p_queue = out->p_next;
+        out->p_next = NULL;
+
+#ifndef HAVE_SENDMMSG
+        /* Sent from a single buffer */
+        rtp_packet_flatten( out );
+#endif
 #ifdef HAVE_SRTP
         if( id->srtp )
         {   /* FIXME: this is awfully inefficient */
+            rtp_packet_flatten( out );
+
             size_t len = out->i_buffer;
             out = block_Realloc( out, 0, len + 10 );
             out->i_buffer = len;
 
-            int canc = vlc_savecancel ();
             int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
             if( val )
             {
                 msg_Dbg( id->p_stream, "SRTP sending error: %s",
                          vlc_strerror_c(val) );
                 block_Release( out );
-                out = NULL;
+                continue;
             }
-            else
-                out->i_buffer = len;
+            out->i_buffer = len;
         }
-        if (out)
-            mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-        if (out == NULL)
-            continue;
-#else
-        mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
 #endif
+        pktv[pktc++] = out;
+        if( pktc == RTP_SEND_BATCH )
+        {
+            SendPackets( id, pktv, pktc );
+            for( unsigned i = 0; i < pktc; i++ )
+                block_Release( pktv[i] );
+            pktc = 0;
+        }
+    }
 
-        ssize_t len = out->i_buffer;
-        int canc = vlc_savecancel ();
+    if( pktc > 0 )
+    {
+        SendPackets( id, pktv, pktc );
+        for( unsigned i = 0; i < pktc; i++ )
+            block_Release( pktv[i] );
+    }
+}
 
-        vlc_mutex_lock( &id->lock_sink );
-        unsigned deadc = 0; /* How many dead sockets? */
-        int deadv[id->sinkc]; /* Dead sockets list */
+/* This thread sends the packets of all ES when they are due */
+static void *ThreadSend( void *data )
+{
+    sout_stream_t *p_stream = data;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
 
-        for( int i = 0; i < id->sinkc; i++ )
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_sys->lock_send );
+        mutex_cleanup_push( &p_sys->lock_send );
+        for( ;; )
         {
-#ifdef HAVE_SRTP
-            if( !id->srtp ) /* FIXME: SRTCP support */
-#endif
-                SendRTCP( id->sinkv[i].rtcp, out );
+            mtime_t deadline = INT64_MAX;
 
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
+            for( int i = 0; i < p_sys->i_send; i++ )
             {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
+                const sout_stream_id_t *id = p_sys->send[i];
+                if( id->p_queue != NULL
+                 && id->p_queue->i_dts + id->i_caching < deadline )
+                    deadline = id->p_queue->i_dts + id->i_caching;
             }
+
+            if( deadline == INT64_MAX )
+                vlc_cond_wait( &p_sys->wait_send, &p_sys->lock_send );
+            else
+            if( deadline > mdate() )
+                vlc_cond_timedwait( &p_sys->wait_send, &p_sys->lock_send,
+                                    deadline );
+            else
+                break;
         }
-        id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
-        vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
+        vlc_cleanup_pop();
+
+        /* Take all the packets that are due, from every ES */
+        int i_send = p_sys->i_send;
+        sout_stream_id_t *idv[i_send];
+        block_t *queuev[i_send];
+        mtime_t now = mdate();
 
-        for( unsigned i = 0; i < deadc; i++ )
+        for( int i = 0; i < i_send; i++ )
         {
-            msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
-            rtp_del_sink( id, deadv[i] );
+            sout_stream_id_t *id = p_sys->send[i];
+            block_t **pp = &id->p_queue;
+
+            while( *pp != NULL && (*pp)->i_dts + id->i_caching <= now )
+                pp = &(*pp)->p_next;
+
+            idv[i] = id;
+            queuev[i] = id->p_queue;
+            id->p_queue = *pp;
+            *pp = NULL;
+            if( id->p_queue == NULL )
+                id->pp_queue_last = &id->p_queue;
         }
-        vlc_restorecancel (canc);
+        p_sys->b_sending = true;
+        vlc_mutex_unlock( &p_sys->lock_send );
+
+        int canc = vlc_savecancel();
+        for( int i = 0; i < i_send; i++ )
+            if( queuev[i] != NULL )
+                SendQueue( idv[i], queuev[i] );
+
+        vlc_mutex_lock( &p_sys->lock_send );
+        p_sys->b_sending = false;
+        vlc_cond_broadcast( &p_sys->wait_send );
+        vlc_mutex_unlock( &p_sys->lock_send );
+        vlc_restorecancel( canc );
     }
     return NULL;
 }
@@ -1657,7 +2091,15 @@ void rtp_packetize_common( sout_stream_id_t *id, block_t *out,
 
 void rtp_packetize_send( sout_stream_id_t *id, block_t *out )
 {
-    block_FifoPut( id->p_fifo, out );
+    sout_stream_sys_t *p_sys = id->p_stream->p_sys;
+
+    assert( out->p_next == NULL );
+    vlc_mutex_lock( &p_sys->lock_send );
+    if( id->p_queue == NULL )
+        vlc_cond_signal( &p_sys->wait_send );
+    *id->pp_queue_last = out;
+    id->pp_queue_last = &out->p_next;
+    vlc_mutex_unlock( &p_sys->lock_send );
 }
 
 /**
@@ -1742,7 +2184,7 @@ static ssize_t AccessOutGrabberWriteBuffer( sout_stream_t *p_stream,
         if( p_sys->packet == NULL )
         {
             /* allocate a new packet */
-            p_sys->packet = block_Alloc( id->i_mtu );
+            p_sys->packet = rtp_packet_alloc( id, id->i_mtu );
             rtp_packetize_common( id, p_sys->packet, 1, i_dts );
             p_sys->packet->i_dts = i_dts;
             p_sys->packet->i_length = p_buffer->i_length / i_packet;
@@ -1752,10 +2194,7 @@ static ssize_t AccessOutGrabberWriteBuffer( sout_stream_t *p_stream,
         i_size = __MIN( i_data,
                         (unsigned)(id->i_mtu - p_sys->packet->i_buffer) );
 
-        memcpy( &p_sys->packet->p_buffer[p_sys->packet->i_buffer],
-                p_data, i_size );
-
-        p_sys->packet->i_buffer += i_size;
+        rtp_packet_attach( id, p_sys->packet, p_data, i_size );
         p_data += i_size;
         i_data -= i_size;
     }
@@ -1771,12 +2210,15 @@ static ssize_t AccessOutGrabberWrite( sout_access_out_t *p_access,
 
     while( p_buffer )
     {
-        block_t *p_next;
+        block_t *p_next = p_buffer->p_next;
+        sout_stream_id_t *id = p_stream->p_sys->es[0];
 
+        /* The packets may refer to the muxed data rather than copy it */
+        p_buffer->p_next = NULL;
+        rtp_input_begin( id, p_buffer );
         AccessOutGrabberWriteBuffer( p_stream, p_buffer );
+        rtp_input_end( id );
 
-        p_next = p_buffer->p_next;
-        block_Release( p_buffer );
         p_buffer = p_next;
     }
 
@@ -57,6 +57,9 @@ int64_t rtp_get_ts( const sout_stream_t *p_stream, const sout_stream_id_t *id,
 void rtp_packetize_common (sout_stream_id_t *id, block_t *out,
                            int b_marker, int64_t i_pts);
 void rtp_packetize_send (sout_stream_id_t *id, block_t *out);
+block_t *rtp_packet_alloc (sout_stream_id_t *id, size_t size);
+void rtp_packet_attach (sout_stream_id_t *id, block_t *out,
+                        const uint8_t *data, size_t len);
 size_t rtp_mtu (const sout_stream_id_t *id);
 
 int rtp_packetize_xiph_config( sout_stream_id_t *id, const char *fmtp,
@@ -578,7 +578,7 @@ int rtp_packetize_xiph_config( sout_stream_id_t *id, const char *fmtp,
     for( int i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 18 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 18 + i_payload );
 
         unsigned fragtype, numpkts;
         if (i_count == 1)
@@ -633,7 +633,7 @@ static int rtp_packetize_xiph( sout_stream_id_t *id, block_t *in )
     for( int i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 18 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 18 + i_payload );
 
         unsigned fragtype, numpkts;
         if (i_count == 1)
@@ -689,7 +689,7 @@ static int rtp_packetize_mpa( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 16 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 16 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, (i == i_count - 1)?1:0, in->i_pts );
@@ -781,7 +781,7 @@ static int rtp_packetize_mpv( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 16 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 16 + i_payload );
         /* MBZ:5 T:1 TR:10 AN:1 N:1 S:1 B:1 E:1 P:3 FBV:1 BFC:3 FFV:1 FFC:3 */
         uint32_t      h = ( i_temporal_ref << 16 )|
                           ( b_sequence_start << 13 )|
@@ -823,7 +823,7 @@ static int rtp_packetize_ac3( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 14 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 14 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, (i == i_count - 1)?1:0, in->i_pts );
@@ -859,7 +859,7 @@ static int rtp_packetize_split( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 12 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 12 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, (i == i_count - 1),
@@ -892,7 +892,7 @@ static int rtp_packetize_swab( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 12 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 12 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, (i == i_count - 1),
@@ -930,7 +930,7 @@ static int rtp_packetize_mp4a_latm( sout_stream_id_t *id, block_t *in )
 
         if( i != 0 )
             latmhdrsize = 0;
-        out = block_Alloc( 12 + latmhdrsize + i_payload );
+        out = rtp_packet_alloc( id, 12 + latmhdrsize + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, ((i == i_count - 1) ? 1 : 0),
@@ -977,7 +977,7 @@ static int rtp_packetize_mp4a( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 16 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 16 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, ((i == i_count - 1)?1:0),
@@ -1037,7 +1037,8 @@ static int rtp_packetize_h263( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int      i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( RTP_H263_PAYLOAD_START + i_payload );
+        block_t *out = rtp_packet_alloc( id,
+                                        RTP_H263_PAYLOAD_START + i_payload );
         b_p_bit = (i == 0) ? 1 : 0;
         h = ( b_p_bit << 10 )|
             ( b_v_bit << 9  )|
@@ -1090,15 +1091,13 @@ rtp_packetize_h264_nal( sout_stream_id_t *id,
     if( i_data <= i_max )
     {
         /* Single NAL unit packet */
-        block_t *out = block_Alloc( 12 + i_data );
+        block_t *out = rtp_packet_alloc( id, 12 + i_data );
         out->i_dts    = i_dts;
         out->i_length = i_length;
 
         /* */
         rtp_packetize_common( id, out, b_last, i_pts );
-        out->i_buffer = 12 + i_data;
-
-        memcpy( &out->p_buffer[12], p_data, i_data );
+        rtp_packet_attach( id, out, p_data, i_data );
 
         rtp_packetize_send( id, out );
     }
@@ -1114,20 +1113,20 @@ rtp_packetize_h264_nal( sout_stream_id_t *id,
         for( i = 0; i < i_count; i++ )
         {
             const int i_payload = __MIN( i_data, i_max-2 );
-            block_t *out = block_Alloc( 12 + 2 + i_payload );
+            block_t *out = rtp_packet_alloc( id, 12 + 2 + i_payload );
             out->i_dts    = i_dts + i * i_length / i_count;
             out->i_length = i_length / i_count;
 
             /* */
             rtp_packetize_common( id, out, (b_last && i_payload == i_data),
                                     i_pts );
-            out->i_buffer = 14 + i_payload;
+            out->i_buffer = 14;
 
             /* FU indicator */
             out->p_buffer[12] = 0x00 | (i_nal_hdr & 0x60) | 28;
             /* FU header */
             out->p_buffer[13] = ( i == 0 ? 0x80 : 0x00 ) | ( (i == i_count-1) ? 0x40 : 0x00 )  | i_nal_type;
-            memcpy( &out->p_buffer[14], p_data, i_payload );
+            rtp_packet_attach( id, out, p_data, i_payload );
 
             rtp_packetize_send( id, out );
 
@@ -1191,7 +1190,7 @@ static int rtp_packetize_amr( sout_stream_id_t *id, block_t *in )
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 14 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 14 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, ((i == i_count - 1)?1:0),
@@ -1241,7 +1240,7 @@ static int rtp_packetize_t140( sout_stream_id_t *id, block_t *in )
             }
         }
 
-        block_t *out = block_Alloc( 12 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 12 + i_payload );
         if( out == NULL )
             return VLC_SUCCESS;
 
@@ -1292,7 +1291,7 @@ static int rtp_packetize_spx( sout_stream_id_t *id, block_t *in )
       Allocate a new RTP p_output block of the appropriate size. 
       Allow for 12 extra bytes of RTP header. 
     */
-    p_out = block_Alloc( 12 + i_payload_size );
+    p_out = rtp_packet_alloc( id, 12 + i_payload_size );
 
     if ( i_payload_padding )
     {
@@ -1348,7 +1347,7 @@ static int rtp_packetize_g726( sout_stream_id_t *id, block_t *in, int i_pad )
     while( i_data > 0 )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 12 + i_payload );
+        block_t *out = rtp_packet_alloc( id, 12 + i_payload );
 
         /* rtp common header */
         rtp_packetize_common( id, out, 0,
@@ -1405,7 +1404,8 @@ static int rtp_packetize_vp8( sout_stream_id_t *id, block_t *in )
     for( int i = 0; i < i_count; i++ )
     {
         int i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( RTP_VP8_PAYLOAD_START + i_payload );
+        block_t *out = rtp_packet_alloc( id,
+                                        RTP_VP8_PAYLOAD_START + i_payload );
         if ( out == NULL )
             return VLC_ENOMEM;
 
@@ -1564,7 +1564,7 @@ static int rtp_packetize_jpeg( sout_stream_id_t *id, block_t *in )
         if ( i_payload <= 0 )
             return VLC_EGENERIC;
 
-        block_t *out = block_Alloc( 12 + hdr_size + i_payload );
+        block_t *out = rtp_packet_alloc( id, 12 + hdr_size + i_payload );
         if( out == NULL )
             return VLC_ENOMEM;
 
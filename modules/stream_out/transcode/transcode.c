@@ -76,6 +76,17 @@
 #define MAXHEIGHT_TEXT N_("Maximum video height")
 #define MAXHEIGHT_LONGTEXT N_( \
     "Maximum output video height." )
+#define RENDITIONS_TEXT N_("Video renditions")
+#define RENDITIONS_LONGTEXT N_( \
+    "Extra encodings of the video from the same decoded pictures, as a " \
+    "comma-separated list of WIDTHxHEIGHT@KBPS (eg: 640x360@800). A zero " \
+    "width or height keeps the aspect ratio. Each one is a new video " \
+    "stream, with the ES id of the source plus 1000 times its rank." )
+#define GOP_TEXT N_("Key frame interval")
+#define GOP_LONGTEXT N_( \
+    "Fixed number of frames between key frames, in all the video " \
+    "encodings. Renditions need the same key frames, so this defaults to " \
+    "2 seconds of video with them." )
 #define VFILTER_TEXT N_("Video filter")
 #define VFILTER_LONGTEXT N_( \
     "Video filters will be applied to the video streams (after overlays " \
@@ -186,6 +197,10 @@ vlc_module_begin ()
                  MAXWIDTH_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "maxheight", 0, MAXHEIGHT_TEXT,
                  MAXHEIGHT_LONGTEXT, true )
+    add_string( SOUT_CFG_PREFIX "renditions", NULL, RENDITIONS_TEXT,
+                RENDITIONS_LONGTEXT, false )
+    add_integer( SOUT_CFG_PREFIX "gop", 0, GOP_TEXT,
+                 GOP_LONGTEXT, true )
     add_module_list( SOUT_CFG_PREFIX "vfilter", "video filter2",
                      NULL, VFILTER_TEXT, VFILTER_LONGTEXT, false )
 
@@ -235,7 +250,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "hurry-up", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "osd", "audio-sync", "high-priority", "maxwidth", "maxheight",
-    NULL
+    "renditions", "gop", NULL
 };
 
 /*****************************************************************************
@@ -367,6 +382,35 @@ static int Open( vlc_object_t *p_this )
         p_sys->psz_vf2 = NULL;
     free( psz_string );
 
+    p_sys->i_renditions = 0;
+    p_sys->p_renditions = NULL;
+    psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "renditions" );
+    if( psz_string && *psz_string )
+    {
+        char *psz_save;
+        for( char *psz_tok = strtok_r( psz_string, ",", &psz_save ); psz_tok;
+             psz_tok = strtok_r( NULL, ",", &psz_save ) )
+        {
+            transcode_rendition_cfg_t cfg = { 0, 0, 0 };
+
+            if( sscanf( psz_tok, "%ux%u@%d", &cfg.i_width, &cfg.i_height,
+                        &cfg.i_bitrate ) < 2 ||
+                ( cfg.i_width == 0 && cfg.i_height == 0 ) )
+            {
+                msg_Warn( p_stream, "invalid rendition `%s'", psz_tok );
+                continue;
+            }
+            if( cfg.i_bitrate <= 0 )
+                cfg.i_bitrate = p_sys->i_vbitrate;
+            else if( cfg.i_bitrate < 16000 )
+                cfg.i_bitrate *= 1000;
+            TAB_APPEND( p_sys->i_renditions, p_sys->p_renditions, cfg );
+        }
+    }
+    free( psz_string );
+
+    p_sys->i_gop = var_GetInteger( p_stream, SOUT_CFG_PREFIX "gop" );
+
     p_sys->b_deinterlace = var_GetBool( p_stream, SOUT_CFG_PREFIX "deinterlace" );
 
     psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "deinterlace-module" );
@@ -491,6 +535,7 @@ static void Close( vlc_object_t * p_this )
     free( p_sys->psz_alang );
 
     free( p_sys->psz_vf2 );
+    free( p_sys->p_renditions );
 
     config_ChainDestroy( p_sys->p_video_cfg );
     free( p_sys->psz_venc );
@@ -14,6 +14,14 @@
 /*100ms is around the limit where people are noticing lipsync issues*/
 #define MASTER_SYNC_MAX_DRIFT 100000
 
+/* Size and bitrate of an extra video encoding */
+typedef struct
+{
+    unsigned int i_width;   /* 0 to keep the aspect ratio */
+    unsigned int i_height;  /* 0 to keep the aspect ratio */
+    int          i_bitrate;
+} transcode_rendition_cfg_t;
+
 struct sout_stream_sys_t
 {
     sout_stream_id_t *id_video;
@@ -55,6 +63,11 @@ struct sout_stream_sys_t
 
     char            *psz_vf2;
 
+    /* Extra encodings of the video, from the same decoded pictures */
+    int             i_renditions;
+    transcode_rendition_cfg_t *p_renditions;
+    int             i_gop;      /* fixed key frame interval, 0 if free */
+
     /* SPU */
     vlc_fourcc_t    i_scodec;   /* codec spu (0 if not transcode) */
     char            *psz_senc;
@@ -77,6 +90,14 @@ struct sout_stream_sys_t
 
 struct aout_filters;
 
+/* Extra encoding of a video stream */
+typedef struct
+{
+    encoder_t       *p_encoder;
+    filter_chain_t  *p_f_chain; /**< Scaling from the main encoder input */
+    void            *id;        /**< id of the out stream */
+} transcode_rendition_t;
+
 struct sout_stream_id_t
 {
     bool            b_transcode;
@@ -100,6 +121,10 @@ struct sout_stream_id_t
     /* Encoder */
     encoder_t       *p_encoder;
 
+    /* Video renditions */
+    int                   i_renditions;
+    transcode_rendition_t *p_renditions;
+
     /* Sync */
     date_t          interpolated_pts; /**< Incoming calculated PTS */
     date_t          next_output_pts; /**< output calculated PTS */
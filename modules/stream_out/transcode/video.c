@@ -540,6 +540,12 @@ static void transcode_video_encoder_init( sout_stream_t *p_stream,
         id->p_encoder->fmt_in.video.i_frame_rate,
         id->p_encoder->fmt_in.video.i_frame_rate_base,
         0 );
+    /* Renditions are cut at the same key frames, so their GOP is fixed */
+    id->p_encoder->i_iframes = p_sys->i_gop;
+    if( id->p_encoder->i_iframes <= 0 && p_sys->i_renditions > 0 )
+        id->p_encoder->i_iframes = 2 * id->p_encoder->fmt_in.video.i_frame_rate /
+                                   id->p_encoder->fmt_in.video.i_frame_rate_base;
+
      msg_Dbg( p_stream, "source fps %d/%d, destination %d/%d",
         id->p_decoder->fmt_out.video.i_frame_rate,
         id->p_decoder->fmt_out.video.i_frame_rate_base,
@@ -624,6 +630,180 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
     return VLC_SUCCESS;
 }
 
+/* Scale the main encoder input to the rendition encoder input */
+static int transcode_rendition_chain( sout_stream_t *p_stream,
+                                      sout_stream_id_t *id,
+                                      transcode_rendition_t *p_rend )
+{
+    const es_format_t *p_fmt_in = &id->p_encoder->fmt_in;
+    const es_format_t *p_fmt_out = &p_rend->p_encoder->fmt_in;
+
+    if( p_rend->p_f_chain )
+        filter_chain_Delete( p_rend->p_f_chain );
+
+    p_rend->p_f_chain = filter_chain_New( p_stream, "video filter2", false,
+                                          transcode_video_filter_allocation_init,
+                                          transcode_video_filter_allocation_clear,
+                                          p_stream->p_sys );
+    if( !p_rend->p_f_chain )
+        return VLC_EGENERIC;
+    filter_chain_Reset( p_rend->p_f_chain, p_fmt_in, p_fmt_out );
+
+    if( ( p_fmt_in->video.i_chroma != p_fmt_out->video.i_chroma ||
+          p_fmt_in->video.i_width != p_fmt_out->video.i_width ||
+          p_fmt_in->video.i_height != p_fmt_out->video.i_height ) &&
+        !filter_chain_AppendFilter( p_rend->p_f_chain, NULL, NULL,
+                                    p_fmt_in, p_fmt_out ) )
+    {
+        msg_Err( p_stream, "cannot scale to %ix%i",
+                 p_fmt_out->video.i_width, p_fmt_out->video.i_height );
+        /* The rendition is not encoded anymore */
+        filter_chain_Delete( p_rend->p_f_chain );
+        p_rend->p_f_chain = NULL;
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void transcode_rendition_close( sout_stream_t *p_stream,
+                                       transcode_rendition_t *p_rend )
+{
+    if( p_rend->id )
+        sout_StreamIdDel( p_stream->p_next, p_rend->id );
+    if( p_rend->p_f_chain )
+        filter_chain_Delete( p_rend->p_f_chain );
+    if( p_rend->p_encoder->p_module )
+        module_unneed( p_rend->p_encoder, p_rend->p_encoder->p_module );
+    es_format_Clean( &p_rend->p_encoder->fmt_in );
+    es_format_Clean( &p_rend->p_encoder->fmt_out );
+    vlc_object_release( p_rend->p_encoder );
+}
+
+/* Open the extra encoders, once the main one is opened. They take the
+ * pictures given to the main encoder, so only the scaling is done again. */
+static void transcode_video_renditions_open( sout_stream_t *p_stream,
+                                             sout_stream_id_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    const es_format_t *p_main_in = &id->p_encoder->fmt_in;
+    const es_format_t *p_main_out = &id->p_encoder->fmt_out;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        const transcode_rendition_cfg_t *p_cfg = &p_sys->p_renditions[i];
+        transcode_rendition_t rend = { NULL, NULL, NULL };
+        unsigned i_src_width = p_main_in->video.i_visible_width;
+        unsigned i_src_height = p_main_in->video.i_visible_height;
+        unsigned i_width = p_cfg->i_width;
+        unsigned i_height = p_cfg->i_height;
+
+        /* Keep the aspect ratio of the main encoding */
+        if( i_width == 0 )
+            i_width = (uint64_t)i_height * i_src_width / i_src_height;
+        if( i_height == 0 )
+            i_height = (uint64_t)i_width * i_src_height / i_src_width;
+        i_width = __MAX( i_width & ~1, 2 );
+        i_height = __MAX( i_height & ~1, 2 );
+
+        rend.p_encoder = sout_EncoderCreate( p_stream );
+        if( !rend.p_encoder )
+            continue;
+        encoder_t *p_enc = rend.p_encoder;
+
+        es_format_Init( &p_enc->fmt_in, VIDEO_ES, p_main_in->i_codec );
+        p_enc->fmt_in.video = p_main_in->video;
+        p_enc->fmt_in.video.p_palette = NULL;
+        p_enc->fmt_in.video.i_width = p_enc->fmt_in.video.i_visible_width = i_width;
+        p_enc->fmt_in.video.i_height = p_enc->fmt_in.video.i_visible_height = i_height;
+        p_enc->fmt_in.video.i_x_offset = p_enc->fmt_in.video.i_y_offset = 0;
+        vlc_ureduce( &p_enc->fmt_in.video.i_sar_num, &p_enc->fmt_in.video.i_sar_den,
+                     (uint64_t)p_main_out->video.i_sar_num * i_src_width * i_height,
+                     (uint64_t)p_main_out->video.i_sar_den * i_src_height * i_width,
+                     0 );
+
+        es_format_Init( &p_enc->fmt_out, VIDEO_ES, p_sys->i_vcodec );
+        p_enc->fmt_out.video = p_enc->fmt_in.video;
+        p_enc->fmt_out.i_bitrate = p_cfg->i_bitrate;
+        p_enc->fmt_out.i_id = p_main_out->i_id + 1000 * ( i + 1 );
+        p_enc->fmt_out.i_group = p_main_out->i_group;
+
+        p_enc->i_threads = p_sys->i_threads;
+        p_enc->i_iframes = id->p_encoder->i_iframes;
+        p_enc->p_cfg = p_sys->p_video_cfg;
+
+        p_enc->p_module = module_need( p_enc, "encoder", p_sys->psz_venc, true );
+        if( !p_enc->p_module )
+        {
+            msg_Err( p_stream, "cannot find video encoder for rendition %ux%u",
+                     i_width, i_height );
+            transcode_rendition_close( p_stream, &rend );
+            continue;
+        }
+        p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
+        p_enc->fmt_out.i_codec = vlc_fourcc_GetCodec( VIDEO_ES, p_enc->fmt_out.i_codec );
+
+        if( transcode_rendition_chain( p_stream, id, &rend ) )
+        {
+            transcode_rendition_close( p_stream, &rend );
+            continue;
+        }
+
+        rend.id = sout_StreamIdAdd( p_stream->p_next, &p_enc->fmt_out );
+        if( !rend.id )
+        {
+            msg_Err( p_stream, "cannot add rendition %ux%u", i_width, i_height );
+            transcode_rendition_close( p_stream, &rend );
+            continue;
+        }
+
+        msg_Dbg( p_stream, "rendition %ux%u %d kb/s (es id %d)", i_width,
+                 i_height, p_cfg->i_bitrate / 1000, p_enc->fmt_out.i_id );
+        TAB_APPEND( id->i_renditions, id->p_renditions, rend );
+    }
+}
+
+/* Encode a picture given to the main encoder in every rendition */
+static void transcode_video_renditions_encode( sout_stream_t *p_stream,
+                                               sout_stream_id_t *id,
+                                               picture_t *p_pic )
+{
+    for( int i = 0; i < id->i_renditions; i++ )
+    {
+        transcode_rendition_t *p_rend = &id->p_renditions[i];
+        picture_t *p_scaled;
+
+        if( !p_rend->p_f_chain )
+            continue;
+        p_scaled = filter_chain_VideoFilter( p_rend->p_f_chain,
+                                             picture_Hold( p_pic ) );
+        if( !p_scaled )
+            continue;
+
+        block_t *p_block = p_rend->p_encoder->pf_encode_video( p_rend->p_encoder,
+                                                               p_scaled );
+        picture_Release( p_scaled );
+        if( p_block )
+            sout_StreamIdSend( p_stream->p_next, p_rend->id, p_block );
+    }
+}
+
+static void transcode_video_renditions_flush( sout_stream_t *p_stream,
+                                              sout_stream_id_t *id )
+{
+    for( int i = 0; i < id->i_renditions; i++ )
+    {
+        transcode_rendition_t *p_rend = &id->p_renditions[i];
+        block_t *p_out = NULL, *p_block;
+
+        do {
+            p_block = p_rend->p_encoder->pf_encode_video( p_rend->p_encoder, NULL );
+            block_ChainAppend( &p_out, p_block );
+        } while( p_block );
+        if( p_out )
+            sout_StreamIdSend( p_stream->p_next, p_rend->id, p_out );
+    }
+}
+
 void transcode_video_close( sout_stream_t *p_stream,
                                    sout_stream_id_t *id )
 {
@@ -660,6 +840,13 @@ void transcode_video_close( sout_stream_t *p_stream,
         filter_chain_Delete( id->p_f_chain );
     if( id->p_uf_chain )
         filter_chain_Delete( id->p_uf_chain );
+
+    /* Close renditions */
+    for( int i = 0; i < id->i_renditions; i++ )
+        transcode_rendition_close( p_stream, &id->p_renditions[i] );
+    free( id->p_renditions );
+    id->p_renditions = NULL;
+    id->i_renditions = 0;
 }
 
 static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream_t *p_stream, sout_stream_id_t *id, block_t **out )
@@ -731,6 +918,8 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
     /*This pts is handled, increase clock to next one*/
     date_Increment( &id->next_output_pts, id->p_encoder->fmt_in.video.i_frame_rate_base );
 
+    transcode_video_renditions_encode( p_stream, id, p_pic );
+
     if( p_sys->i_threads == 0 )
     {
         block_t *p_block;
@@ -768,6 +957,7 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
             {
                 picture_Copy( p_tmp, p_pic2 );
                 p_tmp->date = date_Get( &id->next_output_pts );
+                transcode_video_renditions_encode( p_stream, id, p_tmp );
                 vlc_mutex_lock( &p_sys->lock_out );
                 picture_fifo_Push( p_sys->pp_pics, p_tmp );
                 vlc_cond_signal( &p_sys->cond );
@@ -778,6 +968,7 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
         {
             block_t *p_block;
             p_pic->date = date_Get( &id->next_output_pts );
+            transcode_video_renditions_encode( p_stream, id, p_pic );
             p_block = id->p_encoder->pf_encode_video(id->p_encoder, p_pic);
             block_ChainAppend( out, p_block );
         }
@@ -804,6 +995,8 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_t *id,
 
     if( unlikely( in == NULL ) )
     {
+        transcode_video_renditions_flush( p_stream, id );
+
         if( p_sys->i_threads == 0 )
         {
             block_t *p_block;
@@ -874,6 +1067,9 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_t *id,
             transcode_video_encoder_init( p_stream, id );
             conversion_video_filter_append( id );
             memcpy( &p_sys->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
+
+            for( int i = 0; i < id->i_renditions; i++ )
+                transcode_rendition_chain( p_stream, id, &id->p_renditions[i] );
         }
 
 
@@ -899,6 +1095,8 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_t *id,
             }
             date_Set( &id->interpolated_pts, p_pic->date );
             date_Set( &id->next_output_pts, p_pic->date );
+
+            transcode_video_renditions_open( p_stream, id );
         }
 
         /*Input lipsync and drop check */
@@ -135,6 +135,10 @@ static const char *const ppsz_sizes_text[] = {
 #define YUVP_TEXT N_("Use YUVP renderer")
 #define YUVP_LONGTEXT N_("This renders the font using \"paletized YUV\". " \
   "This option is only needed if you want to encode into DVB subtitles" )
+#define CACHE_TEXT N_("Glyph cache size (kB)")
+#define CACHE_LONGTEXT N_("Amount of memory used to keep rendered glyphs " \
+  "from one subtitle to the next. Large character sets, such as CJK, " \
+  "benefit from a bigger cache. 0 disables the cache." )
 
 static const int pi_color_values[] = {
   0x00000000, 0x00808080, 0x00C0C0C0, 0x00FFFFFF, 0x00800000,
@@ -229,6 +233,8 @@ vlc_module_begin ()
 
     add_bool( "freetype-yuvp", false, YUVP_TEXT,
               YUVP_LONGTEXT, true )
+    add_integer_with_range( "freetype-cache-size", 4096, 0, 262144,
+                            CACHE_TEXT, CACHE_LONGTEXT, true )
     set_capability( "text renderer", 100 )
     add_shortcut( "text" )
     set_callbacks( Create, Destroy )
@@ -261,6 +267,59 @@ struct line_desc_t
     line_character_t *p_character;
 };
 
+/* Face loaded for a given font name and style, kept across subtitles so
+ * that it is not reopened for every one of them. The least recently used
+ * face is closed beyond FACE_CACHE_MAX faces, and a failed lookup is only
+ * remembered for FACE_CACHE_RETRY, so that a font installed later is found */
+typedef struct
+{
+    char    *psz_fontname;
+    int      i_style_flags;
+    FT_Face  p_face;            /* NULL if the default face is to be used */
+    unsigned i_last_use;
+    mtime_t  i_retry;           /* date of the next lookup if p_face is NULL */
+} face_cache_entry_t;
+
+#define FACE_CACHE_MAX   16
+#define FACE_CACHE_RETRY (CLOCK_FREQ * 10)
+
+/* Rendered glyph. The bitmaps are positioned relatively to the fractional
+ * part of the pen, so that they can be moved anywhere on the pixel grid */
+typedef struct glyph_cache_entry_t glyph_cache_entry_t;
+struct glyph_cache_entry_t
+{
+    glyph_cache_entry_t *p_hash_next;
+    glyph_cache_entry_t *p_lru_prev;    /* more recently used */
+    glyph_cache_entry_t *p_lru_next;    /* less recently used */
+
+    /* Key */
+    FT_Face   p_face;
+    int       i_glyph_index;
+    int       i_font_size;
+    int       i_style_flags;
+    int       i_outline_radius;
+    FT_Vector pen_frac;
+    FT_Vector pen_shadow_frac;
+
+    /* Value */
+    FT_Glyph  glyph;
+    FT_Glyph  outline;
+    FT_Glyph  shadow;
+    FT_Vector advance;
+    size_t    i_size;
+};
+
+#define GLYPH_CACHE_BUCKETS 1024
+
+typedef struct
+{
+    glyph_cache_entry_t *pp_bucket[GLYPH_CACHE_BUCKETS];
+    glyph_cache_entry_t *p_lru_first;
+    glyph_cache_entry_t *p_lru_last;
+    size_t               i_size;        /* in bytes */
+    size_t               i_max_size;    /* in bytes, 0 to disable */
+} glyph_cache_t;
+
 /*****************************************************************************
  * filter_sys_t: freetype local data
  *****************************************************************************
@@ -290,6 +349,12 @@ struct filter_sys_t
                                bool bold, bool italic, int size,
                                int *index);
 
+    /* Caches */
+    face_cache_entry_t **pp_faces;
+    int                  i_faces;
+    unsigned             i_face_use;
+    glyph_cache_t        glyph_cache;
+    int                  i_outline_radius;  /* current stroker radius */
 };
 
 /* */
@@ -1042,19 +1107,241 @@ static FT_Face LoadFace( filter_t *p_filter,
     return p_face;
 }
 
-static int GetGlyph( filter_t *p_filter,
-                     FT_Glyph *pp_glyph,   FT_BBox *p_glyph_bbox,
-                     FT_Glyph *pp_outline, FT_BBox *p_outline_bbox,
-                     FT_Glyph *pp_shadow,  FT_BBox *p_shadow_bbox,
+static void GlyphCacheEvictFace( glyph_cache_t *, FT_Face );
 
-                     FT_Face  p_face,
-                     int i_glyph_index,
-                     int i_style_flags,
-                     FT_Vector *p_pen,
-                     FT_Vector *p_pen_shadow )
+static void FaceCacheRemove( filter_sys_t *p_sys, int i )
+{
+    face_cache_entry_t *p_entry = p_sys->pp_faces[i];
+
+    TAB_REMOVE( p_sys->i_faces, p_sys->pp_faces, p_entry );
+    if( p_entry->p_face )
+    {
+        /* The glyphs are keyed by face, whose address may be reused */
+        GlyphCacheEvictFace( &p_sys->glyph_cache, p_entry->p_face );
+        FT_Done_Face( p_entry->p_face );
+    }
+    free( p_entry->psz_fontname );
+    free( p_entry );
+}
+
+static FT_Face GetFace( filter_t *p_filter,
+                        const text_style_t *p_style )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_style_flags = p_style->i_style_flags & (STYLE_BOLD | STYLE_ITALIC);
+
+    for( int i = 0; i < p_sys->i_faces; i++ )
+    {
+        face_cache_entry_t *p_entry = p_sys->pp_faces[i];
+        if( p_entry->i_style_flags != i_style_flags ||
+            strcmp( p_entry->psz_fontname, p_style->psz_fontname ) )
+            continue;
+
+        if( !p_entry->p_face && mdate() >= p_entry->i_retry )
+        {
+            FaceCacheRemove( p_sys, i );
+            break;
+        }
+        p_entry->i_last_use = ++p_sys->i_face_use;
+        return p_entry->p_face;
+    }
+
+    FT_Face p_face = LoadFace( p_filter, p_style );
+
+    face_cache_entry_t *p_entry = malloc( sizeof(*p_entry) );
+    if( p_entry )
+        p_entry->psz_fontname = strdup( p_style->psz_fontname );
+    if( unlikely(!p_entry || !p_entry->psz_fontname) )
+    {
+        free( p_entry );
+        if( p_face )
+            FT_Done_Face( p_face );
+        return NULL;
+    }
+
+    /* The face in use is always the last one returned, so the least
+     * recently used one can be closed */
+    if( p_sys->i_faces >= FACE_CACHE_MAX )
+    {
+        int i_oldest = 0;
+        for( int i = 1; i < p_sys->i_faces; i++ )
+            if( p_sys->pp_faces[i]->i_last_use <
+                p_sys->pp_faces[i_oldest]->i_last_use )
+                i_oldest = i;
+        FaceCacheRemove( p_sys, i_oldest );
+    }
+
+    p_entry->i_style_flags = i_style_flags;
+    p_entry->p_face = p_face;
+    p_entry->i_last_use = ++p_sys->i_face_use;
+    p_entry->i_retry = mdate() + FACE_CACHE_RETRY;
+    TAB_APPEND( p_sys->i_faces, p_sys->pp_faces, p_entry );
+
+    return p_face;
+}
+
+static void FaceCacheClean( filter_sys_t *p_sys )
+{
+    while( p_sys->i_faces > 0 )
+        FaceCacheRemove( p_sys, p_sys->i_faces - 1 );
+    TAB_CLEAN( p_sys->i_faces, p_sys->pp_faces );
+}
+
+static size_t GlyphSize( FT_Glyph glyph )
+{
+    if( !glyph )
+        return 0;
+    const FT_Bitmap *p_bitmap = &((FT_BitmapGlyph)glyph)->bitmap;
+    return sizeof(FT_BitmapGlyphRec) + abs( p_bitmap->pitch ) * p_bitmap->rows;
+}
+
+static unsigned GlyphCacheHash( const glyph_cache_entry_t *p_key )
+{
+    uint32_t i_hash = (uintptr_t)p_key->p_face;
+    i_hash = i_hash * 31 + p_key->i_glyph_index;
+    i_hash = i_hash * 31 + p_key->i_font_size;
+    i_hash = i_hash * 31 + p_key->i_style_flags;
+    i_hash = i_hash * 31 + p_key->pen_frac.x;
+    i_hash = i_hash * 31 + p_key->pen_frac.y;
+    i_hash ^= i_hash >> 16;
+    return i_hash % GLYPH_CACHE_BUCKETS;
+}
+
+static bool GlyphCacheKeyEquals( const glyph_cache_entry_t *p_a,
+                                 const glyph_cache_entry_t *p_b )
+{
+    return p_a->p_face == p_b->p_face &&
+           p_a->i_glyph_index == p_b->i_glyph_index &&
+           p_a->i_font_size == p_b->i_font_size &&
+           p_a->i_style_flags == p_b->i_style_flags &&
+           p_a->i_outline_radius == p_b->i_outline_radius &&
+           p_a->pen_frac.x == p_b->pen_frac.x &&
+           p_a->pen_frac.y == p_b->pen_frac.y &&
+           p_a->pen_shadow_frac.x == p_b->pen_shadow_frac.x &&
+           p_a->pen_shadow_frac.y == p_b->pen_shadow_frac.y;
+}
+
+static void GlyphCacheInit( glyph_cache_t *p_cache, size_t i_max_size )
+{
+    for( unsigned i = 0; i < GLYPH_CACHE_BUCKETS; i++ )
+        p_cache->pp_bucket[i] = NULL;
+    p_cache->p_lru_first = NULL;
+    p_cache->p_lru_last = NULL;
+    p_cache->i_size = 0;
+    p_cache->i_max_size = i_max_size;
+}
+
+static void GlyphCacheUnlink( glyph_cache_t *p_cache, glyph_cache_entry_t *p_entry )
+{
+    if( p_entry->p_lru_prev )
+        p_entry->p_lru_prev->p_lru_next = p_entry->p_lru_next;
+    else
+        p_cache->p_lru_first = p_entry->p_lru_next;
+    if( p_entry->p_lru_next )
+        p_entry->p_lru_next->p_lru_prev = p_entry->p_lru_prev;
+    else
+        p_cache->p_lru_last = p_entry->p_lru_prev;
+}
+
+static void GlyphCacheLinkFirst( glyph_cache_t *p_cache, glyph_cache_entry_t *p_entry )
+{
+    p_entry->p_lru_prev = NULL;
+    p_entry->p_lru_next = p_cache->p_lru_first;
+    if( p_cache->p_lru_first )
+        p_cache->p_lru_first->p_lru_prev = p_entry;
+    else
+        p_cache->p_lru_last = p_entry;
+    p_cache->p_lru_first = p_entry;
+}
+
+static void GlyphCacheEvict( glyph_cache_t *p_cache, glyph_cache_entry_t *p_entry )
+{
+    glyph_cache_entry_t **pp = &p_cache->pp_bucket[GlyphCacheHash( p_entry )];
+    while( *pp != p_entry )
+        pp = &(*pp)->p_hash_next;
+    *pp = p_entry->p_hash_next;
+
+    GlyphCacheUnlink( p_cache, p_entry );
+    p_cache->i_size -= p_entry->i_size;
+
+    FT_Done_Glyph( p_entry->glyph );
+    if( p_entry->outline )
+        FT_Done_Glyph( p_entry->outline );
+    if( p_entry->shadow )
+        FT_Done_Glyph( p_entry->shadow );
+    free( p_entry );
+}
+
+static void GlyphCacheClean( glyph_cache_t *p_cache )
+{
+    while( p_cache->p_lru_last )
+        GlyphCacheEvict( p_cache, p_cache->p_lru_last );
+}
+
+static void GlyphCacheEvictFace( glyph_cache_t *p_cache, FT_Face p_face )
+{
+    glyph_cache_entry_t *p_entry = p_cache->p_lru_first;
+    while( p_entry )
+    {
+        glyph_cache_entry_t *p_next = p_entry->p_lru_next;
+        if( p_entry->p_face == p_face )
+            GlyphCacheEvict( p_cache, p_entry );
+        p_entry = p_next;
+    }
+}
+
+static glyph_cache_entry_t *GlyphCacheGet( glyph_cache_t *p_cache,
+                                           const glyph_cache_entry_t *p_key )
+{
+    glyph_cache_entry_t *p_entry = p_cache->pp_bucket[GlyphCacheHash( p_key )];
+    while( p_entry && !GlyphCacheKeyEquals( p_entry, p_key ) )
+        p_entry = p_entry->p_hash_next;
+
+    if( p_entry && p_entry != p_cache->p_lru_first )
+    {
+        GlyphCacheUnlink( p_cache, p_entry );
+        GlyphCacheLinkFirst( p_cache, p_entry );
+    }
+    return p_entry;
+}
+
+/* Takes ownership of the glyphs of p_rendered on success */
+static glyph_cache_entry_t *GlyphCachePut( glyph_cache_t *p_cache,
+                                           const glyph_cache_entry_t *p_rendered )
 {
-    if( FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT ) &&
-        FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_DEFAULT ) )
+    const size_t i_size = sizeof(glyph_cache_entry_t) +
+                          GlyphSize( p_rendered->glyph ) +
+                          GlyphSize( p_rendered->outline ) +
+                          GlyphSize( p_rendered->shadow );
+    if( i_size > p_cache->i_max_size )
+        return NULL;
+
+    glyph_cache_entry_t *p_entry = malloc( sizeof(*p_entry) );
+    if( unlikely(!p_entry) )
+        return NULL;
+    *p_entry = *p_rendered;
+    p_entry->i_size = i_size;
+
+    const unsigned i_bucket = GlyphCacheHash( p_entry );
+    p_entry->p_hash_next = p_cache->pp_bucket[i_bucket];
+    p_cache->pp_bucket[i_bucket] = p_entry;
+    GlyphCacheLinkFirst( p_cache, p_entry );
+    p_cache->i_size += i_size;
+
+    while( p_cache->i_size > p_cache->i_max_size )
+        GlyphCacheEvict( p_cache, p_cache->p_lru_last );
+
+    return p_entry;
+}
+
+/* Renders the glyph described by the key part of p_entry */
+static int RenderGlyph( filter_t *p_filter, glyph_cache_entry_t *p_entry )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    FT_Face p_face = p_entry->p_face;
+
+    if( FT_Load_Glyph( p_face, p_entry->i_glyph_index, FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT ) &&
+        FT_Load_Glyph( p_face, p_entry->i_glyph_index, FT_LOAD_DEFAULT ) )
     {
         msg_Err( p_filter, "unable to render text FT_Load_Glyph failed" );
         return VLC_EGENERIC;
@@ -1064,9 +1351,9 @@ static int GetGlyph( filter_t *p_filter,
      * ie. if the font we have loaded is NOT already in the
      * style that the tags want, then switch it on; if they
      * are then don't. */
-    if ((i_style_flags & STYLE_BOLD) && !(p_face->style_flags & FT_STYLE_FLAG_BOLD))
+    if ((p_entry->i_style_flags & STYLE_BOLD) && !(p_face->style_flags & FT_STYLE_FLAG_BOLD))
         FT_GlyphSlot_Embolden( p_face->glyph );
-    if ((i_style_flags & STYLE_ITALIC) && !(p_face->style_flags & FT_STYLE_FLAG_ITALIC))
+    if ((p_entry->i_style_flags & STYLE_ITALIC) && !(p_face->style_flags & FT_STYLE_FLAG_ITALIC))
         FT_GlyphSlot_Oblique( p_face->glyph );
 
     FT_Glyph glyph;
@@ -1075,31 +1362,26 @@ static int GetGlyph( filter_t *p_filter,
         msg_Err( p_filter, "unable to render text FT_Get_Glyph failed" );
         return VLC_EGENERIC;
     }
+    p_entry->advance = p_face->glyph->advance;
 
     FT_Glyph outline = NULL;
-    if( p_filter->p_sys->p_stroker )
+    if( p_sys->p_stroker )
     {
         outline = glyph;
-        if( FT_Glyph_StrokeBorder( &outline, p_filter->p_sys->p_stroker, 0, 0 ) )
+        if( FT_Glyph_StrokeBorder( &outline, p_sys->p_stroker, 0, 0 ) )
             outline = NULL;
     }
 
     FT_Glyph shadow = NULL;
-    if( p_filter->p_sys->style.i_shadow_alpha > 0 )
+    if( p_sys->style.i_shadow_alpha > 0 )
     {
         shadow = outline ? outline : glyph;
-        if( FT_Glyph_To_Bitmap( &shadow, FT_RENDER_MODE_NORMAL, p_pen_shadow, 0  ) )
-        {
+        if( FT_Glyph_To_Bitmap( &shadow, FT_RENDER_MODE_NORMAL, &p_entry->pen_shadow_frac, 0 ) )
             shadow = NULL;
-        }
-        else
-        {
-            FT_Glyph_Get_CBox( shadow, ft_glyph_bbox_pixels, p_shadow_bbox );
-        }
     }
-    *pp_shadow = shadow;
+    p_entry->shadow = shadow;
 
-    if( FT_Glyph_To_Bitmap( &glyph, FT_RENDER_MODE_NORMAL, p_pen, 1) )
+    if( FT_Glyph_To_Bitmap( &glyph, FT_RENDER_MODE_NORMAL, &p_entry->pen_frac, 1) )
     {
         FT_Done_Glyph( glyph );
         if( outline )
@@ -1108,32 +1390,95 @@ static int GetGlyph( filter_t *p_filter,
             FT_Done_Glyph( shadow );
         return VLC_EGENERIC;
     }
-    FT_Glyph_Get_CBox( glyph, ft_glyph_bbox_pixels, p_glyph_bbox );
-    *pp_glyph = glyph;
+    p_entry->glyph = glyph;
 
-    if( outline )
+    if( outline &&
+        FT_Glyph_To_Bitmap( &outline, FT_RENDER_MODE_NORMAL, &p_entry->pen_frac, 1 ) )
     {
-        FT_Glyph_To_Bitmap( &outline, FT_RENDER_MODE_NORMAL, p_pen, 1 );
-        FT_Glyph_Get_CBox( outline, ft_glyph_bbox_pixels, p_outline_bbox );
+        FT_Done_Glyph( outline );
+        outline = NULL;
     }
-    *pp_outline = outline;
+    p_entry->outline = outline;
 
     return VLC_SUCCESS;
 }
 
-static void FixGlyph( FT_Glyph glyph, FT_BBox *p_bbox, FT_Face face, const FT_Vector *p_pen )
+/* Moves a rendered glyph (or a copy of it) by the integer part of the pen */
+static FT_Glyph PlaceGlyph( FT_Glyph glyph, bool b_copy,
+                            const FT_Vector *p_pen, FT_BBox *p_bbox )
+{
+    if( !glyph || ( b_copy && FT_Glyph_Copy( glyph, &glyph ) ) )
+        return NULL;
+
+    FT_BitmapGlyph glyph_bmp = (FT_BitmapGlyph)glyph;
+    glyph_bmp->left += p_pen->x >> 6;
+    glyph_bmp->top  += p_pen->y >> 6;
+    FT_Glyph_Get_CBox( glyph, ft_glyph_bbox_pixels, p_bbox );
+    return glyph;
+}
+
+static int GetGlyph( filter_t *p_filter,
+                     FT_Glyph *pp_glyph,   FT_BBox *p_glyph_bbox,
+                     FT_Glyph *pp_outline, FT_BBox *p_outline_bbox,
+                     FT_Glyph *pp_shadow,  FT_BBox *p_shadow_bbox,
+                     FT_Vector *p_advance,
+
+                     FT_Face  p_face,
+                     int i_glyph_index,
+                     int i_font_size,
+                     int i_style_flags,
+                     const FT_Vector *p_pen,
+                     const FT_Vector *p_pen_shadow )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    glyph_cache_entry_t rendered = {
+        .p_face = p_face,
+        .i_glyph_index = i_glyph_index,
+        .i_font_size = i_font_size,
+        .i_style_flags = i_style_flags & (STYLE_BOLD | STYLE_ITALIC),
+        .i_outline_radius = p_sys->p_stroker ? p_sys->i_outline_radius : 0,
+        .pen_frac = { .x = p_pen->x & 63, .y = p_pen->y & 63 },
+        .pen_shadow_frac = { .x = p_pen_shadow->x & 63, .y = p_pen_shadow->y & 63 },
+    };
+
+    const glyph_cache_entry_t *p_entry = GlyphCacheGet( &p_sys->glyph_cache, &rendered );
+    if( !p_entry )
+    {
+        if( RenderGlyph( p_filter, &rendered ) )
+            return VLC_EGENERIC;
+        p_entry = GlyphCachePut( &p_sys->glyph_cache, &rendered );
+    }
+
+    /* Cached glyphs are copied, as the lines own their glyphs */
+    const bool b_copy = p_entry != NULL;
+    if( !p_entry )
+        p_entry = &rendered;
+
+    *pp_glyph = PlaceGlyph( p_entry->glyph, b_copy, p_pen, p_glyph_bbox );
+    if( !*pp_glyph )
+        return VLC_EGENERIC;
+    *pp_outline = PlaceGlyph( p_entry->outline, b_copy, p_pen, p_outline_bbox );
+    *pp_shadow  = PlaceGlyph( p_entry->shadow, b_copy, p_pen_shadow, p_shadow_bbox );
+    *p_advance  = p_entry->advance;
+
+    return VLC_SUCCESS;
+}
+
+static void FixGlyph( FT_Glyph glyph, FT_BBox *p_bbox,
+                      const FT_Vector *p_advance, const FT_Vector *p_pen )
 {
     FT_BitmapGlyph glyph_bmp = (FT_BitmapGlyph)glyph;
     if( p_bbox->xMin >= p_bbox->xMax )
     {
         p_bbox->xMin = FT_CEIL(p_pen->x);
-        p_bbox->xMax = FT_CEIL(p_pen->x + face->glyph->advance.x);
+        p_bbox->xMax = FT_CEIL(p_pen->x + p_advance->x);
         glyph_bmp->left = p_bbox->xMin;
     }
     if( p_bbox->yMin >= p_bbox->yMax )
     {
         p_bbox->yMax = FT_CEIL(p_pen->y);
-        p_bbox->yMin = FT_CEIL(p_pen->y + face->glyph->advance.y);
+        p_bbox->yMin = FT_CEIL(p_pen->y + p_advance->y);
         glyph_bmp->top  = p_bbox->yMax;
     }
 }
@@ -1322,11 +1667,9 @@ static int ProcessLines( filter_t *p_filter,
             /* (Re)load/reconfigure the face if needed */
             if( !FaceStyleEquals( p_current_style, p_previous_style ) )
             {
-                if( p_face )
-                    FT_Done_Face( p_face );
                 p_previous_style = NULL;
 
-                p_face = LoadFace( p_filter, p_current_style );
+                p_face = GetFace( p_filter, p_current_style );
             }
             FT_Face p_current_face = p_face ? p_face : p_sys->p_face;
             if( !p_previous_style || p_previous_style->i_font_size != p_current_style->i_font_size )
@@ -1338,6 +1681,7 @@ static int ProcessLines( filter_t *p_filter,
                     double f_outline_thickness = var_InheritInteger( p_filter, "freetype-outline-thickness" ) / 100.0;
                     f_outline_thickness = VLC_CLIP( f_outline_thickness, 0.0, 0.5 );
                     int i_radius = (p_current_style->i_font_size << 6) * f_outline_thickness;
+                    p_sys->i_outline_radius = i_radius;
                     FT_Stroker_Set( p_sys->p_stroker,
                                     i_radius,
                                     FT_STROKER_LINECAP_ROUND,
@@ -1378,20 +1722,23 @@ static int ProcessLines( filter_t *p_filter,
                 FT_BBox  outline_bbox;
                 FT_Glyph shadow;
                 FT_BBox  shadow_bbox;
+                FT_Vector advance;
 
                 if( GetGlyph( p_filter,
                               &glyph, &glyph_bbox,
                               &outline, &outline_bbox,
                               &shadow, &shadow_bbox,
-                              p_current_face, i_glyph_index, p_glyph_style->i_style_flags,
+                              &advance,
+                              p_current_face, i_glyph_index,
+                              p_current_style->i_font_size, p_glyph_style->i_style_flags,
                               &pen_new, &pen_shadow_new ) )
                     goto next;
 
-                FixGlyph( glyph, &glyph_bbox, p_current_face, &pen_new );
+                FixGlyph( glyph, &glyph_bbox, &advance, &pen_new );
                 if( outline )
-                    FixGlyph( outline, &outline_bbox, p_current_face, &pen_new );
+                    FixGlyph( outline, &outline_bbox, &advance, &pen_new );
                 if( shadow )
-                    FixGlyph( shadow, &shadow_bbox, p_current_face, &pen_shadow_new );
+                    FixGlyph( shadow, &shadow_bbox, &advance, &pen_shadow_new );
 
                 /* FIXME and what about outline */
 
@@ -1490,8 +1837,8 @@ static int ProcessLines( filter_t *p_filter,
                     .i_line_thickness = i_line_thickness,
                 };
 
-                pen.x = pen_new.x + p_current_face->glyph->advance.x;
-                pen.y = pen_new.y + p_current_face->glyph->advance.y;
+                pen.x = pen_new.x + advance.x;
+                pen.y = pen_new.y + advance.y;
                 line_bbox = line_bbox_new;
             next:
                 i_glyph_last = i_glyph_index;
@@ -1556,9 +1903,6 @@ static int ProcessLines( filter_t *p_filter,
             break;
         }
     }
-    if( p_face )
-        FT_Done_Face( p_face );
-
     free( pp_fribidi_styles );
     free( p_fribidi_string );
     free( pi_karaoke_bar );
@@ -1976,6 +2320,12 @@ static int Create( vlc_object_t *p_this )
     p_sys->pp_font_attachments = NULL;
     p_sys->i_font_attachments = 0;
 
+    TAB_INIT( p_sys->i_faces, p_sys->pp_faces );
+    p_sys->i_face_use = 0;
+    p_sys->i_outline_radius = 0;
+    GlyphCacheInit( &p_sys->glyph_cache,
+                    1024 * var_InheritInteger( p_filter, "freetype-cache-size" ) );
+
     p_filter->pf_render_text = RenderText;
     p_filter->pf_render_html = RenderHtml;
 
@@ -2017,6 +2367,10 @@ static void Destroy( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
+    /* Faces may use the attachments memory */
+    GlyphCacheClean( &p_sys->glyph_cache );
+    FaceCacheClean( p_sys );
+
     if( p_sys->pp_font_attachments )
     {
         for( int k = 0; k < p_sys->i_font_attachments; k++ )
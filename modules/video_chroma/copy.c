@@ -32,6 +32,10 @@
 
 #include "copy.h"
 
+#ifdef CAN_COMPILE_SSE2
+static void CopyWorkerDelete(copy_worker_t *);
+#endif
+
 int CopyInitCache(copy_cache_t *cache, unsigned width)
 {
 #ifdef CAN_COMPILE_SSE2
@@ -39,6 +43,10 @@ int CopyInitCache(copy_cache_t *cache, unsigned width)
     cache->buffer = vlc_memalign(16, cache->size);
     if (!cache->buffer)
         return VLC_EGENERIC;
+
+    /* The helper thread is only started by the first copy that needs it */
+    cache->worker = NULL;
+    cache->worker_tried = false;
 #else
     (void) cache; (void) width;
 #endif
@@ -48,6 +56,10 @@ int CopyInitCache(copy_cache_t *cache, unsigned width)
 void CopyCleanCache(copy_cache_t *cache)
 {
 #ifdef CAN_COMPILE_SSE2
+    if (cache->worker)
+        CopyWorkerDelete(cache->worker);
+    cache->worker = NULL;
+    cache->worker_tried = false;
     vlc_free(cache->buffer);
     cache->buffer = NULL;
     cache->size   = 0;
@@ -87,6 +99,56 @@ void CopyCleanCache(copy_cache_t *cache)
 # define vlc_CPU_SSE2() ((cpu & VLC_CPU_SSE2) != 0)
 #endif
 
+#ifndef __AVX2__
+# undef vlc_CPU_AVX2
+# define vlc_CPU_AVX2() ((cpu & VLC_CPU_AVX2) != 0)
+#endif
+
+/* Planes smaller than this are not worth handing over to the helper thread */
+#define COPY_WORKER_MIN_PIXELS (640 * 360)
+
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+
+/* AVX2 version of CopyFromUswc(), streaming 128 bytes per iteration with
+ * 256-bits non-temporal loads.
+ */
+__attribute__((__target__("avx2")))
+static void AVX2_CopyFromUswc(uint8_t *dst, size_t dst_pitch,
+                              const uint8_t *src, size_t src_pitch,
+                              unsigned width, unsigned height)
+{
+    _mm_mfence();
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned unaligned = (-(uintptr_t)src) & 0x1f;
+        unsigned x = 0;
+
+        for (; x < unaligned && x < width; x++)
+            dst[x] = src[x];
+
+        for (; x+127 < width; x += 128) {
+            __m256i *in = (__m256i *)&src[x];
+            __m256i y0 = _mm256_stream_load_si256(in + 0);
+            __m256i y1 = _mm256_stream_load_si256(in + 1);
+            __m256i y2 = _mm256_stream_load_si256(in + 2);
+            __m256i y3 = _mm256_stream_load_si256(in + 3);
+            __m256i *out = (__m256i *)&dst[x];
+            _mm256_storeu_si256(out + 0, y0);
+            _mm256_storeu_si256(out + 1, y1);
+            _mm256_storeu_si256(out + 2, y2);
+            _mm256_storeu_si256(out + 3, y3);
+        }
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+}
+#endif
+
 /* Optimized copy from "Uncacheable Speculative Write Combining" memory
  * as used by some video surface.
  * XXX It is really efficient only when SSE4.1 is available.
@@ -99,6 +161,13 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
 {
     assert(((intptr_t)dst & 0x0f) == 0 && (dst_pitch & 0x0f) == 0);
 
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2()) {
+        AVX2_CopyFromUswc(dst, dst_pitch, src, src_pitch, width, height);
+        return;
+    }
+#endif
+
     asm volatile ("mfence");
 
     for (unsigned y = 0; y < height; y++) {
@@ -263,6 +332,14 @@ static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
     const unsigned hstep = cache_size / w16;
     assert(hstep > 0);
 
+    /* The bounce buffer only exists to provide aligned stores to
+     * CopyFromUswc(): skip it when the destination is already aligned */
+    if (((intptr_t)dst & 0x0f) == 0 && (dst_pitch & 0x0f) == 0) {
+        CopyFromUswc(dst, dst_pitch, src, src_pitch, width, height, cpu);
+        asm volatile ("mfence");
+        return;
+    }
+
     for (unsigned y = 0; y < height; y += hstep) {
         const unsigned hblock =  __MIN(hstep, height - y);
 
@@ -312,21 +389,181 @@ static void SSE_SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
     asm volatile ("mfence");
 }
 
+/* Copy of the chroma plane(s), run either by the calling thread or by the
+ * helper thread while the calling thread copies the luma plane */
+typedef struct
+{
+    picture_t *dst;
+    uint8_t  **src;
+    size_t    *src_pitch;
+    unsigned   width;
+    unsigned   height;
+    unsigned   cpu;
+    void     (*pf_copy)(const void *, uint8_t *, size_t);
+} copy_job_t;
+
+struct copy_worker
+{
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+    vlc_cond_t   wait;
+    vlc_cond_t   done;
+    const copy_job_t *job;
+    bool         quit;
+    uint8_t     *buffer;
+    size_t       size;
+};
+
+static void *CopyWorkerThread(void *data)
+{
+    copy_worker_t *worker = data;
+
+    vlc_mutex_lock(&worker->lock);
+    for (;;) {
+        while (!worker->quit && worker->job == NULL)
+            vlc_cond_wait(&worker->wait, &worker->lock);
+        if (worker->quit)
+            break;
+
+        const copy_job_t *job = worker->job;
+        vlc_mutex_unlock(&worker->lock);
+
+        job->pf_copy(job, worker->buffer, worker->size);
+
+        vlc_mutex_lock(&worker->lock);
+        worker->job = NULL;
+        vlc_cond_signal(&worker->done);
+    }
+    vlc_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+static copy_worker_t *CopyWorkerNew(size_t size)
+{
+    copy_worker_t *worker = malloc(sizeof(*worker));
+    if (!worker)
+        return NULL;
+
+    worker->buffer = vlc_memalign(16, size);
+    if (!worker->buffer) {
+        free(worker);
+        return NULL;
+    }
+    worker->size = size;
+    worker->job  = NULL;
+    worker->quit = false;
+    vlc_mutex_init(&worker->lock);
+    vlc_cond_init(&worker->wait);
+    vlc_cond_init(&worker->done);
+
+    if (vlc_clone(&worker->thread, CopyWorkerThread, worker,
+                  VLC_THREAD_PRIORITY_VIDEO)) {
+        vlc_cond_destroy(&worker->done);
+        vlc_cond_destroy(&worker->wait);
+        vlc_mutex_destroy(&worker->lock);
+        vlc_free(worker->buffer);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+static void CopyWorkerDelete(copy_worker_t *worker)
+{
+    vlc_mutex_lock(&worker->lock);
+    worker->quit = true;
+    vlc_cond_signal(&worker->wait);
+    vlc_mutex_unlock(&worker->lock);
+
+    vlc_join(worker->thread, NULL);
+    vlc_cond_destroy(&worker->done);
+    vlc_cond_destroy(&worker->wait);
+    vlc_mutex_destroy(&worker->lock);
+    vlc_free(worker->buffer);
+    free(worker);
+}
+
+/* Returns the helper thread for a copy of the given size, starting it on
+ * the first large enough copy. The helper thread is optional: without it,
+ * every plane is copied by the calling thread. */
+static copy_worker_t *CopyGetWorker(copy_cache_t *cache,
+                                    unsigned width, unsigned height)
+{
+    if (width * height < COPY_WORKER_MIN_PIXELS)
+        return NULL;
+
+    if (cache->worker == NULL && !cache->worker_tried) {
+        cache->worker_tried = true;
+        if (vlc_GetCPUCount() > 1)
+            cache->worker = CopyWorkerNew(cache->size);
+    }
+    return cache->worker;
+}
+
+/* Runs the chroma copy, on the helper thread when one is available, and
+ * copies the luma plane with the calling thread in the meantime. */
+static void SSE_CopyPlanes(const copy_job_t *job, copy_cache_t *cache)
+{
+    copy_worker_t *worker = CopyGetWorker(cache, job->width, job->height);
+
+    if (worker != NULL) {
+        vlc_mutex_lock(&worker->lock);
+        assert(worker->job == NULL);
+        worker->job = job;
+        vlc_cond_signal(&worker->wait);
+        vlc_mutex_unlock(&worker->lock);
+    }
+
+    SSE_CopyPlane(job->dst->p[0].p_pixels, job->dst->p[0].i_pitch,
+                  job->src[0], job->src_pitch[0],
+                  cache->buffer, cache->size,
+                  job->width, job->height, job->cpu);
+
+    if (worker != NULL) {
+        vlc_mutex_lock(&worker->lock);
+        while (worker->job != NULL)
+            vlc_cond_wait(&worker->done, &worker->lock);
+        vlc_mutex_unlock(&worker->lock);
+    } else
+        job->pf_copy(job, cache->buffer, cache->size);
+    asm volatile ("emms");
+}
+
+static void SSE_CopyChromaNv12(const void *data, uint8_t *buffer, size_t size)
+{
+    const copy_job_t *job = data;
+    picture_t *dst = job->dst;
+
+    SSE_SplitPlanes(dst->p[2].p_pixels, dst->p[2].i_pitch,
+                    dst->p[1].p_pixels, dst->p[1].i_pitch,
+                    job->src[1], job->src_pitch[1],
+                    buffer, size,
+                    job->width/2, job->height/2, job->cpu);
+}
+
+static void SSE_CopyChromaYv12(const void *data, uint8_t *buffer, size_t size)
+{
+    const copy_job_t *job = data;
+    picture_t *dst = job->dst;
+
+    for (unsigned n = 1; n < 3; n++)
+        SSE_CopyPlane(dst->p[n].p_pixels, dst->p[n].i_pitch,
+                      job->src[n], job->src_pitch[n],
+                      buffer, size,
+                      job->width/2, job->height/2, job->cpu);
+}
+
 static void SSE_CopyFromNv12(picture_t *dst,
                              uint8_t *src[2], size_t src_pitch[2],
                              unsigned width, unsigned height,
                              copy_cache_t *cache, unsigned cpu)
 {
-    SSE_CopyPlane(dst->p[0].p_pixels, dst->p[0].i_pitch,
-                  src[0], src_pitch[0],
-                  cache->buffer, cache->size,
-                  width, height, cpu);
-    SSE_SplitPlanes(dst->p[2].p_pixels, dst->p[2].i_pitch,
-                    dst->p[1].p_pixels, dst->p[1].i_pitch,
-                    src[1], src_pitch[1],
-                    cache->buffer, cache->size,
-                    width/2, height/2, cpu);
-    asm volatile ("emms");
+    const copy_job_t job = {
+        .dst = dst, .src = src, .src_pitch = src_pitch,
+        .width = width, .height = height, .cpu = cpu,
+        .pf_copy = SSE_CopyChromaNv12,
+    };
+    SSE_CopyPlanes(&job, cache);
 }
 
 static void SSE_CopyFromYv12(picture_t *dst,
@@ -334,14 +571,12 @@ static void SSE_CopyFromYv12(picture_t *dst,
                              unsigned width, unsigned height,
                              copy_cache_t *cache, unsigned cpu)
 {
-    for (unsigned n = 0; n < 3; n++) {
-        const unsigned d = n > 0 ? 2 : 1;
-        SSE_CopyPlane(dst->p[n].p_pixels, dst->p[n].i_pitch,
-                      src[n], src_pitch[n],
-                      cache->buffer, cache->size,
-                      width/d, height/d, cpu);
-    }
-    asm volatile ("emms");
+    const copy_job_t job = {
+        .dst = dst, .src = src, .src_pitch = src_pitch,
+        .width = width, .height = height, .cpu = cpu,
+        .pf_copy = SSE_CopyChromaYv12,
+    };
+    SSE_CopyPlanes(&job, cache);
 }
 #undef COPY64
 #endif /* CAN_COMPILE_SSE2 */
@@ -24,10 +24,14 @@
 #ifndef _VLC_VIDEOCHROMA_COPY_H
 #define _VLC_VIDEOCHROMA_COPY_H 1
 
+typedef struct copy_worker copy_worker_t;
+
 typedef struct {
 # ifdef CAN_COMPILE_SSE2
     uint8_t *buffer;
     size_t  size;
+    copy_worker_t *worker; /* chroma planes helper thread, may be NULL */
+    bool    worker_tried;  /* the helper thread was started, or failed to */
 # endif
 } copy_cache_t;
 
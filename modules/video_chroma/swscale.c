@@ -55,6 +55,11 @@ static void CloseScaler( vlc_object_t * );
 
 #define SCALEMODE_TEXT N_("Scaling mode")
 #define SCALEMODE_LONGTEXT N_("Scaling mode to use.")
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads used to convert a picture, " \
+    "each converting a horizontal band of it (0 = one per CPU).")
+
+#define MAX_BANDS (16)
 
 static const int pi_mode_values[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
 const char *const ppsz_mode_descriptions[] =
@@ -72,6 +77,8 @@ vlc_module_begin ()
     set_callbacks( OpenScaler, CloseScaler )
     add_integer( "swscale-mode", 2, SCALEMODE_TEXT, SCALEMODE_LONGTEXT, true )
         change_integer_list( pi_mode_values, ppsz_mode_descriptions )
+    add_integer_with_range( "swscale-threads", 0, 0, MAX_BANDS,
+                            THREADS_TEXT, THREADS_LONGTEXT, true )
 vlc_module_end ()
 
 /* Version checking */
@@ -80,6 +87,20 @@ vlc_module_end ()
  * Local prototypes
  ****************************************************************************/
 
+/**
+ * Horizontal band of the pictures, converted by its own context.
+ */
+typedef struct
+{
+    struct SwsContext *ctx;
+    picture_t *p_pic;   /* output of ctx, padded like its input */
+    int i_src_y;        /* padded input rows */
+    int i_src_height;
+    int i_dst_y;        /* output rows of the band itself */
+    int i_dst_height;
+    int i_dst_skip;     /* padding rows at the top of p_pic */
+} scaler_band_t;
+
 /**
  * Internal swscale filter structure.
  */
@@ -103,6 +124,22 @@ struct filter_sys_t
     bool b_copy;
     bool b_swap_uvi;
     bool b_swap_uvo;
+
+    /* Band threading (i_bands is 0 when the picture is converted at once) */
+    int i_bands;
+    scaler_band_t band[MAX_BANDS];
+
+    int i_threads;                      /* maximum number of bands */
+    int i_workers;                      /* started threads */
+    vlc_thread_t thread[MAX_BANDS - 1];
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    vlc_cond_t done;
+    picture_t *p_job_src;
+    picture_t *p_job_dst;
+    int i_next_band;
+    int i_pending;
+    bool b_quit;
 };
 
 static picture_t *Filter( filter_t *, picture_t * );
@@ -128,11 +165,18 @@ static int GetParameters( ScalerConfiguration *,
 
 static int GetSwsCpuMask(void);
 
+static void *BandThread( void * );
+
 /* SwScaler point resize quality seems really bad, let our scale module do it
  * (change it to true to try) */
 #define ALLOW_YUVP (false)
 /* SwScaler does not like too small picture */
 #define MINIMUM_WIDTH (32)
+/* Bands thinner than that are not worth a thread */
+#define MINIMUM_BAND_HEIGHT (64)
+/* Bands start on multiples of that many rows on both sides, so that
+ * swscale row dithering matches the whole picture conversion */
+#define BAND_ALIGNMENT (8)
 
 /* XXX is it always 3 even for BIG_ENDIAN (blend.c seems to think so) ? */
 #define OFFSET_A (3)
@@ -183,6 +227,7 @@ static int OpenScaler( vlc_object_t *p_this )
     p_sys->p_dst_filter = NULL;
 
     /* Misc init */
+    p_sys->i_bands = 0;
     p_sys->ctx = NULL;
     p_sys->ctxA = NULL;
     p_sys->p_src_a = NULL;
@@ -192,8 +237,26 @@ static int OpenScaler( vlc_object_t *p_this )
     memset( &p_sys->fmt_in,  0, sizeof(p_sys->fmt_in) );
     memset( &p_sys->fmt_out, 0, sizeof(p_sys->fmt_out) );
 
+    /* Band threading */
+    p_sys->i_threads = var_InheritInteger( p_filter, "swscale-threads" );
+    if( p_sys->i_threads <= 0 )
+        p_sys->i_threads = vlc_GetCPUCount();
+    p_sys->i_threads = VLC_CLIP( p_sys->i_threads, 1, MAX_BANDS );
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait );
+    vlc_cond_init( &p_sys->done );
+    p_sys->p_job_src = NULL;
+    p_sys->p_job_dst = NULL;
+    p_sys->i_next_band = 0;
+    p_sys->i_pending = 0;
+    p_sys->i_workers = 0;
+    p_sys->b_quit = false;
+
     if( Init( p_filter ) )
     {
+        vlc_cond_destroy( &p_sys->done );
+        vlc_cond_destroy( &p_sys->wait );
+        vlc_mutex_destroy( &p_sys->lock );
         if( p_sys->p_src_filter )
             sws_freeFilter( p_sys->p_src_filter );
         free( p_sys );
@@ -221,6 +284,10 @@ static void CloseScaler( vlc_object_t *p_this )
     filter_sys_t *p_sys = p_filter->p_sys;
 
     Clean( p_filter );
+    vlc_cond_destroy( &p_sys->done );
+    vlc_cond_destroy( &p_sys->wait );
+    vlc_mutex_destroy( &p_sys->lock );
+
     if( p_sys->p_src_filter )
         sws_freeFilter( p_sys->p_src_filter );
     free( p_sys );
@@ -349,6 +416,206 @@ static int GetParameters( ScalerConfiguration *p_cfg,
     return VLC_SUCCESS;
 }
 
+/* Returns the vertical alignment of the rows of a chroma, 0 if unknown */
+static unsigned GetRowAlignment( vlc_fourcc_t i_chroma )
+{
+    const vlc_chroma_description_t *p_dsc = vlc_fourcc_GetChromaDescription( i_chroma );
+    if( !p_dsc )
+        return 0;
+
+    unsigned i_align = 1;
+    for( unsigned n = 0; n < p_dsc->plane_count; n++ )
+        i_align = __MAX( i_align, p_dsc->p[n].h.den / p_dsc->p[n].h.num );
+    return i_align;
+}
+
+/**
+ * Returns the number of source rows above and below a band that the
+ * vertical filters may read, with some slack for the filter alignment
+ * done by swscale.
+ */
+static unsigned GetBandMargin( int i_sws_flags,
+                               unsigned i_src_height, unsigned i_dst_height,
+                               unsigned i_sub_in, unsigned i_sub_out )
+{
+    unsigned i_taps;
+    if( i_sws_flags & (SWS_SINC | SWS_SPLINE | SWS_LANCZOS) )
+        i_taps = 20;
+    else if( i_sws_flags & (SWS_X | SWS_GAUSS) )
+        i_taps = 8;
+    else if( i_sws_flags & (SWS_BICUBIC | SWS_BICUBLIN) )
+        i_taps = 4;
+    else
+        i_taps = 2;
+
+    /* Downscaling widens the filters by the scaling ratio */
+    const unsigned i_ratio = __MAX( 1, (i_src_height + i_dst_height - 1) / i_dst_height );
+    const unsigned i_chroma_ratio = __MAX( 1,
+        (i_src_height * i_sub_out + i_dst_height * i_sub_in - 1) / (i_dst_height * i_sub_in) );
+
+    const unsigned i_luma = 2 * (i_taps * i_ratio + 2) + 8;
+    const unsigned i_chroma = (2 * (i_taps * i_chroma_ratio + 2) + 8) * i_sub_in;
+    return __MAX( i_luma, i_chroma );
+}
+
+/* swscale steps through the source in 1/65536 of a row. Bands only give
+ * the same result as the whole picture if that step is exact. */
+static bool IsExactStep( unsigned i_src_height, unsigned i_dst_height )
+{
+    return ((uint64_t)i_src_height << 16) % i_dst_height == 0;
+}
+
+static void CleanBands( filter_sys_t *p_sys, int i_bands )
+{
+    for( int i = 0; i < i_bands; i++ )
+    {
+        sws_freeContext( p_sys->band[i].ctx );
+        picture_Release( p_sys->band[i].p_pic );
+    }
+}
+
+/* The calling thread converts one of the bands, so one thread less than
+ * bands is started. If some cannot be started, the calling thread converts
+ * their bands too. */
+static void StartBandThreads( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    while( p_sys->i_workers < p_sys->i_bands - 1 )
+    {
+        if( vlc_clone( &p_sys->thread[p_sys->i_workers], BandThread, p_filter,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            msg_Warn( p_filter, "cannot start scaler thread" );
+            break;
+        }
+        p_sys->i_workers++;
+    }
+}
+
+static void StopBandThreads( filter_sys_t *p_sys )
+{
+    if( p_sys->i_workers == 0 )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_quit = true;
+    vlc_cond_broadcast( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+    for( int i = 0; i < p_sys->i_workers; i++ )
+        vlc_join( p_sys->thread[i], NULL );
+    p_sys->i_workers = 0;
+    p_sys->b_quit = false;
+}
+
+/**
+ * Splits the pictures into horizontal bands, each converted by its own
+ * context. A band maps an exact number of source rows to an exact number
+ * of destination rows. Its context is also given enough source rows
+ * around it for the vertical filters, and only the rows of the band are
+ * kept from its output, so that the result is the same as converting the
+ * whole picture at once. Falls back to whole picture conversion if no
+ * such split exists.
+ */
+static void InitBands( filter_t *p_filter, const ScalerConfiguration *p_cfg )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const video_format_t *p_fmti = &p_filter->fmt_in.video;
+    const video_format_t *p_fmto = &p_filter->fmt_out.video;
+    const unsigned i_src_height = p_fmti->i_visible_height;
+    const unsigned i_dst_height = p_fmto->i_visible_height;
+
+    p_sys->i_bands = 0;
+    if( p_sys->i_threads <= 1 || p_sys->b_copy || p_sys->i_extend_factor != 1 ||
+        p_fmti->i_chroma == VLC_CODEC_RGBP )
+        return;
+
+    const unsigned i_sub_in  = GetRowAlignment( p_fmti->i_chroma );
+    const unsigned i_sub_out = GetRowAlignment( p_fmto->i_chroma );
+    if( i_sub_in == 0 || i_sub_out == 0 ||
+        BAND_ALIGNMENT % i_sub_in || BAND_ALIGNMENT % i_sub_out )
+        return;
+    if( !IsExactStep( i_src_height, i_dst_height ) ||
+        !IsExactStep( (i_src_height + i_sub_in - 1) / i_sub_in,
+                      (i_dst_height + i_sub_out - 1) / i_sub_out ) )
+        return;
+
+    const unsigned i_gcd = GCD( i_src_height, i_dst_height );
+    const unsigned i_src_step = i_src_height / i_gcd;
+    const unsigned i_dst_step = i_dst_height / i_gcd;
+    unsigned i_src_unit = i_src_step;
+    unsigned i_dst_unit = i_dst_step;
+    while( i_src_unit % BAND_ALIGNMENT || i_dst_unit % BAND_ALIGNMENT )
+    {
+        i_src_unit += i_src_step;
+        i_dst_unit += i_dst_step;
+        if( i_src_unit > i_src_height )
+            return;
+    }
+
+    const unsigned i_margin = GetBandMargin( p_cfg->i_sws_flags,
+                                             i_src_height, i_dst_height,
+                                             i_sub_in, i_sub_out );
+    const unsigned i_pad = (i_margin + i_src_unit - 1) / i_src_unit;
+
+    /* Too thin bands are not worth it, nor are bands thinner than their
+     * padding */
+    const unsigned i_units = i_dst_height / i_dst_unit;
+    const int i_bands = __MIN( (unsigned)p_sys->i_threads, i_units / i_pad );
+    if( i_bands <= 1 || i_dst_height / i_bands < MINIMUM_BAND_HEIGHT )
+        return;
+
+    for( int i = 0; i < i_bands; i++ )
+    {
+        scaler_band_t *p_band = &p_sys->band[i];
+        const unsigned i_start = i_units * i / i_bands;
+        const unsigned i_end   = i_units * (i + 1) / i_bands;
+        const unsigned i_pad_start = i_start > i_pad ? i_start - i_pad : 0;
+
+        /* The last band, and those whose padding reaches the last one, take
+         * the remaining rows */
+        unsigned i_src_end, i_dst_end;
+        if( i + 1 == i_bands || (i_end + i_pad) * i_src_unit >= i_src_height )
+        {
+            i_src_end = i_src_height;
+            i_dst_end = i_dst_height;
+        }
+        else
+        {
+            i_src_end = (i_end + i_pad) * i_src_unit;
+            i_dst_end = (i_end + i_pad) * i_dst_unit;
+        }
+
+        p_band->i_src_y = i_pad_start * i_src_unit;
+        p_band->i_src_height = i_src_end - p_band->i_src_y;
+        p_band->i_dst_y = i_start * i_dst_unit;
+        p_band->i_dst_height = i + 1 < i_bands ? (i_end - i_start) * i_dst_unit
+                                               : i_dst_height - p_band->i_dst_y;
+        p_band->i_dst_skip = (i_start - i_pad_start) * i_dst_unit;
+
+        const unsigned i_pic_height = i_dst_end - i_pad_start * i_dst_unit;
+        p_band->ctx = sws_getContext( p_fmti->i_visible_width, p_band->i_src_height, p_cfg->i_fmti,
+                                      p_fmto->i_visible_width, i_pic_height, p_cfg->i_fmto,
+                                      p_cfg->i_sws_flags | p_sys->i_cpu_mask,
+                                      p_sys->p_src_filter, p_sys->p_dst_filter, 0 );
+        p_band->p_pic = picture_New( p_fmto->i_chroma, p_fmto->i_visible_width,
+                                     i_pic_height, 0, 1 );
+        if( !p_band->ctx || !p_band->p_pic )
+        {
+            if( p_band->ctx )
+                sws_freeContext( p_band->ctx );
+            if( p_band->p_pic )
+                picture_Release( p_band->p_pic );
+            CleanBands( p_sys, i );
+            return;
+        }
+    }
+    p_sys->i_bands = i_bands;
+    StartBandThreads( p_filter );
+    msg_Dbg( p_filter, "converting in %d bands with %d threads",
+             i_bands, p_sys->i_workers + 1 );
+}
+
 static int Init( filter_t *p_filter )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
@@ -433,6 +700,8 @@ static int Init( filter_t *p_filter )
     p_sys->b_swap_uvi = cfg.b_swap_uvi;
     p_sys->b_swap_uvo = cfg.b_swap_uvo;
 
+    InitBands( p_filter, &cfg );
+
 #if 0
     msg_Dbg( p_filter, "%ix%i (%ix%i) chroma: %4.4s -> %ix%i (%ix%i) chroma: %4.4s extend by %d",
              p_fmti->i_visible_width, p_fmti->i_visible_height, p_fmti->i_width, p_fmti->i_height, (char *)&p_fmti->i_chroma,
@@ -445,6 +714,10 @@ static void Clean( filter_t *p_filter )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
 
+    StopBandThreads( p_sys );
+    CleanBands( p_sys, p_sys->i_bands );
+    p_sys->i_bands = 0;
+
     if( p_sys->p_src_e )
         picture_Release( p_sys->p_src_e );
     if( p_sys->p_dst_e )
@@ -574,6 +847,113 @@ static void Convert( filter_t *p_filter, struct SwsContext *ctx,
 #endif
 }
 
+static void OffsetPixels( uint8_t *pp_pixel[4], const int pi_pitch[4],
+                          vlc_fourcc_t i_chroma, int i_row )
+{
+    const vlc_chroma_description_t *p_dsc = vlc_fourcc_GetChromaDescription( i_chroma );
+
+    for( unsigned n = 0; n < p_dsc->plane_count && n < 4; n++ )
+    {
+        if( pp_pixel[n] )
+            pp_pixel[n] += pi_pitch[n] * (i_row * p_dsc->p[n].h.num / p_dsc->p[n].h.den);
+    }
+}
+
+static void ConvertBand( filter_t *p_filter, const scaler_band_t *p_band,
+                         picture_t *p_dst, picture_t *p_src )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    uint8_t *src[4]; int src_stride[4];
+    uint8_t *dst[4]; int dst_stride[4];
+
+    GetPixels( src, src_stride, p_src, 0, 3, p_sys->b_swap_uvi );
+    OffsetPixels( src, src_stride, p_filter->fmt_in.video.i_chroma, p_band->i_src_y );
+    GetPixels( dst, dst_stride, p_band->p_pic, 0, 3, p_sys->b_swap_uvo );
+
+    sws_scale( p_band->ctx, src, src_stride, 0, p_band->i_src_height,
+               dst, dst_stride );
+
+    /* Keep the rows of the band, not those of its padding */
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_filter->fmt_out.video.i_chroma );
+    for( int n = 0; n < __MIN( 3, p_dst->i_planes ); n++ )
+    {
+        const plane_t *s = &p_band->p_pic->p[n];
+        plane_t *d = &p_dst->p[n];
+        const unsigned i_num = p_dsc->p[n].h.num;
+        const unsigned i_den = p_dsc->p[n].h.den;
+        const int i_skip = p_band->i_dst_skip * i_num / i_den;
+        const int i_y = p_band->i_dst_y * i_num / i_den;
+        const int i_rows = ((p_band->i_dst_y + p_band->i_dst_height) * i_num
+                            + i_den - 1) / i_den - i_y;
+
+        for( int y = 0; y < i_rows; y++ )
+            memcpy( &d->p_pixels[(i_y + y) * d->i_pitch],
+                    &s->p_pixels[(i_skip + y) * s->i_pitch],
+                    __MIN( d->i_visible_pitch, s->i_visible_pitch ) );
+    }
+}
+
+/* Converts bands of the current job until there are none left.
+ * Must be called with the lock held. */
+static void ConvertPendingBands( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    while( p_sys->p_job_dst && p_sys->i_next_band < p_sys->i_bands )
+    {
+        const scaler_band_t *p_band = &p_sys->band[p_sys->i_next_band++];
+        picture_t *p_src = p_sys->p_job_src;
+        picture_t *p_dst = p_sys->p_job_dst;
+
+        vlc_mutex_unlock( &p_sys->lock );
+        ConvertBand( p_filter, p_band, p_dst, p_src );
+        vlc_mutex_lock( &p_sys->lock );
+
+        if( --p_sys->i_pending == 0 )
+            vlc_cond_signal( &p_sys->done );
+    }
+}
+
+static void *BandThread( void *data )
+{
+    filter_t *p_filter = data;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( !p_sys->b_quit &&
+               ( !p_sys->p_job_dst || p_sys->i_next_band >= p_sys->i_bands ) )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+        if( p_sys->b_quit )
+            break;
+        ConvertPendingBands( p_filter );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void ConvertBands( filter_t *p_filter, picture_t *p_dst, picture_t *p_src )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->p_job_src = p_src;
+    p_sys->p_job_dst = p_dst;
+    p_sys->i_next_band = 0;
+    p_sys->i_pending = p_sys->i_bands;
+    vlc_cond_broadcast( &p_sys->wait );
+
+    ConvertPendingBands( p_filter );
+    while( p_sys->i_pending > 0 )
+        vlc_cond_wait( &p_sys->done, &p_sys->lock );
+    p_sys->p_job_src = NULL;
+    p_sys->p_job_dst = NULL;
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
 /****************************************************************************
  * Filter: the whole thing
  ****************************************************************************
@@ -616,6 +996,8 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         picture_CopyPixels( p_dst, p_src );
     else if( p_sys->b_copy )
         SwapUV( p_dst, p_src );
+    else if( p_sys->i_bands > 0 )
+        ConvertBands( p_filter, p_dst, p_src );
     else
         Convert( p_filter, p_sys->ctx, p_dst, p_src, p_fmti->i_visible_height, 0, 3,
                  p_sys->b_swap_uvi, p_sys->b_swap_uvo );
@@ -47,6 +47,301 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+
+/* AVX2 version of the line filter of yadif.h, 16 pixels at a time.
+   The result is identical to yadif_filter_line_c(). */
+#define AVX2_LOAD(p) _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i *)(p) ) )
+#define AVX2_AVG(a,b) _mm256_srai_epi16( _mm256_add_epi16( a, b ), 1 )
+#define AVX2_ABSDIFF(a,b) _mm256_abs_epi16( _mm256_sub_epi16( a, b ) )
+#define AVX2_SCORE(j) \
+    _mm256_add_epi16( _mm256_add_epi16( \
+        AVX2_ABSDIFF( AVX2_LOAD(&cur[mrefs-1+(j)]), AVX2_LOAD(&cur[prefs-1-(j)]) ), \
+        AVX2_ABSDIFF( AVX2_LOAD(&cur[mrefs  +(j)]), AVX2_LOAD(&cur[prefs  -(j)]) ) ), \
+        AVX2_ABSDIFF( AVX2_LOAD(&cur[mrefs+1+(j)]), AVX2_LOAD(&cur[prefs+1-(j)]) ) )
+#define AVX2_PRED(j) AVX2_AVG( AVX2_LOAD(&cur[mrefs+(j)]), AVX2_LOAD(&cur[prefs-(j)]) )
+#define AVX2_CHECK(mask, j) do { \
+        __m256i score = AVX2_SCORE(j); \
+        mask = _mm256_and_si256( mask, _mm256_cmpgt_epi16( spatial_score, score ) ); \
+        spatial_score = _mm256_blendv_epi8( spatial_score, score, mask ); \
+        spatial_pred = _mm256_blendv_epi8( spatial_pred, AVX2_PRED(j), mask ); \
+    } while(0)
+
+__attribute__ ((__target__ ("avx2")))
+static void yadif_filter_line_avx2(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t *prev2 = parity ? prev : cur;
+    uint8_t *next2 = parity ? cur  : next;
+    const __m256i one = _mm256_set1_epi16( 1 );
+    int x;
+
+    for( x = 0; x + 16 <= w; x += 16 )
+    {
+        const __m256i c = AVX2_LOAD(&cur[mrefs]);
+        const __m256i e = AVX2_LOAD(&cur[prefs]);
+        const __m256i p2 = AVX2_LOAD(prev2);
+        const __m256i n2 = AVX2_LOAD(next2);
+        const __m256i d = AVX2_AVG( p2, n2 );
+
+        __m256i temporal_diff0 = _mm256_srai_epi16( AVX2_ABSDIFF( p2, n2 ), 1 );
+        __m256i temporal_diff1 = _mm256_srai_epi16( _mm256_add_epi16(
+                                    AVX2_ABSDIFF( AVX2_LOAD(&prev[mrefs]), c ),
+                                    AVX2_ABSDIFF( AVX2_LOAD(&prev[prefs]), e ) ), 1 );
+        __m256i temporal_diff2 = _mm256_srai_epi16( _mm256_add_epi16(
+                                    AVX2_ABSDIFF( AVX2_LOAD(&next[mrefs]), c ),
+                                    AVX2_ABSDIFF( AVX2_LOAD(&next[prefs]), e ) ), 1 );
+        __m256i diff = _mm256_max_epi16( temporal_diff0,
+                           _mm256_max_epi16( temporal_diff1, temporal_diff2 ) );
+
+        __m256i spatial_pred = AVX2_AVG( c, e );
+        __m256i spatial_score = _mm256_sub_epi16( _mm256_add_epi16( _mm256_add_epi16(
+                    AVX2_ABSDIFF( AVX2_LOAD(&cur[mrefs-1]), AVX2_LOAD(&cur[prefs-1]) ),
+                    AVX2_ABSDIFF( c, e ) ),
+                    AVX2_ABSDIFF( AVX2_LOAD(&cur[mrefs+1]), AVX2_LOAD(&cur[prefs+1]) ) ),
+                    one );
+
+        /* The +-2 checks are only done when the +-1 ones succeeded */
+        __m256i mask = _mm256_cmpeq_epi16( one, one );
+        AVX2_CHECK( mask, -1 );
+        AVX2_CHECK( mask, -2 );
+        mask = _mm256_cmpeq_epi16( one, one );
+        AVX2_CHECK( mask, 1 );
+        AVX2_CHECK( mask, 2 );
+
+        if( mode < 2 )
+        {
+            const __m256i b = AVX2_AVG( AVX2_LOAD(&prev2[2*mrefs]), AVX2_LOAD(&next2[2*mrefs]) );
+            const __m256i f = AVX2_AVG( AVX2_LOAD(&prev2[2*prefs]), AVX2_LOAD(&next2[2*prefs]) );
+            const __m256i de = _mm256_sub_epi16( d, e );
+            const __m256i dc = _mm256_sub_epi16( d, c );
+            const __m256i bc = _mm256_sub_epi16( b, c );
+            const __m256i fe = _mm256_sub_epi16( f, e );
+            const __m256i max = _mm256_max_epi16( _mm256_max_epi16( de, dc ),
+                                                  _mm256_min_epi16( bc, fe ) );
+            const __m256i min = _mm256_min_epi16( _mm256_min_epi16( de, dc ),
+                                                  _mm256_max_epi16( bc, fe ) );
+            diff = _mm256_max_epi16( diff, _mm256_max_epi16( min,
+                       _mm256_sub_epi16( _mm256_setzero_si256(), max ) ) );
+        }
+
+        /* diff is never negative, so clamping to [d-diff, d+diff] is
+           equivalent to the reference code */
+        spatial_pred = _mm256_min_epi16( _mm256_max_epi16( spatial_pred,
+                                            _mm256_sub_epi16( d, diff ) ),
+                                         _mm256_add_epi16( d, diff ) );
+
+        const __m256i packed = _mm256_permute4x64_epi64(
+                _mm256_packus_epi16( spatial_pred, spatial_pred ), 0xD8 );
+        _mm_storeu_si128( (__m128i *)dst, _mm256_castsi256_si128( packed ) );
+
+        dst += 16;
+        cur += 16;
+        prev += 16;
+        next += 16;
+        prev2 += 16;
+        next2 += 16;
+    }
+
+    if( x < w )
+        yadif_filter_line_c( dst, prev, cur, next, w - x, prefs, mrefs, parity, mode );
+}
+#undef AVX2_LOAD
+#undef AVX2_AVG
+#undef AVX2_ABSDIFF
+#undef AVX2_SCORE
+#undef AVX2_PRED
+#undef AVX2_CHECK
+#endif
+
+/*****************************************************************************
+ * Slice threading
+ *****************************************************************************/
+
+typedef void (*yadif_filter_t)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
+                               int w, int prefs, int mrefs, int parity, int mode);
+
+/* Everything needed to render one field */
+typedef struct yadif_job_t
+{
+    yadif_filter_t filter;
+    picture_t *p_dst;
+    const picture_t *p_prev;
+    const picture_t *p_cur;
+    const picture_t *p_next;
+    int i_field;
+    int i_parity;
+} yadif_job_t;
+
+static void YadifSlice( const yadif_job_t *p_job, unsigned i_slice, unsigned i_slices )
+{
+    for( int n = 0; n < p_job->p_dst->i_planes; n++ )
+    {
+        const plane_t *prevp = &p_job->p_prev->p[n];
+        const plane_t *curp  = &p_job->p_cur->p[n];
+        const plane_t *nextp = &p_job->p_next->p[n];
+        plane_t *dstp        = &p_job->p_dst->p[n];
+
+        /* The first and last lines are duplicated from their neighbours */
+        const int i_lines = dstp->i_visible_lines - 2;
+        if( i_lines <= 0 )
+            continue;
+        const int y_start = 1 + i_lines * (int)i_slice / (int)i_slices;
+        const int y_end   = 1 + i_lines * (int)(i_slice + 1) / (int)i_slices;
+
+        for( int y = y_start; y < y_end; y++ )
+        {
+            if( (y % 2) == p_job->i_field  ||  p_job->i_parity == 2 )
+            {
+                memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                            &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+            }
+            else
+            {
+                int mode;
+                /* Spatial checks only when enough data */
+                mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+                assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+                p_job->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                               &prevp->p_pixels[y * prevp->i_pitch],
+                               &curp->p_pixels[y * curp->i_pitch],
+                               &nextp->p_pixels[y * nextp->i_pitch],
+                               dstp->i_visible_pitch,
+                               y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                               y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                               p_job->i_parity,
+                               mode );
+            }
+
+            /* We duplicate the first and last lines */
+            if( y == 1 )
+                memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+            else if( y == dstp->i_visible_lines - 2 )
+                memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+        }
+    }
+}
+
+/* Filters slices of the current job until there are none left.
+   Must be called with the lock held. */
+static void YadifRunSlices( yadif_sys_t *p_yadif )
+{
+    while( p_yadif->p_job && p_yadif->i_next_slice < p_yadif->i_slices )
+    {
+        const yadif_job_t *p_job = p_yadif->p_job;
+        const unsigned i_slice = p_yadif->i_next_slice++;
+        const unsigned i_slices = p_yadif->i_slices;
+
+        vlc_mutex_unlock( &p_yadif->lock );
+        YadifSlice( p_job, i_slice, i_slices );
+        vlc_mutex_lock( &p_yadif->lock );
+
+        assert( p_yadif->i_pending > 0 );
+        if( --p_yadif->i_pending == 0 )
+            vlc_cond_signal( &p_yadif->done );
+    }
+}
+
+static void *YadifThread( void *data )
+{
+    yadif_sys_t *p_yadif = data;
+
+    vlc_mutex_lock( &p_yadif->lock );
+    for( ;; )
+    {
+        while( !p_yadif->b_quit &&
+               ( !p_yadif->p_job || p_yadif->i_next_slice >= p_yadif->i_slices ) )
+            vlc_cond_wait( &p_yadif->wait, &p_yadif->lock );
+        if( p_yadif->b_quit )
+            break;
+        YadifRunSlices( p_yadif );
+    }
+    vlc_mutex_unlock( &p_yadif->lock );
+    return NULL;
+}
+
+static void YadifRun( yadif_sys_t *p_yadif, const yadif_job_t *p_job )
+{
+    if( p_yadif->i_threads == 0 )
+    {
+        YadifSlice( p_job, 0, 1 );
+        return;
+    }
+
+    vlc_mutex_lock( &p_yadif->lock );
+    p_yadif->p_job = p_job;
+    p_yadif->i_slices = p_yadif->i_threads + 1;
+    p_yadif->i_next_slice = 0;
+    p_yadif->i_pending = p_yadif->i_slices;
+    vlc_cond_broadcast( &p_yadif->wait );
+
+    YadifRunSlices( p_yadif );
+    while( p_yadif->i_pending > 0 )
+        vlc_cond_wait( &p_yadif->done, &p_yadif->lock );
+    p_yadif->p_job = NULL;
+    vlc_mutex_unlock( &p_yadif->lock );
+}
+
+void YadifInit( filter_t *p_filter, unsigned i_threads )
+{
+    yadif_sys_t *p_yadif = &p_filter->p_sys->yadif;
+
+    vlc_mutex_init( &p_yadif->lock );
+    vlc_cond_init( &p_yadif->wait );
+    vlc_cond_init( &p_yadif->done );
+    p_yadif->p_job = NULL;
+    p_yadif->i_slices = 0;
+    p_yadif->i_next_slice = 0;
+    p_yadif->i_pending = 0;
+    p_yadif->b_quit = false;
+    p_yadif->i_time = 0;
+    p_yadif->i_fields = 0;
+
+    if( i_threads == 0 )
+        i_threads = vlc_GetCPUCount();
+    i_threads = VLC_CLIP( i_threads, 1, YADIF_MAX_THREADS + 1 );
+
+    /* The calling thread takes one of the slices */
+    p_yadif->i_threads = 0;
+    for( unsigned i = 0; i < i_threads - 1; i++ )
+    {
+        if( vlc_clone( &p_yadif->thread[i], YadifThread, p_yadif,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            msg_Warn( p_filter, "cannot start yadif worker thread" );
+            break;
+        }
+        p_yadif->i_threads++;
+    }
+    msg_Dbg( p_filter, "yadif using %u slice(s)", p_yadif->i_threads + 1 );
+}
+
+void YadifClean( filter_t *p_filter )
+{
+    yadif_sys_t *p_yadif = &p_filter->p_sys->yadif;
+
+    vlc_mutex_lock( &p_yadif->lock );
+    p_yadif->b_quit = true;
+    vlc_cond_broadcast( &p_yadif->wait );
+    vlc_mutex_unlock( &p_yadif->lock );
+
+    for( unsigned i = 0; i < p_yadif->i_threads; i++ )
+        vlc_join( p_yadif->thread[i], NULL );
+
+    if( p_yadif->i_fields > 0 )
+        msg_Dbg( p_filter, "yadif filtered %u field(s), %"PRId64" us per field",
+                 p_yadif->i_fields, p_yadif->i_time / p_yadif->i_fields );
+
+    vlc_cond_destroy( &p_yadif->done );
+    vlc_cond_destroy( &p_yadif->wait );
+    vlc_mutex_destroy( &p_yadif->lock );
+}
+
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field )
 {
@@ -105,9 +400,13 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     if( p_prev && p_cur && p_next )
     {
         /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_filter_t filter;
 
+#if defined(HAVE_AVX2_INTRINSICS)
+        if( vlc_CPU_AVX2() )
+            filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
             filter = yadif_filter_line_ssse3;
@@ -126,51 +425,22 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
             filter = yadif_filter_line_c;
 
         if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
+            filter = (yadif_filter_t)yadif_filter_line_c_16bit;
 
-        for( int n = 0; n < p_dst->i_planes; n++ )
-        {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
+        const yadif_job_t job = {
+            .filter = filter,
+            .p_dst = p_dst,
+            .p_prev = p_prev,
+            .p_cur = p_cur,
+            .p_next = p_next,
+            .i_field = i_field,
+            .i_parity = yadif_parity,
+        };
 
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
-        }
+        const mtime_t i_start = mdate();
+        YadifRun( &p_sys->yadif, &job );
+        p_sys->yadif.i_time += mdate() - i_start;
+        p_sys->yadif.i_fields++;
 
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
 
@@ -34,11 +34,60 @@
 /* Forward declarations */
 struct filter_t;
 struct picture_t;
+struct yadif_job_t;
+
+/*****************************************************************************
+ * Data structures
+ *****************************************************************************/
+
+#define YADIF_MAX_THREADS (16)
+
+/**
+ * Yadif worker pool state.
+ *
+ * Each output picture is cut into horizontal slices, which are filtered
+ * by the worker threads and by the calling thread.
+ * @see RenderYadif()
+ */
+typedef struct
+{
+    vlc_thread_t thread[YADIF_MAX_THREADS];
+    unsigned i_threads;     /**< Number of worker threads, 0 if none */
+
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;       /**< Signaled when a new job is posted */
+    vlc_cond_t  done;       /**< Signaled when all slices are done */
+    const struct yadif_job_t *p_job; /**< Current job, NULL if none */
+    unsigned i_slices;      /**< Number of slices of the current job */
+    unsigned i_next_slice;  /**< Next slice to filter */
+    unsigned i_pending;     /**< Number of slices not yet done */
+    bool     b_quit;
+
+    /* Timing statistics */
+    mtime_t  i_time;        /**< Total time spent filtering */
+    unsigned i_fields;      /**< Number of filtered fields */
+} yadif_sys_t;
 
 /*****************************************************************************
  * Functions
  *****************************************************************************/
 
+/**
+ * Initializes the Yadif state, and starts the worker threads.
+ *
+ * @param p_filter The filter instance. Must be non-NULL.
+ * @param i_threads Number of slices to use; 0 for one per CPU.
+ *                  The calling thread filters one of the slices.
+ */
+void YadifInit( filter_t *p_filter, unsigned i_threads );
+
+/**
+ * Stops the worker threads and releases the Yadif state.
+ *
+ * @param p_filter The filter instance. Must be non-NULL.
+ */
+void YadifClean( filter_t *p_filter );
+
 /**
  * Yadif (Yet Another DeInterlacing Filter) from FFmpeg.
  * One field is copied as-is (i_field), the other is interpolated.
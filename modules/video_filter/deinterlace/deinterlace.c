@@ -92,6 +92,12 @@
                                     "in the Phosphor framerate doubler. "\
                                     "Default: Low.")
 
+#define THREADS_TEXT N_("Yadif threads")
+#define THREADS_LONGTEXT N_("Number of threads used by the Yadif "\
+                            "algorithms, each filtering a horizontal "\
+                            "slice of the picture. "\
+                            "0 uses one thread per CPU.")
+
 vlc_module_begin ()
     set_description( N_("Deinterlacing video filter") )
     set_shortname( N_("Deinterlace" ))
@@ -111,6 +117,8 @@ vlc_module_begin ()
                 PHOSPHOR_DIMMER_LONGTEXT, true )
         change_integer_list( phosphor_dimmer_list, phosphor_dimmer_list_text )
         change_safe ()
+    add_integer_with_range( FILTER_CFG_PREFIX "threads", 0, 0, YADIF_MAX_THREADS + 1,
+                            THREADS_TEXT, THREADS_LONGTEXT, true )
     add_shortcut( "deinterlace" )
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -126,7 +134,7 @@ vlc_module_end ()
  * and reading logic for them implemented in Open().
  */
 static const char *const ppsz_filter_options[] = {
-    "mode", "phosphor-chroma", "phosphor-dimmer",
+    "mode", "phosphor-chroma", "phosphor-dimmer", "threads",
     NULL
 };
 
@@ -663,6 +671,13 @@ notsupp:
 
     IVTCClearState( p_filter );
 
+    if( p_sys->i_mode == DEINTERLACE_YADIF ||
+        p_sys->i_mode == DEINTERLACE_YADIF2X )
+        YadifInit( p_filter,
+                   var_GetInteger( p_filter, FILTER_CFG_PREFIX "threads" ) );
+    else
+        YadifInit( p_filter, 1 );
+
 #if defined(CAN_COMPILE_C_ALTIVEC)
     if( pixel_size == 1 && vlc_CPU_ALTIVEC() )
         p_sys->pf_merge = MergeAltivec;
@@ -774,5 +789,6 @@ void Close( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t*)p_this;
 
     Flush( p_filter );
+    YadifClean( p_filter );
     free( p_filter->p_sys );
 }
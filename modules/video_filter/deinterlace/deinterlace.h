@@ -121,6 +121,7 @@ struct filter_sys_t
     /* Algorithm-specific substructures */
     phosphor_sys_t phosphor; /**< Phosphor algorithm state. */
     ivtc_sys_t ivtc;         /**< IVTC algorithm state. */
+    yadif_sys_t yadif;       /**< Yadif worker pool state. */
 };
 
 /*****************************************************************************
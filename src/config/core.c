@@ -563,37 +563,45 @@ module_config_t *config_FindConfig (vlc_object_t *p_this, const char *name)
  * Destroys an array of configuration items.
  * \param config start of array of items
  * \param confsize number of items in the array
+ * \param mapped whether the strings point into the plugins cache data
  */
-void config_Free (module_config_t *config, size_t confsize)
+void config_Free (module_config_t *config, size_t confsize, bool mapped)
 {
     for (size_t j = 0; j < confsize; j++)
     {
         module_config_t *p_item = config + j;
 
-        free( p_item->psz_type );
-        free( p_item->psz_name );
-        free( p_item->psz_text );
-        free( p_item->psz_longtext );
+        /* Mapped items only own their value and their list arrays */
+        if (!mapped)
+        {
+            free( p_item->psz_type );
+            free( p_item->psz_name );
+            free( p_item->psz_text );
+            free( p_item->psz_longtext );
+        }
 
         if (IsConfigIntegerType (p_item->i_type))
         {
-            if (p_item->list_count)
+            if (p_item->list_count && !mapped)
                 free (p_item->list.i);
         }
         else
         if (IsConfigStringType (p_item->i_type))
         {
             free (p_item->value.psz);
-            free (p_item->orig.psz);
+            if (!mapped)
+                free (p_item->orig.psz);
             if (p_item->list_count)
             {
-                for (size_t i = 0; i < p_item->list_count; i++)
-                    free (p_item->list.psz[i]);
+                if (!mapped)
+                    for (size_t i = 0; i < p_item->list_count; i++)
+                        free (p_item->list.psz[i]);
                 free (p_item->list.psz);
             }
         }
 
-        for (size_t i = 0; i < p_item->list_count; i++)
+        if (!mapped)
+            for (size_t i = 0; i < p_item->list_count; i++)
                 free (p_item->list_text[i]);
         free (p_item->list_text);
     }
@@ -76,6 +76,7 @@ static bool       Control( input_thread_t *, int, vlc_value_t );
 
 static int  UpdateTitleSeekpointFromDemux( input_thread_t * );
 static void UpdateGenericFromDemux( input_thread_t * );
+static void UpdatePacketStatsFromDemux( input_thread_t * );
 static void UpdateTitleListfromDemux( input_thread_t * );
 
 static void MRLSections( const char *, int *, int *, int *, int *);
@@ -354,6 +355,7 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     p_input->p->input.b_can_pace_control = true;
     p_input->p->input.b_can_rate_control = true;
     p_input->p->input.b_rescale_ts = true;
+    p_input->p->input.b_packet_stats = true;
     p_input->p->input.b_eof = false;
 
     vlc_mutex_lock( &p_item->lock );
@@ -678,6 +680,7 @@ static void MainLoopInterface( input_thread_t *p_input )
  */
 static void MainLoopStatistic( input_thread_t *p_input )
 {
+    UpdatePacketStatsFromDemux( p_input );
     stats_ComputeInputStats( p_input, p_input->p->p_item->p_stats );
     input_SendEventStatistics( p_input );
 }
@@ -833,6 +836,19 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( lost_abuffers, COUNTER );
         INIT_COUNTER( displayed_pictures, COUNTER );
         INIT_COUNTER( lost_pictures, COUNTER );
+        INIT_COUNTER( stream_cache, COUNTER );
+        INIT_COUNTER( stream_read_size, COUNTER );
+        INIT_COUNTER( stream_seeks, COUNTER );
+        INIT_COUNTER( packets_lost, COUNTER );
+        INIT_COUNTER( packets_late, COUNTER );
+        INIT_COUNTER( packets_reordered, COUNTER );
+        INIT_COUNTER( packets_duplicate, COUNTER );
+        INIT_COUNTER( read_stalls, COUNTER );
+        INIT_COUNTER( read_stall_time, COUNTER );
+        INIT_COUNTER( cache_hits, COUNTER );
+        INIT_COUNTER( cache_hit_bytes, COUNTER );
+        INIT_COUNTER( connection_reuses, COUNTER );
+        INIT_COUNTER( reconnections, COUNTER );
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
@@ -1312,6 +1328,19 @@ error:
         EXIT_COUNTER( lost_abuffers );
         EXIT_COUNTER( displayed_pictures );
         EXIT_COUNTER( lost_pictures );
+        EXIT_COUNTER( stream_cache );
+        EXIT_COUNTER( stream_read_size );
+        EXIT_COUNTER( stream_seeks );
+        EXIT_COUNTER( packets_lost );
+        EXIT_COUNTER( packets_late );
+        EXIT_COUNTER( packets_reordered );
+        EXIT_COUNTER( packets_duplicate );
+        EXIT_COUNTER( read_stalls );
+        EXIT_COUNTER( read_stall_time );
+        EXIT_COUNTER( cache_hits );
+        EXIT_COUNTER( cache_hit_bytes );
+        EXIT_COUNTER( connection_reuses );
+        EXIT_COUNTER( reconnections );
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
@@ -1349,6 +1378,10 @@ static void End( input_thread_t * p_input )
     /* Stop es out activity */
     es_out_SetMode( p_input->p->p_es_out, ES_OUT_MODE_NONE );
 
+    /* Last packet counts from the demux */
+    if( !p_input->b_preparsing && libvlc_stats( p_input ) )
+        UpdatePacketStatsFromDemux( p_input );
+
     /* Clean up master */
     InputSourceClean( &p_input->p->input );
 
@@ -1383,6 +1416,19 @@ static void End( input_thread_t * p_input )
             CL_CO( lost_abuffers );
             CL_CO( displayed_pictures );
             CL_CO( lost_pictures );
+            CL_CO( stream_cache );
+            CL_CO( stream_read_size );
+            CL_CO( stream_seeks );
+            CL_CO( packets_lost );
+            CL_CO( packets_late );
+            CL_CO( packets_reordered );
+            CL_CO( packets_duplicate );
+            CL_CO( read_stalls );
+            CL_CO( read_stall_time );
+            CL_CO( cache_hits );
+            CL_CO( cache_hit_bytes );
+            CL_CO( connection_reuses );
+            CL_CO( reconnections );
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
@@ -2162,6 +2208,41 @@ static void UpdateGenericFromDemux( input_thread_t *p_input )
     }
 }
 
+/* Brings a counter up to a total counted elsewhere */
+static void UpdateCounterTotal( counter_t *p_counter, uint64_t i_total )
+{
+    uint64_t i_current = 0;
+
+    stats_Update( p_counter, 0, &i_current );
+    if( i_total > i_current )
+        stats_Update( p_counter, i_total - i_current, NULL );
+}
+
+static void UpdatePacketStatsFromDemux( input_thread_t *p_input )
+{
+    input_source_t *in = &p_input->p->input;
+    uint64_t i_lost, i_late, i_reordered, i_duplicate;
+
+    if( !in->b_packet_stats )
+        return;
+    /* Not asked again to a demux that does not count packets */
+    if( demux_Control( in->p_demux, DEMUX_GET_PACKET_STATS, &i_lost, &i_late,
+                       &i_reordered, &i_duplicate ) )
+    {
+        in->b_packet_stats = false;
+        return;
+    }
+
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    UpdateCounterTotal( p_input->p->counters.p_packets_lost, i_lost );
+    UpdateCounterTotal( p_input->p->counters.p_packets_late, i_late );
+    UpdateCounterTotal( p_input->p->counters.p_packets_reordered,
+                        i_reordered );
+    UpdateCounterTotal( p_input->p->counters.p_packets_duplicate,
+                        i_duplicate );
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+}
+
 static void UpdateTitleListfromDemux( input_thread_t *p_input )
 {
     input_source_t *in = &p_input->p->input;
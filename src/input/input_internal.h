@@ -60,6 +60,7 @@ typedef struct
     bool b_can_rate_control;
     bool b_can_stream_record;
     bool b_rescale_ts;
+    bool b_packet_stats; /* DEMUX_GET_PACKET_STATS is answered */
 
     /* */
     int64_t i_pts_delay;
@@ -151,6 +152,19 @@ struct input_thread_private_t
         counter_t *p_lost_abuffers;
         counter_t *p_displayed_pictures;
         counter_t *p_lost_pictures;
+        counter_t *p_stream_cache;
+        counter_t *p_stream_read_size;
+        counter_t *p_stream_seeks;
+        counter_t *p_packets_lost;
+        counter_t *p_packets_late;
+        counter_t *p_packets_reordered;
+        counter_t *p_packets_duplicate;
+        counter_t *p_read_stalls;
+        counter_t *p_read_stall_time;
+        counter_t *p_cache_hits;
+        counter_t *p_cache_hit_bytes;
+        counter_t *p_connection_reuses;
+        counter_t *p_reconnections;
         vlc_mutex_t counters_lock;
     } counters;
 
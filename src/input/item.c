@@ -1082,3 +1082,45 @@ void input_item_UpdateTracksInfo(input_item_t *item, const es_format_t *fmt)
     TAB_APPEND(item->i_es, item->es, fmt_copy);
     vlc_mutex_unlock( &item->lock );
 }
+
+/* Gives an item what preparsing found for another item of the same URI. */
+void input_item_CopyPreparsed( input_item_t *p_dst, input_item_t *p_src )
+{
+    vlc_meta_t *p_meta = vlc_meta_New();
+    es_format_t **pp_es = NULL;
+    int i_es = 0;
+
+    vlc_mutex_lock( &p_src->lock );
+    if( p_meta != NULL && p_src->p_meta != NULL )
+        vlc_meta_Merge( p_meta, p_src->p_meta );
+    mtime_t i_duration = p_src->i_duration;
+    for( int i = 0; i < p_src->i_es; i++ )
+    {
+        es_format_t *p_fmt = malloc( sizeof(*p_fmt) );
+        if( unlikely(p_fmt == NULL) )
+            break;
+        es_format_Copy( p_fmt, p_src->es[i] );
+        TAB_APPEND( i_es, pp_es, p_fmt );
+    }
+    vlc_mutex_unlock( &p_src->lock );
+
+    if( p_meta != NULL )
+    {
+        vlc_mutex_lock( &p_dst->lock );
+        if( !p_dst->p_meta )
+            p_dst->p_meta = vlc_meta_New();
+        vlc_meta_Merge( p_dst->p_meta, p_meta );
+        vlc_mutex_unlock( &p_dst->lock );
+        vlc_meta_Delete( p_meta );
+    }
+
+    input_item_SetDuration( p_dst, i_duration );
+
+    for( int i = 0; i < i_es; i++ )
+    {
+        input_item_UpdateTracksInfo( p_dst, pp_es[i] );
+        es_format_Clean( pp_es[i] );
+        free( pp_es[i] );
+    }
+    free( pp_es );
+}
@@ -29,6 +29,7 @@
 
 void input_item_SetErrorWhenReading( input_item_t *p_i, bool b_error );
 void input_item_UpdateTracksInfo( input_item_t *item, const es_format_t *fmt );
+void input_item_CopyPreparsed( input_item_t *p_dst, input_item_t *p_src );
 
 typedef struct input_item_owner
 {
@@ -95,6 +95,11 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_demux_corrupted = stats_GetTotal(input->p->counters.p_demux_corrupted);
     st->i_demux_discontinuity = stats_GetTotal(input->p->counters.p_demux_discontinuity);
 
+    /* Stream cache */
+    st->i_stream_cache_size = stats_GetTotal(input->p->counters.p_stream_cache);
+    st->i_stream_read_size = stats_GetTotal(input->p->counters.p_stream_read_size);
+    st->i_stream_seeks = stats_GetTotal(input->p->counters.p_stream_seeks);
+
     /* Decoders */
     st->i_decoded_video = stats_GetTotal(input->p->counters.p_decoded_video);
     st->i_decoded_audio = stats_GetTotal(input->p->counters.p_decoded_audio);
@@ -115,6 +120,22 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_displayed_pictures = stats_GetTotal(input->p->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(input->p->counters.p_lost_pictures);
 
+    /* Network packets */
+    st->i_packets_lost = stats_GetTotal(input->p->counters.p_packets_lost);
+    st->i_packets_late = stats_GetTotal(input->p->counters.p_packets_late);
+    st->i_packets_reordered = stats_GetTotal(input->p->counters.p_packets_reordered);
+    st->i_packets_duplicate = stats_GetTotal(input->p->counters.p_packets_duplicate);
+
+    /* Access stalls */
+    st->i_read_stalls = stats_GetTotal(input->p->counters.p_read_stalls);
+    st->i_read_stall_time = stats_GetTotal(input->p->counters.p_read_stall_time);
+
+    /* Access range cache and connections */
+    st->i_cache_hits = stats_GetTotal(input->p->counters.p_cache_hits);
+    st->i_cache_hit_bytes = stats_GetTotal(input->p->counters.p_cache_hit_bytes);
+    st->i_connection_reuses = stats_GetTotal(input->p->counters.p_connection_reuses);
+    st->i_reconnections = stats_GetTotal(input->p->counters.p_reconnections);
+
     vlc_mutex_unlock(&st->lock);
     vlc_mutex_unlock(&input->p->counters.counters_lock);
 }
@@ -127,11 +148,17 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_demux_read_packets = p_stats->i_demux_read_bytes =
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
+    p_stats->i_stream_cache_size = p_stats->i_stream_read_size =
+    p_stats->i_stream_seeks =
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
-    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
-     = 0;
+    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate =
+    p_stats->i_packets_lost = p_stats->i_packets_late =
+    p_stats->i_packets_reordered = p_stats->i_packets_duplicate =
+    p_stats->i_read_stalls = p_stats->i_read_stall_time =
+    p_stats->i_cache_hits = p_stats->i_cache_hit_bytes =
+    p_stats->i_connection_reuses = p_stats->i_reconnections = 0;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -58,7 +58,8 @@
  *      It should probably defaulted (instead of the stream method (2)).
  */
 
-/* How many tracks we have, currently only used for stream mode */
+/* How many tracks we have at most, currently only used for stream mode.
+ * Non seekable accesses only get one, as other tracks could not be used. */
 #ifdef OPTIMIZE_MEMORY
 #   define STREAM_CACHE_TRACK 1
     /* Max size of our cache 128Ko per track */
@@ -69,6 +70,11 @@
 #   define STREAM_CACHE_SIZE  (4*STREAM_CACHE_TRACK*1024*1024)
 #endif
 
+/* The cache starts small and grows up to STREAM_CACHE_SIZE, so that it
+ * holds about STREAM_CACHE_DURATION seconds of the measured bitrate */
+#define STREAM_CACHE_MIN_SIZE __MIN(512*1024, STREAM_CACHE_SIZE)
+#define STREAM_CACHE_DURATION 4
+
 /* How many data we try to prebuffer
  * XXX it should be small to avoid useless latency but big enough for
  * efficient demux probing */
@@ -93,7 +99,8 @@
  *        - ?
  */
 #define STREAM_READ_ATONCE 1024
-#define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
+/* The read size doubles while the access keeps up, up to this value */
+#define STREAM_READ_MAX (64*1024)
 
 typedef struct
 {
@@ -130,6 +137,7 @@ struct stream_sys_t
     /* Method 1: pf_block */
     struct
     {
+        uint64_t i_cache_size;   /* Amount of data kept in the list */
         uint64_t i_start;        /* Offset of block for p_first */
         uint64_t i_offset;       /* Offset for data in p_current */
         block_t *p_current;     /* Current block */
@@ -145,6 +153,8 @@ struct stream_sys_t
     {
         unsigned i_offset;   /* Buffer offset in the current track */
         int      i_tk;       /* Current track */
+        int      i_tk_count; /* Number of tracks in use */
+        unsigned i_tk_size;  /* Size of each track */
         stream_track_t tk[STREAM_CACHE_TRACK];
 
         /* Global buffer */
@@ -174,6 +184,22 @@ struct stream_sys_t
         unsigned i_seek_count;
         uint64_t i_seek_time;
 
+        /* Bitrate measurement, for cache sizing */
+        int64_t  i_rate_date;
+        uint64_t i_rate_bytes;
+
+        /* Values last added to the input counters */
+        uint64_t i_cache_reported;
+        unsigned i_read_size_reported;
+        bool     b_access_stalls;      /* ACCESS_GET_STALLS is answered */
+        bool     b_access_connections; /* ACCESS_GET_CONNECTION_STATS too */
+        uint64_t i_stalls_reported;
+        uint64_t i_stall_time_reported;
+        uint64_t i_cache_hits_reported;
+        uint64_t i_cache_hit_bytes_reported;
+        uint64_t i_reuses_reported;
+        uint64_t i_reconnections_reported;
+
     } stat;
 
     /* Streams list */
@@ -191,6 +217,7 @@ static void AStreamPrebufferBlock( stream_t *s );
 static block_t *AReadBlock( stream_t *s, bool *pb_eof );
 
 /* Method 2 */
+static int  AStreamResizeStream( stream_t *s, unsigned i_size );
 static int  AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read );
 static int  AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read );
 static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
@@ -198,6 +225,9 @@ static void AStreamPrebufferStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
 
 /* Common */
+static void AStreamAdapt( stream_t *s );
+static void AStreamUpdateCounters( stream_t *s );
+static void AStreamUpdateAccessCounters( stream_t *s );
 static int AStreamControl( stream_t *s, int i_query, va_list );
 static void AStreamDestroy( stream_t *s );
 static int  ASeek( stream_t *s, uint64_t i_pos );
@@ -306,6 +336,18 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     p_sys->stat.i_read_count = 0;
     p_sys->stat.i_seek_count = 0;
     p_sys->stat.i_seek_time = 0;
+    p_sys->stat.i_rate_date = mdate();
+    p_sys->stat.i_rate_bytes = 0;
+    p_sys->stat.i_cache_reported = 0;
+    p_sys->stat.i_read_size_reported = 0;
+    p_sys->stat.b_access_stalls = true;
+    p_sys->stat.b_access_connections = true;
+    p_sys->stat.i_stalls_reported = 0;
+    p_sys->stat.i_stall_time_reported = 0;
+    p_sys->stat.i_cache_hits_reported = 0;
+    p_sys->stat.i_cache_hit_bytes_reported = 0;
+    p_sys->stat.i_reuses_reported = 0;
+    p_sys->stat.i_reconnections_reported = 0;
 
     TAB_INIT( p_sys->i_list, p_sys->list );
     p_sys->i_list_index = 0;
@@ -369,6 +411,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         s->pf_peek = AStreamPeekBlock;
 
         /* Init all fields of p_sys->block */
+        p_sys->block.i_cache_size = STREAM_CACHE_MIN_SIZE;
         p_sys->block.i_start = p_sys->i_pos;
         p_sys->block.i_offset = 0;
         p_sys->block.p_current = NULL;
@@ -397,9 +440,16 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         s->pf_peek = AStreamPeekStream;
 
         /* Allocate/Setup our tracks */
+        bool b_seek;
+        access_Control( p_access, ACCESS_CAN_SEEK, &b_seek );
+
         p_sys->stream.i_offset = 0;
         p_sys->stream.i_tk     = 0;
-        p_sys->stream.p_buffer = malloc( STREAM_CACHE_SIZE );
+        p_sys->stream.i_tk_count = b_seek ? STREAM_CACHE_TRACK : 1;
+        p_sys->stream.i_tk_size = __MIN( STREAM_CACHE_MIN_SIZE,
+                              STREAM_CACHE_SIZE / p_sys->stream.i_tk_count );
+        p_sys->stream.p_buffer = malloc( p_sys->stream.i_tk_count *
+                                         p_sys->stream.i_tk_size );
         if( p_sys->stream.p_buffer == NULL )
             goto error;
         p_sys->stream.i_used   = 0;
@@ -408,13 +458,13 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
 #   error "Invalid STREAM_READ_ATONCE value"
 #endif
 
-        for( i = 0; i < STREAM_CACHE_TRACK; i++ )
+        for( i = 0; i < p_sys->stream.i_tk_count; i++ )
         {
             p_sys->stream.tk[i].i_date  = 0;
             p_sys->stream.tk[i].i_start = p_sys->i_pos;
             p_sys->stream.tk[i].i_end   = p_sys->i_pos;
             p_sys->stream.tk[i].p_buffer=
-                &p_sys->stream.p_buffer[i * STREAM_CACHE_TRACK_SIZE];
+                &p_sys->stream.p_buffer[i * p_sys->stream.i_tk_size];
         }
 
         /* Do the prebuffering */
@@ -427,6 +477,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         }
     }
 
+    AStreamUpdateCounters( s );
     return s;
 
 error:
@@ -454,6 +505,19 @@ static void AStreamDestroy( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
 
+    AStreamUpdateAccessCounters( s );
+
+    if( p_sys->method == STREAM_METHOD_BLOCK )
+        msg_Dbg( s, "cache of %"PRIu64" KiB", p_sys->block.i_cache_size / 1024 );
+    else
+        msg_Dbg( s, "cache of %d track(s) of %u KiB, read size %u bytes",
+                 p_sys->stream.i_tk_count, p_sys->stream.i_tk_size / 1024,
+                 p_sys->stream.i_read_size );
+    msg_Dbg( s, "%"PRIu64" bytes in %"PRIu64" reads (%"PRIu64" ms), "
+             "%u seeks (%"PRIu64" ms)", p_sys->stat.i_bytes,
+             p_sys->stat.i_read_count, p_sys->stat.i_read_time / 1000,
+             p_sys->stat.i_seek_count, p_sys->stat.i_seek_time / 1000 );
+
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
     else
@@ -511,7 +575,7 @@ static void AStreamControlReset( stream_t *s )
         p_sys->stream.i_tk     = 0;
         p_sys->stream.i_used   = 0;
 
-        for( i = 0; i < STREAM_CACHE_TRACK; i++ )
+        for( i = 0; i < p_sys->stream.i_tk_count; i++ )
         {
             p_sys->stream.tk[i].i_date  = 0;
             p_sys->stream.tk[i].i_start = p_sys->i_pos;
@@ -645,6 +709,152 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
     return VLC_SUCCESS;
 }
 
+/****************************************************************************
+ * AStreamAdapt: grow the cache to hold a few seconds of the bitrate
+ ****************************************************************************/
+static void AStreamAdapt( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const int64_t i_now = mdate();
+    const int64_t i_elapsed = i_now - p_sys->stat.i_rate_date;
+
+    if( i_elapsed < CLOCK_FREQ )
+        return;
+
+    const uint64_t i_rate = ( p_sys->stat.i_bytes - p_sys->stat.i_rate_bytes )
+                            * CLOCK_FREQ / i_elapsed;
+    const uint64_t i_target = i_rate * STREAM_CACHE_DURATION;
+
+    p_sys->stat.i_rate_date = i_now;
+    p_sys->stat.i_rate_bytes = p_sys->stat.i_bytes;
+
+    if( p_sys->method == STREAM_METHOD_BLOCK )
+    {
+        if( i_target > p_sys->block.i_cache_size )
+            p_sys->block.i_cache_size = __MIN( i_target, STREAM_CACHE_SIZE );
+        return;
+    }
+
+    const unsigned i_max = STREAM_CACHE_SIZE / p_sys->stream.i_tk_count;
+    unsigned i_size = p_sys->stream.i_tk_size;
+
+    while( i_size < i_target && i_size < i_max )
+        i_size *= 2;
+    AStreamResizeStream( s, __MIN( i_size, i_max ) );
+}
+
+/****************************************************************************
+ * AStreamUpdateCounters: publish the cache and read sizes in the input stats
+ ****************************************************************************/
+static void AStreamUpdateCounters( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    input_thread_t *p_input = s->p_input;
+    uint64_t i_cache;
+    unsigned i_read_size;
+
+    AStreamUpdateAccessCounters( s );
+
+    if( p_sys->method == STREAM_METHOD_BLOCK )
+    {
+        i_cache = p_sys->block.i_cache_size;
+        i_read_size = 0; /* the access decides the block sizes */
+    }
+    else
+    {
+        i_cache = (uint64_t)p_sys->stream.i_tk_count * p_sys->stream.i_tk_size;
+        i_read_size = p_sys->stream.i_read_size;
+    }
+
+    if( !p_input || ( i_cache == p_sys->stat.i_cache_reported &&
+                      i_read_size == p_sys->stat.i_read_size_reported ) )
+        return;
+
+    /* Counters only add up: add the change since the last update, so
+     * that they hold the sum over the streams of the input */
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    stats_Update( p_input->p->counters.p_stream_cache,
+                  i_cache - p_sys->stat.i_cache_reported, NULL );
+    stats_Update( p_input->p->counters.p_stream_read_size,
+                  (uint64_t)i_read_size - p_sys->stat.i_read_size_reported,
+                  NULL );
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+
+    p_sys->stat.i_cache_reported = i_cache;
+    p_sys->stat.i_read_size_reported = i_read_size;
+}
+
+/****************************************************************************
+ * AStreamUpdateAccessCounters: publish what the access counts in the input
+ * stats
+ ****************************************************************************/
+/* Adds the growth of an access total since it was last added. The next
+ * access of a list counts from zero again. */
+static void AStreamAddTotal( counter_t *p_counter, uint64_t i_total,
+                             uint64_t *pi_reported )
+{
+    if( i_total < *pi_reported )
+        *pi_reported = 0;
+    if( i_total > *pi_reported )
+        stats_Update( p_counter, i_total - *pi_reported, NULL );
+    *pi_reported = i_total;
+}
+
+static void AStreamUpdateAccessCounters( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    input_thread_t *p_input = s->p_input;
+    access_t *p_access = p_sys->p_list_access ? p_sys->p_list_access
+                                              : p_sys->p_access;
+
+    if( !p_input )
+        return;
+
+    /* Not asked again to an access that does not count them */
+    if( p_sys->stat.b_access_stalls )
+    {
+        uint64_t i_stalls;
+        int64_t i_stall_time;
+
+        if( access_Control( p_access, ACCESS_GET_STALLS, &i_stalls,
+                            &i_stall_time ) )
+            p_sys->stat.b_access_stalls = false;
+        else
+        {
+            vlc_mutex_lock( &p_input->p->counters.counters_lock );
+            AStreamAddTotal( p_input->p->counters.p_read_stalls, i_stalls,
+                             &p_sys->stat.i_stalls_reported );
+            AStreamAddTotal( p_input->p->counters.p_read_stall_time,
+                             i_stall_time, &p_sys->stat.i_stall_time_reported );
+            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+        }
+    }
+
+    if( p_sys->stat.b_access_connections )
+    {
+        uint64_t i_hits, i_hit_bytes, i_reuses, i_reconnections;
+
+        if( access_Control( p_access, ACCESS_GET_CONNECTION_STATS, &i_hits,
+                            &i_hit_bytes, &i_reuses, &i_reconnections ) )
+            p_sys->stat.b_access_connections = false;
+        else
+        {
+            vlc_mutex_lock( &p_input->p->counters.counters_lock );
+            AStreamAddTotal( p_input->p->counters.p_cache_hits, i_hits,
+                             &p_sys->stat.i_cache_hits_reported );
+            AStreamAddTotal( p_input->p->counters.p_cache_hit_bytes,
+                             i_hit_bytes,
+                             &p_sys->stat.i_cache_hit_bytes_reported );
+            AStreamAddTotal( p_input->p->counters.p_connection_reuses,
+                             i_reuses, &p_sys->stat.i_reuses_reported );
+            AStreamAddTotal( p_input->p->counters.p_reconnections,
+                             i_reconnections,
+                             &p_sys->stat.i_reconnections_reported );
+            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+        }
+    }
+}
+
 /****************************************************************************
  * Method 1:
  ****************************************************************************/
@@ -904,7 +1114,7 @@ static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
             int i_th = b_aseekfast ? 1 : 5;
 
             if( i_skip <= i_th * i_avg &&
-                i_skip < STREAM_CACHE_SIZE )
+                i_skip < (int64_t)p_sys->block.i_cache_size )
                 b_seek = false;
             else
                 b_seek = true;
@@ -939,7 +1149,6 @@ static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
 
         /* Update stat */
         p_sys->stat.i_seek_time += i_end - i_start;
-        p_sys->stat.i_seek_count++;
         return VLC_SUCCESS;
     }
     else
@@ -976,7 +1185,7 @@ static int AStreamRefillBlock( stream_t *s )
     block_t      *b;
 
     /* Release data */
-    while( p_sys->block.i_size >= STREAM_CACHE_SIZE &&
+    while( p_sys->block.i_size >= p_sys->block.i_cache_size &&
            p_sys->block.p_first != p_sys->block.p_current )
     {
         block_t *b = p_sys->block.p_first;
@@ -984,10 +1193,12 @@ static int AStreamRefillBlock( stream_t *s )
         p_sys->block.i_start += b->i_buffer;
         p_sys->block.i_size  -= b->i_buffer;
         p_sys->block.p_first  = b->p_next;
+        if( p_sys->block.p_first == NULL )
+            p_sys->block.pp_last = &p_sys->block.p_first;
 
         block_Release( b );
     }
-    if( p_sys->block.i_size >= STREAM_CACHE_SIZE &&
+    if( p_sys->block.i_size >= p_sys->block.i_cache_size &&
         p_sys->block.p_current == p_sys->block.p_first &&
         p_sys->block.p_current->p_next )    /* At least 2 packets */
     {
@@ -1029,6 +1240,8 @@ static int AStreamRefillBlock( stream_t *s )
 
         b = b->p_next;
     }
+    AStreamAdapt( s );
+    AStreamUpdateCounters( s );
     return VLC_SUCCESS;
 }
 
@@ -1039,6 +1252,46 @@ static int AStreamRefillBlock( stream_t *s )
 static int AStreamRefillStream( stream_t *s );
 static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read );
 
+/* Grows all tracks, keeping their content */
+static int AStreamResizeStream( stream_t *s, unsigned i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const unsigned i_old = p_sys->stream.i_tk_size;
+
+    if( i_size <= i_old )
+        return VLC_SUCCESS;
+
+    uint8_t *p_buffer = malloc( p_sys->stream.i_tk_count * i_size );
+    if( p_buffer == NULL )
+        return VLC_ENOMEM;
+
+    for( int i = 0; i < p_sys->stream.i_tk_count; i++ )
+    {
+        stream_track_t *tk = &p_sys->stream.tk[i];
+        uint8_t *p_dst = &p_buffer[i * i_size];
+
+        /* Data lives at offset modulo the track size */
+        for( uint64_t i_pos = tk->i_start; i_pos < tk->i_end; )
+        {
+            unsigned i_src = i_pos % i_old;
+            unsigned i_dst = i_pos % i_size;
+            unsigned i_copy = __MIN( tk->i_end - i_pos,
+                                     __MIN( i_old - i_src, i_size - i_dst ) );
+
+            memcpy( &p_dst[i_dst], &tk->p_buffer[i_src], i_copy );
+            i_pos += i_copy;
+        }
+        tk->p_buffer = p_dst;
+    }
+
+    free( p_sys->stream.p_buffer );
+    p_sys->stream.p_buffer = p_buffer;
+    p_sys->stream.i_tk_size = i_size;
+    msg_Dbg( s, "cache grown to %d track(s) of %u KiB",
+             p_sys->stream.i_tk_count, i_size / 1024 );
+    return VLC_SUCCESS;
+}
+
 static int AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1072,9 +1325,20 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
              tk->i_start, p_sys->stream.i_offset, tk->i_end );
 #endif
 
+    /* Grow the tracks for large peeks, within the cache size limit */
+    if( i_read > p_sys->stream.i_tk_size / 2 )
+    {
+        const unsigned i_max = STREAM_CACHE_SIZE / p_sys->stream.i_tk_count;
+        unsigned i_size = p_sys->stream.i_tk_size;
+
+        while( i_size / 2 < i_read && i_size < i_max )
+            i_size *= 2;
+        AStreamResizeStream( s, __MIN( i_size, i_max ) );
+    }
+
     /* Avoid problem, but that should *never* happen */
-    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
-        i_read = STREAM_CACHE_TRACK_SIZE / 2;
+    if( i_read > p_sys->stream.i_tk_size / 2 )
+        i_read = p_sys->stream.i_tk_size / 2;
 
     while( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
     {
@@ -1093,8 +1357,9 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
 
 
     /* Now, direct pointer or a copy ? */
-    i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-    if( i_off + i_read <= STREAM_CACHE_TRACK_SIZE )
+    const unsigned i_tk_size = p_sys->stream.i_tk_size;
+    i_off = (tk->i_start + p_sys->stream.i_offset) % i_tk_size;
+    if( i_off + i_read <= i_tk_size )
     {
         *pp_peek = &tk->p_buffer[i_off];
         return i_read;
@@ -1111,10 +1376,9 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
         p_sys->i_peek = i_read;
     }
 
-    memcpy( p_sys->p_peek, &tk->p_buffer[i_off],
-            STREAM_CACHE_TRACK_SIZE - i_off );
-    memcpy( &p_sys->p_peek[STREAM_CACHE_TRACK_SIZE - i_off],
-            &tk->p_buffer[0], i_read - (STREAM_CACHE_TRACK_SIZE - i_off) );
+    memcpy( p_sys->p_peek, &tk->p_buffer[i_off], i_tk_size - i_off );
+    memcpy( &p_sys->p_peek[i_tk_size - i_off],
+            &tk->p_buffer[0], i_read - (i_tk_size - i_off) );
 
     *pp_peek = p_sys->p_peek;
     return i_read;
@@ -1173,7 +1437,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     if( !tk )
     {
         /* Try to maximize already read data */
-        for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
+        for( int i = 0; i < p_sys->stream.i_tk_count; i++ )
         {
             stream_track_t *t = &p_sys->stream.tk[i];
 
@@ -1190,7 +1454,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     if( !tk )
     {
         /* Use the oldest unused */
-        for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
+        for( int i = 0; i < p_sys->stream.i_tk_count; i++ )
         {
             stream_track_t *t = &p_sys->stream.tk[i];
 
@@ -1201,7 +1465,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
             }
         }
     }
-    assert( i_tk_idx >= 0 && i_tk_idx < STREAM_CACHE_TRACK );
+    assert( i_tk_idx >= 0 && i_tk_idx < p_sys->stream.i_tk_count );
 
     if( tk != p_current )
         i_skip_threshold = 0;
@@ -1228,7 +1492,8 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
             uint64_t i_skip = i_pos - tk->i_end;
             while( i_skip > 0 )
             {
-                const int i_read_max = __MIN( 10 * STREAM_READ_ATONCE, i_skip );
+                const int i_read_max = __MIN( 10 * p_sys->stream.i_read_size,
+                                              i_skip );
                 if( AStreamReadNoSeekStream( s, NULL, i_read_max ) != i_read_max )
                     return VLC_EGENERIC;
                 i_skip -= i_read_max;
@@ -1258,8 +1523,8 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
      */
     if( tk->i_end < tk->i_start + p_sys->stream.i_offset + p_sys->stream.i_read_size )
     {
-        if( p_sys->stream.i_used < STREAM_READ_ATONCE / 2 )
-            p_sys->stream.i_used = STREAM_READ_ATONCE / 2;
+        if( p_sys->stream.i_used < p_sys->stream.i_read_size / 2 )
+            p_sys->stream.i_used = p_sys->stream.i_read_size / 2;
 
         if( AStreamRefillStream( s ) && i_pos >= tk->i_end )
             return VLC_EGENERIC;
@@ -1287,10 +1552,11 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
 
     while( i_data < i_read )
     {
-        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
+        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) %
+                         p_sys->stream.i_tk_size;
         unsigned int i_current =
             __MIN( tk->i_end - tk->i_start - p_sys->stream.i_offset,
-                   STREAM_CACHE_TRACK_SIZE - i_off );
+                   p_sys->stream.i_tk_size - i_off );
         int i_copy = __MIN( i_current, i_read - i_data );
 
         if( i_copy <= 0 ) break; /* EOF */
@@ -1314,8 +1580,8 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
         if( tk->i_end + i_data <= tk->i_start + p_sys->stream.i_offset + i_read )
         {
             const unsigned i_read_requested = VLC_CLIP( i_read - i_data,
-                                                    STREAM_READ_ATONCE / 2,
-                                                    STREAM_READ_ATONCE * 10 );
+                                            p_sys->stream.i_read_size / 2,
+                                            p_sys->stream.i_read_size * 10 );
 
             if( p_sys->stream.i_used < i_read_requested )
                 p_sys->stream.i_used = i_read_requested;
@@ -1337,11 +1603,13 @@ static int AStreamRefillStream( stream_t *s )
     stream_sys_t *p_sys = s->p_sys;
     stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
+    const unsigned i_tk_size = p_sys->stream.i_tk_size;
     /* We read but won't increase i_start after initial start + offset */
     int i_toread =
-        __MIN( p_sys->stream.i_used, STREAM_CACHE_TRACK_SIZE -
+        __MIN( p_sys->stream.i_used, i_tk_size -
                (tk->i_end - tk->i_start - p_sys->stream.i_offset) );
     bool b_read = false;
+    bool b_short = false;
     int64_t i_start, i_stop;
 
     if( i_toread <= 0 ) return VLC_EGENERIC; /* EOF */
@@ -1354,14 +1622,14 @@ static int AStreamRefillStream( stream_t *s )
     i_start = mdate();
     while( i_toread > 0 )
     {
-        int i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
-        int i_read;
+        int i_off = tk->i_end % i_tk_size;
+        int i_read, i_wanted;
 
         if( !vlc_object_alive(s) )
             return VLC_EGENERIC;
 
-        i_read = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
-        i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
+        i_wanted = __MIN( i_toread, (int)i_tk_size - i_off );
+        i_read = AReadStream( s, &tk->p_buffer[i_off], i_wanted );
 
         /* msg_Dbg( s, "AStreamRefillStream: read=%d", i_read ); */
         if( i_read <  0 )
@@ -1375,14 +1643,16 @@ static int AStreamRefillStream( stream_t *s )
             return VLC_SUCCESS;
         }
         b_read = true;
+        if( i_read < i_wanted )
+            b_short = true;
 
         /* Update end */
         tk->i_end += i_read;
 
-        /* Windows of STREAM_CACHE_TRACK_SIZE */
-        if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end )
+        /* Windows of the track size */
+        if( tk->i_start + i_tk_size < tk->i_end )
         {
-            unsigned i_invalid = tk->i_end - tk->i_start - STREAM_CACHE_TRACK_SIZE;
+            unsigned i_invalid = tk->i_end - tk->i_start - i_tk_size;
 
             tk->i_start += i_invalid;
             p_sys->stream.i_offset -= i_invalid;
@@ -1398,6 +1668,18 @@ static int AStreamRefillStream( stream_t *s )
 
     p_sys->stat.i_read_time += i_stop - i_start;
 
+    /* Read more at once while the access keeps up, less when it starves */
+    if( !b_short )
+        p_sys->stream.i_read_size = __MIN( 2 * p_sys->stream.i_read_size,
+                                __MIN( STREAM_READ_MAX, i_tk_size / 16 ) );
+    else
+        p_sys->stream.i_read_size = __MAX( p_sys->stream.i_read_size / 2,
+                                           STREAM_READ_ATONCE );
+    p_sys->stream.i_read_size = __MAX( p_sys->stream.i_read_size,
+                                       STREAM_READ_ATONCE );
+
+    AStreamAdapt( s );
+    AStreamUpdateCounters( s );
     return VLC_SUCCESS;
 }
 
@@ -1437,7 +1719,7 @@ static void AStreamPrebufferStream( stream_t *s )
         }
 
         /* */
-        i_read = STREAM_CACHE_TRACK_SIZE - i_buffered;
+        i_read = p_sys->stream.i_tk_size - i_buffered;
         i_read = __MIN( (int)p_sys->stream.i_read_size, i_read );
         i_read = AReadStream( s, &tk->p_buffer[i_buffered], i_read );
         if( i_read <  0 )
@@ -1785,6 +2067,15 @@ static int ASeek( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t *p_access = p_sys->p_access;
+    input_thread_t *p_input = s->p_input;
+
+    p_sys->stat.i_seek_count++;
+    if( p_input )
+    {
+        vlc_mutex_lock( &p_input->p->counters.counters_lock );
+        stats_Update( p_input->p->counters.p_stream_seeks, 1, NULL );
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+    }
 
     /* Check which stream we need to access */
     if( p_sys->i_list )
@@ -1117,6 +1117,11 @@ static const char *const ppsz_prefres[] = {
     "Automatically preparse files added to the playlist " \
     "(to retrieve some metadata)." )
 
+#define PREPARSE_THREADS_TEXT N_("Preparser threads")
+#define PREPARSE_THREADS_LONGTEXT N_( \
+    "Maximum number of items preparsed, or whose art is fetched, " \
+    "at the same time." )
+
 #define ALBUM_ART_TEXT N_( "Album art policy" )
 #define ALBUM_ART_LONGTEXT N_( \
     "Choose how album art will be downloaded." )
@@ -2044,6 +2049,9 @@ vlc_module_begin ()
 
     add_bool( "auto-preparse", true, PREPARSE_TEXT,
               PREPARSE_LONGTEXT, false )
+    add_integer_with_range( "preparse-threads", 4, 1, 32,
+                            PREPARSE_THREADS_TEXT, PREPARSE_THREADS_LONGTEXT,
+                            true )
 
     add_integer( "album-art", ALBUM_ART_WHEN_ASKED, ALBUM_ART_TEXT,
                  ALBUM_ART_LONGTEXT, false )
@@ -628,10 +628,36 @@ int libvlc_MetaRequest(libvlc_int_t *libvlc, input_item_t *item)
     if (unlikely(priv->parser == NULL))
         return VLC_ENOMEM;
 
-    playlist_preparser_Push(priv->parser, item);
+    playlist_preparser_Push(priv->parser, item, true);
     return VLC_SUCCESS;
 }
 
+/**
+ * Requests extraction of the meta data for an input item in the background,
+ * after the explicit requests.
+ */
+int libvlc_MetaRequestBackground(libvlc_int_t *libvlc, input_item_t *item)
+{
+    libvlc_priv_t *priv = libvlc_priv(libvlc);
+
+    if (unlikely(priv->parser == NULL))
+        return VLC_ENOMEM;
+
+    playlist_preparser_Push(priv->parser, item, false);
+    return VLC_SUCCESS;
+}
+
+/**
+ * Withdraws a pending meta data extraction request for an input item.
+ */
+void libvlc_MetaCancel(libvlc_int_t *libvlc, input_item_t *item)
+{
+    libvlc_priv_t *priv = libvlc_priv(libvlc);
+
+    if (priv->parser != NULL)
+        playlist_preparser_Cancel(priv->parser, item);
+}
+
 /**
  * Requests retrieving/downloading art for an input item.
  * The retrieval is performed asynchronously.
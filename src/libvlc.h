@@ -178,6 +178,8 @@ static inline libvlc_priv_t *libvlc_priv (libvlc_int_t *libvlc)
     return (libvlc_priv_t *)libvlc;
 }
 
+int libvlc_MetaRequestBackground(libvlc_int_t *, input_item_t *);
+
 void intf_InsertItem(libvlc_int_t *, const char *mrl, unsigned optc,
                      const char * const *optv, unsigned flags);
 void intf_DestroyAll( libvlc_int_t * );
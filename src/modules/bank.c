@@ -41,6 +41,7 @@
 #include <vlc_plugin.h>
 #include <vlc_modules.h>
 #include <vlc_fs.h>
+#include <vlc_block.h>
 #include "libvlc.h"
 #include "config/configuration.h"
 #include "modules/modules.h"
@@ -49,8 +50,9 @@ static struct
 {
     vlc_mutex_t lock;
     module_t *head;
+    block_t *caches; /* plugins cache data the modules point into */
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+} modules = { VLC_STATIC_MUTEX, NULL, NULL, 0 };
 
 /*****************************************************************************
  * Local prototypes
@@ -131,6 +133,7 @@ void module_InitBank (void)
 void module_EndBank (bool b_plugins)
 {
     module_t *head = NULL;
+    block_t *caches = NULL;
 
     /* If plugins were _not_ loaded, then the caller still has the bank lock
      * from module_InitBank(). */
@@ -145,6 +148,8 @@ void module_EndBank (bool b_plugins)
         config_UnsortConfig ();
         head = modules.head;
         modules.head = NULL;
+        caches = modules.caches;
+        modules.caches = NULL;
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -162,6 +167,7 @@ void module_EndBank (bool b_plugins)
 #endif
         vlc_module_destroy (module);
     }
+    block_ChainRelease (caches);
 }
 
 #undef module_LoadPlugins
@@ -359,6 +365,8 @@ typedef struct module_bank
 
     int            i_loaded_cache;
     module_cache_t *loaded_cache;
+
+    bool           b_cache_dirty; /* cache file needs to be rewritten */
 } module_bank_t;
 
 static void AllocatePluginDir (module_bank_t *, unsigned,
@@ -373,12 +381,15 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
 {
     module_bank_t bank;
     module_cache_t *cache = NULL;
+    block_t *map = NULL;
     size_t count = 0;
 
     switch( mode )
     {
         case CACHE_USE:
-            count = CacheLoad( p_this, path, &cache );
+            count = CacheLoad( p_this, path, &cache, &map );
+            if( map != NULL )
+                block_ChainAppend( &modules.caches, map );
             break;
         case CACHE_RESET:
             CacheDelete( p_this, path );
@@ -396,6 +407,7 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     bank.i_cache = 0;
     bank.loaded_cache = cache;
     bank.i_loaded_cache = count;
+    bank.b_cache_dirty = map == NULL;
 
     /* Don't go deeper than 5 subdirectories */
     AllocatePluginDir (&bank, 5, path, NULL);
@@ -407,10 +419,21 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
             for( size_t i = 0; i < count; i++ )
             {
                 if (cache[i].p_module != NULL)
+                {
                    vlc_module_destroy (cache[i].p_module);
+                   bank.b_cache_dirty = true;
+                }
                 free (cache[i].path);
             }
             free( cache );
+            /* Do not rewrite an up-to-date cache on every start-up */
+            if( !bank.b_cache_dirty )
+            {
+                for( size_t i = 0; i < bank.i_cache; i++ )
+                    free( bank.cache[i].path );
+                free( bank.cache );
+                break;
+            }
         case CACHE_RESET:
             CacheSave (p_this, path, bank.cache, bank.i_cache);
         case CACHE_IGNORE:
@@ -523,7 +546,10 @@ static int AllocatePluginFile (module_bank_t *bank, const char *abspath,
         }
     }
     if (module == NULL)
+    {
         module = module_InitDynamic (bank->obj, abspath, true);
+        bank->b_cache_dirty = true;
+    }
     if (module == NULL)
         return -1;
 
@@ -45,6 +45,7 @@
 #include "config/configuration.h"
 
 #include <vlc_fs.h>
+#include <vlc_block.h>
 
 #include "modules/modules.h"
 
@@ -55,7 +56,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 22
+#define CACHE_SUBVERSION_NUM 23
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -76,8 +77,26 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
     free( path );
 }
 
+/* The cache file is mapped (or read) in memory as a whole. Strings and
+ * integer lists of the module descriptors point straight into it; only
+ * pointer arrays are allocated. */
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+} cache_reader_t;
+
+static int CacheLoadBytes (void *buf, size_t len, cache_reader_t *r)
+{
+    if ((size_t)(r->end - r->p) < len)
+        return -1;
+    memcpy (buf, r->p, len);
+    r->p += len;
+    return 0;
+}
+
 #define LOAD_IMMEDIATE(a) \
-    if (fread (&(a), sizeof (char), sizeof (a), file) != sizeof (a)) \
+    if (CacheLoadBytes (&(a), sizeof (a), file)) \
         goto error
 #define LOAD_FLAG(a) \
     do { \
@@ -88,7 +107,7 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
         (a) = b; \
     } while (0)
 
-static int CacheLoadString (char **p, FILE *file)
+static int CacheLoadString (char **p, cache_reader_t *file)
 {
     char *psz = NULL;
     uint16_t size;
@@ -102,15 +121,11 @@ error:
 
     if (size > 0)
     {
-        psz = malloc (size+1);
-        if (unlikely(psz == NULL))
-            goto error;
-        if (fread (psz, 1, size, file) != size)
-        {
-            free (psz);
+        /* stored with its nul terminator */
+        if ((size_t)(file->end - file->p) <= size || file->p[size] != '\0')
             goto error;
-        }
-        psz[size] = '\0';
+        psz = (char *)file->p;
+        file->p += size + 1;
     }
     *p = psz;
     return 0;
@@ -119,7 +134,22 @@ error:
 #define LOAD_STRING(a) \
     if (CacheLoadString (&(a), file)) goto error
 
-static int CacheLoadConfig (module_config_t *cfg, FILE *file)
+/* Arrays are aligned within the file, which is itself mapped aligned */
+static const void *CacheLoadArray (size_t size, size_t count,
+                                   cache_reader_t *file)
+{
+    size_t pad = -(uintptr_t)file->p & (size - 1);
+
+    if ((size_t)(file->end - file->p) < pad
+     || (size_t)(file->end - file->p - pad) / size < count)
+        return NULL;
+
+    const void *array = file->p + pad;
+    file->p += pad + size * count;
+    return array;
+}
+
+static int CacheLoadConfig (module_config_t *cfg, cache_reader_t *file)
 {
     LOAD_IMMEDIATE (cfg->i_type);
     LOAD_IMMEDIATE (cfg->i_short);
@@ -149,9 +179,8 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
         for (unsigned i = 0; i < cfg->list_count; i++)
         {
             LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
+            if (cfg->list.psz[i] == NULL) /* NULL -> empty string */
+                cfg->list.psz[i] = (char *)"";
         }
     }
     else
@@ -162,19 +191,24 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
         cfg->value = cfg->orig;
 
         if (cfg->list_count)
-            cfg->list.i = xmalloc (cfg->list_count * sizeof (int));
+        {
+            cfg->list.i = (int *)CacheLoadArray (sizeof (int),
+                                                 cfg->list_count, file);
+            if (cfg->list.i == NULL)
+                goto error;
+        }
         else /* TODO: fix config_GetPszChoices() instead of this hack: */
             LOAD_IMMEDIATE(cfg->list.i_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             LOAD_IMMEDIATE (cfg->list.i[i]);
     }
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
+
+    cfg->list_text = NULL;
+    if (cfg->list_count)
+        cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
     for (unsigned i = 0; i < cfg->list_count; i++)
     {
         LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
+        if (cfg->list_text[i] == NULL) /* NULL -> empty string */
+            cfg->list_text[i] = (char *)"";
     }
 
     return 0;
@@ -182,7 +216,7 @@ error:
     return -1; /* FIXME: leaks */
 }
 
-static int CacheLoadModuleConfig (module_t *module, FILE *file)
+static int CacheLoadModuleConfig (module_t *module, cache_reader_t *file)
 {
     uint16_t lines;
 
@@ -222,26 +256,31 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The returned modules point into the cache file data, which is returned in
+ * *mapp and must be kept until all those modules are destroyed.
  */
-size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
+size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r,
+                  block_t **mapp )
 {
     char *psz_filename;
-    FILE *file;
-    int i_size, i_read;
-    char p_cachestring[sizeof(CACHE_STRING)];
+    block_t *map;
+    cache_reader_t reader, *file = &reader;
+    size_t i_size;
     size_t i_cache;
     int32_t i_marker;
 
     assert( dir != NULL );
 
     *r = NULL;
+    *mapp = NULL;
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
         return 0;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    file = vlc_fopen( psz_filename, "rb" );
-    if( !file )
+    map = block_FilePath( psz_filename );
+    if( map == NULL )
     {
         msg_Warn( p_this, "cannot read %s: %s", psz_filename,
                   vlc_strerror_c(errno) );
@@ -250,57 +289,58 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
     }
     free( psz_filename );
 
+    reader.p = map->p_buffer;
+    reader.end = map->p_buffer + map->i_buffer;
+
     /* Check the file is a plugins cache */
     i_size = sizeof(CACHE_STRING) - 1;
-    i_read = fread( p_cachestring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_cachestring, CACHE_STRING, i_size ) )
+    if( (size_t)(reader.end - reader.p) < i_size ||
+        memcmp( reader.p, CACHE_STRING, i_size ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+        block_Release( map );
         return 0;
     }
+    reader.p += i_size;
 
 #ifdef DISTRO_VERSION
     /* Check for distribution specific version */
-    char p_distrostring[sizeof( DISTRO_VERSION )];
     i_size = sizeof( DISTRO_VERSION ) - 1;
-    i_read = fread( p_distrostring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_distrostring, DISTRO_VERSION, i_size ) )
+    if( (size_t)(reader.end - reader.p) < i_size ||
+        memcmp( reader.p, DISTRO_VERSION, i_size ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+        block_Release( map );
         return 0;
     }
+    reader.p += i_size;
 #endif
 
     /* Check Sub-version number */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) || i_marker != CACHE_SUBVERSION_NUM )
+    if( CacheLoadBytes( &i_marker, sizeof(i_marker), &reader )
+     || i_marker != CACHE_SUBVERSION_NUM )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
+        block_Release( map );
         return 0;
     }
 
     /* Check header marker */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) ||
-        i_marker != ftell( file ) - (int)sizeof(i_marker) )
+    if( CacheLoadBytes( &i_marker, sizeof(i_marker), &reader )
+     || i_marker != (reader.p - map->p_buffer) - (int)sizeof(i_marker) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
+        block_Release( map );
         return 0;
     }
 
-    if (fread( &i_cache, 1, sizeof(i_cache), file ) != sizeof(i_cache) )
+    if( CacheLoadBytes( &i_cache, sizeof(i_cache), &reader ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(file too short)" );
-        fclose( file );
+        block_Release( map );
         return 0;
     }
 
@@ -312,6 +352,7 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
         int i_submodules;
 
         module = vlc_module_create (NULL);
+        module->b_mapped = true;
 
         /* Load additional infos */
         LOAD_STRING(module->psz_shortname);
@@ -346,6 +387,7 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
         while( i_submodules-- )
         {
             module_t *submodule = vlc_module_create (module);
+            submodule->b_mapped = true;
             free (submodule->pp_shortcuts);
             LOAD_STRING(submodule->psz_shortname);
             LOAD_STRING(submodule->psz_longname);
@@ -376,19 +418,18 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
         LOAD_IMMEDIATE(st.st_size);
 
         CacheAdd (&cache, &count, path, &st, module);
-        free (path);
         /* TODO: deal with errors */
     }
-    fclose( file );
 
     *r = cache;
+    *mapp = map;
     return i_cache;
 
 error:
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
 
     /* TODO: cleanup */
-    fclose( file );
+    block_Release( map );
     return 0;
 }
 
@@ -406,7 +447,7 @@ static int CacheSaveString (FILE *file, const char *str)
     uint16_t size = (str != NULL) ? strlen (str) : 0;
 
     SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite (str, 1, size, file) != size)
+    if (size != 0 && fwrite (str, 1, size + 1, file) != size + 1u)
     {
 error:
         return -1;
@@ -418,6 +459,23 @@ error:
     if (CacheSaveString (file, (a))) \
         goto error
 
+/* See CacheLoadArray() */
+static int CacheSaveArray (FILE *file, const void *array, size_t size,
+                           size_t count)
+{
+    static const char zero[16];
+    long offset = ftell (file);
+
+    if (offset < 0)
+        return -1;
+
+    size_t pad = -(unsigned long)offset & (size - 1);
+    if (fwrite (zero, 1, pad, file) != pad
+     || fwrite (array, size, count, file) != count)
+        return -1;
+    return 0;
+}
+
 static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
 {
     SAVE_IMMEDIATE (cfg->i_type);
@@ -447,9 +505,12 @@ static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
         SAVE_IMMEDIATE (cfg->min);
         SAVE_IMMEDIATE (cfg->max);
         if (cfg->list_count == 0)
+        {
             SAVE_IMMEDIATE (cfg->list.i_cb); /* XXX: see CacheLoadConfig() */
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+        }
+        else if (CacheSaveArray (file, cfg->list.i, sizeof (int),
+                                 cfg->list_count))
+            goto error;
     }
     for (unsigned i = 0; i < cfg->list_count; i++)
         SAVE_STRING (cfg->list_text[i]);
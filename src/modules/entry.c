@@ -71,6 +71,7 @@ module_t *vlc_module_create (module_t *parent)
     module->i_score = (parent != NULL) ? parent->i_score : 1;
     module->b_loaded = false;
     module->b_unloadable = parent == NULL;
+    module->b_mapped = false;
     module->pf_activate = NULL;
     module->pf_deactivate = NULL;
     module->p_config = NULL;
@@ -97,17 +98,20 @@ void vlc_module_destroy (module_t *module)
         vlc_module_destroy (m);
     }
 
-    config_Free (module->p_config, module->confsize);
+    config_Free (module->p_config, module->confsize, module->b_mapped);
 
-    free (module->domain);
     free (module->psz_filename);
-    for (unsigned i = 0; i < module->i_shortcuts; i++)
-        free (module->pp_shortcuts[i]);
+    if (!module->b_mapped)
+    {
+        free (module->domain);
+        for (unsigned i = 0; i < module->i_shortcuts; i++)
+            free (module->pp_shortcuts[i]);
+        free (module->psz_capability);
+        free (module->psz_help);
+        free (module->psz_longname);
+        free (module->psz_shortname);
+    }
     free (module->pp_shortcuts);
-    free (module->psz_capability);
-    free (module->psz_help);
-    free (module->psz_longname);
-    free (module->psz_shortname);
     free (module);
 }
 
@@ -48,7 +48,8 @@ struct playlist_fetcher_t
     vlc_object_t   *object;
     vlc_mutex_t     lock;
     vlc_cond_t      wait;
-    bool            b_live;
+    unsigned        i_live;       /* running worker threads */
+    unsigned        i_max_live;
     int             i_art_policy;
     int             i_waiting;
     input_item_t    **pp_waiting;
@@ -71,7 +72,9 @@ playlist_fetcher_t *playlist_fetcher_New( vlc_object_t *parent )
     p_fetcher->object = parent;
     vlc_mutex_init( &p_fetcher->lock );
     vlc_cond_init( &p_fetcher->wait );
-    p_fetcher->b_live = false;
+    p_fetcher->i_live = 0;
+    p_fetcher->i_max_live = __MAX( var_InheritInteger( parent,
+                                                "preparse-threads" ), 1 );
     p_fetcher->i_waiting = 0;
     p_fetcher->pp_waiting = NULL;
     p_fetcher->i_art_policy = var_GetInteger( parent, "album-art" );
@@ -88,14 +91,14 @@ void playlist_fetcher_Push( playlist_fetcher_t *p_fetcher,
     vlc_mutex_lock( &p_fetcher->lock );
     INSERT_ELEM( p_fetcher->pp_waiting, p_fetcher->i_waiting,
                  p_fetcher->i_waiting, p_item );
-    if( !p_fetcher->b_live )
+    if( p_fetcher->i_live < p_fetcher->i_max_live )
     {
         if( vlc_clone_detach( NULL, Thread, p_fetcher,
                               VLC_THREAD_PRIORITY_LOW ) )
             msg_Err( p_fetcher->object,
                      "cannot spawn secondary preparse thread" );
         else
-            p_fetcher->b_live = true;
+            p_fetcher->i_live++;
     }
     vlc_mutex_unlock( &p_fetcher->lock );
 }
@@ -110,7 +113,7 @@ void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
         REMOVE_ELEM( p_fetcher->pp_waiting, p_fetcher->i_waiting, 0 );
     }
 
-    while( p_fetcher->b_live )
+    while( p_fetcher->i_live > 0 )
         vlc_cond_wait( &p_fetcher->wait, &p_fetcher->lock );
     vlc_mutex_unlock( &p_fetcher->lock );
 
@@ -148,10 +151,13 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     /* If we already checked this album in this session, skip */
     if( psz_artist && psz_album )
     {
+        /* Several fetcher threads may share the album list */
+        vlc_mutex_lock( &p_fetcher->lock );
         FOREACH_ARRAY( playlist_album_t album, p_fetcher->albums )
             if( !strcmp( album.psz_artist, psz_artist ) &&
                 !strcmp( album.psz_album, psz_album ) )
             {
+                vlc_mutex_unlock( &p_fetcher->lock );
                 msg_Dbg( p_fetcher->object,
                          " %s - %s has already been searched",
                          psz_artist, psz_album );
@@ -172,6 +178,7 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
                 }
             }
         FOREACH_END();
+        vlc_mutex_unlock( &p_fetcher->lock );
     }
     free( psz_artist );
     free( psz_album );
@@ -248,7 +255,9 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
         a.psz_album = psz_album;
         a.psz_arturl = input_item_GetArtURL( p_item );
         a.b_found = (i_ret == VLC_EGENERIC ? false : true );
+        vlc_mutex_lock( &p_fetcher->lock );
         ARRAY_APPEND( p_fetcher->albums, a );
+        vlc_mutex_unlock( &p_fetcher->lock );
     }
     else
     {
@@ -365,7 +374,7 @@ static void *Thread( void *p_data )
         }
         else
         {
-            p_fetcher->b_live = false;
+            p_fetcher->i_live--;
             vlc_cond_signal( &p_fetcher->wait );
         }
         vlc_mutex_unlock( &p_fetcher->lock );
@@ -30,6 +30,7 @@
 #include <vlc_playlist.h>
 #include <vlc_rand.h>
 #include "playlist_internal.h"
+#include "../libvlc.h"
 
 static void AddItem( playlist_t *p_playlist, playlist_item_t *p_item,
                      playlist_item_t *p_node, int i_mode, int i_pos );
@@ -772,7 +773,7 @@ static void GoAndPreparse( playlist_t *p_playlist, int i_mode,
         input_item_IsPreparsed( p_item->p_input ) == false &&
             ( EMPTY_STR( psz_artist ) || ( EMPTY_STR( psz_album ) ) )
           )
-        libvlc_MetaRequest( p_playlist->p_libvlc, p_item->p_input );
+        libvlc_MetaRequestBackground( p_playlist->p_libvlc, p_item->p_input );
     free( psz_artist );
     free( psz_album );
 }
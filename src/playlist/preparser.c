@@ -30,10 +30,25 @@
 #include "fetcher.h"
 #include "preparser.h"
 #include "input/input_interface.h"
+#include "input/item.h"
 
 /*****************************************************************************
  * Structures/definitions
  *****************************************************************************/
+typedef struct preparser_job_t preparser_job_t;
+
+struct preparser_job_t
+{
+    input_item_t    *p_item;  /**< item actually preparsed */
+    char            *psz_uri; /**< sharing key, NULL if the item has options */
+    input_item_t   **pp_dups; /**< other requests for the same URI */
+    int              i_dups;
+    bool             b_running;
+
+    preparser_job_t *p_prev;  /**< waiting queue */
+    preparser_job_t *p_next;
+};
+
 struct playlist_preparser_t
 {
     vlc_object_t        *object;
@@ -41,15 +56,66 @@ struct playlist_preparser_t
 
     vlc_mutex_t     lock;
     vlc_cond_t      wait;
-    bool            b_live;
-    input_item_t  **pp_waiting;
-    int             i_waiting;
+    unsigned        i_live;       /**< running worker threads */
+    unsigned        i_max_live;
+    preparser_job_t *p_first;     /**< waiting queue, urgent jobs first */
+    preparser_job_t *p_last;
+    preparser_job_t *p_last_urgent;
+    vlc_dictionary_t jobs;        /**< waiting and running jobs by URI */
 
     int             i_art_policy;
 };
 
 static void *Thread( void * );
 
+static void JobDequeue( playlist_preparser_t *p_preparser,
+                        preparser_job_t *p_job )
+{
+    if( p_preparser->p_last_urgent == p_job )
+        p_preparser->p_last_urgent = p_job->p_prev;
+
+    if( p_job->p_prev != NULL )
+        p_job->p_prev->p_next = p_job->p_next;
+    else
+        p_preparser->p_first = p_job->p_next;
+    if( p_job->p_next != NULL )
+        p_job->p_next->p_prev = p_job->p_prev;
+    else
+        p_preparser->p_last = p_job->p_prev;
+    p_job->p_prev = p_job->p_next = NULL;
+}
+
+static void JobEnqueue( playlist_preparser_t *p_preparser,
+                        preparser_job_t *p_job, bool b_urgent )
+{
+    preparser_job_t *p_after = b_urgent ? p_preparser->p_last_urgent
+                                        : p_preparser->p_last;
+
+    p_job->p_prev = p_after;
+    p_job->p_next = p_after ? p_after->p_next : p_preparser->p_first;
+    if( p_job->p_next != NULL )
+        p_job->p_next->p_prev = p_job;
+    else
+        p_preparser->p_last = p_job;
+    if( p_after != NULL )
+        p_after->p_next = p_job;
+    else
+        p_preparser->p_first = p_job;
+
+    if( b_urgent )
+        p_preparser->p_last_urgent = p_job;
+}
+
+static void JobDelete( preparser_job_t *p_job )
+{
+    for( int i = 0; i < p_job->i_dups; i++ )
+        vlc_gc_decref( p_job->pp_dups[i] );
+    free( p_job->pp_dups );
+    vlc_gc_decref( p_job->p_item );
+    free( p_job->psz_uri );
+    free( p_job );
+}
+
 /*****************************************************************************
  * Public functions
  *****************************************************************************/
@@ -66,32 +132,133 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t *parent )
 
     vlc_mutex_init( &p_preparser->lock );
     vlc_cond_init( &p_preparser->wait );
-    p_preparser->b_live = false;
+    p_preparser->i_live = 0;
+    p_preparser->i_max_live = __MAX( var_InheritInteger( parent,
+                                                 "preparse-threads" ), 1 );
     p_preparser->i_art_policy = var_InheritInteger( parent, "album-art" );
-    p_preparser->i_waiting = 0;
-    p_preparser->pp_waiting = NULL;
+    p_preparser->p_first = p_preparser->p_last = NULL;
+    p_preparser->p_last_urgent = NULL;
+    vlc_dictionary_init( &p_preparser->jobs, 0 );
 
     return p_preparser;
 }
 
-void playlist_preparser_Push( playlist_preparser_t *p_preparser, input_item_t *p_item )
+void playlist_preparser_Push( playlist_preparser_t *p_preparser,
+                              input_item_t *p_item, bool b_urgent )
 {
+    preparser_job_t *p_job = NULL;
+    char *psz_uri = NULL;
+
     vlc_gc_incref( p_item );
 
+    /* Items with options may not parse alike, do not share them */
+    vlc_mutex_lock( &p_item->lock );
+    if( p_item->i_options == 0 && p_item->psz_uri != NULL )
+        psz_uri = strdup( p_item->psz_uri );
+    vlc_mutex_unlock( &p_item->lock );
+
     vlc_mutex_lock( &p_preparser->lock );
-    INSERT_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting,
-                 p_preparser->i_waiting, p_item );
-    if( !p_preparser->b_live )
+    if( psz_uri != NULL )
+    {
+        p_job = vlc_dictionary_value_for_key( &p_preparser->jobs, psz_uri );
+        if( p_job == kVLCDictionaryNotFound )
+            p_job = NULL;
+    }
+
+    if( p_job != NULL )
+    {
+        /* Already requested: piggyback on it */
+        free( psz_uri );
+        if( p_job->p_item == p_item )
+            vlc_gc_decref( p_item );
+        else
+            INSERT_ELEM( p_job->pp_dups, p_job->i_dups, p_job->i_dups,
+                         p_item );
+
+        if( b_urgent && !p_job->b_running )
+        {
+            JobDequeue( p_preparser, p_job );
+            JobEnqueue( p_preparser, p_job, true );
+        }
+    }
+    else
+    {
+        p_job = malloc( sizeof(*p_job) );
+        if( unlikely(p_job == NULL) )
+        {
+            vlc_mutex_unlock( &p_preparser->lock );
+            free( psz_uri );
+            vlc_gc_decref( p_item );
+            return;
+        }
+        p_job->p_item = p_item;
+        p_job->psz_uri = psz_uri;
+        p_job->pp_dups = NULL;
+        p_job->i_dups = 0;
+        p_job->b_running = false;
+        JobEnqueue( p_preparser, p_job, b_urgent );
+        if( psz_uri != NULL )
+            vlc_dictionary_insert( &p_preparser->jobs, psz_uri, p_job );
+    }
+
+    if( p_preparser->i_live < p_preparser->i_max_live )
     {
         if( vlc_clone_detach( NULL, Thread, p_preparser,
                               VLC_THREAD_PRIORITY_LOW ) )
             msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
         else
-            p_preparser->b_live = true;
+            p_preparser->i_live++;
     }
     vlc_mutex_unlock( &p_preparser->lock );
 }
 
+void playlist_preparser_Cancel( playlist_preparser_t *p_preparser,
+                                input_item_t *p_item )
+{
+    preparser_job_t *p_job;
+    input_item_t *p_drop = NULL;
+
+    vlc_mutex_lock( &p_preparser->lock );
+    for( p_job = p_preparser->p_first; p_job != NULL; p_job = p_job->p_next )
+    {
+        if( p_job->p_item == p_item )
+            break;
+        for( int i = 0; i < p_job->i_dups; i++ )
+            if( p_job->pp_dups[i] == p_item )
+            {
+                p_drop = p_item;
+                REMOVE_ELEM( p_job->pp_dups, p_job->i_dups, i );
+                break;
+            }
+        if( p_drop != NULL )
+            break;
+    }
+
+    if( p_job != NULL && p_drop == NULL )
+    {
+        /* Another request for the same URI takes over, if any */
+        if( p_job->i_dups > 0 )
+        {
+            p_drop = p_job->p_item;
+            p_job->p_item = p_job->pp_dups[0];
+            REMOVE_ELEM( p_job->pp_dups, p_job->i_dups, 0 );
+        }
+        else
+        {
+            JobDequeue( p_preparser, p_job );
+            if( p_job->psz_uri != NULL )
+                vlc_dictionary_remove_value_for_key( &p_preparser->jobs,
+                                                     p_job->psz_uri,
+                                                     NULL, NULL );
+            JobDelete( p_job );
+        }
+    }
+    vlc_mutex_unlock( &p_preparser->lock );
+
+    if( p_drop != NULL )
+        vlc_gc_decref( p_drop );
+}
+
 void playlist_preparser_fetcher_Push( playlist_preparser_t *p_preparser,
                                       input_item_t *p_item )
 {
@@ -103,17 +270,23 @@ void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
 {
     vlc_mutex_lock( &p_preparser->lock );
     /* Remove pending item to speed up preparser thread exit */
-    while( p_preparser->i_waiting > 0 )
+    while( p_preparser->p_first != NULL )
     {
-        vlc_gc_decref( p_preparser->pp_waiting[0] );
-        REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
+        preparser_job_t *p_job = p_preparser->p_first;
+
+        JobDequeue( p_preparser, p_job );
+        if( p_job->psz_uri != NULL )
+            vlc_dictionary_remove_value_for_key( &p_preparser->jobs,
+                                                 p_job->psz_uri, NULL, NULL );
+        JobDelete( p_job );
     }
 
-    while( p_preparser->b_live )
+    while( p_preparser->i_live > 0 )
         vlc_cond_wait( &p_preparser->wait, &p_preparser->lock );
     vlc_mutex_unlock( &p_preparser->lock );
 
     /* Destroy the item preparser */
+    vlc_dictionary_clear( &p_preparser->jobs, NULL, NULL );
     vlc_cond_destroy( &p_preparser->wait );
     vlc_mutex_destroy( &p_preparser->lock );
 
@@ -203,31 +376,51 @@ static void *Thread( void *data )
 
     for( ;; )
     {
-        input_item_t *p_current;
+        preparser_job_t *p_job;
 
         /* */
         vlc_mutex_lock( &p_preparser->lock );
-        if( p_preparser->i_waiting > 0 )
+        p_job = p_preparser->p_first;
+        if( p_job != NULL )
         {
-            p_current = p_preparser->pp_waiting[0];
-            REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
+            JobDequeue( p_preparser, p_job );
+            p_job->b_running = true;
         }
         else
         {
-            p_current = NULL;
-            p_preparser->b_live = false;
+            p_preparser->i_live--;
             vlc_cond_signal( &p_preparser->wait );
         }
         vlc_mutex_unlock( &p_preparser->lock );
 
-        if( !p_current )
+        if( !p_job )
             break;
 
+        input_item_t *p_current = p_job->p_item;
+
         Preparse( obj, p_current );
 
         Art( p_preparser, p_current );
-        vlc_gc_decref(p_current);
+
+        /* Requests for the same URI that came meanwhile are done too */
+        vlc_mutex_lock( &p_preparser->lock );
+        if( p_job->psz_uri != NULL )
+            vlc_dictionary_remove_value_for_key( &p_preparser->jobs,
+                                                 p_job->psz_uri, NULL, NULL );
+        vlc_mutex_unlock( &p_preparser->lock );
+
+        for( int i = 0; i < p_job->i_dups; i++ )
+        {
+            input_item_t *p_dup = p_job->pp_dups[i];
+
+            if( p_dup == p_current || input_item_IsPreparsed( p_dup ) )
+                continue;
+            input_item_CopyPreparsed( p_dup, p_current );
+            input_item_SetPreparsed( p_dup, true );
+            var_SetAddress( obj, "item-change", p_dup );
+            Art( p_preparser, p_dup );
+        }
+        JobDelete( p_job );
     }
     return NULL;
 }
-
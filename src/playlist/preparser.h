@@ -35,7 +35,8 @@
 typedef struct playlist_preparser_t playlist_preparser_t;
 
 /**
- * This function creates the preparser object and thread.
+ * This function creates the preparser object. Its worker threads are
+ * spawned on demand, up to the "preparse-threads" count.
  */
 playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
 
@@ -44,13 +45,24 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
  *
  * The input item is retained until the preparsing is done or until the
  * preparser object is deleted.
+ * Urgent items (explicitly requested, typically shown to the user) are
+ * preparsed before the others. Items sharing an URI (and without options)
+ * are preparsed only once.
  */
-void playlist_preparser_Push( playlist_preparser_t *, input_item_t * );
+void playlist_preparser_Push( playlist_preparser_t *, input_item_t *,
+                              bool b_urgent );
+
+/**
+ * This function removes one pending request for the provided item.
+ *
+ * A preparsing already in progress is not interrupted.
+ */
+void playlist_preparser_Cancel( playlist_preparser_t *, input_item_t * );
 
 void playlist_preparser_fetcher_Push( playlist_preparser_t *, input_item_t * );
 
 /**
- * This function destroys the preparser object and thread.
+ * This function destroys the preparser object and threads.
  *
  * All pending input items will be released.
  */
@@ -24,6 +24,7 @@
 #include "test.h"
 
 #include <string.h>
+#include <inttypes.h>
 
 static void test_core (const char ** argv, int argc)
 {
@@ -97,10 +98,59 @@ static void test_audio_output (void)
     libvlc_release (vlc);
 }
 
+#ifdef TEST_STARTUP
+/* Start-up time benchmark, built as test_libvlc_core_startup */
+#define STARTUP_RUNS 30
+
+static int cmp_time (const void *a, const void *b)
+{
+    int64_t ta = *(const int64_t *)a, tb = *(const int64_t *)b;
+    return (ta > tb) - (ta < tb);
+}
+
+static void bench_startup (bool cache)
+{
+    const char *argv[] = {
+        "-q",
+        "--ignore-config",
+        "-I",
+        "dummy",
+        "--no-media-library",
+        "--vout=dummy",
+        "--aout=dummy",
+        cache ? "--plugins-cache" : "--no-plugins-cache",
+    };
+    int64_t times[STARTUP_RUNS];
+
+    /* The first run may (re)write the plugins cache: not timed */
+    libvlc_release (libvlc_new (sizeof (argv) / sizeof (argv[0]), argv));
+
+    for (int i = 0; i < STARTUP_RUNS; i++)
+    {
+        int64_t start = libvlc_clock ();
+        libvlc_instance_t *vlc = libvlc_new (sizeof (argv) / sizeof (argv[0]),
+                                             argv);
+        times[i] = libvlc_clock () - start;
+        assert (vlc != NULL);
+        libvlc_release (vlc);
+    }
+
+    qsort (times, STARTUP_RUNS, sizeof (times[0]), cmp_time);
+    log ("libvlc_new() %s plugins cache: min %"PRId64" us, "
+         "median %"PRId64" us, max %"PRId64" us\n",
+         cache ? "with" : "without", times[0], times[STARTUP_RUNS / 2],
+         times[STARTUP_RUNS - 1]);
+}
+#endif
+
 int main (void)
 {
     test_init();
 
+#ifdef TEST_STARTUP
+    bench_startup (true);
+    bench_startup (false);
+#endif
     test_core (test_defaults_args, test_defaults_nargs);
     test_audiovideofilterlists (test_defaults_args, test_defaults_nargs);
     test_audio_output ();
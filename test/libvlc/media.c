@@ -23,6 +23,10 @@
 
 #include "test.h"
 
+#include <limits.h>
+#include <string.h>
+#include <inttypes.h>
+
 static void preparsed_changed(const libvlc_event_t *event, void *user_data)
 {
     (void)event;
@@ -73,11 +77,187 @@ static void test_media_preparsed(const char** argv, int argc)
     libvlc_release (vlc);
 }
 
+#define PARSE_COUNT 16
+
+static int media_tracks_count(libvlc_media_t *media)
+{
+    libvlc_media_track_t **tracks;
+    unsigned count = libvlc_media_tracks_get(media, &tracks);
+
+    libvlc_media_tracks_release(tracks, count);
+    return count;
+}
+
+static void test_media_parse_concurrent(const char** argv, int argc)
+{
+    const char * file = SRCDIR"/samples/image.jpg";
+    libvlc_media_t *media[PARSE_COUNT];
+
+    log ("Testing concurrent parsing of the same media\n");
+
+    libvlc_instance_t *vlc = libvlc_new (argc, argv);
+    assert (vlc != NULL);
+
+    // All but the first requests can be served by the first one.
+    for (int i = 0; i < PARSE_COUNT; i++)
+    {
+        media[i] = libvlc_media_new_path (vlc, file);
+        assert (media[i] != NULL);
+        libvlc_media_parse_async (media[i]);
+    }
+
+    // Each media must get the result, with the same tracks.
+    for (int i = 0; i < PARSE_COUNT; i++)
+        while (!libvlc_media_is_parsed (media[i]))
+            usleep (10000);
+
+    int tracks = media_tracks_count (media[0]);
+    assert (tracks > 0);
+    for (int i = 1; i < PARSE_COUNT; i++)
+        assert (media_tracks_count (media[i]) == tracks);
+
+    for (int i = 0; i < PARSE_COUNT; i++)
+        libvlc_media_release (media[i]);
+    libvlc_release (vlc);
+}
+
+static void test_media_parse_release(const char** argv, int argc)
+{
+    static const char *const files[] = {
+        SRCDIR"/samples/image.jpg",
+        SRCDIR"/samples/empty.voc",
+    };
+
+    log ("Testing release of media being parsed\n");
+
+    libvlc_instance_t *vlc = libvlc_new (argc, argv);
+    assert (vlc != NULL);
+
+    // More requests than workers, so that some are still queued when
+    // released, and some are being parsed or coalesced.
+    for (int i = 0; i < PARSE_COUNT; i++)
+    {
+        libvlc_media_t *media = libvlc_media_new_path (vlc, files[i % 2]);
+        assert (media != NULL);
+        libvlc_media_parse_async (media);
+        libvlc_media_release (media);
+    }
+
+    // A media parsed afterwards must still be served.
+    libvlc_media_t *media = libvlc_media_new_path (vlc, files[0]);
+    assert (media != NULL);
+    libvlc_media_parse (media);
+    assert (libvlc_media_is_parsed (media));
+    assert (media_tracks_count (media) > 0);
+    libvlc_media_release (media);
+
+    libvlc_release (vlc);
+}
+
+#ifdef TEST_PREPARSE
+/* Preparser benchmark, built as test_libvlc_media_preparse */
+#define PREPARSE_FILES 64
+#define PREPARSE_RUNS 5
+
+static int cmp_time (const void *a, const void *b)
+{
+    int64_t ta = *(const int64_t *)a, tb = *(const int64_t *)b;
+    return (ta > tb) - (ta < tb);
+}
+
+static void bench_preparse (const char *dir, const char *threads)
+{
+    const char *argv[] = {
+        "-q",
+        "--ignore-config",
+        "-I",
+        "dummy",
+        "--no-media-library",
+        "--vout=dummy",
+        "--aout=dummy",
+        threads,
+    };
+    int64_t times[PREPARSE_RUNS];
+
+    for (int run = 0; run < PREPARSE_RUNS; run++)
+    {
+        libvlc_instance_t *vlc = libvlc_new (sizeof (argv) / sizeof (argv[0]),
+                                             argv);
+        assert (vlc != NULL);
+
+        libvlc_media_t *media[PREPARSE_FILES];
+        int64_t start = libvlc_clock ();
+
+        // Distinct paths, so that no request is coalesced with another.
+        for (int i = 0; i < PREPARSE_FILES; i++)
+        {
+            char path[PATH_MAX];
+            snprintf (path, sizeof (path), "%s/%d.%s", dir, i,
+                      (i & 1) ? "voc" : "jpg");
+            media[i] = libvlc_media_new_path (vlc, path);
+            assert (media[i] != NULL);
+            libvlc_media_parse_async (media[i]);
+        }
+        for (int i = 0; i < PREPARSE_FILES; i++)
+            while (!libvlc_media_is_parsed (media[i]))
+                usleep (1000);
+
+        times[run] = libvlc_clock () - start;
+
+        for (int i = 0; i < PREPARSE_FILES; i++)
+            libvlc_media_release (media[i]);
+        libvlc_release (vlc);
+    }
+
+    qsort (times, PREPARSE_RUNS, sizeof (times[0]), cmp_time);
+    log ("%d files with %s: min %"PRId64" us, median %"PRId64" us, "
+         "max %"PRId64" us\n", PREPARSE_FILES, threads, times[0],
+         times[PREPARSE_RUNS / 2], times[PREPARSE_RUNS - 1]);
+}
+
+static void bench_preparse_threads (void)
+{
+    static const char *const samples[] = {
+        SRCDIR"/samples/image.jpg",
+        SRCDIR"/samples/empty.voc",
+    };
+    char dir[] = "/tmp/vlc-test-preparse-XXXXXX";
+    char target[2][PATH_MAX], path[PATH_MAX];
+
+    assert (mkdtemp (dir) != NULL);
+    for (int i = 0; i < 2; i++)
+        assert (realpath (samples[i], target[i]) != NULL);
+    for (int i = 0; i < PREPARSE_FILES; i++)
+    {
+        snprintf (path, sizeof (path), "%s/%d.%s", dir, i,
+                  (i & 1) ? "voc" : "jpg");
+        assert (symlink (target[i & 1], path) == 0);
+    }
+
+    alarm (0); /* the runs may take longer than a test */
+    bench_preparse (dir, "--preparse-threads=1");
+    bench_preparse (dir, "--preparse-threads=4");
+
+    for (int i = 0; i < PREPARSE_FILES; i++)
+    {
+        snprintf (path, sizeof (path), "%s/%d.%s", dir, i,
+                  (i & 1) ? "voc" : "jpg");
+        unlink (path);
+    }
+    rmdir (dir);
+}
+#endif
+
 int main (void)
 {
     test_init();
 
+#ifdef TEST_PREPARSE
+    bench_preparse_threads ();
+#endif
     test_media_preparsed (test_defaults_args, test_defaults_nargs);
+    test_media_parse_concurrent (test_defaults_args, test_defaults_nargs);
+    test_media_parse_release (test_defaults_args, test_defaults_nargs);
 
     return 0;
 }
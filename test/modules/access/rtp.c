@@ -0,0 +1,173 @@
+/*****************************************************************************
+ * rtp.c: RTP input packet statistics test
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Plays an RTP stream from a loopback socket, with one packet lost, one late,
+ * one reordered and one duplicated, and checks that the input statistics
+ * count each of them once. Exits with 77 (skipped) if the RTP input is not
+ * built. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+#include "../lib/media_internal.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <vlc_common.h>
+#include <vlc_input_item.h>
+
+#define SSRC (0x12345678)
+
+/* Finds a free even port, as the next one is for RTCP */
+static int FreePort( void )
+{
+    for( ;; )
+    {
+        struct sockaddr_in addr;
+        socklen_t i_addr = sizeof(addr);
+        int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+        assert( fd >= 0 );
+
+        memset( &addr, 0, sizeof(addr) );
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        assert( bind( fd, (struct sockaddr *)&addr, sizeof(addr) ) == 0 );
+        assert( getsockname( fd, (struct sockaddr *)&addr, &i_addr ) == 0 );
+        close( fd );
+
+        int i_port = ntohs( addr.sin_port );
+        if( i_port % 2 == 0 && i_port < 65534 )
+            return i_port;
+    }
+}
+
+/* One G.711 (PCMU) packet of 20 ms */
+static void SendPacket( int fd, const struct sockaddr_in *p_addr,
+                        uint16_t i_seq )
+{
+    uint8_t p_pkt[12 + 160];
+
+    p_pkt[0] = 0x80;
+    p_pkt[1] = 0; /* PCMU */
+    SetWBE( &p_pkt[2], i_seq );
+    SetDWBE( &p_pkt[4], i_seq * 160 );
+    SetDWBE( &p_pkt[8], SSRC );
+    memset( &p_pkt[12], 0xff, 160 );
+
+    assert( sendto( fd, p_pkt, sizeof(p_pkt), 0,
+                    (const struct sockaddr *)p_addr,
+                    sizeof(*p_addr) ) == sizeof(p_pkt) );
+}
+
+static void SendStream( int i_port )
+{
+    /* 10 is lost, 32 comes twice then 31, 5 comes again after 49 */
+    static const uint16_t seqs[] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+        21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 32, 32, 31, 33, 34, 35, 36, 37,
+        38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 5, 50, 51, 52, 53,
+    };
+    struct sockaddr_in addr;
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    assert( fd >= 0 );
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    addr.sin_port = htons( i_port );
+
+    for( size_t i = 0; i < sizeof(seqs) / sizeof(seqs[0]); i++ )
+        SendPacket( fd, &addr, seqs[i] );
+    close( fd );
+}
+
+static int test_packet_stats( libvlc_instance_t *p_vlc )
+{
+    const int i_port = FreePort();
+    char psz_mrl[32];
+    snprintf( psz_mrl, sizeof(psz_mrl), "rtp://@127.0.0.1:%d", i_port );
+
+    libvlc_media_t *p_media = libvlc_media_new_location( p_vlc, psz_mrl );
+    assert( p_media != NULL );
+    libvlc_media_player_t *p_mp = libvlc_media_player_new_from_media( p_media );
+    assert( p_mp != NULL );
+    libvlc_media_player_play( p_mp );
+
+    /* Wait for the socket to be bound */
+    libvlc_state_t state;
+    while( ( state = libvlc_media_player_get_state( p_mp ) ) != libvlc_Playing
+        && state != libvlc_Error && state != libvlc_Ended )
+        usleep( 10000 );
+    if( state != libvlc_Playing )
+    {
+        libvlc_media_player_release( p_mp );
+        libvlc_media_release( p_media );
+        return 77;
+    }
+
+    SendStream( i_port );
+
+    /* The input reads the counts once per second */
+    input_stats_t *p_stats = p_media->p_input_item->p_stats;
+    int64_t i_lost, i_late, i_reordered, i_duplicate;
+    for( int i = 0; i < 50; i++ )
+    {
+        usleep( 100000 );
+        vlc_mutex_lock( &p_stats->lock );
+        i_lost = p_stats->i_packets_lost;
+        i_late = p_stats->i_packets_late;
+        i_reordered = p_stats->i_packets_reordered;
+        i_duplicate = p_stats->i_packets_duplicate;
+        vlc_mutex_unlock( &p_stats->lock );
+        if( i_lost && i_late && i_reordered && i_duplicate )
+            break;
+    }
+    log( "%"PRId64" lost, %"PRId64" late, %"PRId64" reordered, "
+         "%"PRId64" duplicate\n", i_lost, i_late, i_reordered, i_duplicate );
+
+    libvlc_media_player_stop( p_mp );
+    libvlc_media_player_release( p_mp );
+    libvlc_media_release( p_media );
+
+    return ( i_lost == 1 && i_late == 1 && i_reordered == 1
+          && i_duplicate == 1 ) ? 0 : 1;
+}
+
+int main( void )
+{
+    test_init();
+
+    const char *argv[test_defaults_nargs + 1];
+    for( int i = 0; i < test_defaults_nargs; i++ )
+        argv[i] = test_defaults_args[i];
+    argv[test_defaults_nargs] = "--stats";
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs + 1, argv );
+    assert( p_vlc != NULL );
+
+    int i_ret = test_packet_stats( p_vlc );
+    if( i_ret == 77 )
+        log( "RTP input not found, skipping\n" );
+
+    libvlc_release( p_vlc );
+    return i_ret;
+}
@@ -0,0 +1,170 @@
+/*****************************************************************************
+ * demux.h: helpers to run a demux module on a local file
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef TEST_DEMUX_H
+#define TEST_DEMUX_H
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+#include <vlc_modules.h>
+#include <vlc_url.h>
+
+/* Elementary stream output that only keeps the date of the first block
+ * received since the last reset */
+struct es_out_sys_t
+{
+    unsigned i_es;
+    unsigned i_blocks;
+    mtime_t  i_first_date;
+};
+
+static es_out_id_t *TestEsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    (void) p_fmt;
+    /* Only compared, never dereferenced */
+    return (es_out_id_t *)(uintptr_t)++out->p_sys->i_es;
+}
+
+static int TestEsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    (void) id;
+    if( out->p_sys->i_first_date <= VLC_TS_INVALID )
+        out->p_sys->i_first_date = p_block->i_pts > VLC_TS_INVALID
+                                 ? p_block->i_pts : p_block->i_dts;
+    out->p_sys->i_blocks++;
+    block_Release( p_block );
+    return VLC_SUCCESS;
+}
+
+static void TestEsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    (void) out; (void) id;
+}
+
+static int TestEsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    (void) out;
+    switch( i_query )
+    {
+        case ES_OUT_GET_ES_STATE:
+            (void) va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+        case ES_OUT_GET_EMPTY:
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static inline void TestEsOutInit( es_out_t *out, es_out_sys_t *p_sys )
+{
+    memset( p_sys, 0, sizeof(*p_sys) );
+    p_sys->i_first_date = VLC_TS_INVALID;
+    out->pf_add     = TestEsOutAdd;
+    out->pf_send    = TestEsOutSend;
+    out->pf_del     = TestEsOutDel;
+    out->pf_control = TestEsOutControl;
+    out->pf_destroy = NULL;
+    out->p_sys      = p_sys;
+}
+
+/* Opens the given demux module on a local file, as the input would */
+static inline demux_t *TestDemuxNew( vlc_object_t *p_parent,
+                                     const char *psz_module,
+                                     const char *psz_path, es_out_t *out )
+{
+    demux_t *p_demux = vlc_object_create( p_parent, sizeof(*p_demux) );
+    assert( p_demux != NULL );
+
+    p_demux->psz_access   = strdup( "file" );
+    p_demux->psz_demux    = strdup( psz_module );
+    p_demux->psz_location = strdup( psz_path );
+    p_demux->psz_file     = strdup( psz_path );
+    p_demux->out          = out;
+    p_demux->p_input      = NULL;
+
+    char *psz_url = vlc_path2uri( psz_path, "file" );
+    assert( psz_url != NULL );
+    p_demux->s = stream_UrlNew( p_parent, psz_url );
+    free( psz_url );
+
+    if( p_demux->s )
+        p_demux->p_module = module_need( p_demux, "demux", psz_module, true );
+    if( !p_demux->s || !p_demux->p_module )
+    {
+        if( p_demux->s )
+            stream_Delete( p_demux->s );
+        free( p_demux->psz_access );
+        free( p_demux->psz_demux );
+        free( p_demux->psz_location );
+        free( p_demux->psz_file );
+        vlc_object_release( p_demux );
+        return NULL;
+    }
+    return p_demux;
+}
+
+static inline void TestDemuxDelete( demux_t *p_demux )
+{
+    module_unneed( p_demux, p_demux->p_module );
+    stream_Delete( p_demux->s );
+    free( p_demux->psz_access );
+    free( p_demux->psz_demux );
+    free( p_demux->psz_location );
+    free( p_demux->psz_file );
+    vlc_object_release( p_demux );
+}
+
+static inline int TestDemuxControl( demux_t *p_demux, int i_query, ... )
+{
+    va_list args;
+    va_start( args, i_query );
+    int i_ret = p_demux->pf_control( p_demux, i_query, args );
+    va_end( args );
+    return i_ret;
+}
+
+/* Seeks and demuxes until the first block comes out. Returns its date,
+ * without VLC_TS_0, or -1 at the end of the stream, and the time the seek
+ * took in *pi_latency */
+static inline mtime_t TestDemuxSeek( demux_t *p_demux, mtime_t i_time,
+                                     mtime_t *pi_latency )
+{
+    es_out_sys_t *p_out = p_demux->out->p_sys;
+    mtime_t i_start = mdate();
+
+    p_out->i_first_date = VLC_TS_INVALID;
+    if( TestDemuxControl( p_demux, DEMUX_SET_TIME, i_time ) )
+        return -1;
+    while( p_out->i_first_date <= VLC_TS_INVALID )
+        if( p_demux->pf_demux( p_demux ) <= 0 )
+            return -1;
+
+    *pi_latency = mdate() - i_start;
+    return p_out->i_first_date - VLC_TS_0;
+}
+
+#endif
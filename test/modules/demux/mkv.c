@@ -0,0 +1,316 @@
+/*****************************************************************************
+ * mkv.c: test of the matroska demuxer seeking in files without cues
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Writes a file of PCM audio without cues nor seek head, seeks in it and
+ * checks the date of the first block demuxed after each seek. Checks that
+ * the first seek indexed all the clusters, and that the next opening reads
+ * the index back from the cache. Exits with 77 (skipped) if the mkv plugin
+ * is not built. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+#include "demux.h"
+
+#include <dirent.h>
+
+#define CLUSTERS          (600)             /* one per second */
+#define BLOCKS            (10)              /* per cluster */
+#define BLOCK_DURATION    (CLOCK_FREQ / BLOCKS)
+#define BLOCK_SAMPLES     (800)             /* 8 kHz, 8 bits, mono */
+
+/*****************************************************************************
+ * EBML writer
+ *****************************************************************************/
+typedef struct
+{
+    uint8_t *p_data;
+    size_t   i_size;
+} ebml_t;
+
+static void Append( ebml_t *p_ebml, const void *p_data, size_t i_size )
+{
+    p_ebml->p_data = realloc( p_ebml->p_data, p_ebml->i_size + i_size );
+    assert( p_ebml->p_data != NULL );
+    memcpy( &p_ebml->p_data[p_ebml->i_size], p_data, i_size );
+    p_ebml->i_size += i_size;
+}
+
+static void PutId( ebml_t *p_ebml, uint32_t i_id )
+{
+    uint8_t p_id[4];
+    int i_len = 0;
+    for( int i = 3; i >= 0; i-- )
+        if( i_len || (i_id >> (8 * i)) || i == 0 )
+            p_id[i_len++] = i_id >> (8 * i);
+    Append( p_ebml, p_id, i_len );
+}
+
+static void PutSize( ebml_t *p_ebml, uint64_t i_size )
+{
+    uint8_t p_size[8];
+    int i_len = 1;
+    while( i_len < 8 && i_size >= (UINT64_C(1) << (7 * i_len)) - 1 )
+        i_len++;
+    for( int i = 0; i < i_len; i++ )
+        p_size[i] = i_size >> (8 * (i_len - 1 - i));
+    p_size[0] |= 0x80 >> (i_len - 1);
+    Append( p_ebml, p_size, i_len );
+}
+
+static void PutUint( ebml_t *p_ebml, uint32_t i_id, uint64_t i_value )
+{
+    uint8_t p_value[8];
+    int i_len = 1;
+    while( i_len < 8 && (i_value >> (8 * i_len)) )
+        i_len++;
+    for( int i = 0; i < i_len; i++ )
+        p_value[i] = i_value >> (8 * (i_len - 1 - i));
+    PutId( p_ebml, i_id );
+    PutSize( p_ebml, i_len );
+    Append( p_ebml, p_value, i_len );
+}
+
+static void PutFloat( ebml_t *p_ebml, uint32_t i_id, double f_value )
+{
+    uint64_t i_value;
+    uint8_t p_value[8];
+    memcpy( &i_value, &f_value, sizeof(i_value) );
+    SetQWBE( p_value, i_value );
+    PutId( p_ebml, i_id );
+    PutSize( p_ebml, 8 );
+    Append( p_ebml, p_value, 8 );
+}
+
+static void PutString( ebml_t *p_ebml, uint32_t i_id, const char *psz )
+{
+    PutId( p_ebml, i_id );
+    PutSize( p_ebml, strlen( psz ) );
+    Append( p_ebml, psz, strlen( psz ) );
+}
+
+/* Appends a master element made of the given children, and frees them */
+static void PutMaster( ebml_t *p_ebml, uint32_t i_id, ebml_t *p_children )
+{
+    PutId( p_ebml, i_id );
+    PutSize( p_ebml, p_children->i_size );
+    Append( p_ebml, p_children->p_data, p_children->i_size );
+    free( p_children->p_data );
+    p_children->p_data = NULL;
+    p_children->i_size = 0;
+}
+
+static void WriteFile( const char *psz_path )
+{
+    ebml_t file = { NULL, 0 }, segment = { NULL, 0 }, master = { NULL, 0 };
+    ebml_t track = { NULL, 0 }, audio = { NULL, 0 };
+
+    PutUint( &master, 0x4286, 1 );              /* EBMLVersion */
+    PutUint( &master, 0x42F7, 1 );              /* EBMLReadVersion */
+    PutUint( &master, 0x42F2, 4 );              /* EBMLMaxIDLength */
+    PutUint( &master, 0x42F3, 8 );              /* EBMLMaxSizeLength */
+    PutString( &master, 0x4282, "matroska" );   /* DocType */
+    PutUint( &master, 0x4287, 2 );              /* DocTypeVersion */
+    PutUint( &master, 0x4285, 2 );              /* DocTypeReadVersion */
+    PutMaster( &file, 0x1A45DFA3, &master );
+
+    PutUint( &master, 0x2AD7B1, 1000000 );      /* TimecodeScale */
+    PutFloat( &master, 0x4489, CLUSTERS * 1000. ); /* Duration */
+    PutString( &master, 0x4D80, "vlc test" );   /* MuxingApp */
+    PutString( &master, 0x5741, "vlc test" );   /* WritingApp */
+    PutMaster( &segment, 0x1549A966, &master ); /* Info */
+
+    PutFloat( &audio, 0xB5, 8000. );            /* SamplingFrequency */
+    PutUint( &audio, 0x9F, 1 );                 /* Channels */
+    PutUint( &audio, 0x6264, 8 );               /* BitDepth */
+    PutUint( &track, 0xD7, 1 );                 /* TrackNumber */
+    PutUint( &track, 0x73C5, 1 );               /* TrackUID */
+    PutUint( &track, 0x83, 2 );                 /* TrackType: audio */
+    PutString( &track, 0x86, "A_PCM/INT/LIT" ); /* CodecID */
+    PutMaster( &track, 0xE1, &audio );          /* Audio */
+    PutMaster( &master, 0xAE, &track );         /* TrackEntry */
+    PutMaster( &segment, 0x1654AE6B, &master ); /* Tracks */
+
+    for( int i_cluster = 0; i_cluster < CLUSTERS; i_cluster++ )
+    {
+        PutUint( &master, 0xE7, i_cluster * 1000 ); /* Timecode */
+        for( int i_block = 0; i_block < BLOCKS; i_block++ )
+        {
+            uint8_t p_block[4 + BLOCK_SAMPLES];
+            const int i_timecode = i_block * 1000 / BLOCKS;
+
+            p_block[0] = 0x81;                  /* track 1 */
+            SetWBE( &p_block[1], i_timecode );
+            p_block[3] = 0x80;                  /* keyframe */
+            memset( &p_block[4], i_cluster + i_block, BLOCK_SAMPLES );
+            PutId( &master, 0xA3 );             /* SimpleBlock */
+            PutSize( &master, sizeof(p_block) );
+            Append( &master, p_block, sizeof(p_block) );
+        }
+        PutMaster( &segment, 0x1F43B675, &master ); /* Cluster */
+    }
+    PutMaster( &file, 0x18538067, &segment );   /* Segment */
+
+    FILE *p_file = fopen( psz_path, "wb" );
+    assert( p_file != NULL );
+    assert( fwrite( file.p_data, 1, file.i_size, p_file ) == file.i_size );
+    assert( fclose( p_file ) == 0 );
+    free( file.p_data );
+}
+
+/*****************************************************************************
+ * Test
+ *****************************************************************************/
+static int i_scanned = -1, i_cached = -1;
+
+static void LogCallback( void *p_data, int i_level, const libvlc_log_t *p_ctx,
+                         const char *psz_fmt, va_list args )
+{
+    char psz_msg[256];
+    char psz_incomplete[16] = "";
+    int i_count, i_ms;
+
+    (void) p_data; (void) i_level; (void) p_ctx;
+    vsnprintf( psz_msg, sizeof(psz_msg), psz_fmt, args );
+    if( sscanf( psz_msg, "cluster scan found %d clusters in %d ms%15s",
+                &i_count, &i_ms, psz_incomplete ) >= 2 )
+        i_scanned = psz_incomplete[0] ? -1 : i_count;
+    else if( sscanf( psz_msg, "loaded %d cached cluster index entries",
+                     &i_count ) == 1 )
+        i_cached = i_count;
+}
+
+static const mtime_t seeks[] =
+{
+    300 * CLOCK_FREQ,
+    12 * CLOCK_FREQ + 345000,
+    (CLUSTERS - 1) * CLOCK_FREQ + 900000,
+    450 * CLOCK_FREQ + BLOCK_DURATION,
+    0,
+    123 * CLOCK_FREQ + 999999,
+};
+
+static int test_seeks( vlc_object_t *p_parent, const char *psz_path,
+                       bool *pb_skip )
+{
+    es_out_sys_t out_sys;
+    es_out_t out;
+    TestEsOutInit( &out, &out_sys );
+
+    demux_t *p_demux = TestDemuxNew( p_parent, "mkv", psz_path, &out );
+    if( !p_demux )
+    {
+        *pb_skip = true;
+        return 0;
+    }
+
+    int64_t i_length;
+    assert( TestDemuxControl( p_demux, DEMUX_GET_LENGTH,
+                              &i_length ) == VLC_SUCCESS );
+    assert( i_length == CLUSTERS * CLOCK_FREQ );
+
+    int i_ret = 0;
+    for( size_t i = 0; i < sizeof(seeks) / sizeof(seeks[0]); i++ )
+    {
+        mtime_t i_latency = 0;
+        mtime_t i_date = TestDemuxSeek( p_demux, seeks[i], &i_latency );
+
+        /* Every block is a key frame: the first one not before the date */
+        mtime_t i_expected = (seeks[i] + BLOCK_DURATION - 1) /
+                             BLOCK_DURATION * BLOCK_DURATION;
+        log( "seek to %"PRId64" us: first block at %"PRId64" us in %"PRId64" us\n",
+             seeks[i], i_date, i_latency );
+        if( i_date != i_expected )
+        {
+            log( "expected the block at %"PRId64" us\n", i_expected );
+            i_ret = 1;
+        }
+    }
+
+    TestDemuxDelete( p_demux );
+    return i_ret;
+}
+
+static void RemoveTree( const char *psz_dir )
+{
+    DIR *p_dir = opendir( psz_dir );
+    if( p_dir )
+    {
+        struct dirent *p_ent;
+        while( (p_ent = readdir( p_dir )) != NULL )
+        {
+            if( !strcmp( p_ent->d_name, "." ) || !strcmp( p_ent->d_name, ".." ) )
+                continue;
+            char *psz_path;
+            assert( asprintf( &psz_path, "%s/%s", psz_dir,
+                              p_ent->d_name ) >= 0 );
+            if( unlink( psz_path ) )
+                RemoveTree( psz_path );
+            free( psz_path );
+        }
+        closedir( p_dir );
+    }
+    rmdir( psz_dir );
+}
+
+int main( void )
+{
+    test_init();
+
+    char psz_dir[] = "/tmp/vlc-test-mkv-XXXXXX";
+    assert( mkdtemp( psz_dir ) != NULL );
+
+    /* Keep the cluster index cache out of the user's one */
+    char *psz_path;
+    assert( asprintf( &psz_path, "%s/nocues.mkv", psz_dir ) >= 0 );
+    setenv( "XDG_CACHE_HOME", psz_dir, 1 );
+    WriteFile( psz_path );
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+    libvlc_log_set( p_vlc, LogCallback, NULL );
+
+    bool b_skip = false;
+    int i_ret = test_seeks( VLC_OBJECT(p_vlc->p_libvlc_int), psz_path, &b_skip );
+    if( b_skip )
+    {
+        log( "mkv plugin not found, skipping\n" );
+        i_ret = 77;
+    }
+    else
+    {
+        /* The first seek scanned all the clusters, but the first one that
+         * the opening may have indexed already */
+        log( "%d clusters indexed by the scan\n", i_scanned );
+        if( i_scanned < CLUSTERS - 1 || i_scanned > CLUSTERS )
+            i_ret = 1;
+
+        /* The second opening uses the saved index */
+        i_ret |= test_seeks( VLC_OBJECT(p_vlc->p_libvlc_int), psz_path, &b_skip );
+        log( "%d clusters loaded from the cache\n", i_cached );
+        if( i_cached != CLUSTERS )
+            i_ret = 1;
+    }
+
+    libvlc_release( p_vlc );
+    RemoveTree( psz_dir );
+    free( psz_path );
+    return i_ret;
+}
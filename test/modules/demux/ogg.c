@@ -0,0 +1,241 @@
+/*****************************************************************************
+ * ogg.c: benchmark of the ogg demuxer seeks in a long file
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Writes a three hours long Opus file, seeks to the same dates twice and
+ * prints the latency of both passes: the first one bisects the file, the
+ * second one may use what the demuxer learnt. Checks the date of the first
+ * block demuxed after each seek. Exits with 77 (skipped) if the ogg plugin
+ * is not built. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+#include "demux.h"
+
+#include <stdio.h>
+
+#define PAGES             (3 * 3600)        /* one per second */
+#define PACKETS           (50)              /* per page */
+#define PACKET_DURATION   (CLOCK_FREQ / PACKETS)
+#define PACKET_SAMPLES    (960)             /* 20 ms at 48 kHz */
+#define PACKET_SIZE       (24)
+#define SEEKS             (64)
+
+/*****************************************************************************
+ * Ogg writer
+ *****************************************************************************/
+static uint32_t Crc32( const uint8_t *p_data, size_t i_size )
+{
+    uint32_t i_crc = 0;
+    for( size_t i = 0; i < i_size; i++ )
+    {
+        i_crc ^= (uint32_t)p_data[i] << 24;
+        for( int b = 0; b < 8; b++ )
+            i_crc = (i_crc << 1) ^ ((i_crc & 0x80000000) ? 0x04c11db7 : 0);
+    }
+    return i_crc;
+}
+
+/* Writes one page holding packets of less than 255 bytes */
+static void WritePage( FILE *p_file, uint8_t i_flags, int64_t i_granule,
+                       uint32_t i_seqno, const uint8_t *p_data,
+                       const size_t *pi_sizes, int i_packets )
+{
+    uint8_t p_page[27 + 255 + 255 * 255];
+    size_t i_data = 0;
+
+    memcpy( p_page, "OggS", 4 );
+    p_page[4] = 0;
+    p_page[5] = i_flags;
+    SetQWLE( &p_page[6], i_granule );
+    SetDWLE( &p_page[14], 1 );              /* serial number */
+    SetDWLE( &p_page[18], i_seqno );
+    SetDWLE( &p_page[22], 0 );              /* CRC, set below */
+    p_page[26] = i_packets;
+    for( int i = 0; i < i_packets; i++ )
+    {
+        assert( pi_sizes[i] < 255 );
+        p_page[27 + i] = pi_sizes[i];
+        i_data += pi_sizes[i];
+    }
+    memcpy( &p_page[27 + i_packets], p_data, i_data );
+
+    const size_t i_page = 27 + i_packets + i_data;
+    SetDWLE( &p_page[22], Crc32( p_page, i_page ) );
+    assert( fwrite( p_page, 1, i_page, p_file ) == i_page );
+}
+
+static void WriteFile( const char *psz_path )
+{
+    FILE *p_file = fopen( psz_path, "wb" );
+    assert( p_file != NULL );
+
+    /* Mono, no pre-skip, so that the dates are the granule positions */
+    uint8_t p_head[19];
+    memcpy( p_head, "OpusHead", 8 );
+    p_head[8] = 1;                          /* version */
+    p_head[9] = 1;                          /* channels */
+    SetWLE( &p_head[10], 0 );               /* pre-skip */
+    SetDWLE( &p_head[12], 48000 );
+    SetWLE( &p_head[16], 0 );               /* gain */
+    p_head[18] = 0;                         /* channel mapping */
+    size_t i_size = sizeof(p_head);
+    WritePage( p_file, 0x02, 0, 0, p_head, &i_size, 1 );
+
+    static const uint8_t p_tags[] = "OpusTags\x04\0\0\0test\0\0\0\0";
+    i_size = sizeof(p_tags) - 1;
+    WritePage( p_file, 0x00, 0, 1, p_tags, &i_size, 1 );
+
+    /* CELT only, fullband, 20 ms frames */
+    uint8_t p_data[PACKETS * PACKET_SIZE];
+    size_t pi_sizes[PACKETS];
+    for( int i = 0; i < PACKETS; i++ )
+    {
+        p_data[i * PACKET_SIZE] = 0xF8;
+        memset( &p_data[i * PACKET_SIZE + 1], i, PACKET_SIZE - 1 );
+        pi_sizes[i] = PACKET_SIZE;
+    }
+
+    for( uint32_t i_page = 0; i_page < PAGES; i_page++ )
+        WritePage( p_file, i_page == PAGES - 1 ? 0x04 : 0x00,
+                   (int64_t)(i_page + 1) * PACKETS * PACKET_SAMPLES,
+                   i_page + 2, p_data, pi_sizes, PACKETS );
+
+    assert( fclose( p_file ) == 0 );
+}
+
+/*****************************************************************************
+ * Seeks
+ *****************************************************************************/
+static uint64_t i_read_bytes, i_read_count;
+static unsigned i_seek_count;
+
+/* Keeps what the stream read, as it logs it when deleted */
+static void LogCallback( void *p_data, int i_level, const libvlc_log_t *p_ctx,
+                         const char *psz_fmt, va_list args )
+{
+    char psz_msg[256];
+
+    (void) p_data; (void) i_level; (void) p_ctx;
+    vsnprintf( psz_msg, sizeof(psz_msg), psz_fmt, args );
+    sscanf( psz_msg, "%"SCNu64" bytes in %"SCNu64" reads (%*u ms), %u seeks",
+            &i_read_bytes, &i_read_count, &i_seek_count );
+}
+
+static mtime_t seeks[SEEKS];
+
+static int test_pass( demux_t *p_demux, const char *psz_pass )
+{
+    mtime_t i_total = 0, i_max = 0;
+    int i_ret = 0;
+
+    for( int i = 0; i < SEEKS; i++ )
+    {
+        mtime_t i_latency = 0;
+        mtime_t i_date = TestDemuxSeek( p_demux, seeks[i], &i_latency );
+
+        /* The first block of a page ending before the date, no more than
+         * the index interval (2 s) earlier */
+        if( i_date < 0 || i_date > seeks[i]
+         || i_date < seeks[i] - 3 * CLOCK_FREQ )
+        {
+            log( "seek to %"PRId64" us: first block at %"PRId64" us\n",
+                 seeks[i], i_date );
+            i_ret = 1;
+        }
+        i_total += i_latency;
+        i_max = __MAX( i_max, i_latency );
+    }
+
+    log( "%s pass: %d seeks, %"PRId64" us on average, %"PRId64" us at most\n",
+         psz_pass, SEEKS, i_total / SEEKS, i_max );
+    return i_ret;
+}
+
+static int test_seeks( vlc_object_t *p_parent, const char *psz_path,
+                       bool *pb_skip )
+{
+    es_out_sys_t out_sys;
+    es_out_t out;
+    TestEsOutInit( &out, &out_sys );
+
+    mtime_t i_start = mdate();
+    demux_t *p_demux = TestDemuxNew( p_parent, "ogg", psz_path, &out );
+    if( !p_demux )
+    {
+        *pb_skip = true;
+        return 0;
+    }
+    log( "opened in %"PRId64" us\n", mdate() - i_start );
+
+    int64_t i_length;
+    assert( TestDemuxControl( p_demux, DEMUX_GET_LENGTH,
+                              &i_length ) == VLC_SUCCESS );
+    log( "length %"PRId64" us\n", i_length );
+
+    /* The elementary stream is only created once playback started */
+    while( out_sys.i_blocks == 0 )
+        assert( p_demux->pf_demux( p_demux ) > 0 );
+
+    /* Spread over the whole file, in no particular order */
+    unsigned i_seed = 1;
+    for( int i = 0; i < SEEKS; i++ )
+    {
+        i_seed = i_seed * 1103515245 + 12345;
+        seeks[i] = (mtime_t)(i_seed >> 8) % (PAGES - 1) * CLOCK_FREQ
+                 + (i_seed & 0xff) * CLOCK_FREQ / 256;
+    }
+
+    int i_ret = test_pass( p_demux, "first" );
+    i_ret |= test_pass( p_demux, "second" );
+
+    TestDemuxDelete( p_demux );
+    log( "%"PRIu64" bytes read in %"PRIu64" reads and %u seeks\n",
+         i_read_bytes, i_read_count, i_seek_count );
+    return i_ret;
+}
+
+int main( void )
+{
+    test_init();
+    alarm( 0 );
+
+    char psz_path[] = "/tmp/vlc-test-ogg-XXXXXX";
+    int fd = mkstemp( psz_path );
+    assert( fd >= 0 );
+    close( fd );
+    WriteFile( psz_path );
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+    libvlc_log_set( p_vlc, LogCallback, NULL );
+
+    bool b_skip = false;
+    int i_ret = test_seeks( VLC_OBJECT(p_vlc->p_libvlc_int), psz_path, &b_skip );
+    if( b_skip )
+    {
+        log( "ogg plugin not found, skipping\n" );
+        i_ret = 77;
+    }
+
+    libvlc_release( p_vlc );
+    unlink( psz_path );
+    return i_ret;
+}
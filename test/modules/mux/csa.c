@@ -0,0 +1,244 @@
+/*****************************************************************************
+ * csa.c: CSA (de)scrambling test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks the CSA scrambler against known packets, checks that the batch
+ * functions give the same results as the per packet ones, and prints the
+ * rate of both. */
+
+#include "../../libvlc/test.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+
+#define TS_NO_CSA_CK_MSG
+#include "../../../modules/mux/mpeg/csa.c"
+
+#define ODD_KEY  "0x1122334455667788"
+#define EVEN_KEY "8877665544332211"
+
+/* Scrambled by the original per packet code, from the packets of
+ * FillPacket() with seed 1 (no adaptation field, odd key) and seed 2
+ * (83 bytes adaptation field, even key) */
+static const uint8_t scrambled_odd[188] =
+{
+    0x47, 0x01, 0x00, 0xd5, 0x10, 0xf5, 0x41, 0xa5, 0x23, 0x21, 0x3b, 0x99,
+    0x20, 0x79, 0x82, 0x46, 0xa9, 0x0a, 0x6c, 0x4d, 0x87, 0x1e, 0xe1, 0x01,
+    0xb9, 0x4b, 0x15, 0xf8, 0x8a, 0x0c, 0x62, 0xff, 0xe7, 0xc0, 0x3c, 0xd0,
+    0x09, 0xdd, 0x43, 0x7e, 0x68, 0x4e, 0x00, 0xe4, 0x2c, 0xf3, 0x3c, 0xbb,
+    0x9a, 0xcc, 0xc6, 0xf2, 0xd3, 0xf2, 0x07, 0x38, 0x8d, 0xe0, 0xdd, 0xae,
+    0xa9, 0x96, 0xc2, 0x9c, 0xae, 0x31, 0x55, 0xbf, 0x94, 0xa6, 0xd6, 0x07,
+    0x67, 0x18, 0xd9, 0xe2, 0x1e, 0x9f, 0x8f, 0x9d, 0x1e, 0x78, 0x8c, 0xfe,
+    0xe0, 0xfc, 0xf0, 0x0a, 0x68, 0xe4, 0xb6, 0xe6, 0x21, 0xa8, 0xdb, 0xdc,
+    0xcc, 0x9c, 0xe0, 0x89, 0xba, 0x8e, 0xcf, 0x98, 0x9c, 0xab, 0xdb, 0x24,
+    0x17, 0xe9, 0xbb, 0x2c, 0xd6, 0xdc, 0x8d, 0x48, 0xe6, 0xdb, 0xc4, 0x3c,
+    0x4d, 0xb7, 0x52, 0x78, 0x54, 0x90, 0xef, 0x38, 0xd8, 0x07, 0x25, 0xe5,
+    0x1c, 0xe6, 0xff, 0x7b, 0x1c, 0xdc, 0xa2, 0x0a, 0xd1, 0xa5, 0x27, 0xe7,
+    0x01, 0x66, 0x98, 0x36, 0x3f, 0xb3, 0x9b, 0x74, 0x55, 0x4e, 0x4a, 0x51,
+    0xe6, 0x73, 0x24, 0xd9, 0xf8, 0xae, 0xfc, 0xa1, 0x24, 0x1b, 0x45, 0x2a,
+    0x1c, 0x13, 0x3c, 0x9a, 0xc0, 0x12, 0x04, 0xbf, 0xe6, 0xb3, 0xaa, 0x14,
+    0x5b, 0x46, 0xc4, 0xd1, 0x32, 0x26, 0xc8, 0x2f,
+};
+static const uint8_t scrambled_even[188] =
+{
+    0x47, 0x01, 0x00, 0xb6, 0x53, 0xd7, 0x18, 0xd9, 0x4e, 0x13, 0x95, 0x13,
+    0xdc, 0x1b, 0x63, 0xfc, 0x93, 0x06, 0xf6, 0xbf, 0x9c, 0xe5, 0x06, 0xe0,
+    0x6d, 0xb0, 0x0a, 0x05, 0x9f, 0xf2, 0x75, 0x87, 0x8e, 0x34, 0xb3, 0xbc,
+    0xb3, 0x2b, 0xe2, 0x02, 0xc0, 0xa1, 0x51, 0x8c, 0x80, 0x23, 0xb9, 0xec,
+    0x6d, 0x6f, 0x3d, 0x64, 0x0e, 0x9c, 0x23, 0xec, 0x17, 0x07, 0x50, 0x03,
+    0x3f, 0x01, 0x85, 0x36, 0xdf, 0x3a, 0x5c, 0x71, 0x4f, 0xec, 0x00, 0x09,
+    0x00, 0xc7, 0xaf, 0x85, 0x59, 0xa0, 0xf1, 0x30, 0x53, 0xd8, 0x95, 0x5f,
+    0xd3, 0x8d, 0x70, 0x82, 0xb0, 0xad, 0xca, 0x07, 0xa7, 0xb3, 0xad, 0x26,
+    0x8f, 0x95, 0x2d, 0xb1, 0x6c, 0xf4, 0xf8, 0x6c, 0x70, 0x50, 0xcd, 0xd8,
+    0xe3, 0x94, 0x81, 0xbc, 0x3a, 0x23, 0x5f, 0x68, 0x21, 0xc6, 0x07, 0xcb,
+    0xf2, 0x76, 0x56, 0x02, 0x69, 0x3b, 0x65, 0x66, 0xf7, 0xc0, 0x55, 0xcf,
+    0x3f, 0x1a, 0x2c, 0x04, 0x32, 0x64, 0x3e, 0x24, 0x99, 0x62, 0x60, 0xb0,
+    0x5c, 0x3f, 0x1a, 0x15, 0xe3, 0x2d, 0xc4, 0x01, 0x1c, 0x86, 0xaf, 0x71,
+    0x72, 0x50, 0xc3, 0xc1, 0x33, 0x1b, 0x02, 0xa7, 0xfe, 0x3c, 0x94, 0xa6,
+    0xdc, 0x44, 0x5f, 0x89, 0x88, 0xa8, 0x27, 0x0d, 0xb2, 0x47, 0x0e, 0x6d,
+    0x60, 0xb5, 0xb5, 0x9d, 0x1b, 0x3c, 0x6e, 0xa8,
+};
+
+#define PACKETS (CSA_BATCH * 64)
+
+static uint8_t packets[PACKETS][188];
+static uint8_t copies[PACKETS][188];
+
+/* Random TS packet, with an adaptation field of i_af bytes if i_af >= 0 */
+static void FillPacket( uint8_t *p, int i_af, unsigned i_seed )
+{
+    for( int i = 0; i < 188; i++ )
+    {
+        i_seed = i_seed * 1103515245 + 12345;
+        p[i] = i_seed >> 16;
+    }
+    p[0] = 0x47;
+    p[1] = 0x01;
+    p[2] = 0x00;
+    p[3] = 0x10 | (i_seed & 15);
+    if( i_af >= 0 )
+    {
+        p[3] |= 0x20;
+        p[4] = i_af;
+    }
+}
+
+static void test_known_answer( csa_t *c, bool b_odd, int i_af, unsigned i_seed,
+                               const uint8_t *p_expected )
+{
+    uint8_t plain[188], pkt[188];
+    uint8_t *p_pkt = pkt;
+
+    log( "known answer, %s key\n", b_odd ? "odd" : "even" );
+    FillPacket( plain, i_af, i_seed );
+    csa_UseKey( NULL, c, b_odd );
+
+    memcpy( pkt, plain, 188 );
+    csa_Encrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, p_expected, 188 ) );
+    csa_Decrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, plain, 188 ) );
+
+    memcpy( pkt, plain, 188 );
+    csa_EncryptBatch( c, &p_pkt, 1, 188 );
+    assert( !memcmp( pkt, p_expected, 188 ) );
+    csa_DecryptBatch( c, &p_pkt, 1, 188 );
+    assert( !memcmp( pkt, plain, 188 ) );
+
+    /* The descrambler picks the key from the packet, not from UseKey */
+    csa_UseKey( NULL, c, !b_odd );
+    memcpy( pkt, p_expected, 188 );
+    csa_Decrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, plain, 188 ) );
+}
+
+/* Random packets, some with adaptation fields */
+static void FillPackets( int i_count, unsigned i_seed )
+{
+    for( int i = 0; i < i_count; i++ )
+    {
+        i_seed = i_seed * 1103515245 + 12345;
+        const int i_af = (i_seed >> 16) % 3 ? -1 : (int)((i_seed >> 20) % 184);
+        FillPacket( packets[i], i_af, i_seed );
+    }
+}
+
+static void test_batch( csa_t *c, int i_pkt_size )
+{
+    uint8_t *pp_pkt[CSA_BATCH * 3];
+    const int i_count = CSA_BATCH * 3;
+
+    log( "batch against per packet, %d bytes\n", i_pkt_size );
+    for( int i_key = 0; i_key < 2; i_key++ )
+    {
+        FillPackets( i_count, i_pkt_size + i_key );
+        memcpy( copies, packets, i_count * 188 );
+        for( int i = 0; i < i_count; i++ )
+            pp_pkt[i] = packets[i];
+
+        csa_UseKey( NULL, c, i_key );
+        csa_EncryptBatch( c, pp_pkt, i_count, i_pkt_size );
+        for( int i = 0; i < i_count; i++ )
+        {
+            csa_Encrypt( c, copies[i], i_pkt_size );
+            assert( !memcmp( packets[i], copies[i], 188 ) );
+        }
+    }
+
+    /* Descrambling, with clear, odd and even packets mixed */
+    FillPackets( i_count, i_pkt_size );
+    for( int i = 0; i < i_count; i++ )
+    {
+        if( i % 3 )
+            packets[i][3] |= i % 3 == 1 ? 0xc0 : 0x80;
+        pp_pkt[i] = packets[i];
+    }
+    memcpy( copies, packets, i_count * 188 );
+    csa_DecryptBatch( c, pp_pkt, i_count, i_pkt_size );
+    for( int i = 0; i < i_count; i++ )
+    {
+        csa_Decrypt( c, copies[i], i_pkt_size );
+        assert( !memcmp( packets[i], copies[i], 188 ) );
+    }
+}
+
+static void bench( csa_t *c )
+{
+    static uint8_t *pp_pkt[PACKETS];
+
+    FillPackets( PACKETS, 0 );
+    for( int i = 0; i < PACKETS; i++ )
+    {
+        packets[i][3] &= ~0x20;
+        pp_pkt[i] = packets[i];
+    }
+
+    mtime_t i_single = mdate();
+    for( int i = 0; i < PACKETS; i++ )
+        csa_Encrypt( c, packets[i], 188 );
+    i_single = mdate() - i_single;
+
+    mtime_t i_batch = mdate();
+    csa_EncryptBatch( c, pp_pkt, PACKETS, 188 );
+    i_batch = mdate() - i_batch;
+
+    log( "scrambling: %.0f packets/s per packet, %.0f packets/s batched\n",
+         PACKETS * (double)CLOCK_FREQ / __MAX( i_single, 1 ),
+         PACKETS * (double)CLOCK_FREQ / __MAX( i_batch, 1 ) );
+
+    i_single = mdate();
+    for( int i = 0; i < PACKETS; i++ )
+        csa_Decrypt( c, packets[i], 188 );
+    i_single = mdate() - i_single;
+
+    for( int i = 0; i < PACKETS; i++ )
+        packets[i][3] |= 0xc0;
+    i_batch = mdate();
+    csa_DecryptBatch( c, pp_pkt, PACKETS, 188 );
+    i_batch = mdate() - i_batch;
+
+    log( "descrambling: %.0f packets/s per packet, %.0f packets/s batched\n",
+         PACKETS * (double)CLOCK_FREQ / __MAX( i_single, 1 ),
+         PACKETS * (double)CLOCK_FREQ / __MAX( i_batch, 1 ) );
+}
+
+int main( void )
+{
+    char odd_key[] = ODD_KEY, even_key[] = EVEN_KEY;
+
+    test_init();
+
+    csa_t *c = csa_New();
+    assert( c != NULL );
+    assert( csa_SetCW( NULL, c, odd_key, true ) == VLC_SUCCESS );
+    assert( csa_SetCW( NULL, c, even_key, false ) == VLC_SUCCESS );
+
+    test_known_answer( c, true, -1, 1, scrambled_odd );
+    test_known_answer( c, false, 83, 2, scrambled_even );
+
+    test_batch( c, 188 );
+    test_batch( c, 100 );
+    test_batch( c, 13 );
+
+    bench( c );
+
+    csa_Delete( c );
+    return 0;
+}
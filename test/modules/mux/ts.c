@@ -0,0 +1,176 @@
+/*****************************************************************************
+ * ts.c: TS muxer throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Muxes synthetic MPEG video and audio into the TS muxer, writing to the
+ * dummy access output, and prints the muxing rate for a few TS muxer
+ * settings. Exits with 77 (skipped) if the TS muxer is not built. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+
+#define SECONDS (60)
+
+#define VIDEO_BITRATE (8000000)
+#define VIDEO_FPS     (25)
+#define AUDIO_BITRATE (192000)
+#define AUDIO_FRAME   (24000) /* 1152 samples at 48kHz */
+
+static const char *const mux_configs[] =
+{
+    "ts{slab=1}",
+    "ts",
+    "ts{slab=21}",
+    "ts{muxrate=10000000}",
+};
+
+static block_t *NewFrame( size_t i_size, mtime_t i_dts, mtime_t i_length,
+                          unsigned *pi_seed )
+{
+    block_t *p_block = block_Alloc( i_size );
+    assert( p_block != NULL );
+
+    for( size_t i = 0; i < i_size; i++ )
+    {
+        *pi_seed = *pi_seed * 1103515245 + 12345;
+        p_block->p_buffer[i] = *pi_seed >> 16;
+    }
+    p_block->i_dts = p_block->i_pts = i_dts;
+    p_block->i_length = i_length;
+    return p_block;
+}
+
+static int bench_mux( vlc_object_t *p_parent, const char *psz_mux )
+{
+    sout_instance_t *p_sout = vlc_object_create( p_parent, sizeof(*p_sout) );
+    assert( p_sout != NULL );
+    p_sout->psz_sout = NULL;
+    p_sout->i_out_pace_nocontrol = 0;
+    p_sout->p_stream = NULL;
+    vlc_mutex_init( &p_sout->lock );
+    var_Create( p_sout, "sout-mux-caching", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT );
+
+    sout_access_out_t *p_access = sout_AccessOutNew( p_sout, "dummy", "" );
+    assert( p_access != NULL );
+    sout_mux_t *p_mux = sout_MuxNew( p_sout, psz_mux, p_access );
+    if( p_mux == NULL )
+    {
+        sout_AccessOutDelete( p_access );
+        vlc_mutex_destroy( &p_sout->lock );
+        vlc_object_release( p_sout );
+        return 77;
+    }
+
+    es_format_t fmt_video, fmt_audio;
+    es_format_Init( &fmt_video, VIDEO_ES, VLC_CODEC_MPGV );
+    fmt_video.video.i_width = fmt_video.video.i_visible_width = 1920;
+    fmt_video.video.i_height = fmt_video.video.i_visible_height = 1080;
+    fmt_video.i_bitrate = VIDEO_BITRATE;
+    es_format_Init( &fmt_audio, AUDIO_ES, VLC_CODEC_MPGA );
+    fmt_audio.audio.i_rate = 48000;
+    fmt_audio.audio.i_channels = 2;
+    fmt_audio.i_bitrate = AUDIO_BITRATE;
+
+    sout_input_t *p_video = sout_MuxAddStream( p_mux, &fmt_video );
+    sout_input_t *p_audio = sout_MuxAddStream( p_mux, &fmt_audio );
+    assert( p_video != NULL && p_audio != NULL );
+
+    const mtime_t i_start = VLC_TS_0 + CLOCK_FREQ;
+    const mtime_t i_video_length = CLOCK_FREQ / VIDEO_FPS;
+    const size_t i_video_size = VIDEO_BITRATE / 8 / VIDEO_FPS;
+    const size_t i_audio_size = AUDIO_BITRATE / 8 * AUDIO_FRAME / CLOCK_FREQ;
+    unsigned i_seed = 0;
+    size_t i_bytes = 0;
+    mtime_t i_audio_dts = i_start;
+    mtime_t i_time = 0;
+
+    for( int i = 0; i < SECONDS * VIDEO_FPS; i++ )
+    {
+        const mtime_t i_video_dts = i_start + i * i_video_length;
+
+        /* Only the muxing is timed, not the frames generation */
+        block_t *p_frame = NewFrame( i_video_size, i_video_dts,
+                                     i_video_length, &i_seed );
+        if( i % 12 == 0 )
+            p_frame->i_flags |= BLOCK_FLAG_TYPE_I;
+        i_bytes += i_video_size;
+
+        mtime_t i_begin = mdate();
+        sout_MuxSendBuffer( p_mux, p_video, p_frame );
+        i_time += mdate() - i_begin;
+
+        while( i_audio_dts < i_video_dts + i_video_length )
+        {
+            p_frame = NewFrame( i_audio_size, i_audio_dts, AUDIO_FRAME, &i_seed );
+            i_audio_dts += AUDIO_FRAME;
+            i_bytes += i_audio_size;
+
+            i_begin = mdate();
+            sout_MuxSendBuffer( p_mux, p_audio, p_frame );
+            i_time += mdate() - i_begin;
+        }
+    }
+
+    mtime_t i_begin = mdate();
+    sout_MuxDeleteStream( p_mux, p_audio );
+    sout_MuxDeleteStream( p_mux, p_video );
+    sout_MuxDelete( p_mux );
+    i_time += mdate() - i_begin;
+
+    log( "%-24s %d s of stream in %"PRId64" ms: %.1f MB/s of ES, "
+         "%.0f TS packets/s\n", psz_mux, SECONDS, i_time / 1000,
+         i_bytes / (double)__MAX( i_time, 1 ),
+         i_bytes / 184. * CLOCK_FREQ / __MAX( i_time, 1 ) );
+
+    sout_AccessOutDelete( p_access );
+    es_format_Clean( &fmt_video );
+    es_format_Clean( &fmt_audio );
+    vlc_mutex_destroy( &p_sout->lock );
+    vlc_object_release( p_sout );
+    return 0;
+}
+
+int main( void )
+{
+    test_init();
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+
+    int i_ret = 0;
+    for( size_t i = 0; i < sizeof(mux_configs) / sizeof(mux_configs[0]); i++ )
+    {
+        i_ret = bench_mux( VLC_OBJECT(p_vlc->p_libvlc_int), mux_configs[i] );
+        if( i_ret == 77 )
+        {
+            log( "TS muxer not found, skipping\n" );
+            break;
+        }
+    }
+
+    libvlc_release( p_vlc );
+    return i_ret;
+}
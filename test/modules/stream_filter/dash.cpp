@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * dash.cpp: DASH rate based adaptation logic test
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Drives RateBasedAdaptationLogic with synthetic throughput and buffer
+ * levels over an MPD built in memory, and checks the chosen
+ * representation at each step. */
+
+#include "../../../modules/stream_filter/dash/adaptationlogic/AbstractAdaptationLogic.cpp"
+#include "../../../modules/stream_filter/dash/adaptationlogic/RateBasedAdaptationLogic.cpp"
+#include "../../../modules/stream_filter/dash/http/Chunk.cpp"
+#include "../../../modules/stream_filter/dash/mpd/AdaptationSet.cpp"
+#include "../../../modules/stream_filter/dash/mpd/BasicCMManager.cpp"
+#include "../../../modules/stream_filter/dash/mpd/CommonAttributesElements.cpp"
+#include "../../../modules/stream_filter/dash/mpd/ContentDescription.cpp"
+#include "../../../modules/stream_filter/dash/mpd/MPD.cpp"
+#include "../../../modules/stream_filter/dash/mpd/Period.cpp"
+#include "../../../modules/stream_filter/dash/mpd/ProgramInformation.cpp"
+#include "../../../modules/stream_filter/dash/mpd/Representation.cpp"
+#include "../../../modules/stream_filter/dash/mpd/Segment.cpp"
+#include "../../../modules/stream_filter/dash/mpd/SegmentBase.cpp"
+#include "../../../modules/stream_filter/dash/mpd/SegmentInfo.cpp"
+#include "../../../modules/stream_filter/dash/mpd/SegmentInfoCommon.cpp"
+#include "../../../modules/stream_filter/dash/mpd/SegmentList.cpp"
+#include "../../../modules/stream_filter/dash/mpd/SegmentTimeline.cpp"
+#include "../../../modules/stream_filter/dash/mpd/TrickModeType.cpp"
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#define SEGMENTS 8
+
+static const uint64_t bandwidths[] = { 200000, 500000, 1000000, 2000000 };
+
+/* One period with one adaptation set of all the bandwidths, lowest first */
+static MPD *CreateMPD (void)
+{
+    MPD *mpd = new MPD();
+    Period *period = new Period();
+    AdaptationSet *set = new AdaptationSet();
+
+    for (size_t i = 0; i < sizeof (bandwidths) / sizeof (bandwidths[0]); i++)
+    {
+        Representation *rep = new Representation();
+        SegmentInfo *info = new SegmentInfo();
+
+        rep->setBandwidth (bandwidths[i]);
+        rep->setSegmentInfo (info);
+        for (int j = 0; j < SEGMENTS; j++)
+        {
+            Segment *seg = new Segment (rep);
+            seg->setSourceUrl ("http://localhost/segment");
+            info->addSegment (seg);
+        }
+        set->addRepresentation (rep);
+    }
+    period->addAdaptationSet (set);
+    mpd->addPeriod (period);
+    return mpd;
+}
+
+/* Feeds one sample and returns the bandwidth of the representation of
+ * the next chunk, 0 if there is no chunk anymore */
+static uint64_t Step (RateBasedAdaptationLogic *logic, uint64_t bps,
+                      int buffer_percent)
+{
+    logic->downloadRateChanged (bps, bps);
+    logic->bufferLevelChanged (0, buffer_percent);
+
+    Chunk *chunk = logic->getNextChunk ();
+    if (chunk == NULL)
+        return 0;
+
+    uint64_t bandwidth = chunk->getBitrate ();
+    assert (bandwidth == logic->getCurrentRepresentation ()->getBandwidth ());
+    delete chunk;
+    return bandwidth;
+}
+
+static void test_rate_based (stream_t *stream)
+{
+    log ("Testing rate based adaptation\n");
+
+    BasicCMManager manager (CreateMPD ());
+    RateBasedAdaptationLogic logic (&manager, stream);
+
+    /* Below MINBUFFER, the lowest representation whatever the rate */
+    assert (Step (&logic, 10000000, MINBUFFER - 1) == 200000);
+
+    /* At MINBUFFER, 65% of the rate: 1.04 Mb/s, but no up switch
+     * below UPSWITCHBUFFER */
+    assert (Step (&logic, 1600000, MINBUFFER) == 200000);
+
+    /* At UPSWITCHBUFFER, 75% of the rate: 1.2 Mb/s */
+    assert (Step (&logic, 1600000, UPSWITCHBUFFER) == 1000000);
+
+    /* Down switches are not delayed: 70% of 1 Mb/s */
+    assert (Step (&logic, 1000000, 40) == 500000);
+
+    /* A full buffer uses the whole rate, a lower one scales it down */
+    assert (Step (&logic, 2100000, 100) == 2000000);
+    assert (Step (&logic, 2100000, 60) == 1000000);
+
+    /* Beyond 100%, no more than the rate */
+    assert (Step (&logic, 1900000, 200) == 1000000);
+
+    /* Every segment is handed out once, then the only period ends */
+    assert (Step (&logic, 1900000, 100) == 1000000);
+    assert (Step (&logic, 1900000, 100) == 0);
+}
+
+int main (void)
+{
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    stream_t *stream = (stream_t *)vlc_object_create (vlc->p_libvlc_int,
+                                                      sizeof (*stream));
+    assert (stream != NULL);
+
+    test_rate_based (stream);
+
+    vlc_object_release (stream);
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*****************************************************************************
+ * httplive.c: HTTP Live Streaming playback test
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Serves a plain and an AES-128 playlist of the same segments from a local
+ * HTTP server, with the segments answered out of order, and dumps the
+ * stream read through the httplive filter with one and three download
+ * threads. Checks that each dump is the concatenation of the plain
+ * segments. Exits with 77 (skipped) if the httplive or http plugins are
+ * not built. */
+
+#include "../../../libvlc/test.h"
+#include "server.h"
+
+#include <stdio.h>
+#include <gcrypt.h>
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_gcrypt.h>
+
+#define SEGMENTS      (8)
+#define SEGMENT_SIZE  (347 * 188)   /* not a multiple of the AES block */
+#define KEY_NAME      "key.bin"     /* relative to the playlist */
+
+static const uint8_t key[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+
+static uint8_t plain[SEGMENTS * SEGMENT_SIZE];
+static uint8_t *encrypted[SEGMENTS];
+static size_t i_encrypted;
+static char psz_plain_list[1024], psz_aes_list[1024];
+static char psz_paths[2 * SEGMENTS][32];
+
+/* Transport stream packets of random data */
+static void MakeSegments( void )
+{
+    unsigned i_seed = 1;
+
+    for( size_t i = 0; i < sizeof(plain); i++ )
+    {
+        i_seed = i_seed * 1103515245 + 12345;
+        plain[i] = i % 188 ? i_seed >> 16 : 0x47;
+    }
+}
+
+/* AES-128-CBC with PKCS#7 padding, the IV being the sequence number */
+static void EncryptSegments( void )
+{
+    i_encrypted = (SEGMENT_SIZE / 16 + 1) * 16;
+
+    for( int i = 0; i < SEGMENTS; i++ )
+    {
+        uint8_t iv[16] = { 0 };
+        gcry_cipher_hd_t aes;
+
+        encrypted[i] = malloc( i_encrypted );
+        assert( encrypted[i] != NULL );
+        memcpy( encrypted[i], &plain[i * SEGMENT_SIZE], SEGMENT_SIZE );
+        memset( &encrypted[i][SEGMENT_SIZE], i_encrypted - SEGMENT_SIZE,
+                i_encrypted - SEGMENT_SIZE );
+        SetDWBE( &iv[12], i );
+
+        assert( !gcry_cipher_open( &aes, GCRY_CIPHER_AES,
+                                   GCRY_CIPHER_MODE_CBC, 0 ) );
+        assert( !gcry_cipher_setkey( aes, key, sizeof(key) ) );
+        assert( !gcry_cipher_setiv( aes, iv, sizeof(iv) ) );
+        assert( !gcry_cipher_encrypt( aes, encrypted[i], i_encrypted,
+                                      NULL, 0 ) );
+        gcry_cipher_close( aes );
+    }
+}
+
+static void MakePlaylist( char *psz_list, size_t i_list, const char *psz_name,
+                          bool b_aes )
+{
+    int i_len = snprintf( psz_list, i_list, "#EXTM3U\n"
+                          "#EXT-X-TARGETDURATION:2\n"
+                          "#EXT-X-MEDIA-SEQUENCE:0\n%s",
+                          b_aes ? "#EXT-X-KEY:METHOD=AES-128,"
+                                  "URI=\"" KEY_NAME "\"\n" : "" );
+    for( int i = 0; i < SEGMENTS; i++ )
+        i_len += snprintf( psz_list + i_len, i_list - i_len,
+                           "#EXTINF:2,\n%s-%d.ts\n", psz_name, i );
+    i_len += snprintf( psz_list + i_len, i_list - i_len, "#EXT-X-ENDLIST\n" );
+    assert( (size_t)i_len < i_list );
+}
+
+static unsigned MakeResources( test_http_resource_t *p_res )
+{
+    unsigned n = 0;
+
+    MakePlaylist( psz_plain_list, sizeof(psz_plain_list), "plain", false );
+    MakePlaylist( psz_aes_list, sizeof(psz_aes_list), "aes", true );
+    p_res[n++] = (test_http_resource_t){ "/plain.m3u8", psz_plain_list,
+                                         strlen( psz_plain_list ), 0 };
+    p_res[n++] = (test_http_resource_t){ "/aes.m3u8", psz_aes_list,
+                                         strlen( psz_aes_list ), 0 };
+    p_res[n++] = (test_http_resource_t){ "/" KEY_NAME, key, sizeof(key), 0 };
+
+    /* Earlier segments take longer to come, so that several download
+     * threads complete them out of order */
+    for( int i = 0; i < SEGMENTS; i++ )
+    {
+        const mtime_t i_delay = (2 - i % 3) * 30000;
+
+        snprintf( psz_paths[2 * i], sizeof(psz_paths[0]), "/plain-%d.ts", i );
+        snprintf( psz_paths[2 * i + 1], sizeof(psz_paths[0]), "/aes-%d.ts", i );
+        p_res[n++] = (test_http_resource_t){ psz_paths[2 * i],
+            &plain[i * SEGMENT_SIZE], SEGMENT_SIZE, i_delay };
+        p_res[n++] = (test_http_resource_t){ psz_paths[2 * i + 1],
+            encrypted[i], i_encrypted, i_delay };
+    }
+    return n;
+}
+
+/* Compares what the demuxdump demux wrote with the plain segments */
+static int CheckDump( const char *psz_dump )
+{
+    static uint8_t dump[sizeof(plain) + 1];
+    FILE *p_file = fopen( psz_dump, "rb" );
+    assert( p_file != NULL );
+    size_t i_dump = fread( dump, 1, sizeof(dump), p_file );
+    fclose( p_file );
+
+    if( i_dump != sizeof(plain) )
+    {
+        log( "dumped %zu bytes instead of %zu\n", i_dump, sizeof(plain) );
+        return 1;
+    }
+    for( size_t i = 0; i < i_dump; i++ )
+        if( dump[i] != plain[i] )
+        {
+            log( "dump differs at byte %zu (segment %zu)\n", i,
+                 i / SEGMENT_SIZE );
+            return 1;
+        }
+    return 0;
+}
+
+static int test_play( int i_port, const char *psz_list, int i_threads )
+{
+    char psz_dump[] = "/tmp/vlc-test-httplive-XXXXXX";
+    int fd = mkstemp( psz_dump );
+    assert( fd >= 0 );
+    close( fd );
+
+    char psz_threads[32], psz_file[64], psz_url[64];
+    snprintf( psz_threads, sizeof(psz_threads), "--hls-threads=%d",
+              i_threads );
+    snprintf( psz_file, sizeof(psz_file), "--demuxdump-file=%s", psz_dump );
+    snprintf( psz_url, sizeof(psz_url), "http://127.0.0.1:%d%s",
+              i_port, psz_list );
+
+    const char *argv[test_defaults_nargs + 3];
+    for( int i = 0; i < test_defaults_nargs; i++ )
+        argv[i] = test_defaults_args[i];
+    argv[test_defaults_nargs] = psz_threads;
+    argv[test_defaults_nargs + 1] = "--demux=demuxdump";
+    argv[test_defaults_nargs + 2] = psz_file;
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs + 3, argv );
+    assert( p_vlc != NULL );
+    if( !module_exists( "httplive" ) || !module_exists( "http" ) )
+    {
+        libvlc_release( p_vlc );
+        unlink( psz_dump );
+        return 77;
+    }
+
+    libvlc_media_t *p_media = libvlc_media_new_location( p_vlc, psz_url );
+    assert( p_media != NULL );
+    libvlc_media_player_t *p_mp = libvlc_media_player_new_from_media( p_media );
+    assert( p_mp != NULL );
+
+    mtime_t i_start = mdate();
+    libvlc_media_player_play( p_mp );
+    libvlc_state_t state;
+    while( ( state = libvlc_media_player_get_state( p_mp ) ) != libvlc_Ended
+        && state != libvlc_Error )
+        usleep( 10000 );
+    log( "%s with %d thread(s): %s in %"PRId64" ms\n", psz_list, i_threads,
+         state == libvlc_Ended ? "ended" : "failed",
+         ( mdate() - i_start ) / 1000 );
+
+    /* Stopping closes the dump file */
+    libvlc_media_player_stop( p_mp );
+    libvlc_media_player_release( p_mp );
+    libvlc_media_release( p_media );
+    libvlc_release( p_vlc );
+
+    int i_ret = state == libvlc_Ended ? CheckDump( psz_dump ) : 1;
+    unlink( psz_dump );
+    return i_ret;
+}
+
+int main( void )
+{
+    test_init();
+
+    vlc_gcrypt_init();
+    MakeSegments();
+    EncryptSegments();
+
+    test_http_resource_t res[3 + 2 * SEGMENTS];
+    test_http_server_t srv;
+    assert( TestHttpStart( &srv, res, MakeResources( res ) ) == VLC_SUCCESS );
+
+    int i_ret = test_play( srv.i_port, "/plain.m3u8", 1 );
+    if( i_ret == 77 )
+    {
+        log( "httplive or http plugin not found, skipping\n" );
+    }
+    else
+    {
+        i_ret |= test_play( srv.i_port, "/plain.m3u8", 3 );
+        i_ret |= test_play( srv.i_port, "/aes.m3u8", 1 );
+        i_ret |= test_play( srv.i_port, "/aes.m3u8", 3 );
+        log( "%u requests served\n", atomic_load( &srv.i_requests ) );
+    }
+
+    TestHttpStop( &srv );
+    for( int i = 0; i < SEGMENTS; i++ )
+        free( encrypted[i] );
+    return i_ret;
+}
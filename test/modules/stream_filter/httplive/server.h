@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * server.h: local HTTP server standing in for an HLS origin
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef TEST_HTTPLIVE_SERVER_H
+#define TEST_HTTPLIVE_SERVER_H
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+
+/* Connections served at once, enough for several download threads */
+#define TEST_HTTP_THREADS (6)
+
+/* Served from memory, under a fixed path */
+typedef struct
+{
+    const char *psz_path;
+    const void *p_data;
+    size_t      i_data;
+    mtime_t     i_delay;    /* before the response, to reorder downloads */
+} test_http_resource_t;
+
+typedef struct
+{
+    int          fd;
+    int          i_port;
+    const test_http_resource_t *p_res;
+    unsigned     i_res;
+    atomic_bool  b_stop;
+    atomic_uint  i_requests;
+    vlc_thread_t threads[TEST_HTTP_THREADS];
+} test_http_server_t;
+
+static void TestHttpSend( int fd, const void *p_data, size_t i_data )
+{
+    const uint8_t *p = p_data;
+
+    while( i_data > 0 )
+    {
+        ssize_t val = send( fd, p, i_data, MSG_NOSIGNAL );
+        if( val <= 0 )
+        {
+            if( val < 0 && errno == EINTR )
+                continue;
+            return; /* the client went away */
+        }
+        p += val;
+        i_data -= val;
+    }
+}
+
+/* Serves one request, then closes the connection */
+static void TestHttpServe( test_http_server_t *p_srv, int fd )
+{
+    char psz_req[4096];
+    size_t i_req = 0;
+
+    /* Headers only: the requests have no body */
+    while( i_req < sizeof(psz_req) - 1 )
+    {
+        ssize_t val = recv( fd, &psz_req[i_req], sizeof(psz_req) - 1 - i_req,
+                            0 );
+        if( val <= 0 )
+            return;
+        i_req += val;
+        psz_req[i_req] = '\0';
+        if( strstr( psz_req, "\r\n\r\n" ) != NULL )
+            break;
+    }
+
+    char psz_method[8], psz_path[256];
+    if( sscanf( psz_req, "%7s %255s HTTP/1.", psz_method, psz_path ) != 2 )
+        return;
+    atomic_fetch_add( &p_srv->i_requests, 1 );
+
+    const test_http_resource_t *p_res = NULL;
+    for( unsigned i = 0; i < p_srv->i_res; i++ )
+        if( !strcmp( p_srv->p_res[i].psz_path, psz_path ) )
+            p_res = &p_srv->p_res[i];
+
+    char psz_hdr[256];
+    if( p_res == NULL )
+    {
+        static const char psz_404[] = "HTTP/1.1 404 Not Found\r\n"
+            "Content-Length: 0\r\nConnection: close\r\n\r\n";
+        TestHttpSend( fd, psz_404, strlen( psz_404 ) );
+        return;
+    }
+
+    if( p_res->i_delay > 0 )
+        msleep( p_res->i_delay );
+
+    /* Open ended ranges, as asked when resuming or seeking */
+    unsigned long long i_start = 0;
+    const char *psz_range = strcasestr( psz_req, "\r\nRange: bytes=" );
+    if( psz_range != NULL )
+        i_start = strtoull( psz_range + 15, NULL, 10 );
+    if( i_start > p_res->i_data )
+        i_start = p_res->i_data;
+
+    if( psz_range != NULL )
+        snprintf( psz_hdr, sizeof(psz_hdr), "HTTP/1.1 206 Partial Content\r\n"
+                  "Content-Range: bytes %llu-%zu/%zu\r\n"
+                  "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                  i_start, p_res->i_data - 1, p_res->i_data,
+                  p_res->i_data - (size_t)i_start );
+    else
+        snprintf( psz_hdr, sizeof(psz_hdr), "HTTP/1.1 200 OK\r\n"
+                  "Accept-Ranges: bytes\r\n"
+                  "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                  p_res->i_data );
+    TestHttpSend( fd, psz_hdr, strlen( psz_hdr ) );
+    if( strcmp( psz_method, "HEAD" ) )
+        TestHttpSend( fd, (const uint8_t *)p_res->p_data + i_start,
+                      p_res->i_data - i_start );
+}
+
+static void *TestHttpThread( void *data )
+{
+    test_http_server_t *p_srv = data;
+
+    while( !atomic_load( &p_srv->b_stop ) )
+    {
+        struct pollfd ufd = { .fd = p_srv->fd, .events = POLLIN };
+        if( poll( &ufd, 1, 50 ) <= 0 )
+            continue;
+
+        /* Another thread may have taken the connection */
+        int fd = accept( p_srv->fd, NULL, NULL );
+        if( fd == -1 )
+            continue;
+        fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) & ~O_NONBLOCK );
+
+        TestHttpServe( p_srv, fd );
+        shutdown( fd, SHUT_WR );
+        close( fd );
+    }
+    return NULL;
+}
+
+/* Listens on a free loopback port */
+static int TestHttpStart( test_http_server_t *p_srv,
+                          const test_http_resource_t *p_res, unsigned i_res )
+{
+    struct sockaddr_in addr;
+    socklen_t i_addr = sizeof(addr);
+
+    p_srv->p_res = p_res;
+    p_srv->i_res = i_res;
+    atomic_init( &p_srv->b_stop, false );
+    atomic_init( &p_srv->i_requests, 0 );
+
+    p_srv->fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if( p_srv->fd == -1 )
+        return VLC_EGENERIC;
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    if( bind( p_srv->fd, (struct sockaddr *)&addr, sizeof(addr) )
+     || listen( p_srv->fd, 16 )
+     || getsockname( p_srv->fd, (struct sockaddr *)&addr, &i_addr ) )
+    {
+        close( p_srv->fd );
+        return VLC_EGENERIC;
+    }
+    p_srv->i_port = ntohs( addr.sin_port );
+    fcntl( p_srv->fd, F_SETFL, fcntl( p_srv->fd, F_GETFL ) | O_NONBLOCK );
+
+    for( int i = 0; i < TEST_HTTP_THREADS; i++ )
+        if( vlc_clone( &p_srv->threads[i], TestHttpThread, p_srv,
+                       VLC_THREAD_PRIORITY_LOW ) )
+            abort();
+    return VLC_SUCCESS;
+}
+
+static void TestHttpStop( test_http_server_t *p_srv )
+{
+    atomic_store( &p_srv->b_stop, true );
+    for( int i = 0; i < TEST_HTTP_THREADS; i++ )
+        vlc_join( p_srv->threads[i], NULL );
+    close( p_srv->fd );
+}
+
+#endif
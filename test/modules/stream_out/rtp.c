@@ -0,0 +1,315 @@
+/*****************************************************************************
+ * rtp.c: RTP stream output loopback benchmark
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Streams synthetic H.264 to a loopback socket, as RTP H.264 and as RTP
+ * MPEG-TS, with all packets due at once, and prints the sending rate. Checks
+ * that no packet is lost, that the H.264 stream depacketizes to what was
+ * sent, and that the MPEG-TS packets are whole. Exits with 77 (skipped) if
+ * the RTP stream output is not built. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+
+#include <vlc_common.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+#include <vlc_atomic.h>
+
+#define FRAMES      (250)
+#define FRAME_SIZE  (40000)
+#define FPS         (25)
+#define IDLE        (CLOCK_FREQ / 2) /* no more packets coming */
+
+typedef struct
+{
+    int         fd;
+    bool        b_ts;
+    atomic_bool b_stop;
+
+    /* Received packets */
+    unsigned    i_packets;
+    unsigned    i_lost;
+    uint64_t    i_bytes;
+    int         i_seq;
+    mtime_t     i_first;
+    mtime_t     i_last;
+    bool        b_broken;
+
+    /* Depacketized H.264 */
+    uint8_t    *p_es;
+    size_t      i_es;
+} receiver_t;
+
+static void Append( receiver_t *p_recv, const uint8_t *p_data, size_t i_data )
+{
+    p_recv->p_es = realloc( p_recv->p_es, p_recv->i_es + i_data );
+    assert( p_recv->p_es != NULL );
+    memcpy( &p_recv->p_es[p_recv->i_es], p_data, i_data );
+    p_recv->i_es += i_data;
+}
+
+static void Receive( receiver_t *p_recv, const uint8_t *p_pkt, size_t i_pkt )
+{
+    static const uint8_t startcode[3] = { 0, 0, 1 };
+
+    if( i_pkt < 12 || (p_pkt[0] >> 6) != 2 )
+    {
+        p_recv->b_broken = true;
+        return;
+    }
+
+    int i_seq = GetWBE( &p_pkt[2] );
+    if( p_recv->i_seq >= 0 )
+        p_recv->i_lost += (i_seq - p_recv->i_seq - 1) & 0xffff;
+    p_recv->i_seq = i_seq;
+    p_pkt += 12;
+    i_pkt -= 12;
+
+    if( p_recv->b_ts )
+    {
+        /* Whole TS packets only */
+        if( i_pkt % 188 )
+            p_recv->b_broken = true;
+        for( size_t i = 0; i < i_pkt; i += 188 )
+            if( p_pkt[i] != 0x47 )
+                p_recv->b_broken = true;
+        return;
+    }
+
+    if( i_pkt < 2 )
+    {
+        p_recv->b_broken = true;
+        return;
+    }
+    if( (p_pkt[0] & 0x1f) != 28 )
+    {
+        /* Single NAL unit */
+        Append( p_recv, startcode, 3 );
+        Append( p_recv, p_pkt, i_pkt );
+        return;
+    }
+
+    /* FU-A: the first fragment restores the NAL unit header */
+    if( p_pkt[1] & 0x80 )
+    {
+        uint8_t i_hdr = (p_pkt[0] & 0xe0) | (p_pkt[1] & 0x1f);
+        Append( p_recv, startcode, 3 );
+        Append( p_recv, &i_hdr, 1 );
+    }
+    Append( p_recv, p_pkt + 2, i_pkt - 2 );
+}
+
+static void *ReceiveThread( void *data )
+{
+    receiver_t *p_recv = data;
+    uint8_t p_pkt[65536];
+
+    while( !atomic_load( &p_recv->b_stop ) )
+    {
+        struct pollfd ufd = { .fd = p_recv->fd, .events = POLLIN };
+        if( poll( &ufd, 1, 50 ) <= 0 )
+            continue;
+
+        ssize_t i_pkt = recv( p_recv->fd, p_pkt, sizeof(p_pkt), 0 );
+        if( i_pkt <= 0 )
+            continue;
+
+        p_recv->i_last = mdate();
+        if( p_recv->i_packets++ == 0 )
+            p_recv->i_first = p_recv->i_last;
+        p_recv->i_bytes += i_pkt;
+        Receive( p_recv, p_pkt, i_pkt );
+    }
+    return NULL;
+}
+
+/* One NAL unit per frame, without start code emulation */
+static block_t *NewFrame( int i_frame, unsigned *pi_seed )
+{
+    block_t *p_block = block_Alloc( FRAME_SIZE );
+    assert( p_block != NULL );
+
+    p_block->p_buffer[0] = 0;
+    p_block->p_buffer[1] = 0;
+    p_block->p_buffer[2] = 1;
+    p_block->p_buffer[3] = i_frame % 12 ? 0x41 : 0x65;
+    for( size_t i = 4; i < FRAME_SIZE; i++ )
+    {
+        *pi_seed = *pi_seed * 1103515245 + 12345;
+        p_block->p_buffer[i] = 1 + (*pi_seed >> 16) % 255;
+    }
+    return p_block;
+}
+
+/* The frames are dated in the past, so the muxer warns for each one */
+static void LogCallback( void *p_data, int i_level, const libvlc_log_t *p_ctx,
+                         const char *psz_fmt, va_list args )
+{
+    (void) p_data; (void) p_ctx;
+    if( i_level == LIBVLC_ERROR )
+    {
+        vfprintf( stderr, psz_fmt, args );
+        fputc( '\n', stderr );
+    }
+}
+
+static int bench_rtp( vlc_object_t *p_parent, bool b_ts )
+{
+    receiver_t recv;
+    memset( &recv, 0, sizeof(recv) );
+    recv.b_ts = b_ts;
+    recv.i_seq = -1;
+    atomic_init( &recv.b_stop, false );
+
+    /* Large enough to hold the whole stream, not to measure the reader */
+    recv.fd = net_ListenUDP1( p_parent, "127.0.0.1", 0 );
+    assert( recv.fd != -1 );
+    int i_rcvbuf = 64 << 20;
+    if( setsockopt( recv.fd, SOL_SOCKET, SO_RCVBUFFORCE, &i_rcvbuf,
+                    sizeof(i_rcvbuf) ) )
+        setsockopt( recv.fd, SOL_SOCKET, SO_RCVBUF, &i_rcvbuf,
+                    sizeof(i_rcvbuf) );
+
+    struct sockaddr_storage addr;
+    socklen_t i_addr = sizeof(addr);
+    assert( getsockname( recv.fd, (struct sockaddr *)&addr, &i_addr ) == 0 );
+    const int i_port = ntohs( ((struct sockaddr_in *)&addr)->sin_port );
+
+    sout_instance_t *p_sout = vlc_object_create( p_parent, sizeof(*p_sout) );
+    assert( p_sout != NULL );
+    p_sout->psz_sout = NULL;
+    p_sout->i_out_pace_nocontrol = 0;
+    p_sout->p_stream = NULL;
+    vlc_mutex_init( &p_sout->lock );
+    var_Create( p_sout, "sout-mux-caching", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT );
+
+    char *psz_chain;
+    assert( asprintf( &psz_chain, "rtp{dst=127.0.0.1,port=%d,caching=0%s}",
+                      i_port, b_ts ? ",mux=ts" : "" ) >= 0 );
+    sout_stream_t *p_stream = sout_StreamChainNew( p_sout, psz_chain,
+                                                   NULL, NULL );
+    if( p_stream == NULL )
+    {
+        free( psz_chain );
+        vlc_mutex_destroy( &p_sout->lock );
+        vlc_object_release( p_sout );
+        net_Close( recv.fd );
+        return 77;
+    }
+
+    es_format_t fmt;
+    es_format_Init( &fmt, VIDEO_ES, VLC_CODEC_H264 );
+    fmt.video.i_width = fmt.video.i_visible_width = 1280;
+    fmt.video.i_height = fmt.video.i_visible_height = 720;
+    sout_stream_id_t *id = sout_StreamIdAdd( p_stream, &fmt );
+    assert( id != NULL );
+
+    vlc_thread_t thread;
+    assert( vlc_clone( &thread, ReceiveThread, &recv,
+                       VLC_THREAD_PRIORITY_LOW ) == 0 );
+
+    /* The frames are built first, so that only the RTP output is timed.
+     * They are all dated in the past, so that they are due at once. */
+    uint8_t *p_sent = malloc( FRAMES * FRAME_SIZE );
+    block_t *pp_frames[FRAMES];
+    unsigned i_seed = 0;
+    const mtime_t i_start = mdate() - 2 * FRAMES * CLOCK_FREQ / FPS;
+    assert( p_sent != NULL );
+    for( int i = 0; i < FRAMES; i++ )
+    {
+        pp_frames[i] = NewFrame( i, &i_seed );
+        pp_frames[i]->i_dts = pp_frames[i]->i_pts =
+            i_start + i * CLOCK_FREQ / FPS;
+        pp_frames[i]->i_length = CLOCK_FREQ / FPS;
+        if( i % 12 == 0 )
+            pp_frames[i]->i_flags |= BLOCK_FLAG_TYPE_I;
+        memcpy( &p_sent[i * FRAME_SIZE], pp_frames[i]->p_buffer, FRAME_SIZE );
+    }
+
+    mtime_t i_begin = mdate();
+    for( int i = 0; i < FRAMES; i++ )
+        sout_StreamIdSend( p_stream, id, pp_frames[i] );
+    mtime_t i_queued = mdate() - i_begin;
+
+    /* Wait for the sender to be done */
+    for( ;; )
+    {
+        msleep( IDLE / 5 );
+        if( recv.i_packets > 0 && mdate() - recv.i_last > IDLE )
+            break;
+        if( recv.i_packets == 0 && mdate() - i_begin > 5 * CLOCK_FREQ )
+            break;
+    }
+    atomic_store( &recv.b_stop, true );
+    vlc_join( thread, NULL );
+
+    const mtime_t i_time = __MAX( recv.i_last - i_begin, 1 );
+    log( "%-8s %u packets, %.1f MB in %"PRId64" ms (%"PRId64" ms to queue): "
+         "%.0f packets/s, %u lost\n", b_ts ? "MPEG-TS" : "H.264",
+         recv.i_packets, recv.i_bytes / 1e6, i_time / 1000, i_queued / 1000,
+         recv.i_packets * (double)CLOCK_FREQ / i_time, recv.i_lost );
+
+    int i_ret = 0;
+    if( recv.i_packets == 0 || recv.i_lost > 0 || recv.b_broken )
+        i_ret = 1;
+    if( !b_ts && ( recv.i_es != FRAMES * FRAME_SIZE ||
+                   memcmp( recv.p_es, p_sent, recv.i_es ) ) )
+    {
+        log( "H.264 stream differs from what was sent\n" );
+        i_ret = 1;
+    }
+
+    sout_StreamIdDel( p_stream, id );
+    sout_StreamChainDelete( p_stream, NULL );
+    es_format_Clean( &fmt );
+    free( psz_chain );
+    free( p_sent );
+    free( recv.p_es );
+    net_Close( recv.fd );
+    vlc_mutex_destroy( &p_sout->lock );
+    vlc_object_release( p_sout );
+    return i_ret;
+}
+
+int main( void )
+{
+    test_init();
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+    libvlc_log_set( p_vlc, LogCallback, NULL );
+
+    int i_ret = bench_rtp( VLC_OBJECT(p_vlc->p_libvlc_int), false );
+    if( i_ret == 77 )
+    {
+        log( "RTP stream output not found, skipping\n" );
+    }
+    else
+        i_ret |= bench_rtp( VLC_OBJECT(p_vlc->p_libvlc_int), true );
+
+    libvlc_release( p_vlc );
+    return i_ret;
+}
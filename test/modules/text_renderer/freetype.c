@@ -0,0 +1,231 @@
+/*****************************************************************************
+ * freetype.c: benchmark of the freetype text renderer on ARIB captions
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Renders a corpus of Japanese captions, as carried by ARIB STD-B24, in
+ * various fonts with the glyph cache disabled and enabled, checks that both
+ * give the same regions and prints the rendering rate of both. The default
+ * font can be chosen with the VLC_TEST_FONT environment variable. Exits with
+ * 77 (skipped) if the freetype plugin is not built or finds no font. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_subpicture.h>
+#include <vlc_modules.h>
+
+#define PASSES (20)
+
+static const char *const captions[] =
+{
+    "♪～",
+    "（アナウンサー）こんばんは。７時のニュースです。",
+    "きょう午後、東京都内で\n震度４の揺れを観測しました。",
+    "この地震による津波の心配はありません。",
+    "（男性）えっ　本当に？",
+    "（女性）うん。　昨日　駅前で会ったの。",
+    "≪（拍手と歓声）",
+    "気象庁によりますと、\n震源地は千葉県北西部。",
+    "明日の天気は　晴れのち曇り。\n最高気温は２８℃の予想です。",
+    "［字幕スーパー］　第３話　「旅立ちの朝」",
+    "（ナレーター）江戸時代から続く\n老舗の味を守り続けて１５０年。",
+    "ＮＨＫ　総合　デジタル　０１１ｃｈ",
+    "ご覧のスポンサーの提供でお送りしました。",
+    "（子供たち）いただきます！",
+    "新幹線は上下線とも\n平常どおり運転しています。",
+    "→　詳しくはデータ放送で",
+};
+
+#define CAPTIONS (sizeof(captions) / sizeof(captions[0]))
+
+/* Captions switch fonts, more of them than the renderer keeps open */
+static const char *const families[] =
+{
+    NULL, "Sans", "Serif", "Monospace", "IPAGothic", "IPAMincho",
+    "IPAPGothic", "IPAPMincho", "TakaoGothic", "TakaoMincho", "VL Gothic",
+    "Noto Sans CJK JP", "Noto Serif CJK JP", "Source Han Sans JP",
+    "M+ 1p", "Kochi Gothic", "Kochi Mincho", "Sazanami Gothic",
+    "Sazanami Mincho", "Droid Sans Fallback", "UmePlus Gothic",
+    "Rounded M+ 1c", "Migu 1M", "DejaVu Sans",
+};
+
+#define FAMILIES (sizeof(families) / sizeof(families[0]))
+
+static filter_t *CreateRenderer( vlc_object_t *p_parent, int i_cache_size )
+{
+    filter_t *p_filter = vlc_object_create( p_parent, sizeof(*p_filter) );
+    if( !p_filter )
+        return NULL;
+
+    var_Create( p_filter, "freetype-cache-size", VLC_VAR_INTEGER );
+    var_SetInteger( p_filter, "freetype-cache-size", i_cache_size );
+
+    const char *psz_font = getenv( "VLC_TEST_FONT" );
+    if( psz_font )
+    {
+        var_Create( p_filter, "freetype-font", VLC_VAR_STRING );
+        var_SetString( p_filter, "freetype-font", psz_font );
+    }
+
+    es_format_Init( &p_filter->fmt_in, VIDEO_ES, 0 );
+    es_format_Init( &p_filter->fmt_out, VIDEO_ES, 0 );
+    p_filter->fmt_out.video.i_width =
+    p_filter->fmt_out.video.i_visible_width = 1920;
+    p_filter->fmt_out.video.i_height =
+    p_filter->fmt_out.video.i_visible_height = 1080;
+
+    var_Create( p_filter, "spu-elapsed", VLC_VAR_TIME );
+    var_Create( p_filter, "text-rerender", VLC_VAR_BOOL );
+
+    p_filter->p_module = module_need( p_filter, "text renderer", "freetype", true );
+    if( !p_filter->p_module )
+    {
+        vlc_object_release( p_filter );
+        return NULL;
+    }
+    return p_filter;
+}
+
+static void DeleteRenderer( filter_t *p_filter )
+{
+    module_unneed( p_filter, p_filter->p_module );
+    es_format_Clean( &p_filter->fmt_in );
+    es_format_Clean( &p_filter->fmt_out );
+    vlc_object_release( p_filter );
+}
+
+static subpicture_region_t *Render( filter_t *p_filter, const char *psz_text,
+                                    const char *psz_family )
+{
+    static const vlc_fourcc_t p_chroma_list[] = {
+        VLC_CODEC_YUVA, VLC_CODEC_RGBA, 0
+    };
+    video_format_t fmt;
+
+    video_format_Init( &fmt, VLC_CODEC_TEXT );
+    subpicture_region_t *p_region = subpicture_region_New( &fmt );
+    assert( p_region != NULL );
+    p_region->psz_text = strdup( psz_text );
+    assert( p_region->psz_text != NULL );
+    if( psz_family )
+    {
+        p_region->p_style = text_style_New();
+        assert( p_region->p_style != NULL );
+        p_region->p_style->psz_fontname = strdup( psz_family );
+    }
+
+    int i_ret = p_filter->pf_render_text( p_filter, p_region, p_region,
+                                          p_chroma_list );
+    assert( i_ret == VLC_SUCCESS );
+    assert( p_region->p_picture != NULL );
+    return p_region;
+}
+
+static bool SameRegions( const subpicture_region_t *p_a,
+                         const subpicture_region_t *p_b )
+{
+    if( p_a->fmt.i_chroma != p_b->fmt.i_chroma ||
+        p_a->fmt.i_visible_width != p_b->fmt.i_visible_width ||
+        p_a->fmt.i_visible_height != p_b->fmt.i_visible_height )
+        return false;
+
+    const picture_t *p_pa = p_a->p_picture, *p_pb = p_b->p_picture;
+    for( int n = 0; n < p_pa->i_planes; n++ )
+    {
+        const plane_t *a = &p_pa->p[n];
+        const plane_t *b = &p_pb->p[n];
+        for( int y = 0; y < a->i_visible_lines; y++ )
+            if( memcmp( &a->p_pixels[y * a->i_pitch],
+                        &b->p_pixels[y * b->i_pitch], a->i_visible_pitch ) )
+                return false;
+    }
+    return true;
+}
+
+/* Renders the corpus PASSES times, keeps the regions of the last pass and
+ * returns the rendering time */
+static mtime_t RenderCorpus( filter_t *p_filter, subpicture_region_t **pp_regions )
+{
+    mtime_t i_start = mdate();
+    for( int i_pass = 0; i_pass < PASSES; i_pass++ )
+        for( size_t i = 0; i < CAPTIONS; i++ )
+        {
+            if( pp_regions[i] )
+                subpicture_region_Delete( pp_regions[i] );
+            pp_regions[i] = Render( p_filter, captions[i],
+                                    families[(i_pass * CAPTIONS + i) % FAMILIES] );
+        }
+    return mdate() - i_start;
+}
+
+static int test_captions( vlc_object_t *p_parent )
+{
+    filter_t *p_uncached = CreateRenderer( p_parent, 0 );
+    if( !p_uncached )
+        return 77;
+    filter_t *p_cached = CreateRenderer( p_parent, 4096 );
+    assert( p_cached != NULL );
+
+    subpicture_region_t *pp_uncached[CAPTIONS] = { NULL };
+    subpicture_region_t *pp_cached[CAPTIONS] = { NULL };
+
+    const mtime_t i_uncached = RenderCorpus( p_uncached, pp_uncached );
+    const mtime_t i_cached = RenderCorpus( p_cached, pp_cached );
+
+    log( "%u captions: %.1f renders/s uncached, %.1f renders/s cached\n",
+         (unsigned)CAPTIONS,
+         PASSES * CAPTIONS * (double)CLOCK_FREQ / __MAX( i_uncached, 1 ),
+         PASSES * CAPTIONS * (double)CLOCK_FREQ / __MAX( i_cached, 1 ) );
+
+    int i_ret = 0;
+    for( size_t i = 0; i < CAPTIONS; i++ )
+    {
+        if( !SameRegions( pp_uncached[i], pp_cached[i] ) )
+        {
+            log( "caption %u differs\n", (unsigned)i );
+            i_ret = 1;
+        }
+        subpicture_region_Delete( pp_uncached[i] );
+        subpicture_region_Delete( pp_cached[i] );
+    }
+
+    DeleteRenderer( p_uncached );
+    DeleteRenderer( p_cached );
+    return i_ret;
+}
+
+int main( void )
+{
+    test_init();
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+
+    int i_ret = test_captions( VLC_OBJECT(p_vlc->p_libvlc_int) );
+    if( i_ret == 77 )
+        log( "freetype plugin or font not found, skipping\n" );
+
+    libvlc_release( p_vlc );
+    return i_ret;
+}
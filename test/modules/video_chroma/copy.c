@@ -0,0 +1,250 @@
+/*****************************************************************************
+ * copy.c: test and benchmark of the hardware surface readback copies
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Copies synthetic NV12 and YV12 surfaces from ordinary memory with the
+ * SSE2, SSSE3, SSE4.1 and AVX2 code paths enabled in turn, to aligned and
+ * unaligned pictures, with and without the helper thread. Checks that the
+ * result matches the plain C copy and prints the copy rate of each path.
+ * Paths not supported by the CPU are skipped. */
+
+#include "../../libvlc/test.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "../../../modules/video_chroma/copy.c"
+
+#ifdef CAN_COMPILE_SSE2
+
+#define FRAMES (20)
+
+typedef struct
+{
+    const char *psz_name;
+    unsigned    i_cpu;
+} cpu_path_t;
+
+static const cpu_path_t paths[] =
+{
+    { "SSE2",   VLC_CPU_SSE2 },
+    { "SSSE3",  VLC_CPU_SSE2 | VLC_CPU_SSSE3 },
+    { "SSE4.1", VLC_CPU_SSE2 | VLC_CPU_SSSE3 | VLC_CPU_SSE4_1 },
+    { "AVX2",   VLC_CPU_SSE2 | VLC_CPU_SSSE3 | VLC_CPU_SSE4_1 | VLC_CPU_AVX2 },
+};
+
+static const struct
+{
+    unsigned i_width;
+    unsigned i_height;
+} sizes[] =
+{
+    { 1920, 1088 }, { 1280, 720 }, { 720, 576 }, { 1366, 768 }, { 350, 240 },
+};
+
+/* Surface as mapped from the GPU, with its padded pitches */
+typedef struct
+{
+    uint8_t *p_buffer;
+    uint8_t *pp_plane[3];
+    size_t   pi_pitch[3];
+    int      i_planes;
+} surface_t;
+
+static void SurfaceInit( surface_t *p_surface, bool b_nv12,
+                         unsigned i_width, unsigned i_height, unsigned i_seed )
+{
+    const size_t i_pitch = (i_width + 127) & ~63;
+    const size_t i_luma = i_pitch * i_height;
+
+    p_surface->p_buffer = vlc_memalign( 64, 2 * i_luma );
+    assert( p_surface->p_buffer != NULL );
+    for( size_t i = 0; i < 2 * i_luma; i++ )
+    {
+        i_seed = i_seed * 1103515245 + 12345;
+        p_surface->p_buffer[i] = i_seed >> 16;
+    }
+
+    p_surface->i_planes = b_nv12 ? 2 : 3;
+    p_surface->pp_plane[0] = p_surface->p_buffer;
+    p_surface->pi_pitch[0] = i_pitch;
+    p_surface->pp_plane[1] = p_surface->p_buffer + i_luma;
+    p_surface->pi_pitch[1] = b_nv12 ? i_pitch : i_pitch / 2;
+    p_surface->pp_plane[2] = p_surface->pp_plane[1] + i_luma / 2;
+    p_surface->pi_pitch[2] = i_pitch / 2;
+}
+
+/* YV12 picture, with planes and pitches 16 bytes aligned or not */
+static void PictureInit( picture_t *p_pic, uint8_t **pp_buffer, bool b_aligned,
+                         unsigned i_width, unsigned i_height )
+{
+    const unsigned i_offset = b_aligned ? 0 : 1;
+    const unsigned pi_pitch[3] = {
+        ((i_width + 31) & ~15) + i_offset,
+        ((i_width / 2 + 31) & ~15) + i_offset,
+        ((i_width / 2 + 31) & ~15) + i_offset,
+    };
+    const unsigned pi_lines[3] = { i_height, i_height / 2, i_height / 2 };
+
+    size_t i_size = 0;
+    for( int n = 0; n < 3; n++ )
+        i_size += pi_pitch[n] * pi_lines[n] + 16;
+    *pp_buffer = vlc_memalign( 16, i_size );
+    assert( *pp_buffer != NULL );
+    memset( *pp_buffer, 0, i_size );
+
+    memset( p_pic, 0, sizeof(*p_pic) );
+    p_pic->i_planes = 3;
+    uint8_t *p = *pp_buffer;
+    for( int n = 0; n < 3; n++ )
+    {
+        p_pic->p[n].p_pixels = p + i_offset;
+        p_pic->p[n].i_pitch = pi_pitch[n];
+        p_pic->p[n].i_lines = pi_lines[n];
+        p_pic->p[n].i_visible_lines = pi_lines[n];
+        p_pic->p[n].i_visible_pitch = n == 0 ? i_width : i_width / 2;
+        p += (pi_pitch[n] * pi_lines[n] + 15 + i_offset) & ~15;
+    }
+}
+
+/* Plain C copy, as done without SSE2 */
+static void CopyReference( picture_t *p_dst, const surface_t *p_src,
+                           unsigned i_width, unsigned i_height )
+{
+    CopyPlane( p_dst->p[0].p_pixels, p_dst->p[0].i_pitch,
+               p_src->pp_plane[0], p_src->pi_pitch[0], i_width, i_height );
+    if( p_src->i_planes == 2 )
+        SplitPlanes( p_dst->p[2].p_pixels, p_dst->p[2].i_pitch,
+                     p_dst->p[1].p_pixels, p_dst->p[1].i_pitch,
+                     p_src->pp_plane[1], p_src->pi_pitch[1],
+                     i_width / 2, i_height / 2 );
+    else
+        for( int n = 1; n < 3; n++ )
+            CopyPlane( p_dst->p[n].p_pixels, p_dst->p[n].i_pitch,
+                       p_src->pp_plane[n], p_src->pi_pitch[n],
+                       i_width / 2, i_height / 2 );
+}
+
+static bool SamePictures( const picture_t *p_a, const picture_t *p_b )
+{
+    for( int n = 0; n < 3; n++ )
+        for( int y = 0; y < p_a->p[n].i_visible_lines; y++ )
+            if( memcmp( &p_a->p[n].p_pixels[y * p_a->p[n].i_pitch],
+                        &p_b->p[n].p_pixels[y * p_b->p[n].i_pitch],
+                        p_a->p[n].i_visible_pitch ) )
+            {
+                log( "plane %d differs at row %d\n", n, y );
+                return false;
+            }
+    return true;
+}
+
+static int test_copy( const cpu_path_t *p_path, bool b_nv12,
+                      unsigned i_width, unsigned i_height,
+                      bool b_aligned, bool b_worker )
+{
+    surface_t surface;
+    SurfaceInit( &surface, b_nv12, i_width, i_height, i_width ^ i_height );
+
+    picture_t ref, dst;
+    uint8_t *p_ref_buffer, *p_dst_buffer;
+    PictureInit( &ref, &p_ref_buffer, true, i_width, i_height );
+    PictureInit( &dst, &p_dst_buffer, b_aligned, i_width, i_height );
+    CopyReference( &ref, &surface, i_width, i_height );
+
+    copy_cache_t cache;
+    int i_ret = CopyInitCache( &cache, i_width );
+    assert( i_ret == VLC_SUCCESS );
+    assert( cache.worker == NULL ); /* only started by the copies */
+    if( b_worker )
+    {
+        /* Started whatever the number of CPUs */
+        cache.worker = CopyWorkerNew( cache.size );
+        assert( cache.worker != NULL );
+    }
+    cache.worker_tried = true;
+
+    mtime_t i_start = mdate();
+    for( int i = 0; i < FRAMES; i++ )
+    {
+        if( b_nv12 )
+            SSE_CopyFromNv12( &dst, surface.pp_plane, surface.pi_pitch,
+                              i_width, i_height, &cache, p_path->i_cpu );
+        else
+            SSE_CopyFromYv12( &dst, surface.pp_plane, surface.pi_pitch,
+                              i_width, i_height, &cache, p_path->i_cpu );
+    }
+    mtime_t i_duration = mdate() - i_start;
+
+    i_ret = 0;
+    if( !SamePictures( &ref, &dst ) )
+        i_ret = 1;
+
+    log( "%s %s %ux%u %s%s: %.1f fps%s\n", p_path->psz_name,
+         b_nv12 ? "NV12" : "YV12", i_width, i_height,
+         b_aligned ? "aligned" : "unaligned",
+         b_worker ? " with helper" : "",
+         FRAMES * (double)CLOCK_FREQ / __MAX( i_duration, 1 ),
+         i_ret ? ", MISMATCH" : "" );
+
+    CopyCleanCache( &cache );
+    vlc_free( p_ref_buffer );
+    vlc_free( p_dst_buffer );
+    vlc_free( surface.p_buffer );
+    return i_ret;
+}
+
+int main( void )
+{
+    test_init();
+
+    const unsigned i_cpu = vlc_CPU();
+    int i_ret = 0;
+
+    for( size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++ )
+    {
+        if( (paths[p].i_cpu & i_cpu) != paths[p].i_cpu )
+        {
+            log( "%s not supported by the CPU, skipping\n", paths[p].psz_name );
+            continue;
+        }
+
+        for( size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ )
+            for( int i_mode = 0; i_mode < 8; i_mode++ )
+                if( test_copy( &paths[p], i_mode & 1,
+                               sizes[s].i_width, sizes[s].i_height,
+                               i_mode & 2, i_mode & 4 ) )
+                    i_ret = 1;
+    }
+    return i_ret;
+}
+
+#else
+
+int main( void )
+{
+    test_init();
+    log( "SSE2 not supported by the compiler, skipping\n" );
+    return 77;
+}
+
+#endif
@@ -0,0 +1,259 @@
+/*****************************************************************************
+ * swscale.c: test and benchmark of the swscale chroma converter
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Converts the same pictures with one thread and with several threads,
+ * checks that the latter did split them into bands when expected, that the
+ * results are identical and prints the conversion rate of both. Exits with
+ * 77 (skipped) if the swscale plugin is not built. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include <vlc_modules.h>
+
+#define FRAMES (10)
+
+typedef struct
+{
+    vlc_fourcc_t i_src_chroma;
+    unsigned     i_src_width;
+    unsigned     i_src_height;
+    vlc_fourcc_t i_dst_chroma;
+    unsigned     i_dst_width;
+    unsigned     i_dst_height;
+    int          i_mode;
+    bool         b_banded;
+} conversion_t;
+
+static const conversion_t conversions[] =
+{
+    { VLC_CODEC_I420, 1920, 1080, VLC_CODEC_RGB32, 1920, 1080, 2, true },
+    { VLC_CODEC_I420, 1920, 1080, VLC_CODEC_I420,  1280,  720, 2, true },
+    { VLC_CODEC_I420, 1920, 1080, VLC_CODEC_I420,   960,  540, 0, true },
+    { VLC_CODEC_I420,  960,  540, VLC_CODEC_YUYV,  1920, 1080, 4, true },
+    { VLC_CODEC_YUYV, 1280,  720, VLC_CODEC_I420,  1280,  720, 1, true },
+    { VLC_CODEC_I422, 1920, 1080, VLC_CODEC_NV12,   960,  540, 10, true },
+    { VLC_CODEC_I420, 1920, 1080, VLC_CODEC_I420,  1024,  576, 2, true },
+    /* Not split into bands: the vertical step is not exact */
+    { VLC_CODEC_I420, 1280,  720, VLC_CODEC_YUYV,  1920, 1080, 4, false },
+    { VLC_CODEC_I420, 1920, 1080, VLC_CODEC_I420,  1280,  700, 2, false },
+};
+
+/* Number of bands reported by the last scaler that split its pictures */
+static int i_logged_bands;
+
+static void LogCallback( void *p_data, int i_level, const libvlc_log_t *p_ctx,
+                         const char *psz_fmt, va_list args )
+{
+    char psz_msg[256];
+    int i_bands;
+
+    (void)p_data; (void)i_level; (void)p_ctx;
+    vsnprintf( psz_msg, sizeof(psz_msg), psz_fmt, args );
+    if( sscanf( psz_msg, "converting in %d bands", &i_bands ) == 1 )
+        i_logged_bands = i_bands;
+}
+
+static picture_t *NewBuffer( filter_t *p_filter )
+{
+    return picture_NewFromFormat( &p_filter->fmt_out.video );
+}
+
+static void DelBuffer( filter_t *p_filter, picture_t *p_pic )
+{
+    (void)p_filter;
+    picture_Release( p_pic );
+}
+
+static filter_t *CreateFilter( vlc_object_t *p_parent, const conversion_t *p_conv,
+                               int i_threads )
+{
+    filter_t *p_filter = vlc_object_create( p_parent, sizeof(*p_filter) );
+    if( !p_filter )
+        return NULL;
+
+    var_Create( p_filter, "swscale-threads", VLC_VAR_INTEGER );
+    var_SetInteger( p_filter, "swscale-threads", i_threads );
+    var_Create( p_filter, "swscale-mode", VLC_VAR_INTEGER );
+    var_SetInteger( p_filter, "swscale-mode", p_conv->i_mode );
+
+    p_filter->pf_video_buffer_new = NewBuffer;
+    p_filter->pf_video_buffer_del = DelBuffer;
+
+    es_format_Init( &p_filter->fmt_in, VIDEO_ES, p_conv->i_src_chroma );
+    video_format_Setup( &p_filter->fmt_in.video, p_conv->i_src_chroma,
+                        p_conv->i_src_width, p_conv->i_src_height, 1, 1 );
+    es_format_Init( &p_filter->fmt_out, VIDEO_ES, p_conv->i_dst_chroma );
+    video_format_Setup( &p_filter->fmt_out.video, p_conv->i_dst_chroma,
+                        p_conv->i_dst_width, p_conv->i_dst_height, 1, 1 );
+
+    p_filter->p_module = module_need( p_filter, "video filter2", "swscale", true );
+    if( !p_filter->p_module )
+    {
+        vlc_object_release( p_filter );
+        return NULL;
+    }
+    return p_filter;
+}
+
+static void DeleteFilter( filter_t *p_filter )
+{
+    module_unneed( p_filter, p_filter->p_module );
+    es_format_Clean( &p_filter->fmt_in );
+    es_format_Clean( &p_filter->fmt_out );
+    vlc_object_release( p_filter );
+}
+
+static void FillPicture( picture_t *p_pic, unsigned i_seed )
+{
+    for( int n = 0; n < p_pic->i_planes; n++ )
+    {
+        plane_t *p = &p_pic->p[n];
+        for( int y = 0; y < p->i_lines; y++ )
+            for( int x = 0; x < p->i_pitch; x++ )
+            {
+                /* Smooth gradients with some noise, so that the filters
+                 * have something to work on */
+                i_seed = i_seed * 1103515245 + 12345;
+                p->p_pixels[y * p->i_pitch + x] =
+                    (x + 2 * y + n * 64) + ((i_seed >> 16) & 0x0f);
+            }
+    }
+}
+
+static bool SamePictures( const picture_t *p_a, const picture_t *p_b )
+{
+    for( int n = 0; n < p_a->i_planes; n++ )
+    {
+        const plane_t *a = &p_a->p[n];
+        const plane_t *b = &p_b->p[n];
+        for( int y = 0; y < a->i_visible_lines; y++ )
+            if( memcmp( &a->p_pixels[y * a->i_pitch],
+                        &b->p_pixels[y * b->i_pitch], a->i_visible_pitch ) )
+            {
+                log( "plane %d differs at row %d\n", n, y );
+                return false;
+            }
+    }
+    return true;
+}
+
+/* Converts the pictures with the filter, returns the outputs and the
+ * conversion time */
+static mtime_t Convert( filter_t *p_filter, picture_t **pp_src, picture_t **pp_dst )
+{
+    mtime_t i_start = mdate();
+    for( int i = 0; i < FRAMES; i++ )
+    {
+        pp_dst[i] = p_filter->pf_video_filter( p_filter, picture_Hold( pp_src[i] ) );
+        assert( pp_dst[i] != NULL );
+    }
+    return mdate() - i_start;
+}
+
+static int test_conversion( vlc_object_t *p_parent, const conversion_t *p_conv )
+{
+    filter_t *p_single = CreateFilter( p_parent, p_conv, 1 );
+    if( !p_single )
+        return 77;
+    i_logged_bands = 0;
+    filter_t *p_banded = CreateFilter( p_parent, p_conv, 4 );
+    assert( p_banded != NULL );
+
+    int i_ret = 0;
+    if( p_conv->b_banded ? i_logged_bands < 2 : i_logged_bands != 0 )
+    {
+        log( "%4.4s %ux%u -> %4.4s %ux%u: %d bands, %s expected\n",
+             (const char *)&p_conv->i_src_chroma,
+             p_conv->i_src_width, p_conv->i_src_height,
+             (const char *)&p_conv->i_dst_chroma,
+             p_conv->i_dst_width, p_conv->i_dst_height, i_logged_bands,
+             p_conv->b_banded ? "several" : "none" );
+        i_ret = 1;
+    }
+
+    picture_t *pp_src[FRAMES], *pp_single[FRAMES], *pp_banded[FRAMES];
+    for( int i = 0; i < FRAMES; i++ )
+    {
+        pp_src[i] = picture_NewFromFormat( &p_single->fmt_in.video );
+        assert( pp_src[i] != NULL );
+        FillPicture( pp_src[i], i );
+    }
+
+    const mtime_t i_single = Convert( p_single, pp_src, pp_single );
+    const mtime_t i_banded = Convert( p_banded, pp_src, pp_banded );
+
+    log( "%4.4s %ux%u -> %4.4s %ux%u mode %d: "
+         "%.1f fps single, %.1f fps in %d bands\n",
+         (const char *)&p_conv->i_src_chroma,
+         p_conv->i_src_width, p_conv->i_src_height,
+         (const char *)&p_conv->i_dst_chroma,
+         p_conv->i_dst_width, p_conv->i_dst_height, p_conv->i_mode,
+         FRAMES * (double)CLOCK_FREQ / __MAX( i_single, 1 ),
+         FRAMES * (double)CLOCK_FREQ / __MAX( i_banded, 1 ),
+         __MAX( i_logged_bands, 1 ) );
+
+    for( int i = 0; i < FRAMES; i++ )
+    {
+        if( !SamePictures( pp_single[i], pp_banded[i] ) )
+            i_ret = 1;
+        picture_Release( pp_src[i] );
+        picture_Release( pp_single[i] );
+        picture_Release( pp_banded[i] );
+    }
+
+    DeleteFilter( p_single );
+    DeleteFilter( p_banded );
+    return i_ret;
+}
+
+int main( void )
+{
+    test_init();
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+    libvlc_log_set( p_vlc, LogCallback, NULL );
+
+    int i_ret = 0;
+    for( size_t i = 0; i < sizeof(conversions) / sizeof(conversions[0]); i++ )
+    {
+        int i_conv = test_conversion( VLC_OBJECT(p_vlc->p_libvlc_int),
+                                      &conversions[i] );
+        if( i_conv == 77 )
+        {
+            log( "swscale plugin not found, skipping\n" );
+            i_ret = 77;
+            break;
+        }
+        if( i_conv )
+            i_ret = 1;
+    }
+
+    libvlc_release( p_vlc );
+    return i_ret;
+}
@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * yadif.c: test of the yadif deinterlacer line filters
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Checks that the AVX2 line filter gives the same output as the C
+ * reference on random and smooth lines, with all modes and parities.
+ * Exits with 77 (skipped) if the CPU or the compiler lacks AVX2. */
+
+#include "../../libvlc/test.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+
+#include "../../../modules/video_filter/deinterlace/algo_yadif.c"
+/* Fallback of RenderYadif() */
+#include "../../../modules/video_filter/deinterlace/algo_x.c"
+
+#ifdef HAVE_AVX2_INTRINSICS
+
+#define MARGIN (32)
+#define STRIDE (2048 + 2 * MARGIN)
+#define LINES  (5)
+
+/* Five lines per field, the filtered one being the middle one */
+static uint8_t prev[LINES * STRIDE], cur[LINES * STRIDE], next[LINES * STRIDE];
+static uint8_t dst_c[STRIDE], dst_avx2[STRIDE];
+
+static unsigned i_seed = 1;
+
+static uint8_t Random( void )
+{
+    i_seed = i_seed * 1103515245 + 12345;
+    return i_seed >> 16;
+}
+
+/* Noise, or smooth gradients with a little noise so that the spatial and
+ * temporal checks of the filter take all their branches */
+static void FillField( uint8_t *p_field, bool b_smooth, int i_phase )
+{
+    for( int y = 0; y < LINES; y++ )
+        for( int x = 0; x < STRIDE; x++ )
+            p_field[y * STRIDE + x] = b_smooth
+                ? (uint8_t)(x + 3 * y + i_phase + (Random() & 7))
+                : Random();
+}
+
+static int test_line( int i_width, int i_mode, int i_parity, bool b_smooth )
+{
+    FillField( prev, b_smooth, 0 );
+    FillField( cur, b_smooth, 4 );
+    FillField( next, b_smooth, 8 );
+    memset( dst_c, 0x55, sizeof(dst_c) );
+    memset( dst_avx2, 0x55, sizeof(dst_avx2) );
+
+    const int i_offset = 2 * STRIDE + MARGIN;
+    yadif_filter_line_c( &dst_c[MARGIN], &prev[i_offset], &cur[i_offset],
+                         &next[i_offset], i_width, STRIDE, -STRIDE,
+                         i_parity, i_mode );
+    yadif_filter_line_avx2( &dst_avx2[MARGIN], &prev[i_offset],
+                            &cur[i_offset], &next[i_offset], i_width,
+                            STRIDE, -STRIDE, i_parity, i_mode );
+
+    if( memcmp( dst_c, dst_avx2, sizeof(dst_c) ) )
+    {
+        for( int x = 0; x < STRIDE; x++ )
+            if( dst_c[x] != dst_avx2[x] )
+            {
+                log( "width %d mode %d parity %d %s: pixel %d is %u, not %u\n",
+                     i_width, i_mode, i_parity, b_smooth ? "smooth" : "random",
+                     x - MARGIN, dst_avx2[x], dst_c[x] );
+                break;
+            }
+        return 1;
+    }
+    return 0;
+}
+
+int main( void )
+{
+    static const int pi_widths[] = { 1, 15, 16, 17, 31, 32, 33, 360, 719,
+                                     720, 1918, 1920, 2048 };
+    int i_ret = 0;
+
+    test_init();
+
+    if( !vlc_CPU_AVX2() )
+    {
+        log( "AVX2 not supported by the CPU, skipping\n" );
+        return 77;
+    }
+
+    for( size_t i = 0; i < sizeof(pi_widths) / sizeof(pi_widths[0]); i++ )
+        for( int i_mode = 0; i_mode < 4; i_mode++ )
+            for( int i_parity = 0; i_parity < 2; i_parity++ )
+                for( int i_run = 0; i_run < 8; i_run++ )
+                    if( test_line( pi_widths[i], i_mode, i_parity, i_run & 1 ) )
+                        i_ret = 1;
+
+    if( !i_ret )
+        log( "AVX2 line filter matches the C one\n" );
+    return i_ret;
+}
+
+#else
+
+int main( void )
+{
+    test_init();
+    log( "AVX2 not supported by the compiler, skipping\n" );
+    return 77;
+}
+
+#endif